@@ -74,6 +74,11 @@ extern bool readFileFromSD(const char *fn, uint8_t *buf, int len);
 extern bool writeFileToSD(const char *fn, uint8_t *buf, int len);
 extern bool readFileFromFS(const char *fn, uint8_t *buf, int len);
 extern bool writeFileToFS(const char *fn, uint8_t *buf, int len);
+extern void removeFileFromFS(const char *fn);
+extern bool readBlobFromNVS(const char *key, uint8_t *buf, int len);
+extern bool writeBlobToNVS(const char *key, uint8_t *buf, int len);
+
+extern uint32_t i2cErrCount;
 
 static const char months[12][4] = {
     "JAN", "FEB", "MAR", "APR", "MAY", "JUN",
@@ -82,11 +87,44 @@ static const char months[12][4] = {
 
 static const char *nullStr = "";
 
+// File names (SD in FlashROMode; flash FS for migration from 
+// previous versions and as fallback). NVS keys are the names 
+// without the "/".
 static const char *fnLastYear = "/tcdly";
 static const char *fnEEPROM[3] = {
     "/tcddt", "/tcdpt", "/tcdlt"
 };
 
+/*
+ * NVS with flash FS fallback
+ *
+ * If writing to NVS fails, the data goes into a file in the 
+ * flash FS. Such a file - or one of a previous version - is 
+ * therefore always newer than what is in NVS. When found, it
+ * is moved into NVS and removed.
+ */
+static bool readNVMBlob(const char *fn, uint8_t *buf, int len)
+{
+    if(readFileFromFS(fn, buf, len)) {
+        if(writeBlobToNVS(fn + 1, buf, len)) {
+            removeFileFromFS(fn);
+        }
+        return true;
+    }
+
+    return readBlobFromNVS(fn + 1, buf, len);
+}
+
+static bool writeNVMBlob(const char *fn, uint8_t *buf, int len)
+{
+    if(writeBlobToNVS(fn + 1, buf, len)) {
+        removeFileFromFS(fn);
+        return true;
+    }
+
+    return writeFileToFS(fn, buf, len);
+}
+
 // Store i2c address and display ID
 clockDisplay::clockDisplay(uint8_t did, uint8_t address)
 {
@@ -144,7 +182,7 @@ void clockDisplay::realLampTest()
     for(int i = 0; i < CD_BUF_SIZE*2; i++) {
         Wire.write(0xff);
     }
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 #endif
 
@@ -152,6 +190,8 @@ void clockDisplay::realLampTest()
 // Used for effects and brightness keypad menu
 void clockDisplay::lampTest(bool randomize)
 {
+    _stripIdx = -1;
+
     Wire.beginTransmission(_address);
     Wire.write(0x00);  // start address
 
@@ -168,7 +208,7 @@ void clockDisplay::lampTest(bool randomize)
         }
     }
     
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 // Clear the buffer
@@ -266,6 +306,8 @@ void clockDisplay::setDateTime(DateTime& dt)
     setDay(dt.day());
     setHour(dt.hour());
     setMinute(dt.minute());
+
+    _lastDTValid = false;
 }
 
 // Set the displayed time with supplied DateTime object with timeDifference
@@ -274,35 +316,50 @@ void clockDisplay::setDateTimeDiff(DateTime& dt)
     uint64_t rtcTime;
     int year, month, day, hour, minute;
 
-    if(!timeDifference) {
-        setDateTime(dt);
+    // If called every second, avoid re-calculating all fields
+    if(advanceMinute(dt))
         return;
-    }
 
-    rtcTime = dateToMins(dt.year() - _yearoffset, dt.month(), dt.day(), dt.hour(), dt.minute());
+    _lastDTValid = false;
 
-    if(timeDiffUp) {
-        rtcTime += timeDifference;
-        // Don't care about 9999-10000 roll-over
-        // So we display 0000 for 10000+
-        // So be it.
+    if(!timeDifference) {
+        setDateTime(dt);
     } else {
-        rtcTime -= timeDifference;
-    }
 
-    minsToDate(rtcTime, year, month, day, hour, minute);
+        rtcTime = dateToMins(dt.year() - _yearoffset, dt.month(), dt.day(), dt.hour(), dt.minute());
 
-    setYear(year + _yearoffset);
-    setMonth(month);
-    setDay(day);
-    setHour(hour);
-    setMinute(minute);
+        if(timeDiffUp) {
+            rtcTime += timeDifference;
+            // Don't care about 9999-10000 roll-over
+            // So we display 0000 for 10000+
+            // So be it.
+        } else {
+            rtcTime -= timeDifference;
+        }
+
+        minsToDate(rtcTime, year, month, day, hour, minute);
+
+        setYear(year + _yearoffset);
+        setMonth(month);
+        setDay(day);
+        setHour(hour);
+        setMinute(minute);
+
+    }
+
+    _lastDT = dt;
+    _lastTimeDiff = timeDifference;
+    _lastTimeDiffUp = timeDiffUp;
+    _lastYearOffs = _yearoffset;
+    _lastDTValid = true;
 }
 
 // Set YEAR, MONTH, DAY, HOUR, MIN from structure
 // Never use for RTC!
 void clockDisplay::setFromStruct(const dateStruct *s)
 {    
+    _lastDTValid = false;
+
     setYear(s->year);
     setMonth(s->month);
     setDay(s->day);
@@ -312,6 +369,8 @@ void clockDisplay::setFromStruct(const dateStruct *s)
 
 void clockDisplay::setFromParms(int year, int month, int day, int hour, int minute)
 {
+    _lastDTValid = false;
+
     setYear(year);
     setMonth(month);
     setDay(day);
@@ -350,13 +409,15 @@ void clockDisplay::showAnimate2()
     if(_nightmode && _NmOff)
         return;
 
+    _stripIdx = -1;
+
     Wire.beginTransmission(_address);
     Wire.write(0x00);
     for(int i = 0; i < CD_BUF_SIZE; i++) {
         Wire.write(_displayBuffer[i] & 0xff);
         Wire.write(_displayBuffer[i] >> 8);
     }
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 void clockDisplay::showAlt()
@@ -710,6 +771,75 @@ void clockDisplay::showTextDirect(const char *text, uint16_t flags)
     _corr6 = _withColon = false;
 }
 
+// Pre-render text into segment patterns for showStripDirect(),
+// so scrolling does not need to look up the font for each step.
+// Returns the number of characters rendered.
+int clockDisplay::renderStrip(const char *text, stripChar *strip, int maxLen)
+{
+    int i;
+
+    _stripIdx = -1;
+
+    for(i = 0; text[i] && i < maxLen; i++) {
+        strip[i].seg7 = getLED7AlphaChar(text[i]);
+        #ifdef IS_ACAR_DISPLAY
+        strip[i].alpha = strip[i].seg7;
+        #else
+        strip[i].alpha = getLEDAlphaChar(text[i]);
+        #endif
+    }
+
+    return i;
+}
+
+// Show pre-rendered text starting at character idx. Layout
+// is the same as showTextDirect(text + idx), but the display
+// RAM is written in one go. Nothing is written if the display
+// already shows this (no other writes since, no re-render).
+void clockDisplay::showStripDirect(const stripChar *strip, int len, int idx)
+{
+    uint16_t buf[CD_BUF_SIZE];
+    int pos = CD_MONTH_POS;
+    int startIdx = idx;
+
+    if(idx == _stripIdx && strip == _strip && len == _stripLen && _yearDot == _stripYDot)
+        return;
+
+    memset(buf, 0, sizeof(buf));
+
+    while(idx < len && pos < (CD_MONTH_POS+CD_MONTH_SIZE)) {
+        buf[pos] = strip[idx++].alpha;
+        #ifdef IS_ACAR_DISPLAY
+        if(idx < len) buf[pos] |= (strip[idx++].alpha << 8);
+        #endif
+        pos++;
+    }
+
+    pos = CD_DAY_POS;
+    while(idx < len && pos <= CD_MIN_POS) {
+        buf[pos] = strip[idx++].seg7;
+        if(idx < len) buf[pos] |= (strip[idx++].seg7 << 8);
+        pos++;
+    }
+
+    if(_yearDot) buf[CD_YEAR_POS + 1] |= 0x8000;
+
+    Wire.beginTransmission(_address);
+    Wire.write(0x00);
+    for(int i = 0; i < CD_BUF_SIZE; i++) {
+        Wire.write(buf[i] & 0xff);
+        Wire.write(buf[i] >> 8);
+    }
+    if(Wire.endTransmission()) {
+        i2cErrCount++;
+    } else {
+        _strip = strip;
+        _stripLen = len;
+        _stripIdx = startIdx;
+        _stripYDot = _yearDot;
+    }
+}
+
 // Clear the display RAM and only show the provided 2 numbers (parts of IP)
 void clockDisplay::showHalfIPDirect(int a, int b, uint16_t flags)
 {
@@ -909,7 +1039,7 @@ bool clockDisplay::saveLastYear(uint16_t theYear)
         return true;
 
     #ifdef TC_DBG
-    Serial.printf("Clockdisplay: Saving RTC/LastYear to %s\n", FlashROMode ? "SD" : "Flash");
+    Serial.printf("Clockdisplay: Saving RTC/LastYear to %s\n", FlashROMode ? "SD" : "NVS");
     #endif
     
     savBuf[0] = theYear & 0xff;
@@ -920,7 +1050,7 @@ bool clockDisplay::saveLastYear(uint16_t theYear)
     if(FlashROMode) {
         writeFileToSD(fnLastYear, savBuf, 4);
     } else {
-        writeFileToFS(fnLastYear, savBuf, 4);
+        writeNVMBlob(fnLastYear, savBuf, 4);
     }
 
     _lastWrittenLY = theYear;
@@ -1068,7 +1198,7 @@ int16_t clockDisplay::loadLastYear()
     if(FlashROMode) {
         readFileFromSD(fnLastYear, loadBuf, 4);
     } else {
-        readFileFromFS(fnLastYear, loadBuf, 4);
+        readNVMBlob(fnLastYear, loadBuf, 4);
     }
 
     if( (loadBuf[0] == (loadBuf[2] ^ 0xff)) &&
@@ -1103,7 +1233,7 @@ bool clockDisplay::saveNVMData(uint8_t *savBuf, bool noReadChk)
 
     if(!skipSave) {
         #ifdef TC_DBG
-        Serial.printf("saveNVMData to %s\n", FlashROMode ? "SD" : "Flash");
+        Serial.printf("saveNVMData to %s\n", FlashROMode ? "SD" : "NVS");
         #endif
         for(uint8_t i = 0; i < 9; i++) {
             sum += (savBuf[i] ^ 0x55);
@@ -1112,7 +1242,7 @@ bool clockDisplay::saveNVMData(uint8_t *savBuf, bool noReadChk)
         if(FlashROMode) {
             return writeFileToSD(fnEEPROM[_did], savBuf, 10);
         } else {
-            return writeFileToFS(fnEEPROM[_did], savBuf, 10);
+            return writeNVMBlob(fnEEPROM[_did], savBuf, 10);
         }
     }
     return true;
@@ -1126,13 +1256,13 @@ bool clockDisplay::loadNVMData(uint8_t *loadBuf)
     memset(loadBuf, 0, 10);
 
     #ifdef TC_DBG
-    Serial.printf("loadNVMData from %s\n", FlashROMode ? "SD" : "Flash");
+    Serial.printf("loadNVMData from %s\n", FlashROMode ? "SD" : "NVS");
     #endif
         
     if(FlashROMode) {
         readFileFromSD(fnEEPROM[_did], loadBuf, 10);
     } else {
-        readFileFromFS(fnEEPROM[_did], loadBuf, 10);
+        readNVMBlob(fnEEPROM[_did], loadBuf, 10);
     }
 
     for(uint8_t i = 0; i < 9; i++) {
@@ -1142,18 +1272,6 @@ bool clockDisplay::loadNVMData(uint8_t *loadBuf)
     return ((sum & 0xff) == loadBuf[9]);
 }
 
-// Returns bit pattern for provided value 0-9 or number provided as a char '0'-'9'
-// for display on 7 segment display
-uint8_t clockDisplay::getLED7NumChar(uint8_t value)
-{
-    if(value >= '0' && value <= '9') {
-        return numDigs[value - 32];
-    } else if(value <= 9) {
-        return numDigs[value + '0' - 32];
-    }
-    return 0;
-}
-  
 // Returns bit pattern for provided character for display on 7 segment display
 uint8_t clockDisplay::getLED7AlphaChar(uint8_t value)
 {
@@ -1181,21 +1299,79 @@ uint16_t clockDisplay::getLEDAlphaChar(uint8_t value)
 }
 #endif
 
+/*
+ * Incremental update for setDateTimeDiff():
+ * If the given time is the same as, or one minute ahead of, the
+ * time last set (with identical timeDifference and yearOffset), 
+ * update the fields by carrying over from the minute instead of 
+ * the dateToMins()/minsToDate() round trip.
+ * Returns false if a full update is required.
+ */
+bool clockDisplay::advanceMinute(DateTime& dt)
+{
+    int minute, hour;
+
+    if(!_lastDTValid                       ||
+       (_lastTimeDiff   != timeDifference) ||
+       (_lastTimeDiffUp != timeDiffUp)     ||
+       (_lastYearOffs   != _yearoffset)    ||
+       (dt.year()       != _lastDT.year()) ||
+       (dt.month()      != _lastDT.month())||
+       (dt.day()        != _lastDT.day()))
+        return false;
+
+    if(dt.hour() == _lastDT.hour()) {
+
+        if(dt.minute() == _lastDT.minute()) {
+            // Nothing changed; refresh dots only
+            setYear(_year);
+            setMinute(_minute);
+            _lastDT = dt;
+            return true;
+        }
+        if(dt.minute() != _lastDT.minute() + 1)
+            return false;
+
+    } else if((dt.hour() != _lastDT.hour() + 1) || dt.minute() || (_lastDT.minute() != 59)) {
+        return false;
+    }
+
+    minute = _minute + 1;
+    hour = _hour;
+
+    if(minute > 59) {
+        minute = 0;
+        if(++hour > 23) {
+            // Day change: Leave this to full update
+            return false;
+        }
+        setHour(hour);
+    }
+    setYear(_year);
+    setMinute(minute);
+
+    _lastDT = dt;
+
+    return true;
+}
+
 // Make a 2 digit number from the array and return the segment data
 // (makes leading 0s)
 uint16_t clockDisplay::makeNum(uint8_t num, uint16_t dflags)
 {
-    uint16_t segments = 0;
-
     // Each position holds two digits
     // MSB = 1s, LSB = 10s
 
-    segments = getLED7NumChar(num % 10) << 8;     
-    if(!(dflags & CDD_NOLEAD0) || (num / 10)) {
-        segments |= getLED7NumChar(num / 10);   
+    if(num > 99) {
+        // Out of range: 1s digit only
+        return numPairs[num % 10] & 0xff00;
+    }
+
+    if((dflags & CDD_NOLEAD0) && num < 10) {
+        return numPairs[num] & 0xff00;
     }
 
-    return segments;
+    return numPairs[num];
 }
 
 // Directly write to a column with supplied segments
@@ -1207,16 +1383,19 @@ void clockDisplay::directCol(int col, int segments)
     } else if(_withColon && (col == CD_YEAR_POS)) {
         segments |= 0x8080;
     }
+    _stripIdx = -1;
     Wire.beginTransmission(_address);
     Wire.write(col * 2);
     Wire.write(segments & 0xff);
     Wire.write(segments >> 8);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 // Directly clear the display
 void clockDisplay::clearDisplay()
 {
+    _stripIdx = -1;
+
     Wire.beginTransmission(_address);
     Wire.write(0x00);
 
@@ -1224,7 +1403,7 @@ void clockDisplay::clearDisplay()
         Wire.write(0x00);
     }
 
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 bool clockDisplay::handleNM()
@@ -1269,6 +1448,8 @@ void clockDisplay::showInt(bool animate, bool Alt)
 
     (_colon) ? colonOn() : colonOff();
 
+    _stripIdx = -1;
+
     Wire.beginTransmission(_address);
     Wire.write(0x00);
 
@@ -1285,7 +1466,7 @@ void clockDisplay::showInt(bool animate, bool Alt)
         Wire.write(db[i] >> 8);
     }
 
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 
     if(animate || (_NmOff && (_oldnm > 0)) ) on();
 
@@ -1321,11 +1502,13 @@ void clockDisplay::AMPMoff()
 
 void clockDisplay::directAMPM(int val1, int val2)
 {
+    _stripIdx = -1;
+
     Wire.beginTransmission(_address);
     Wire.write(CD_AMPM_POS * 2);
     Wire.write(val1 & 0xff);
     Wire.write(val2 & 0xff);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 void clockDisplay::directAM()
@@ -1347,5 +1530,5 @@ void clockDisplay::directCmd(uint8_t val)
 {
     Wire.beginTransmission(_address);
     Wire.write(val);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
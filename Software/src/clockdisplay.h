@@ -47,6 +47,12 @@ struct dateStruct {
 
 #define CD_BUF_SIZE   8  // Buffer size in words (16bit)
 
+// Pre-rendered character for scrolling text (showStripDirect)
+struct stripChar {
+    uint16_t alpha;     // Pattern for month field
+    uint8_t  seg7;      // Pattern for 7-segment fields
+};
+
 // Flags for textDirect() etc (flags)
 #define CDT_CLEAR 0x0001
 #define CDT_CORR6 0x0002
@@ -131,6 +137,8 @@ class clockDisplay {
         void showYearDirect(int yearNum, uint16_t dflags = 0);
 
         void showTextDirect(const char *text, uint16_t flags = CDT_CLEAR);
+        int  renderStrip(const char *text, stripChar *strip, int maxLen);
+        void showStripDirect(const stripChar *strip, int len, int idx);
         void showHalfIPDirect(int a, int b, uint16_t flags = 0);
         void showSettingValDirect(const char* setting, int8_t val = -1, uint16_t flags = 0);
 
@@ -153,7 +161,6 @@ class clockDisplay {
         bool     saveNVMData(uint8_t *savBuf, bool noReadChk = false);
         bool     loadNVMData(uint8_t *loadBuf);
 
-        uint8_t  getLED7NumChar(uint8_t value);
         uint8_t  getLED7AlphaChar(uint8_t value);
         #ifndef IS_ACAR_DISPLAY
         uint16_t getLEDAlphaChar(uint8_t value);
@@ -161,6 +168,8 @@ class clockDisplay {
 
         uint16_t makeNum(uint8_t num, uint16_t dflags = 0);
 
+        bool     advanceMinute(DateTime& dt);
+
         void directCol(int col, int segments);  // directly writes column RAM
 
         void clearDisplay();                    // clears display RAM
@@ -190,6 +199,12 @@ class clockDisplay {
 
         int16_t  _lastWrittenLY = -333; // Not to be confused with possible results from loadLastYear
 
+        DateTime _lastDT;               // For incremental updates in setDateTimeDiff()
+        bool     _lastDTValid = false;
+        uint64_t _lastTimeDiff = 0;
+        bool     _lastTimeDiffUp = false;
+        int16_t  _lastYearOffs = 0;
+
         int8_t  _isDST = 0;             // DST active? -1:dunno 0:no 1:yes
 
         uint8_t _month = 1;
@@ -207,6 +222,12 @@ class clockDisplay {
         bool _corr6 = false;
         bool _yearDot = false;
         bool _withColon = false;
+
+        // What showStripDirect() last wrote
+        const stripChar *_strip = NULL;
+        int  _stripLen = 0;
+        int  _stripIdx = -1;
+        bool _stripYDot = false;
 };
 
 #endif
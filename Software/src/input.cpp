@@ -73,11 +73,6 @@
 #define MAX_ROWS  4
 #define MAX_COLS  3
 
-static void defaultDelay(unsigned int mydelay)
-{
-    delay(mydelay);
-}
-
 /*
  * Keypad_i2c class
  */
@@ -102,11 +97,10 @@ Keypad_I2C::Keypad_I2C(char *userKeymap, const uint8_t *row, const uint8_t *col,
 
     setScanInterval(10);
     setHoldTime(500);
+    setDebounceTime(15);
 
     _keypadEventListener = NULL;
 
-    _customDelayFunc = defaultDelay;
-
     _key.kState = TCKS_IDLE;
     _key.kChar = 0;
     _key.kCode = -1;
@@ -128,6 +122,15 @@ void Keypad_I2C::begin()
     for(int i = 0; i < _rows; i++) {
         _rowMask |= (1 << _rowPins[i]);
     }
+
+    // Build colMask for idle state
+    _colMask = 0;
+    for(int i = 0; i < _columns; i++) {
+        _colMask |= (1 << _columnPins[i]);
+    }
+
+    // Idle state: All columns LOW
+    port_write(_pinState & ~_colMask);
 }
 
 void Keypad_I2C::setScanInterval(unsigned int interval)
@@ -140,14 +143,14 @@ void Keypad_I2C::setHoldTime(unsigned int hold)
     _holdTime = hold;
 }
 
-void Keypad_I2C::addEventListener(void (*listener)(char, KeyState))
+void Keypad_I2C::setDebounceTime(unsigned int debounceTime)
 {
-    _keypadEventListener = listener;
+    _debounceTime = debounceTime;
 }
 
-void Keypad_I2C::setCustomDelayFunc(void (*myDelay)(unsigned int))
+void Keypad_I2C::addEventListener(void (*listener)(char, KeyState))
 {
-    _customDelayFunc = myDelay;
+    _keypadEventListener = listener;
 }
 
 // Scan keypad and update key state
@@ -169,83 +172,72 @@ bool Keypad_I2C::scanKeypad()
  */
 
 // Hardware scan & update key state
+//
+// In idle state, all columns are driven LOW, so a single read 
+// tells us whether any key is down. Only if so, the matrix is 
+// scanned column by column. Debouncing is time-based: A scan 
+// result counts only after being stable for _debounceTime.
 bool Keypad_I2C::scanKeys()
 {
-    uint16_t pinVals[3][MAX_COLS], rm;
-    bool     repeat, haveKey;
-    int      maxRetry = 5;
-    int      kc;
-    uint8_t  c, r, d;
-
-    do {
-
-        repeat = haveKey = false;
-
-        for(d = 0; d < 3; d++) {
-
-            for(c = 0; c < _columns; c++) {
-
-                pin_write(_columnPins[c], LOW);
-
-                _wire->requestFrom(_i2caddr, (int)1);
-                if((pinVals[d][c] = _wire->read() & _rowMask) != _rowMask) 
-                    haveKey = true;
-
-                pin_write(_columnPins[c], HIGH);
-
-            }
-
-            if(d < 2) (*_customDelayFunc)(5);
-
-        }
+    unsigned long now = millis();
+    int rawCode = -1;
 
-        for(c = 0; c < _columns; c++) {
-            if((pinVals[0][c] != pinVals[1][c]) || (pinVals[0][c] != pinVals[2][c])) 
-                repeat = true;
-        }
+    if((port_read() & _rowMask) != _rowMask) {
+        rawCode = scanMatrix();
+    }
 
-    } while(maxRetry-- && repeat);
+    if(rawCode != _rawCode) {
+        _rawCode = rawCode;
+        _rawTime = now;
+    } else if(now - _rawTime >= _debounceTime) {
+        _stableCode = rawCode;
+    }
 
     _key.stateChanged = false;
 
     // If we currently have an active key, advance its state
     if(_key.kCode >= 0) {
-
-        advanceState(!(pinVals[0][_key.kCode % _columns] & (1 << _rowPins[_key.kCode / _columns])));
-
-    } 
+        advanceState(_stableCode == _key.kCode);
+    }
 
     // If _key is idle, evaluate scanning result
-    if(haveKey && _key.kState == TCKS_IDLE) {
-
-        for(r = 0; r < _rows; r++) {
-
-            rm = 1 << _rowPins[r];
+    if(_stableCode >= 0 && _key.kState == TCKS_IDLE) {
+        _key.kCode = _stableCode;
+        _key.kChar = _keymap[_stableCode];
+        advanceState(CLOSED);
+    }
 
-            for(c = 0, kc = r * _columns; c < _columns; c++, kc++) {
+    return _key.stateChanged;
+}
 
-                bool newstate = !(pinVals[0][c] & rm);
+// Scan matrix, return code of first closed key (or -1). 
+// Returns with all columns LOW (idle state).
+int Keypad_I2C::scanMatrix()
+{
+    uint8_t colsHigh = _pinState | _colMask;
+    uint8_t pinVals[MAX_COLS];
+    uint8_t c, r;
 
-                if(newstate == CLOSED) {
+    for(c = 0; c < _columns; c++) {
+        port_write(colsHigh & ~(1 << _columnPins[c]));
+        pinVals[c] = port_read() & _rowMask;
+    }
 
-                    // (New) key pressed, handle it
-                    _key.kCode = kc;
-                    _key.kChar = _keymap[kc];
-                    advanceState(newstate);
-                    goto quitScan;  // bail, _key is busy
+    port_write(colsHigh & ~_colMask);
 
-                }
+    for(r = 0; r < _rows; r++) {
+        for(c = 0; c < _columns; c++) {
+            if(!(pinVals[c] & (1 << _rowPins[r]))) {
+                return r * _columns + c;
             }
         }
-        
     }
-quitScan:
 
-    return _key.stateChanged;
+    return -1;
 }
 
 // State machine. 
-// Unlike TCButton, we do not need to debounce.
+// Debouncing is done in scanKeys().
 void Keypad_I2C::advanceState(bool newstate)
 {
     switch(_key.kState) {
@@ -285,19 +277,6 @@ void Keypad_I2C::transitionTo(KeyState nextState)
     }
 }
 
-void Keypad_I2C::pin_write(uint8_t pinNum, bool level)
-{
-    uint8_t mask = 1 << pinNum;
-
-    if(level == HIGH) {
-      	_pinState |= mask;
-    } else {
-        _pinState &= ~mask;
-    }
-
-    port_write(_pinState);
-}
-
 void Keypad_I2C::port_write(uint8_t val)
 {
     _wire->beginTransmission(_i2caddr);
@@ -306,6 +285,12 @@ void Keypad_I2C::port_write(uint8_t val)
     _pinState = val;
 }
 
+uint8_t Keypad_I2C::port_read()
+{
+    _wire->requestFrom(_i2caddr, (int)1);
+    return _wire->read();
+}
+
 
 
 /*
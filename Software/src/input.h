@@ -98,11 +98,9 @@ class Keypad_I2C {
 
         void begin();
 
-        // Setter for custom delay function
-        void setCustomDelayFunc(void (*myDelay)(unsigned int));
-
         void setScanInterval(unsigned int interval);
         void setHoldTime(unsigned int holdTime);
+        void setDebounceTime(unsigned int debounceTime);
 
         void addEventListener(void (*listener)(char, KeyState));
 
@@ -111,16 +109,18 @@ class Keypad_I2C {
     private:
 
         bool scanKeys();
+        int  scanMatrix();
         void advanceState(bool kstate);
         void transitionTo(KeyState nextState);
 
         void (*_keypadEventListener)(char, KeyState);
 
-        void pin_write(uint8_t pinNum, bool level);
-        void port_write(uint8_t i2cportval);
+        void    port_write(uint8_t i2cportval);
+        uint8_t port_read();
 
         unsigned int  _scanInterval;
         unsigned int  _holdTime;
+        unsigned int  _debounceTime;
         const uint8_t *_rowPins;
         const uint8_t *_columnPins;
         uint8_t       _rows;
@@ -130,15 +130,17 @@ class Keypad_I2C {
 
         unsigned long _scanTime = 0;        
         uint16_t      _rowMask;
+        uint16_t      _colMask;
+
+        int           _rawCode = -1;      // last scan result
+        unsigned long _rawTime = 0;       // when it last changed
+        int           _stableCode = -1;   // debounced result
 
         uint8_t       _pinState;  // shadow for output pins
 
         KeyStruct     _key;
 
         TwoWire       *_wire;
-
-        // Ptr to custom delay function
-        void (*_customDelayFunc)(unsigned int) = NULL;
 };
 
 /*
@@ -34,19 +34,8 @@
 
 #include "mqtt.h"
 
-#include "lwip/inet_chksum.h"
-#include "lwip/ip.h"
-#include "lwip/ip4.h"
-#include "lwip/err.h"
-#include "lwip/icmp.h"
+#include <WiFi.h>
 #include "lwip/sockets.h"
-#include "lwip/sys.h"
-#include "lwip/netdb.h"
-#include "lwip/dns.h"
-
-static void defLooper()
-{
-}
 
 PubSubClient::PubSubClient()
 {
@@ -57,7 +46,6 @@ PubSubClient::PubSubClient()
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
-    setLooper(defLooper);
 }
 
 PubSubClient::PubSubClient(WiFiClient& client)
@@ -68,12 +56,12 @@ PubSubClient::PubSubClient(WiFiClient& client)
     setBufferSize(MQTT_MAX_PACKET_SIZE);
     setKeepAlive(MQTT_KEEPALIVE);
     setSocketTimeout(MQTT_SOCKET_TIMEOUT);
-    setLooper(defLooper);
 }
 
 PubSubClient::~PubSubClient()
 {
     free(this->buffer);
+    free(this->txBuffer);
 }
 
 bool PubSubClient::connect(const char *id)
@@ -86,199 +74,369 @@ bool PubSubClient::connect(const char *id, const char *user, const char *pass)
     return connect(id, user, pass, true);
 }
 
+/*
+ * connect() does not block: It starts the TCP connection and
+ * returns; loop() finishes it and sends the CONNECT packet. 
+ * The outcome is reflected in state(): MQTT_TCP_CONNECTING and
+ * MQTT_CONNECTING while in progress, MQTT_CONNECTED on success.
+ * id, user and pass must remain valid until the CONNACK.
+ */
 bool PubSubClient::connect(const char *id, const char *user, const char *pass, bool cleanSession)
 {
-    if(!connected()) {
-
-        int result = 0;
-
-        if(_client->connected()) {
-            result = 1;
-        } else {
-            if(domain) {
-                result = _client->connect(this->domain, this->port, (int)5000);
-            } else {
-                result = _client->connect(this->ip, this->port, (int)5000);
-            }
-        }
-
-        if(result == 1) {
-          
-            nextMsgId = 1;
-            
-            // Leave room in the buffer for header and variable length field
-            uint16_t length = MQTT_MAX_HEADER_SIZE;
-            unsigned int j;
-
-#if MQTT_VERSION == MQTT_VERSION_3_1
-            uint8_t d[9] = { 0x00, 0x06, 'M', 'Q', 'I', 's', 'd', 'p', MQTT_VERSION };
-            #define MQTT_HEADER_VERSION_LENGTH 9
-#elif MQTT_VERSION == MQTT_VERSION_3_1_1
-            uint8_t d[7] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', MQTT_VERSION };
-            #define MQTT_HEADER_VERSION_LENGTH 7
-#endif
-            for(j = 0; j < MQTT_HEADER_VERSION_LENGTH; j++) {
-                this->buffer[length++] = d[j];
-            }
+    if(connected() || _state == MQTT_TCP_CONNECTING || _state == MQTT_CONNECTING)
+        return true;
 
-            uint8_t v = 0;
-            
-            if(cleanSession) v |= 0x02;
+    _cId = id;
+    _cUser = user;
+    _cPass = pass;
+    _cClean = cleanSession;
 
-            if(user) {
-                v |= 0x80;
-                if(pass) {
-                    v |= 0x40;
-                }
-            }
-            this->buffer[length++] = v;
+    if(_client->connected()) {
+        return sendConnect();
+    }
 
-            this->buffer[length++] = (this->keepAlive >> 8);
-            this->buffer[length++] = (this->keepAlive & 0xff);
+    if(!tcpStart()) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
 
-            CHECK_STRING_LENGTH(length, id)
-            length = writeString(id, this->buffer, length);
+    _state = MQTT_TCP_CONNECTING;
 
-            if(user) {
-                CHECK_STRING_LENGTH(length, user)
-                length = writeString(user, this->buffer, length);
-                if(pass) {
-                    CHECK_STRING_LENGTH(length, pass)
-                    length = writeString(pass, this->buffer, length);
-                }
-            }
+    return true;
+}
 
-            write(MQTTCONNECT, this->buffer, length - MQTT_MAX_HEADER_SIZE);
+/*
+ * Start a non-blocking TCP connect
+ * (Domain names still require a - blocking - DNS lookup)
+ */
+bool PubSubClient::tcpStart()
+{
+    struct sockaddr_in addr;
+    IPAddress remote = this->ip;
 
-            lastInActivity = lastOutActivity = millis();
+    if(this->domain) {
+        if(!WiFi.hostByName(this->domain, remote))
+            return false;
+    }
 
-            _state = MQTT_CONNECTING;
+    if((_sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        _sock = -1;
+        return false;
+    }
 
-            return true;
-            
-        } else {
+    fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL, 0) | O_NONBLOCK);
 
-            _state = MQTT_CONNECT_FAILED;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = (uint32_t)remote;
+    addr.sin_port = htons(this->port);
 
-        }
-        
+    if(lwip_connect(_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        closesocket(_sock);
+        _sock = -1;
         return false;
-        
     }
-    
+
+    _tcpStart = millis();
+
     return true;
 }
 
-// reads a byte into result
-bool PubSubClient::readByte(uint8_t *result)
+/*
+ * Check if the TCP connection is established; if so, hand
+ * the socket over to our WiFiClient and send CONNECT.
+ * Returns false if the connection failed or timed-out.
+ */
+bool PubSubClient::tcpPoll()
 {
-    unsigned long mnow, currentMillis;
-    unsigned long previousMillis = millis();
+    fd_set fdset;
+    struct timeval tv = { 0, 0 };
+    int res, sockerr = 0;
+    socklen_t len = sizeof(sockerr);
 
-    mnow = previousMillis;
-    
-    while(!_client->available()) {
+    FD_ZERO(&fdset);
+    FD_SET(_sock, &fdset);
 
-        currentMillis =  millis();
-        
-        if(currentMillis - previousMillis >= this->socketTimeout)
-            return false;
-        
-        if(currentMillis - mnow > 20) {
-            looper();
-            mnow = millis();
+    res = select(_sock + 1, NULL, &fdset, NULL, &tv);
+
+    if(!res) {
+        if(millis() - _tcpStart < MQTT_TCP_TIMEOUT)
+            return true;
+        #ifdef TC_DBG
+        Serial.println("MQTT: TCP connect timed-out");
+        #endif
+    } else if(res > 0) {
+        getsockopt(_sock, SOL_SOCKET, SO_ERROR, &sockerr, &len);
+        if(!sockerr) {
+            int on = 1;
+            // Back to blocking, as WiFiClient expects it
+            fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL, 0) & ~O_NONBLOCK);
+            setsockopt(_sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            setsockopt(_sock, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+            *_client = WiFiClient(_sock);
+            _sock = -1;
+            return sendConnect();
         }
+        #ifdef TC_DBG
+        Serial.printf("MQTT: TCP connect failed (%d)\n", sockerr);
+        #endif
+    }
 
-        delay(2);
+    closesocket(_sock);
+    _sock = -1;
+    _state = MQTT_CONNECT_FAILED;
 
-    }
-    
-    *result = _client->read();
-    
-    return true;
+    return false;
 }
 
-// reads a byte into result[*index] and increments index
-bool PubSubClient::readByte(uint8_t *result, uint16_t *index)
+bool PubSubClient::sendConnect()
 {
-    uint16_t current_index = *index;
-    uint8_t *write_address = &(result[current_index]);
+    nextMsgId = 1;
+
+    _rxState = MQTT_RX_IDLE;
+
+    // Resend message in flight immediately once connected
+    if(_oqMsgId) _oqSent = millis() - MQTT_OUTQ_RETRY;
+
+    // Stays at that if CHECK_STRING_LENGTH bails out
+    _state = MQTT_CONNECT_FAILED;
     
-    if(readByte(write_address)) {
-        *index = current_index + 1;
-        return true;
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = MQTT_MAX_HEADER_SIZE;
+    unsigned int j;
+
+#if MQTT_VERSION == MQTT_VERSION_3_1
+    uint8_t d[9] = { 0x00, 0x06, 'M', 'Q', 'I', 's', 'd', 'p', MQTT_VERSION };
+    #define MQTT_HEADER_VERSION_LENGTH 9
+#elif MQTT_VERSION == MQTT_VERSION_3_1_1
+    uint8_t d[7] = { 0x00, 0x04, 'M', 'Q', 'T', 'T', MQTT_VERSION };
+    #define MQTT_HEADER_VERSION_LENGTH 7
+#endif
+    for(j = 0; j < MQTT_HEADER_VERSION_LENGTH; j++) {
+        this->txBuffer[length++] = d[j];
     }
+
+    uint8_t v = 0;
     
-    return false;
+    if(_cClean) v |= 0x02;
+
+    if(_cUser) {
+        v |= 0x80;
+        if(_cPass) {
+            v |= 0x40;
+        }
+    }
+    this->txBuffer[length++] = v;
+
+    this->txBuffer[length++] = (this->keepAlive >> 8);
+    this->txBuffer[length++] = (this->keepAlive & 0xff);
+
+    CHECK_STRING_LENGTH(length, _cId)
+    length = writeString(_cId, this->txBuffer, length);
+
+    if(_cUser) {
+        CHECK_STRING_LENGTH(length, _cUser)
+        length = writeString(_cUser, this->txBuffer, length);
+        if(_cPass) {
+            CHECK_STRING_LENGTH(length, _cPass)
+            length = writeString(_cPass, this->txBuffer, length);
+        }
+    }
+
+    write(MQTTCONNECT, this->txBuffer, length - MQTT_MAX_HEADER_SIZE);
+
+    lastInActivity = lastOutActivity = millis();
+
+    _sessPresent = false;
+
+    _state = MQTT_CONNECTING;
+
+    return true;
 }
 
+/*
+ * Non-blocking packet reader
+ *
+ * Consumes whatever the socket has available and returns without
+ * waiting. The state is kept across calls, so a packet may trickle
+ * in over several loop() iterations. The body is read in bulk.
+ * Returns the total packet length (fixed header included) once a
+ * packet is complete, 0 if it is not (yet) complete. 
+ * PUBLISH packets that do not fit the buffer are streamed: The
+ * topic is kept in the buffer, the payload is passed to the stream
+ * callback in chunks as it arrives, using the rest of the buffer
+ * (returns 0). Other packets that do not fit the buffer (or all, 
+ * if there is no stream callback) are read and discarded.
+ * A packet that stays incomplete for longer than socketTimeout
+ * kills the connection, since the stream is out of sync by then.
+ * Positions only advance by what read() actually returned; on a 
+ * failed read, we simply try again on the next call.
+ * Everything sent (by loop() or the application) is built in 
+ * txBuffer, so sending does not disturb a packet that is only
+ * partly received, or the topic of a streamed one.
+ */
 uint32_t PubSubClient::readPacket(uint8_t *lengthLength)
 {
-    uint16_t len = 0;
-    
-    if(!readByte(this->buffer, &len))
-        return 0;
-    
-    bool isPublish = ((this->buffer[0] & 0xf0) == MQTTPUBLISH);
-    
-    uint32_t multiplier = 1;
-    uint32_t length = 0;
-    uint8_t  digit = 0;
-    uint32_t start = 0;
+    int      avail, r;
+    uint32_t n;
+    uint8_t  digit;
 
-    do {
+    while((avail = _client->available()) > 0) {
 
-        if(len == 5) {
-            // Invalid remaining length encoding - kill the connection
-            _state = MQTT_DISCONNECTED;
-            _client->stop();
-            return 0;
+        switch(_rxState) {
+          
+        case MQTT_RX_IDLE:
+            if((r = _client->read()) < 0) return 0;
+            this->buffer[0] = r;
+            _rxPos = 1;
+            _rxRemain = 0;
+            _rxMult = 1;
+            _rxDrop = false;
+            _rxStart = millis();
+            _rxState = MQTT_RX_LENGTH;
+            break;
+
+        case MQTT_RX_LENGTH:
+            if(_rxPos == 5) {
+                // Invalid remaining length encoding - kill the connection
+                rxAbort();
+                return 0;
+            }
+            if((r = _client->read()) < 0) return 0;
+            digit = r;
+            this->buffer[_rxPos++] = digit;
+            _rxRemain += (digit & 0x7f) * _rxMult;
+            _rxMult <<= 7;
+            if(!(digit & 0x80)) {
+                _rxLLen = _rxPos - 1;
+                _rxState = MQTT_RX_BODY;
+                if(_rxPos + _rxRemain > this->bufferSize) {
+                    if(streamCallback && (this->buffer[0] & 0xf0) == MQTTPUBLISH) {
+                        _rxHdrEnd = 0;
+                        _rxState = MQTT_RX_STREAM;
+                    } else {
+                        _rxDrop = true;
+                    }
+                }
+            }
+            break;
+
+        case MQTT_RX_BODY:
+            n = _rxRemain;
+            if(n > (uint32_t)avail) n = avail;
+            if(!_rxDrop) {
+                if((r = _client->read(this->buffer + _rxPos, n)) <= 0) return 0;
+                n = r;
+                _rxPos += n;
+            } else {
+                // Drop: Read into whatever space is left behind the header
+                if(n > (uint32_t)(this->bufferSize - _rxPos)) n = this->bufferSize - _rxPos;
+                if((r = _client->read(this->buffer + _rxPos, n)) <= 0) return 0;
+                n = r;
+            }
+            _rxRemain -= n;
+            break;
+
+        case MQTT_RX_STREAM:
+            if(!_rxHdrEnd || _rxPos < _rxHdrEnd) {
+                // Variable header: topic length, topic, msgId (QoS 1)
+                n = (_rxHdrEnd ? _rxHdrEnd : _rxLLen + 3) - _rxPos;
+                if(n > (uint32_t)avail) n = avail;
+                if((r = _client->read(this->buffer + _rxPos, n)) <= 0) return 0;
+                n = r;
+                _rxPos += n;
+                _rxRemain -= n;
+                if(!_rxHdrEnd && _rxPos == _rxLLen + 3) {
+                    uint16_t tl = (this->buffer[_rxLLen+1] << 8) | this->buffer[_rxLLen+2];
+                    _rxHdrEnd = _rxLLen + 3 + tl;
+                    if((this->buffer[0] & 0x06) == MQTTQOS1) _rxHdrEnd += 2;
+                    if((uint32_t)(_rxHdrEnd - _rxPos) > _rxRemain) {
+                        // Invalid topic length - kill the connection
+                        rxAbort();
+                        return 0;
+                    }
+                    if(_rxHdrEnd + MQTT_STREAM_MINCHUNK > this->bufferSize) {
+                        // Topic too long to stream
+                        _rxDrop = true;
+                        _rxState = MQTT_RX_BODY;
+                        break;
+                    }
+                }
+                if(_rxPos == _rxHdrEnd) {
+                    uint16_t tl = (this->buffer[_rxLLen+1] << 8) | this->buffer[_rxLLen+2];
+                    if((this->buffer[0] & 0x06) == MQTTQOS1) {
+                        _rxMsgId = (this->buffer[_rxHdrEnd-2] << 8) | this->buffer[_rxHdrEnd-1];
+                    }
+                    // Move topic 1 byte to front to make room for 0-terminator
+                    memmove(this->buffer + _rxLLen + 2, this->buffer + _rxLLen + 3, tl);
+                    this->buffer[_rxLLen + 2 + tl] = 0;
+                    _rxOffs = 0;
+                    _rxTotal = _rxRemain;
+                }
+            } else {
+                // Payload: Pass on whatever is there, chunk by chunk
+                n = _rxRemain;
+                if(n > (uint32_t)avail) n = avail;
+                if(n > (uint32_t)(this->bufferSize - _rxHdrEnd)) n = this->bufferSize - _rxHdrEnd;
+                if((r = _client->read(this->buffer + _rxHdrEnd, n)) <= 0) return 0;
+                n = r;
+                _rxRemain -= n;
+                streamCallback((char *)this->buffer + _rxLLen + 2, this->buffer + _rxHdrEnd, n, _rxOffs, _rxTotal);
+                _rxOffs += n;
+                _rxStart = millis();
+                if(!_rxRemain) {
+                    _rxState = MQTT_RX_IDLE;
+                    lastInActivity = millis();
+                    if((this->buffer[0] & 0x06) == MQTTQOS1) {
+                        uint8_t ack[4] = { MQTTPUBACK, 2, (uint8_t)(_rxMsgId >> 8), (uint8_t)(_rxMsgId & 0xff) };
+                        _client->write(ack, 4);
+                        lastOutActivity = lastInActivity;
+                    }
+                    return 0;
+                }
+            }
+            break;
         }
-        
-        if(!readByte(&digit)) return 0;
-        
-        this->buffer[len++] = digit;
-        length += (digit & 0x7f) * multiplier;
-        multiplier <<= 7;
-        
-    } while((digit & 0x80) != 0);
-    
-    *lengthLength = len - 1;
 
-    if(isPublish) {
-      
-        // Read in topic length to calculate bytes to skip over for Stream writing
-        if(!readByte(this->buffer, &len)) return 0;
-        if(!readByte(this->buffer, &len)) return 0;
-        start = 2;
-        
+        if(_rxState == MQTT_RX_BODY && !_rxRemain) {
+            _rxState = MQTT_RX_IDLE;
+            if(_rxDrop) {
+                #ifdef TC_DBG
+                Serial.println("MQTT: Packet too large, ignored");
+                #endif
+                return 0;
+            }
+            *lengthLength = _rxLLen;
+            return _rxPos;
+        }
     }
-    
-    uint32_t idx = len;
 
-    for(uint32_t i = start; i < length; i++) {
-      
-        if(!readByte(&digit)) 
-            return 0;
-
-        if(len < this->bufferSize) {
-            this->buffer[len] = digit;
-            len++;
-        }
-        idx++;
+    if(_rxState != MQTT_RX_IDLE && (millis() - _rxStart >= this->socketTimeout)) {
+        #ifdef TC_DBG
+        Serial.println("MQTT: Incomplete packet timed-out");
+        #endif
+        rxAbort();
     }
 
-    if(idx > this->bufferSize)
-        len = 0; // This will cause the packet to be ignored.
-    
-    return len;
+    return 0;
+}
+
+void PubSubClient::rxAbort()
+{
+    _rxState = MQTT_RX_IDLE;
+    _state = MQTT_DISCONNECTED;
+    _client->stop();
 }
 
 bool PubSubClient::loop()
 {
-    if(_state == MQTT_CONNECTING) {
+    if(_state == MQTT_TCP_CONNECTING) {
+
+        return tcpPoll();
 
-        if(!_client->available()) {
+    } else if(_state == MQTT_CONNECTING) {
+
+        if(!_client->available() && _rxState == MQTT_RX_IDLE) {
 
             if(millis() - lastInActivity >= this->socketTimeout) {
                 _state = MQTT_CONNECTION_TIMEOUT;
@@ -296,13 +454,19 @@ bool PubSubClient::loop()
             uint8_t llen;
             uint32_t len = readPacket(&llen);
 
+            if(!len) {
+                // Incomplete (or readPacket has closed the connection)
+                return (_state == MQTT_CONNECTING);
+            }
+
             if(len == 4) {
                 if(buffer[3] == 0) {
                     lastInActivity = millis();
                     pingOutstanding = false;
+                    _sessPresent = (buffer[2] & 0x01);
                     _state = MQTT_CONNECTED;
                     #ifdef TC_DBG
-                    Serial.println("MQTT: CONNACK received");
+                    Serial.printf("MQTT: CONNACK received, session present %d\n", _sessPresent);
                     #endif
                     return true;
                 } else {
@@ -332,9 +496,9 @@ bool PubSubClient::loop()
                 _client->stop();
                 return false;
             } else {
-                this->buffer[0] = MQTTPINGREQ;
-                this->buffer[1] = 0;
-                _client->write(this->buffer, 2);
+                this->txBuffer[0] = MQTTPINGREQ;
+                this->txBuffer[1] = 0;
+                _client->write(this->txBuffer, 2);
                 lastOutActivity = t;
                 lastInActivity = t;
                 pingOutstanding = true;
@@ -342,7 +506,7 @@ bool PubSubClient::loop()
 
         }
         
-        if(_client->available()) {
+        if(_client->available() || _rxState != MQTT_RX_IDLE) {
           
             uint8_t  llen;
             uint16_t len = readPacket(&llen);
@@ -375,11 +539,11 @@ bool PubSubClient::loop()
                             payload = this->buffer + llen + 3 + tl + 2;
                             callback(topic, payload, len - llen - 3 - tl - 2);
 
-                            this->buffer[0] = MQTTPUBACK;
-                            this->buffer[1] = 2;
-                            this->buffer[2] = msgId1;
-                            this->buffer[3] = msgId2;
-                            _client->write(this->buffer, 4);
+                            this->txBuffer[0] = MQTTPUBACK;
+                            this->txBuffer[1] = 2;
+                            this->txBuffer[2] = msgId1;
+                            this->txBuffer[3] = msgId2;
+                            _client->write(this->txBuffer, 4);
                             lastOutActivity = t;
 
                         } else {
@@ -390,11 +554,18 @@ bool PubSubClient::loop()
                         }
                     }
                     
+                } else if(type == MQTTPUBACK) {
+
+                    if(_oqMsgId && len >= 4 &&
+                       _oqMsgId == ((this->buffer[llen+1] << 8) | this->buffer[llen+2])) {
+                        oqPop();
+                    }
+
                 } else if(type == MQTTPINGREQ) {
                   
-                    this->buffer[0] = MQTTPINGRESP;
-                    this->buffer[1] = 0;
-                    _client->write(this->buffer, 2);
+                    this->txBuffer[0] = MQTTPINGRESP;
+                    this->txBuffer[1] = 0;
+                    _client->write(this->txBuffer, 2);
                     
                 } else if(type == MQTTPINGRESP) {
                   
@@ -409,6 +580,8 @@ bool PubSubClient::loop()
                 
             }
         }
+
+        oqSend();
         
         return true;
     }
@@ -426,12 +599,12 @@ bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned i
         
         // Leave room in the buffer for header and variable length field
         uint16_t length = MQTT_MAX_HEADER_SIZE;
-        length = writeString(topic, this->buffer, length);
+        length = writeString(topic, this->txBuffer, length);
 
         // Add payload
         uint16_t i;
         for(i = 0; i < plength; i++) {
-            this->buffer[length++] = payload[i];
+            this->txBuffer[length++] = payload[i];
         }
 
         // Write the header
@@ -439,12 +612,115 @@ bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned i
         
         if(retained) header |= 1;
         
-        return write(header, this->buffer, length - MQTT_MAX_HEADER_SIZE);
+        return write(header, this->txBuffer, length - MQTT_MAX_HEADER_SIZE);
     }
     
     return false;
 }
 
+/*
+ * Outbound QoS1 queue
+ *
+ * Messages are queued regardless of connection state and
+ * delivered in order, one at a time: The head of the queue is
+ * sent and kept until the broker acknowledges it with PUBACK;
+ * it is resent if the PUBACK does not arrive in time, or after 
+ * a reconnect. 
+ * Retained messages for a topic that is already queued (and 
+ * not in flight) replace the queued one, so only the latest
+ * state is sent. If the queue is full, the oldest message that
+ * is not in flight is dropped.
+ */
+bool PubSubClient::queuePublish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained)
+{
+    int i, idx = -1;
+    int first = _oqMsgId ? 1 : 0;
+
+    if(strlen(topic) >= MQTT_OUTQ_TOPICLEN || plength > MQTT_OUTQ_PLLEN)
+        return false;
+
+    if(retained) {
+        for(i = first; i < _oqCount; i++) {
+            int j = (_oqHead + i) % MQTT_OUTQ_SIZE;
+            if(_oq[j].retained && !strcmp(_oq[j].topic, topic)) {
+                idx = j;
+                break;
+            }
+        }
+    }
+
+    if(idx < 0) {
+        if(_oqCount == MQTT_OUTQ_SIZE) {
+            if(first >= _oqCount) return false;
+            // Drop oldest message not in flight
+            #ifdef TC_DBG
+            Serial.println("MQTT: Outbound queue full, dropping oldest message");
+            #endif
+            for(i = first; i < _oqCount - 1; i++) {
+                _oq[(_oqHead + i) % MQTT_OUTQ_SIZE] = _oq[(_oqHead + i + 1) % MQTT_OUTQ_SIZE];
+            }
+            _oqCount--;
+        }
+        idx = (_oqHead + _oqCount) % MQTT_OUTQ_SIZE;
+        _oqCount++;
+        strcpy(_oq[idx].topic, topic);
+        _oq[idx].retained = retained;
+        _oq[idx].dup = false;
+    }
+
+    memcpy(_oq[idx].payload, payload, plength);
+    _oq[idx].plength = plength;
+
+    return true;
+}
+
+int PubSubClient::queueCount()
+{
+    return _oqCount;
+}
+
+void PubSubClient::oqSend()
+{
+    if(!_oqCount)
+        return;
+
+    if(_oqMsgId && (millis() - _oqSent < MQTT_OUTQ_RETRY))
+        return;
+
+    uint16_t length = MQTT_MAX_HEADER_SIZE;
+    uint8_t  header = MQTTPUBLISH | MQTTQOS1;
+    
+    length = writeString(_oq[_oqHead].topic, this->txBuffer, length);
+
+    // A resent message keeps its msgId
+    if(!_oqMsgId) {
+        nextMsgId++;
+        if(!nextMsgId) nextMsgId++;
+        _oqMsgId = nextMsgId;
+    }
+    this->txBuffer[length++] = (_oqMsgId >> 8);
+    this->txBuffer[length++] = (_oqMsgId & 0xff);
+
+    memcpy(this->txBuffer + length, _oq[_oqHead].payload, _oq[_oqHead].plength);
+    length += _oq[_oqHead].plength;
+
+    if(_oq[_oqHead].retained) header |= 1;
+    if(_oq[_oqHead].dup)      header |= 8;
+
+    if(write(header, this->txBuffer, length - MQTT_MAX_HEADER_SIZE)) {
+        _oq[_oqHead].dup = true;
+    }
+    
+    _oqSent = millis();
+}
+
+void PubSubClient::oqPop()
+{
+    _oqHead = (_oqHead + 1) % MQTT_OUTQ_SIZE;
+    _oqCount--;
+    _oqMsgId = 0;
+}
+
 size_t PubSubClient::buildHeader(uint8_t header, uint8_t *buf, uint16_t length)
 {
     uint8_t lenBuf[4];
@@ -537,18 +813,18 @@ bool PubSubClient::subscribe_int(bool unsubscribe, const char *topic, const char
         uint16_t length = MQTT_MAX_HEADER_SIZE;
         nextMsgId++;
         if(!nextMsgId) nextMsgId++;
-        this->buffer[length++] = (nextMsgId >> 8);
-        this->buffer[length++] = (nextMsgId & 0xff);
+        this->txBuffer[length++] = (nextMsgId >> 8);
+        this->txBuffer[length++] = (nextMsgId & 0xff);
         
-        length = writeString((char*)topic, this->buffer, length);
-        if(!unsubscribe) this->buffer[length++] = qos;
+        length = writeString((char*)topic, this->txBuffer, length);
+        if(!unsubscribe) this->txBuffer[length++] = qos;
 
         if(topic2 && topicLength2) {
-            length = writeString((char*)topic2, this->buffer, length);
-            this->buffer[length++] = qos;
+            length = writeString((char*)topic2, this->txBuffer, length);
+            this->txBuffer[length++] = qos;
         }
 
-        return write(header | MQTTQOS1, this->buffer, length - MQTT_MAX_HEADER_SIZE);
+        return write(header | MQTTQOS1, this->txBuffer, length - MQTT_MAX_HEADER_SIZE);
     }
     
     return false;
@@ -556,12 +832,20 @@ bool PubSubClient::subscribe_int(bool unsubscribe, const char *topic, const char
 
 void PubSubClient::disconnect()
 {
-    this->buffer[0] = MQTTDISCONNECT;
-    this->buffer[1] = 0;
+    if(_state == MQTT_TCP_CONNECTING) {
+        closesocket(_sock);
+        _sock = -1;
+        _state = MQTT_DISCONNECTED;
+        return;
+    }
 
-    _client->write(this->buffer, 2);
+    this->txBuffer[0] = MQTTDISCONNECT;
+    this->txBuffer[1] = 0;
+
+    _client->write(this->txBuffer, 2);
 
     _state = MQTT_DISCONNECTED;
+    _rxState = MQTT_RX_IDLE;
 
     _client->flush();
     _client->stop();
@@ -624,9 +908,15 @@ void PubSubClient::setCallback(void (*callback)(char*, uint8_t*, unsigned int))
     this->callback = callback;
 }
 
-void PubSubClient::setLooper(void (*looper)())
+/*
+ * Optional: Callback for PUBLISH packets too large for the buffer.
+ * Called with topic, chunk, chunk length, offset of chunk in payload, 
+ * and total payload length. The last chunk is the one where 
+ * offset + length == total.
+ */
+void PubSubClient::setStreamCallback(void (*callback)(char*, uint8_t*, unsigned int, uint32_t, uint32_t))
 {
-    this->looper = looper;
+    this->streamCallback = callback;
 }
 
 void PubSubClient::setClient(WiFiClient& client)
@@ -639,6 +929,11 @@ int PubSubClient::state()
     return this->_state;
 }
 
+bool PubSubClient::sessionPresent()
+{
+    return this->_sessPresent;
+}
+
 bool PubSubClient::setBufferSize(uint16_t size)
 {
     if(size == 0)
@@ -646,6 +941,7 @@ bool PubSubClient::setBufferSize(uint16_t size)
 
     if(this->bufferSize == 0) {
         this->buffer = (uint8_t*)malloc(size);
+        this->txBuffer = (uint8_t*)malloc(size);
     } else {
         uint8_t* newBuffer = (uint8_t*)realloc(this->buffer, size);
         if(newBuffer) {
@@ -653,11 +949,18 @@ bool PubSubClient::setBufferSize(uint16_t size)
         } else {
             return false;
         }
+        // If this fails, both are still at least bufferSize
+        newBuffer = (uint8_t*)realloc(this->txBuffer, size);
+        if(newBuffer) {
+            this->txBuffer = newBuffer;
+        } else {
+            return false;
+        }
     }
     
     this->bufferSize = size;
     
-    return (this->buffer != NULL);
+    return (this->buffer != NULL && this->txBuffer != NULL);
 }
 
 uint16_t PubSubClient::getBufferSize()
@@ -675,122 +978,4 @@ void PubSubClient::setSocketTimeout(uint16_t timeout)
     this->socketTimeout = timeout * 1000;
 }
 
-/*
- * Async PING
- * We PING the broker before connecting in order
- * to avoid a blocking connect().
- */
-
-#define PING_ID 0xAFAF
-
-bool PubSubClient::sendPing()
-{
-    struct sockaddr_in    address;
-    ip4_addr_t            ping_target;
-    struct icmp_echo_hdr *iecho;
-    struct sockaddr_in    to;
-    struct timeval        tout;
-    int    size       =   32;
-    size_t ping_size  =   sizeof(struct icmp_echo_hdr) + size;
-    size_t data_len   =   ping_size - sizeof(struct icmp_echo_hdr);
-    int    err;
-
-    #ifdef TC_DBG
-    Serial.printf("MQTT: Sending ping\n");
-    #endif
-
-    // We only PING if we have an IP address.
-    // No point in avoiding a blocking connect
-    // if a DNS call is required beforehand
-    if(this->domain)
-        return false;
-
-    if((_s = socket(AF_INET, SOCK_RAW, IP_PROTO_ICMP)) < 0)
-        return false;
-
-    address.sin_addr.s_addr = ip;
-    ping_target.addr        = ip;
-
-    tout.tv_sec  = 0;
-    tout.tv_usec = 2000;    // 2ms
-
-    if(setsockopt(_s, SOL_SOCKET, SO_RCVTIMEO, &tout, sizeof(tout)) < 0) {
-        closesocket(_s);
-        return false;
-    }
-
-    iecho = (struct icmp_echo_hdr *)mem_malloc((mem_size_t)ping_size);
-    if(!iecho) {
-        closesocket(_s);
-        return false;
-    }
-
-    ICMPH_TYPE_SET(iecho, ICMP_ECHO);
-    ICMPH_CODE_SET(iecho, 0);
-    iecho->chksum = 0;
-    iecho->id = PING_ID;
-    iecho->seqno = htons(++_pseq_num);
-
-    iecho->chksum = inet_chksum(iecho, (uint16_t)ping_size);
-
-    to.sin_len = sizeof(to);
-    to.sin_family = AF_INET;
-    inet_addr_from_ip4addr(&to.sin_addr, &ping_target);
-
-    err = sendto(_s, iecho, ping_size, 0, (struct sockaddr*)&to, sizeof(to));
-        
-    mem_free(iecho);
-
-    if(err) {
-        _pstate = PING_PINGING;
-    } else {
-        closesocket(_s);
-        _pstate = PING_IDLE;
-    }
-        
-    return (err ? true : false);
-}
-
-bool PubSubClient::pollPing()
-{
-    char buf[64];
-    int len, fromlen;
-    struct sockaddr_in    from;
-    struct ip_hdr        *iphdr;
-    struct icmp_echo_hdr *iecho = NULL;
-    bool success = false;
-
-    if(_pstate != PING_PINGING)
-        return false;
-
-    while((len = recvfrom(_s, buf, sizeof(buf), 0, (struct sockaddr*)&from, (socklen_t*)&fromlen)) > 0) {
-        if(len >= (int)(sizeof(struct ip_hdr) + sizeof(struct icmp_echo_hdr))) {
-            iphdr = (struct ip_hdr *)buf;
-            iecho = (struct icmp_echo_hdr *)(buf + (IPH_HL(iphdr) * 4));
-            success = ((iecho->id == PING_ID) && (iecho->seqno == htons(_pseq_num)));
-        }
-    }
-
-    if(success) {
-        closesocket(_s);
-        _pstate = PING_IDLE;
-    }
-
-    return success;
-}
-
-void PubSubClient::cancelPing()
-{
-    if(_pstate != PING_PINGING)
-        return;
-
-    closesocket(_s);
-    _pstate = PING_IDLE;   
-}
-
-int PubSubClient::pstate()
-{
-    return this->_pstate;
-}
-
 #endif  // TC_HAVEMQTT
@@ -64,7 +64,13 @@
 //  pass the entire MQTT packet in each write call.
 //#define MQTT_MAX_TRANSFER_SIZE 80
 
+// MQTT_TCP_TIMEOUT: timeout for establishing the TCP connection in ms
+#ifndef MQTT_TCP_TIMEOUT
+#define MQTT_TCP_TIMEOUT (5*1000)
+#endif
+
 // Possible values for client.state()
+#define MQTT_TCP_CONNECTING         -6
 #define MQTT_CONNECTING             -5
 #define MQTT_CONNECTION_TIMEOUT     -4
 #define MQTT_CONNECTION_LOST        -3
@@ -100,9 +106,21 @@
 // Maximum size of fixed header and variable length size header
 #define MQTT_MAX_HEADER_SIZE 5
 
-#define PING_ERROR    -1
-#define PING_IDLE     0
-#define PING_PINGING  1
+// Outbound QoS1 queue: Number of slots, max topic/payload length, 
+// resend interval if PUBACK is missing
+#define MQTT_OUTQ_SIZE      8
+#define MQTT_OUTQ_TOPICLEN  32
+#define MQTT_OUTQ_PLLEN     64
+#define MQTT_OUTQ_RETRY     (5*1000)
+
+// Receive states for non-blocking packet reader
+#define MQTT_RX_IDLE    0
+#define MQTT_RX_LENGTH  1
+#define MQTT_RX_BODY    2
+#define MQTT_RX_STREAM  3
+
+// Streamed PUBLISH: Minimum buffer space left for payload chunks
+#define MQTT_STREAM_MINCHUNK 64
 
 #define CHECK_STRING_LENGTH(l,s) if(l+2+strnlen(s, this->bufferSize) > this->bufferSize) { _client->stop(); return false; }
 
@@ -117,7 +135,7 @@ class PubSubClient {
         void setServer(IPAddress ip, uint16_t port);
         void setServer(const char *domain, uint16_t port);
         void setCallback(void (*callback)(char *, uint8_t *, unsigned int));
-        void setLooper(void (*looper)());
+        void setStreamCallback(void (*callback)(char *, uint8_t *, unsigned int, uint32_t, uint32_t));
         void setClient(WiFiClient& client);
         void setKeepAlive(uint16_t keepAlive);
         void setSocketTimeout(uint16_t timeout);
@@ -132,6 +150,8 @@ class PubSubClient {
         void disconnect();
 
         bool publish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained = false);
+        bool queuePublish(const char *topic, const uint8_t *payload, unsigned int plength, bool retained = false);
+        int  queueCount();
              
         bool subscribe(const char *topic, const char *topic2 = NULL, uint8_t qos = 0);
         bool unsubscribe(const char *topic);
@@ -140,18 +160,18 @@ class PubSubClient {
         
         bool connected();
         int  state();
-
-        bool sendPing();
-        bool pollPing();
-        void cancelPing();
-        int  pstate();
+        bool sessionPresent();
     
     private:
 
         bool subscribe_int(bool unsubscribe, const char *topic, const char *topic2L, uint8_t qos);
-        uint32_t readPacket(uint8_t *);
-        bool readByte(uint8_t *result);
-        bool readByte(uint8_t *result, uint16_t *index);
+        bool tcpStart();
+        bool tcpPoll();
+        bool sendConnect();
+        uint32_t readPacket(uint8_t *lengthLength);
+        void     rxAbort();
+        void     oqSend();
+        void     oqPop();
         bool write(uint8_t header, uint8_t *buf, uint16_t length);
         uint16_t writeString(const char *string, uint8_t *buf, uint16_t pos);
         // Build up the header ready to send
@@ -161,8 +181,9 @@ class PubSubClient {
         size_t buildHeader(uint8_t header, uint8_t* buf, uint16_t length);
        
         WiFiClient* _client;
-        uint8_t* buffer;
-        uint16_t bufferSize;
+        uint8_t* buffer;                // Incoming packets
+        uint8_t* txBuffer;              // Outgoing packets; separate, as a packet
+        uint16_t bufferSize;            // may be partly received when sending
         uint16_t keepAlive;
         unsigned long socketTimeout;
         uint16_t nextMsgId;
@@ -170,16 +191,44 @@ class PubSubClient {
         unsigned long lastInActivity;
         bool pingOutstanding;
         void (*callback)(char *, uint8_t *, unsigned int);
-        void (*looper)();
+        void (*streamCallback)(char *, uint8_t *, unsigned int, uint32_t, uint32_t) = NULL;
+
+        uint8_t  _rxState = MQTT_RX_IDLE;
+        uint8_t  _rxLLen;
+        bool     _rxDrop;
+        uint16_t _rxPos;
+        uint32_t _rxRemain;
+        uint32_t _rxMult;
+        unsigned long _rxStart;
+        uint16_t _rxHdrEnd;
+        uint16_t _rxMsgId;
+        uint32_t _rxOffs;
+        uint32_t _rxTotal;
+
+        struct {
+            char     topic[MQTT_OUTQ_TOPICLEN];
+            uint8_t  payload[MQTT_OUTQ_PLLEN];
+            uint16_t plength;
+            bool     retained;
+            bool     dup;
+        } _oq[MQTT_OUTQ_SIZE];
+        uint8_t  _oqHead = 0;
+        uint8_t  _oqCount = 0;
+        uint16_t _oqMsgId = 0;          // msgId of head if in flight, 0 otherwise
+        unsigned long _oqSent;
 
         IPAddress ip;
         const char* domain;
         uint16_t port;
         int _state;
 
-        int _s;
-        int _pstate = PING_IDLE;
-        uint16_t _pseq_num = 34;
+        int  _sock = -1;
+        unsigned long _tcpStart;
+        const char *_cId;
+        const char *_cUser;
+        const char *_cPass;
+        bool _cClean;
+        bool _sessPresent = false;
 };
 
 #endif
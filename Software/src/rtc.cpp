@@ -37,6 +37,8 @@
 #include <Wire.h>
 #include "rtc.h"
 
+extern uint32_t i2cErrCount;
+
 // Registers
 #define DS3231_TIME       0x00 // Time 
 #define DS3231_ALARM1     0x07 // Alarm 1 
@@ -84,6 +86,28 @@ uint8_t DateTime::dayOfTheWeek() const
     return (y + y/4 - y/100 + y/400 + t[m-1] + d) % 7;
 }
 
+/*
+ * Advance by one second, carry over into
+ * minute, hour, day, month and year
+ */
+void DateTime::addSecond()
+{
+    const uint8_t mDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    if(++ss < 60) return;
+    ss = 0;
+    if(++mm < 60) return;
+    mm = 0;
+    if(++hh < 24) return;
+    hh = 0;
+    // 2000-2099: Every 4th year is a leap year
+    if(++d <= ((m == 2 && !(yOff & 3)) ? 29 : mDays[m-1])) return;
+    d = 1;
+    if(++m <= 12) return;
+    m = 1;
+    yOff++;
+}
+
 
 /****************************************************************
  * tcRTC Class for DS3231/PCF2129
@@ -362,7 +386,7 @@ void tcRTC::write_register(uint8_t reg, uint8_t val)
     Wire.beginTransmission(_address);
     Wire.write(reg);
     Wire.write(val);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 /*
@@ -372,7 +396,7 @@ uint8_t tcRTC::read_register(uint8_t reg)
 {
     Wire.beginTransmission(_address);
     Wire.write(reg);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
     Wire.requestFrom(_address, (uint8_t)1);
     return Wire.read();
 }
@@ -383,14 +407,14 @@ void tcRTC::write_bytes(uint8_t *buffer, uint8_t num)
     for(int i = 0; i < num; i++) {
         Wire.write(buffer[i]);
     }
-    Wire.endTransmission();   
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 void tcRTC::read_bytes(uint8_t reg, uint8_t *buffer, uint8_t num)
 {
     Wire.beginTransmission(_address);
     Wire.write(reg);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
     Wire.requestFrom(_address, num);
     for(int i = 0; i < num; i++) {
         buffer[i] = Wire.read();
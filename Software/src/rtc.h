@@ -68,6 +68,8 @@ class DateTime {
 
         uint8_t  dayOfTheWeek() const;
 
+        void     addSecond();
+
         void     set(uint16_t yyy, uint8_t mon, uint8_t ddd, 
                      uint8_t hhh = 0, uint8_t mmm = 0, uint8_t sss = 0) 
                     {
@@ -60,6 +60,8 @@
 #include <Wire.h>
 #include "sensors.h"
 
+extern uint32_t i2cErrCount;
+
 static void defaultDelay(unsigned int mydelay)
 {
     delay(mydelay);
@@ -69,7 +71,7 @@ void tcSensor::prepareRead(uint16_t regno)
 {
     Wire.beginTransmission(_address);
     Wire.write((uint8_t)(regno));
-    Wire.endTransmission(false);
+    if(Wire.endTransmission(false)) i2cErrCount++;
 }
 
 uint16_t tcSensor::read16(uint16_t regno, bool LSBfirst)
@@ -119,7 +121,7 @@ void tcSensor::write16(uint16_t regno, uint16_t value, bool LSBfirst)
     } 
     Wire.write((uint8_t)(value >> 8));
     Wire.write((uint8_t)(value & 0xff));
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 void tcSensor::write8(uint16_t regno, uint8_t value)
@@ -129,7 +131,7 @@ void tcSensor::write8(uint16_t regno, uint8_t value)
         Wire.write((uint8_t)(regno));
     }
     Wire.write((uint8_t)(value & 0xff));
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 uint8_t tcSensor::crc8(uint8_t initVal, uint8_t poly, uint8_t len, uint8_t *buf)
@@ -481,25 +483,70 @@ void tempSensor::setCustomDelayFunc(void (*myDelay)(unsigned int))
     _customDelayFunc = myDelay;
 }
 
-// Read temperature
+/*
+ * Read temperature
+ *
+ * This does not wait for the sensor: If the conversion 
+ * triggered after the previous read is not finished yet, 
+ * the last value is returned and the read is marked 
+ * pending; loop() then collects the result as soon as 
+ * the sensor is done.
+ */
 float tempSensor::readTemp(bool celsius)
 {
-    float temp = NAN;
-    uint16_t t = 0;
-    
-
-    if(_delayNeeded > 0) {
-        unsigned long elapsed = millis() - _tempReadNow;
-        if(elapsed < _delayNeeded) (*_customDelayFunc)(_delayNeeded - elapsed);
+    if(millis() - _tempReadNow < _delayNeeded) {
+        _readPending = true;
+        _pendCelsius = celsius;
+    } else {
+        collectTemp(celsius);
     }
 
+    return _lastTemp;
+}
+
+/*
+ * Collect a pending reading once the sensor's 
+ * conversion is finished. 
+ * Returns true if a new value was read.
+ */
+bool tempSensor::loop()
+{
+    if(!_readPending)
+        return false;
+
+    if(millis() - _tempReadNow < _delayNeeded)
+        return false;
+
+    collectTemp(_pendCelsius);
+
+    return true;
+}
+
+void tempSensor::setOffset(float myOffs)
+{
+    _userOffset = (int32_t)(myOffs * 100.0f + ((myOffs < 0.0f) ? -0.5f : 0.5f));
+}
+
+// Private functions ###########################################################
+
+/*
+ * Read result of finished conversion and trigger the next one.
+ * All calculations in 1/100 degrees Celsius.
+ */
+void tempSensor::collectTemp(bool celsius)
+{
+    int32_t temp = 0;
+    bool    haveTemp = false;
+    uint16_t t = 0;
+
     switch(_st) {
 
     case MCP9808:
         t = read16(MCP9808_REG_AMBIENT_TEMP);
         if(t != 0xffff) {
-            temp = ((float)(t & 0x0fff)) / 16.0;
-            if(t & 0x1000) temp = 256.0 - temp;
+            temp = ((int32_t)(t & 0x0fff) * 25) / 4;
+            if(t & 0x1000) temp -= 25600;
+            haveTemp = true;
         }
         break;
 
@@ -513,7 +560,7 @@ float tempSensor::readTemp(bool celsius)
             for(uint8_t i = 0; i < t; i++) buf[i] = Wire.read();
             t1 = (buf[0] << 16) | (buf[1] << 8) | buf[2];
             if(_haveHum) t2 = (buf[3] << 8) | buf[4];
-            temp = BMx280_CalcTemp(t1, t2);
+            haveTemp = BMx280_CalcTemp(t1, t2, temp);
         }
         break;
 
@@ -523,11 +570,12 @@ float tempSensor::readTemp(bool celsius)
             for(uint8_t i = 0; i < 6; i++) buf[i] = Wire.read();
             if(crc8(SHT40_CRC_INIT, SHT40_CRC_POLY, 2, buf) == buf[2]) {
                 t = (buf[0] << 8) | buf[1];
-                temp = ((175.0 * (float)t) / 65535.0) - 45.0;
+                temp = (int32_t)((17500UL * t) / 65535) - 4500;
+                haveTemp = true;
             }
             if(crc8(SHT40_CRC_INIT, SHT40_CRC_POLY, 2, buf+3) == buf[5]) {
                 t = (buf[3] << 8) | buf[4];
-                _hum = (int8_t)(((125.0 * (float)t) / 65535.0) - 6.0);
+                _hum = (int8_t)((int32_t)((125UL * t) / 65535) - 6);
                 if(_hum < 0) _hum = 0;
             }
         }
@@ -540,7 +588,7 @@ float tempSensor::readTemp(bool celsius)
             for(uint8_t i = 0; i < 3; i++) buf[i] = Wire.read();
             if(crc8(SI7021_CRC_INIT, SI7021_CRC_POLY, 2, buf) == buf[2]) {
                 t = (buf[0] << 8) | buf[1];
-                _hum = (int8_t)(((125.0 * (float)t) / 65536.0) - 6.0);
+                _hum = (int8_t)((int32_t)((125UL * t) >> 16) - 6);
                 if(_hum < 0) _hum = 0;
             }
         }
@@ -549,7 +597,8 @@ float tempSensor::readTemp(bool celsius)
             uint8_t buf[2];
             for(uint8_t i = 0; i < 2; i++) buf[i] = Wire.read();
             t = (buf[0] << 8) | buf[1];
-            temp = ((175.72 * (float)t) / 65536.0) - 46.85;
+            temp = (int32_t)((17572UL * t) >> 16) - 4685;
+            haveTemp = true;
         }
         write8(SI7021_DUMMY, SI7021_CMD_RHUM);    // Trigger new measurement
         break;
@@ -557,7 +606,8 @@ float tempSensor::readTemp(bool celsius)
     case TMP117:
         t = read16(TMP117_REG_TEMP);
         if(t != 0x8000) {
-            temp = (float)((int16_t)t) / 128.0;
+            temp = ((int32_t)((int16_t)t) * 25) / 32;
+            haveTemp = true;
         }
         break;
 
@@ -568,7 +618,9 @@ float tempSensor::readTemp(bool celsius)
             if(crc8(AHT20_CRC_INIT, AHT20_CRC_POLY, 6, buf) == buf[6]) {
                 _hum = ((uint32_t)((buf[1] << 12) | (buf[2] << 4) | (buf[3] >> 4))) * 100 / 1048576;
                 if(_hum < 0) _hum = 0;
-                temp = ((float)((uint32_t)(((buf[3] & 0x0f) << 16) | (buf[4] << 8) | buf[5]))) * 200.0 / 1048576.0 - 50.0;
+                // 20000 / 2^20 = 625 / 2^15
+                temp = (int32_t)((((uint32_t)(((buf[3] & 0x0f) << 16) | (buf[4] << 8) | buf[5])) * 625) >> 15) - 5000;
+                haveTemp = true;
             }
         }
         write16(0xac, 0x3300);    // Trigger new measurement
@@ -581,11 +633,12 @@ float tempSensor::readTemp(bool celsius)
             for(uint8_t i = 0; i < 6; i++) buf[i] = Wire.read();
             if(crc8(HTU31_CRC_INIT, HTU31_CRC_POLY, 2, buf) == buf[2]) {
                 t = (buf[0] << 8) | buf[1];
-                temp = ((165.0 * (float)t) / 65535.0) - 40.0;
+                temp = (int32_t)((16500UL * t) / 65535) - 4000;
+                haveTemp = true;
             }
             if(crc8(HTU31_CRC_INIT, HTU31_CRC_POLY, 2, buf+3) == buf[5]) {
                 t = (buf[3] << 8) | buf[4];
-                _hum = (int8_t)((100.0 * (float)t) / 65535.0);
+                _hum = (int8_t)((100UL * t) / 65535);
                 if(_hum < 0) _hum = 0;
             }
         }
@@ -594,39 +647,42 @@ float tempSensor::readTemp(bool celsius)
     }
 
     _tempReadNow = millis();
+    _readPending = false;
 
-    if(!isnan(temp)) {
-        if(!celsius) temp = temp * 9.0 / 5.0 + 32.0;
+    if(haveTemp) {
+        // Smooth out sensor noise; start over on 
+        // larger jumps (>= 2 degrees)
+        if(_smoothValid && abs(temp - _smoothTemp) < 200) {
+            _smoothTemp = (_smoothTemp + temp) / 2;
+        } else {
+            _smoothTemp = temp;
+            _smoothValid = true;
+        }
+        temp = _smoothTemp;
+        if(!celsius) temp = temp * 9 / 5 + 3200;
         temp += _userOffset;
+        _lastTemp = (float)temp / 100.0f;
+    } else {
+        _smoothValid = false;
+        _lastTemp = NAN;
     }
 
     // We use only 2 digits, so truncate
     if(_hum > 99) _hum = 99;
     
     #ifdef TC_DBG
-    Serial.printf("Sensor temp+offset: %f\n", temp);
+    Serial.printf("Sensor temp+offset: %f\n", _lastTemp);
     if(_haveHum) {
         Serial.printf("Sensor humidity: %d\n", _hum);
     }
     #endif
-
-    _lastTemp = temp;
-
-    return temp;
-}
-
-void tempSensor::setOffset(float myOffs)
-{
-    _userOffset = myOffs;
 }
 
-// Private functions ###########################################################
-
-float tempSensor::BMx280_CalcTemp(uint32_t ival, uint32_t hval)
+bool tempSensor::BMx280_CalcTemp(uint32_t ival, uint32_t hval, int32_t& temp)
 {
-    int32_t var1, var2, fine_t, temp;
+    int32_t var1, var2, fine_t;
 
-    if(ival == 0x800000) return NAN;
+    if(ival == 0x800000) return false;
 
     ival >>= 4;
     
@@ -648,7 +704,9 @@ float tempSensor::BMx280_CalcTemp(uint32_t ival, uint32_t hval)
         _hum = temp >> 22;
     }
     
-    return (float)((fine_t * 5 + 128) / 256) / 100.0;
+    temp = (fine_t * 5 + 128) / 256;
+
+    return true;
 }
 
 #endif // TC_HAVETEMP
@@ -711,7 +769,9 @@ static const uint8_t ltr3xxITs[8] = {
 #define BH1750_CONT_HRES2 0x11  // 0.5 lux resolution / 120ms
 #define BH1750_CONT_LRES  0x13  // 4 lux resolution / 16ms
 
-#define BH1750_CONV_FACT  1.2f
+// Lux = count / 1.2 (HRES2: count / 2.4)
+#define BH1750_CONV_MUL   5
+#define BH1750_CONV_DIV   6
 
 static const uint8_t bh1750Arr[3][2] = {
       { BH1750_CONT_HRES,   120+30 }, 
@@ -721,6 +781,38 @@ static const uint8_t bh1750Arr[3][2] = {
 
 #define BH1750_USE_SET  0   // to be adjusted (0-2, index in array above)
 
+#define BH1750_HRES2_LUX  1000  // Below this, switch to HRES2
+#define BH1750_SAT        0xfff0  // Above this (raw), switch to HRES
+
+#define TLS_HG_ENTER      100   // Below this (ch0 raw), switch to high gain
+
+static const uint16_t tlsSat[3] = {
+    5047, 37177, 65535
+//  13.7  101    402ms
+};
+
+static const int32_t ltr3xxMaxLux[6] = { 
+    64000, 32000, 16000, 8000, 1300, 600 
+};
+static const uint8_t ltr3xxGainVals[6] = {
+    1, 2, 4, 8, 48, 96
+};
+// Lux formula selected by ch1/(ch0+ch1) ratio (in percent);
+// coefficients for ch0 and ch1 in 1/10000
+static const struct {
+    uint8_t ratio;
+    int32_t c0;
+    int32_t c1;
+} ltr3xxCoeffs[3] = {
+    { 45, 17743,  11059 },
+    { 64, 42785, -19548 },
+    { 85,  5926,   1185 }
+};
+
+#define VEML7700_CNT_LO   100   // Count window considered "in range"
+#define VEML7700_CNT_HI   10000
+#define VEML7700_CNT_TGT  2500  // Count to aim for when re-ranging
+
 #define VEML7700_CON0   0
 #define VEML7700_HTW1   1
 #define VEML7700_HTW2   2
@@ -757,13 +849,15 @@ static const uint8_t AITArr[6][2] = {
     { VEML7700_AIT800, 200 }
 };
 
-static const float resFact[6][4] = {
-    { 1.8432, 0.9216, 0.2304, 0.1152 },
-    { 0.9216, 0.4608, 0.1152, 0.0576 },
-    { 0.4608, 0.2304, 0.0576, 0.0288 },
-    { 0.2304, 0.1152, 0.0288, 0.0144 },
-    { 0.1152, 0.0576, 0.0144, 0.0072 },
-    { 0.0576, 0.0288, 0.0072, 0.0036 }    
+// Resolution (lux per count) for AIT/gain combinations, 
+// in 1/10000 lux
+static const uint16_t resFact[6][4] = {
+    { 18432, 9216, 2304, 1152 },
+    {  9216, 4608, 1152,  576 },
+    {  4608, 2304,  576,  288 },
+    {  2304, 1152,  288,  144 },
+    {  1152,  576,  144,   72 },
+    {   576,  288,   72,   36 }
 };
 
 // Store i2c address
@@ -844,13 +938,15 @@ bool lightSensor::begin(bool skipLast, unsigned long powerupTime)
         // Set IT; MRate 2000ms
         write8(LTR303_MRATE, (ltr3xxITs[LTR303_USE_IT] << 3) | 0x03); 
         // Set gain, activate
-        write8(LTR303_CTRL, (ltr3xxGains[LTR303_USE_GAIN] << 2) | 0x01);  
+        _gainIdx = LTR303_USE_GAIN;
+        write8(LTR303_CTRL, (ltr3xxGains[_gainIdx] << 2) | 0x01);  
         break;
 
     case LST_TSL2561:
         write8(TSL2561_CTRL, 0x03); // Power up
         write8(TSL2561_ICTRL, 0);   // no interrupts
-        write8(TSL2561_TIM, TLS_USE_GAIN | TLS_USE_IT);
+        _gainIdx = (TLS_USE_GAIN == TLS_GAIN_HIGH) ? 1 : 0;
+        write8(TSL2561_TIM, (_gainIdx ? TLS_GAIN_HIGH : TLS_GAIN_LOW) | TLS_USE_IT);
         break;
         
     case LST_BH1750:
@@ -890,7 +986,18 @@ int32_t lightSensor::readLux()
     return _lux;
 }
 
-void lightSensor::loop()
+/*
+ * Read sensor and adjust its range.
+ * 
+ * Range adjustment is "one-shot": From the current reading, the
+ * setting best suited for the current light level is calculated 
+ * and set directly, instead of stepping through gains/ITs one per
+ * call. The value read is reported regardless, unless the sensor
+ * is saturated.
+ * 
+ * Returns true if a new lux value was read.
+ */
+bool lightSensor::loop()
 {
     uint16_t temp;
     uint32_t temp1;
@@ -899,24 +1006,41 @@ void lightSensor::loop()
     switch(_st) {
     case LST_TSL2561:
         if(elapsed < 500)
-            return;
+            return false;
 
         temp  = read16(TSL2561_ADC0, true);
         temp1 = read16(TSL2561_ADC1, true);
 
+        _lastAccess = millis();
+
+        // Near saturation in high gain: Switch to low gain
+        if(_gainIdx && (temp >= tlsSat[TLS_USE_IT] - (tlsSat[TLS_USE_IT] / 8))) {
+            TSL2561SetGain(0);
+            return false;
+        }
+
         if(temp1 == 0) {
             _lux = 0;
-        } else if( ((temp1 << 1) <= temp) && (temp <= 4900)) {
-            _lux = TSL2561CalcLux(TLS_USE_GAIN, TLS_USE_IT, temp, temp1);
+        } else if( ((temp1 << 1) <= temp) && (_gainIdx || (temp <= 4900)) ) {
+            _lux = TSL2561CalcLux(_gainIdx ? TLS_GAIN_HIGH : TLS_GAIN_LOW, TLS_USE_IT, temp, temp1);
         } else {
             // IR-overload, human eye light level not determinable
             _lux = -1;
         }
-        break;
+
+        // Low light in low gain: Switch to high gain
+        if(!_gainIdx && (temp < TLS_HG_ENTER)) {
+            TSL2561SetGain(1);
+        }
+        return true;
 
     case LST_LTR3xx:
-        if(elapsed < 500)
-            return;
+        // After a gain change, wait for a full measurement cycle
+        if(elapsed < (_rangeChanged ? 2500 : 500))
+            return false;
+
+        _lastAccess = millis();
+        _rangeChanged = false;
 
         write8(LTR303_DUMMY, LTR303_DATA1);
         if(Wire.requestFrom(_address, (uint8_t)4) == 4) {
@@ -924,26 +1048,55 @@ void lightSensor::loop()
             temp1 |= (Wire.read() << 8);
             temp  = Wire.read();
             temp  |= (Wire.read() << 8);
+            if((temp == 0xffff || temp1 == 0xffff) && _gainIdx) {
+                // Saturated: Restart from lowest gain
+                LTR3xxSetGain(0);
+                return false;
+            }
             if(temp + temp1 == 0) {
                 _lux = 0;
             } else {
-                _lux = LTR3xxCalcLux(LTR303_USE_GAIN, LTR303_USE_IT, temp, temp1);
+                _lux = LTR3xxCalcLux(_gainIdx, LTR303_USE_IT, temp, temp1);
+            }
+            // Use highest gain with enough headroom
+            if(_lux >= 0) {
+                uint8_t newGain = 5;
+                while(newGain > 0 && ltr3xxMaxLux[newGain] < _lux * 2) newGain--;
+                if(newGain != _gainIdx) {
+                    LTR3xxSetGain(newGain);
+                }
             }
+            return true;
         }
-        break;
+        return false;
 
     case LST_BH1750:
         if(elapsed < (unsigned long)bh1750Arr[_gainIdx][1])
-            return;
+            return false;
 
         temp = read16(BH1750_DUMMY);
 
-        _lux = (int32_t)((float)temp / BH1750_CONV_FACT);
-        break;
+        _lastAccess = millis();
+
+        if(bh1750Arr[_gainIdx][0] == BH1750_CONT_HRES2) {
+            if(temp >= BH1750_SAT) {
+                // Saturated: Switch to HRES
+                BH1750SetMode(0);
+                return false;
+            }
+            _lux = ((int32_t)temp * BH1750_CONV_MUL) / (BH1750_CONV_DIV * 2);
+        } else {
+            _lux = ((int32_t)temp * BH1750_CONV_MUL) / BH1750_CONV_DIV;
+            if(_lux < BH1750_HRES2_LUX) {
+                // Low light: Switch to HRES2 (0.5 lux resolution)
+                BH1750SetMode(1);
+            }
+        }
+        return true;
 
     case LST_VEML7700:
         if(elapsed < (unsigned long)AITArr[_AITIdx][1] * 8)
-            return;
+            return false;
 
         // Re-write control register now and then; if there was an i2c
         // bus error while writing, the sensor might report values not
@@ -955,64 +1108,102 @@ void lightSensor::loop()
             VEML7700OnOff(true, false);
             _accessNum = 0;
             _lastAccess = millis();
-            return;
+            return false;
         }
         
         temp = read16(VEML7700_ALS, true);
 
-        // Value too low, increase first gain, then AIT
-        if(temp <= 100) {
-            bool doQuit = false;
-            if(_gainIdx < 3) {
-                _gainIdx++;
-                VEML7700OnOff(false);
-                VEML7700SetGain(gainArr[_gainIdx]);
-                doQuit = true;
-            } else if(_AITIdx < 5) {
-                _AITIdx++;
-                VEML7700OnOff(false);
-                VEML7700SetAIT(AITArr[_AITIdx][0]);
-                doQuit = true;
-            }
-            if(doQuit) {
-                VEML7700OnOff(true, false);
-                _lastAccess = millis();
-                _accessNum = 0;
-                return;
-            }
+        _lastAccess = millis();
+
+        // Value within range, or no more range to go
+        if( (temp > VEML7700_CNT_LO || ((_gainIdx == 3) && (_AITIdx == 5))) &&
+            (temp < VEML7700_CNT_HI || ((_gainIdx == 0) && (_AITIdx == 0))) ) {
+            _lux = VEML7700CalcLux(temp, _gainIdx, _AITIdx);
+            return true;
         }
-    
-        // Value within range
-        if(temp < 10000 || ( (_gainIdx == 0) && (_AITIdx == 0) ) ) {
-          
-            _lux = (int32_t)((float)temp * resFact[_AITIdx][_gainIdx]);
-
-            if(_gainIdx < 2 && _lux > 1000) {
-                float lux = (float)_lux;
-                _lux = (int32_t)((((6.0135e-13 * lux - 9.3924e-9) * lux + 8.1488e-5) * lux + 1.0023) * lux);
-            }
-            
-        } else {
-    
-            // Value too high: Restart from low gain
-            _gainIdx = 0;
-            _AITIdx = 0;
-            VEML7700OnOff(false);
-            VEML7700SetGain(gainArr[_gainIdx], false);
-            VEML7700SetAIT(AITArr[_AITIdx][0]);
-            VEML7700OnOff(true, false);
-            _accessNum = 0;
-            
+
+        // Out of range: Unless saturated, report what we have, 
+        // then jump to the best setting for this light level
+        if(temp < 0xffff) {
+            _lux = VEML7700CalcLux(temp, _gainIdx, _AITIdx);
+            VEML7700AutoRange(temp);
+            return true;
         }
+        
+        // Saturated: Restart from lowest sensitivity
+        VEML7700SetRange(0, 0);
+        return false;
     }
 
-    _lastAccess = millis();
+    return false;
 }
 
 // Private functions ###########################################################
 
 // VEML7700:
 
+int32_t lightSensor::VEML7700CalcLux(uint16_t cnt, uint8_t gainIdx, uint8_t AITIdx)
+{
+    // lux * 10000
+    int64_t lux4 = (uint32_t)cnt * resFact[AITIdx][gainIdx];
+
+    // Non-linearity correction (from app note), in integer:
+    // lux = 6.0135e-13 lux^4 - 9.3924e-9 lux^3 + 8.1488e-5 lux^2 + 1.0023 lux
+    if(gainIdx < 2 && lux4 > 1000 * 10000) {
+        int64_t lux2 = (lux4 * lux4) / 100000000;
+        int64_t lux3 = (lux2 * (lux4 / 100)) / 100;
+        // Terms in 1/100 lux
+        return (int32_t)( ( ((((lux2 * 60135) / 10000000) * lux2) / 100000000)
+                            - (((lux3 / 1000) * 93924) / 100000000)
+                            + ((lux2 * 81488) / 10000000)
+                            + ((lux4 * 10023) / 1000000) + 50 ) / 100 );
+    }
+
+    return (int32_t)((lux4 + 5000) / 10000);
+}
+
+/*
+ * Calculate the expected count for all gain/AIT combinations
+ * and choose the most sensitive one that keeps the count 
+ * below VEML7700_CNT_TGT. Among equally sensitive settings, 
+ * the shorter AIT wins.
+ */
+void lightSensor::VEML7700AutoRange(uint16_t cnt)
+{
+    uint32_t lux = (uint32_t)(cnt ? cnt : 1) * resFact[_AITIdx][_gainIdx];
+    uint8_t newGain = 0, newAIT = 0;
+
+    for(uint8_t a = 0; a < 6; a++) {
+        for(uint8_t g = 0; g < 4; g++) {
+            if( (lux < (uint32_t)VEML7700_CNT_TGT * resFact[a][g]) && 
+                (resFact[a][g] < resFact[newAIT][newGain]) ) {
+                newGain = g;
+                newAIT = a;
+            }
+        }
+    }
+
+    #ifdef TC_DBG
+    Serial.printf("VEML7700: cnt %d, gain/AIT %d/%d -> %d/%d\n", cnt, _gainIdx, _AITIdx, newGain, newAIT);
+    #endif
+
+    if(newGain != _gainIdx || newAIT != _AITIdx) {
+        VEML7700SetRange(newGain, newAIT);
+    }
+}
+
+void lightSensor::VEML7700SetRange(uint8_t gainIdx, uint8_t AITIdx)
+{
+    _gainIdx = gainIdx;
+    _AITIdx = AITIdx;
+    VEML7700OnOff(false);
+    VEML7700SetGain(gainArr[_gainIdx], false);
+    VEML7700SetAIT(AITArr[_AITIdx][0]);
+    VEML7700OnOff(true, false);
+    _accessNum = 0;
+    _lastAccess = millis();
+}
+
 void lightSensor::VEML7700SetGain(uint16_t gain, bool doWrite)
 {
     _con0 &= ~(0x1800);
@@ -1039,30 +1230,58 @@ void lightSensor::VEML7700OnOff(bool enable, bool doWait)
     if(enable && doWait) (*_customDelayFunc)(5);
 }
 
+// LTR3xx:
+
+void lightSensor::LTR3xxSetGain(uint8_t gainIdx)
+{
+    _gainIdx = gainIdx;
+    write8(LTR303_CTRL, (ltr3xxGains[_gainIdx] << 2) | 0x01);
+    _rangeChanged = true;
+    _lastAccess = millis();
+}
+
+// Integer version of formulas from LTR303/329 app note
+// iGain: Index in ltr3xxGains, tInt: Index in ltr3xxITs
 int32_t lightSensor::LTR3xxCalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0, uint32_t ch1)
 {
-    double gains[]   = {   1.0,   2.0,   4.0,  8.0, 48.0, 96.0 };
-    int32_t maxLux[] = { 64000, 32000, 16000, 8000, 1300, 600 };
-    double its[]     = { 0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0 };
-    //                   50   100  150  200  250  300  350  400
-    int32_t lux = -1;
-    double dch0 = (double)ch0;
-    double dch1 = (double)ch1;
-
-    double ratio = dch1 / (dch0 + dch1);
-
-    if(ratio < 0.45)
-        lux = (int32_t)((1.7743 * dch0 + 1.1059 * dch1) / gains[iGain] / its[tInt]);
-    else if (ratio < 0.64)
-        lux = (int32_t)((4.2785 * dch0 - 1.9548 * dch1) / gains[iGain] / its[tInt]);
-    else if (ratio < 0.85)
-        lux = (int32_t)((0.5926 * dch0 + 0.1185 * dch1) / gains[iGain] / its[tInt]);
-    else {
+    int64_t lux;
+    int32_t div;
+    int i;
+
+    for(i = 0; i < 3; i++) {
+        if(ch1 * 100 < (ch0 + ch1) * ltr3xxCoeffs[i].ratio)
+            break;
+    }
+
+    if(i >= 3) {
         // IR-overload, human eye light level not determinable
         return -1;
     }
 
-    return min(lux, maxLux[iGain]);
+    // IT in 50ms units: Index 0 = 50ms, 1 = 100ms (=1.0) etc.
+    div = 10000 * ltr3xxGainVals[iGain] * (tInt + 1);
+    lux = (int64_t)ltr3xxCoeffs[i].c0 * ch0 + (int64_t)ltr3xxCoeffs[i].c1 * ch1;
+    lux = (lux * 2 + div / 2) / div;
+
+    return min((int32_t)lux, ltr3xxMaxLux[iGain]);
+}
+
+// BH1750:
+
+void lightSensor::BH1750SetMode(uint8_t idx)
+{
+    _gainIdx = idx;
+    write8(BH1750_DUMMY, bh1750Arr[_gainIdx][0]);
+    _lastAccess = millis();
+}
+
+// TSL2561:
+
+void lightSensor::TSL2561SetGain(uint8_t gainIdx)
+{
+    _gainIdx = gainIdx;
+    write8(TSL2561_TIM, (_gainIdx ? TLS_GAIN_HIGH : TLS_GAIN_LOW) | TLS_USE_IT);
+    _lastAccess = millis();
 }
 
 // TSL2561
@@ -1075,30 +1294,23 @@ int32_t lightSensor::LTR3xxCalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0, ui
 #define TSL2561_CHSCALE_TINT0 0x7517 // 322/11 * 2^CH_SCALE
 #define TSL2561_CHSCALE_TINT1 0x0fe7 // 322/81 * 2^CH_SCALE
 
-#define TSL2561_K1T 0x0040 // 0.125 * 2^RATIO_SCALE
-#define TSL2561_B1T 0x01f2 // 0.0304 * 2^LUX_SCALE
-#define TSL2561_M1T 0x01be // 0.0272 * 2^LUX_SCALE
-#define TSL2561_K2T 0x0080 // 0.250 * 2^RATIO_SCALE
-#define TSL2561_B2T 0x0214 // 0.0325 * 2^LUX_SCALE
-#define TSL2561_M2T 0x02d1 // 0.0440 * 2^LUX_SCALE
-#define TSL2561_K3T 0x00c0 // 0.375 * 2^RATIO_SCALE
-#define TSL2561_B3T 0x023f // 0.0351 * 2^LUX_SCALE
-#define TSL2561_M3T 0x037b // 0.0544 * 2^LUX_SCALE
-#define TSL2561_K4T 0x0100 // 0.50 * 2^RATIO_SCALE
-#define TSL2561_B4T 0x0270 // 0.0381 * 2^LUX_SCALE
-#define TSL2561_M4T 0x03fe // 0.0624 * 2^LUX_SCALE
-#define TSL2561_K5T 0x0138 // 0.61 * 2^RATIO_SCALE
-#define TSL2561_B5T 0x016f // 0.0224 * 2^LUX_SCALE
-#define TSL2561_M5T 0x01fc // 0.0310 * 2^LUX_SCALE
-#define TSL2561_K6T 0x019a // 0.80 * 2^RATIO_SCALE
-#define TSL2561_B6T 0x00d2 // 0.0128 * 2^LUX_SCALE
-#define TSL2561_M6T 0x00fb // 0.0153 * 2^LUX_SCALE
-#define TSL2561_K7T 0x029a // 1.3 * 2^RATIO_SCALE
-#define TSL2561_B7T 0x0018 // 0.00146 * 2^LUX_SCALE
-#define TSL2561_M7T 0x0012 // 0.00112 * 2^LUX_SCALE
-#define TSL2561_K8T 0x029a // 1.3 * 2^RATIO_SCALE
-#define TSL2561_B8T 0x0000 // 0.000 * 2^LUX_SCALE
-#define TSL2561_M8T 0x0000 // 0.000 * 2^LUX_SCALE
+// Breakpoints for ch1/ch0 ratio (scaled by 2^RATIO_SCALE) and
+// the respective b and m coefficients (scaled by 2^LUX_SCALE) 
+// for T, FN, and CL packages
+static const struct {
+    uint16_t k;
+    uint16_t b;
+    uint16_t m;
+} tsl2561Coeffs[8] = {
+    { 0x0040, 0x01f2, 0x01be },   // 0.125: 0.0304,  0.0272
+    { 0x0080, 0x0214, 0x02d1 },   // 0.250: 0.0325,  0.0440
+    { 0x00c0, 0x023f, 0x037b },   // 0.375: 0.0351,  0.0544
+    { 0x0100, 0x0270, 0x03fe },   // 0.50:  0.0381,  0.0624
+    { 0x0138, 0x016f, 0x01fc },   // 0.61:  0.0224,  0.0310
+    { 0x019a, 0x00d2, 0x00fb },   // 0.80:  0.0128,  0.0153
+    { 0x029a, 0x0018, 0x0012 },   // 1.3:   0.00146, 0.00112
+    { 0x029a, 0x0000, 0x0000 }    // >1.3:  0.000,   0.000
+};
 
 // TSL2561: Calculate Lux from ch0 and ch1 data
 // iGain: 0=1x, 1=16x
@@ -1108,6 +1320,7 @@ uint32_t lightSensor::TSL2561CalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0,
     uint32_t chScale, channel0, channel1;
     uint32_t b = 0, m = 0, ratio, ratio1 = 0;
     int32_t  temp;
+    int      i;
 
     switch(tInt) {
     case TLS_IT_13:   // 13.7 msec
@@ -1130,23 +1343,12 @@ uint32_t lightSensor::TSL2561CalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0,
 
     ratio = (ratio1 + 1) >> 1;
     
-    if(ratio <= TSL2561_K1T) {
-        b = TSL2561_B1T; m = TSL2561_M1T;
-    } else if (ratio <= TSL2561_K2T) {
-        b = TSL2561_B2T; m = TSL2561_M2T;
-    } else if(ratio <= TSL2561_K3T) {
-        b = TSL2561_B3T; m = TSL2561_M3T;
-    } else if(ratio <= TSL2561_K4T) {
-        b = TSL2561_B4T; m = TSL2561_M4T;
-    } else if(ratio <= TSL2561_K5T) {
-        b = TSL2561_B5T; m = TSL2561_M5T;
-    } else if(ratio <= TSL2561_K6T) {
-        b = TSL2561_B6T; m = TSL2561_M6T;
-    } else if(ratio <= TSL2561_K7T) {
-        b = TSL2561_B7T; m = TSL2561_M7T;
-    } else { //if(ratio > TSL2561_K8T)
-        b = TSL2561_B8T; m = TSL2561_M8T; 
+    for(i = 0; i < 7; i++) {
+        if(ratio <= tsl2561Coeffs[i].k)
+            break;
     }
+    b = tsl2561Coeffs[i].b;
+    m = tsl2561Coeffs[i].m;
 
     temp = ((channel0 * b) - (channel1 * m));
     if(temp < 0) temp = 0;
@@ -1157,3 +1359,262 @@ uint32_t lightSensor::TSL2561CalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0,
 }
 
 #endif // TC_HAVELIGHT
+
+
+/*****************************************************************
+ * sensHistory Class
+ * 
+ * Keeps a history of sensor readings: The last 24 hours at 
+ * 1-minute resolution, plus min/max/avg per hour (for the 
+ * last 24 hours) and per day (for the last 30 days).
+ * 
+ * Samples are stamped with UTC "minutes since year 0" (as per 
+ * dateToMins()), so slot numbers simply are the stamp modulo
+ * the ring size. Gaps (power off, RTC changes) are cleared.
+ * If time steps back (RTC/NTP/GPS correction), samples are 
+ * dropped until time has caught up. Only jumps beyond 30 days 
+ * (either way) reset the history.
+ * 
+ * Data is saved to flash (or SD in FlashROMode) in one block
+ * once per hour, and only if anything has changed. 
+ * 
+ ****************************************************************/
+
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+
+#define SH_MAGIC    0x48534354    // "TCSH"
+#define SH_VERSION  2             // 2: UTC stamps
+#define SH_SAVE_INT 60            // Save interval (in minutes)
+
+static const char *fnSensHist = "/tcdshist.bin";
+
+extern bool FlashROMode;
+
+extern bool readFileFromSD(const char *fn, uint8_t *buf, int len);
+extern bool writeFileToSD(const char *fn, uint8_t *buf, int len);
+extern bool readFileFromFS(const char *fn, uint8_t *buf, int len);
+extern bool writeFileToFS(const char *fn, uint8_t *buf, int len);
+
+// Load saved history
+void sensHistory::begin(bool tempUnit)
+{
+    bool loaded;
+
+    if(FlashROMode) {
+        loaded = readFileFromSD(fnSensHist, (uint8_t *)&_d, sizeof(_d));
+    } else {
+        loaded = readFileFromFS(fnSensHist, (uint8_t *)&_d, sizeof(_d));
+    }
+
+    // Temperature unit must match, we store what we display
+    if(loaded && 
+       (_d.magic == SH_MAGIC) && (_d.version == SH_VERSION) && 
+       (_d.tempUnit == (uint8_t)tempUnit) && (_d.sum == calcSum())) {
+        _valid = true;
+        _lastSaveStamp = _d.lastStamp;
+        #ifdef TC_DBG
+        Serial.printf("Sensor history: Loaded, last stamp %d\n", _d.lastStamp);
+        #endif
+    } else {
+        _d.tempUnit = tempUnit;
+        reset();
+        #ifdef TC_DBG
+        Serial.println("Sensor history: No (valid) saved data");
+        #endif
+    }
+}
+
+// Add a sample; only the first one per minute is taken
+void sensHistory::add(uint32_t stamp, int16_t temp, int16_t hum, int16_t lux)
+{
+    int16_t vals[SH_NUMCH] = { temp, hum, lux };
+    int16_t *slot;
+    shAgg *hAgg, *dAgg;
+
+    if(_valid && (stamp == _d.lastStamp))
+        return;
+
+    if(!advanceTo(stamp))
+        return;
+
+    slot = _d.mins[stamp % SH_MINS];
+    hAgg = _d.hours[(stamp / 60) % SH_HOURS];
+    dAgg = _d.days[(stamp / SH_MINS) % SH_DAYS];
+    
+    for(int i = 0; i < SH_NUMCH; i++) {
+        slot[i] = vals[i];
+        aggAdd(&hAgg[i], vals[i]);
+        aggAdd(&dAgg[i], vals[i]);
+    }
+
+    _dirty = true;
+
+    if(stamp - _lastSaveStamp >= SH_SAVE_INT) {
+        save();
+    }
+}
+
+/*
+ * Min/max/avg of a channel, for the last 24 hours 
+ * (month = false) or 30 days (month = true).
+ * Cost is bounded by the number of aggregate slots.
+ * Returns false if there are no valid samples.
+ */
+bool sensHistory::getStats(int ch, bool month, int16_t& vmin, int16_t& vmax, int16_t& vavg)
+{
+    shAgg agg;
+
+    if(!_valid || ch < 0 || ch >= SH_NUMCH)
+        return false;
+
+    aggClear(&agg, 1);
+
+    if(month) {
+        for(int i = 0; i < SH_DAYS; i++) aggMerge(agg, &_d.days[i][ch]);
+    } else {
+        for(int i = 0; i < SH_HOURS; i++) aggMerge(agg, &_d.hours[i][ch]);
+    }
+
+    if(!agg.cnt)
+        return false;
+
+    vmin = agg.min;
+    vmax = agg.max;
+    if(agg.sum < 0) {
+        vavg = (agg.sum - (agg.cnt / 2)) / (int32_t)agg.cnt;
+    } else {
+        vavg = (agg.sum + (agg.cnt / 2)) / (int32_t)agg.cnt;
+    }
+
+    return true;
+}
+
+// Sample of a given channel from "minsAgo" minutes ago
+int16_t sensHistory::getSample(int ch, uint16_t minsAgo)
+{
+    if(!_valid || ch < 0 || ch >= SH_NUMCH || minsAgo >= SH_MINS)
+        return SH_INVALID;
+
+    return _d.mins[(_d.lastStamp - minsAgo) % SH_MINS][ch];
+}
+
+void sensHistory::save()
+{
+    if(!_valid || !_dirty)
+        return;
+
+    #ifdef TC_DBG
+    Serial.printf("Sensor history: Saving to %s\n", FlashROMode ? "SD" : "Flash");
+    #endif
+
+    _d.sum = calcSum();
+    
+    if(FlashROMode) {
+        writeFileToSD(fnSensHist, (uint8_t *)&_d, sizeof(_d));
+    } else {
+        writeFileToFS(fnSensHist, (uint8_t *)&_d, sizeof(_d));
+    }
+
+    _dirty = false;
+    _lastSaveStamp = _d.lastStamp;
+}
+
+// Private functions ###########################################################
+
+void sensHistory::reset()
+{
+    uint8_t tempUnit = _d.tempUnit;
+
+    memset((void *)&_d, 0, sizeof(_d));
+
+    _d.magic = SH_MAGIC;
+    _d.version = SH_VERSION;
+    _d.tempUnit = tempUnit;
+
+    for(int i = 0; i < SH_MINS; i++) {
+        for(int j = 0; j < SH_NUMCH; j++) _d.mins[i][j] = SH_INVALID;
+    }
+    for(int i = 0; i < SH_HOURS; i++) aggClear(_d.hours[i]);
+    for(int i = 0; i < SH_DAYS; i++)  aggClear(_d.days[i]);
+
+    _valid = false;
+}
+
+/*
+ * Move "now" to stamp. Clears minute slots skipped as well as 
+ * the one about to be filled, and all hour/day aggregates 
+ * entered on the way.
+ * Returns false if stamp is in the past (sample is to be dropped).
+ */
+bool sensHistory::advanceTo(uint32_t stamp)
+{
+    if(_valid && (stamp < _d.lastStamp) && (_d.lastStamp - stamp < SH_DAYS * SH_MINS))
+        return false;
+
+    if(!_valid || (stamp < _d.lastStamp) || (stamp - _d.lastStamp >= SH_DAYS * SH_MINS)) {
+        if(_valid) reset();
+        _d.lastStamp = stamp;
+        _lastSaveStamp = stamp;
+        _valid = true;
+        return true;
+    }
+
+    for(uint32_t s = _d.lastStamp + 1; s <= stamp; s++) {
+        if(stamp - s < SH_MINS) {
+            for(int j = 0; j < SH_NUMCH; j++) _d.mins[s % SH_MINS][j] = SH_INVALID;
+        }
+        if(!(s % 60))      aggClear(_d.hours[(s / 60) % SH_HOURS]);
+        if(!(s % SH_MINS)) aggClear(_d.days[(s / SH_MINS) % SH_DAYS]);
+    }
+
+    _d.lastStamp = stamp;
+
+    return true;
+}
+
+uint32_t sensHistory::calcSum()
+{
+    const uint8_t *p = (const uint8_t *)&_d;
+    size_t len = (const uint8_t *)&_d.sum - p;
+    uint32_t sum = 0x5a5a5a5a;
+
+    for(size_t i = 0; i < len; i++) {
+        sum = ((sum << 5) | (sum >> 27)) + p[i];
+    }
+
+    return sum;
+}
+
+void sensHistory::aggClear(shAgg *agg, int num)
+{
+    for(int i = 0; i < num; i++) {
+        agg[i].min = 32767;
+        agg[i].max = SH_INVALID;
+        agg[i].sum = 0;
+        agg[i].cnt = 0;
+    }
+}
+
+void sensHistory::aggAdd(shAgg *agg, int16_t val)
+{
+    if(val == SH_INVALID)
+        return;
+
+    if(val < agg->min) agg->min = val;
+    if(val > agg->max) agg->max = val;
+    agg->sum += val;
+    agg->cnt++;
+}
+
+void sensHistory::aggMerge(shAgg& dst, shAgg *agg)
+{
+    if(!agg->cnt)
+        return;
+
+    if(agg->min < dst.min) dst.min = agg->min;
+    if(agg->max > dst.max) dst.max = agg->max;
+    dst.sum += agg->sum;
+    dst.cnt += agg->cnt;
+}
+
+#endif
@@ -80,6 +80,8 @@ class tempSensor : tcSensor {
         float readTemp(bool celsius = true);
         float readLastTemp() { return _lastTemp; };
 
+        bool loop();
+
         void setOffset(float myOffs);
 
         bool haveHum() { return _haveHum; };
@@ -96,7 +98,12 @@ class tempSensor : tcSensor {
 
         float  _lastTemp = NAN;
 
-        float  _userOffset = 0.0;
+        int32_t _userOffset = 0;          // 1/100 degrees
+        int32_t _smoothTemp;              // 1/100 degrees C
+        bool    _smoothValid = false;
+
+        bool    _readPending = false;
+        bool    _pendCelsius = true;
 
         uint32_t _BMx280_CD_T1;
         int32_t  _BMx280_CD_T2;
@@ -110,7 +117,8 @@ class tempSensor : tcSensor {
 
         unsigned long _tempReadNow = 0;
 
-        float BMx280_CalcTemp(uint32_t ival, uint32_t hval);
+        void  collectTemp(bool celsius);
+        bool  BMx280_CalcTemp(uint32_t ival, uint32_t hval, int32_t& temp);
 
         // Ptr to custom delay function
         void (*_customDelayFunc)(unsigned int) = NULL;
@@ -138,13 +146,20 @@ class lightSensor : tcSensor {
 
         int32_t readLux();
         
-        void loop();
+        bool loop();
 
     private:
+        int32_t VEML7700CalcLux(uint16_t cnt, uint8_t gainIdx, uint8_t AITIdx);
+        void VEML7700AutoRange(uint16_t cnt);
+        void VEML7700SetRange(uint8_t gainIdx, uint8_t AITIdx);
         void VEML7700SetGain(uint16_t gain, bool doWrite = true);
         void VEML7700SetAIT(uint16_t ait, bool doWrite = true);
         void VEML7700OnOff(bool enable, bool doWait = true);
 
+        void     LTR3xxSetGain(uint8_t gainIdx);
+        void     BH1750SetMode(uint8_t idx);
+        void     TSL2561SetGain(uint8_t gainIdx);
+
         int32_t  LTR3xxCalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0, uint32_t ch1);
         uint32_t TSL2561CalcLux(uint8_t iGain, uint8_t tInt, uint32_t ch0, uint32_t ch1);
 
@@ -157,6 +172,7 @@ class lightSensor : tcSensor {
 
         uint8_t _gainIdx;
         uint8_t _AITIdx;
+        bool    _rangeChanged = false;
 
         int32_t _lux = -1;
 
@@ -168,4 +184,68 @@ class lightSensor : tcSensor {
 
 #endif
 
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)  // ----------
+
+#define SH_NUMCH    3       // Channels: Temperature, humidity, lux
+#define SH_MINS     (24*60) // Minute samples kept
+#define SH_HOURS    24      // Hourly aggregates kept
+#define SH_DAYS     30      // Daily aggregates kept
+#define SH_INVALID  (-32768)
+
+enum {
+    SH_TEMP = 0,      // 1/10 degrees (in user's unit)
+    SH_HUM,           // percent
+    SH_LUX            // lux (clipped to 32767)
+};
+
+class sensHistory {
+
+    public:
+
+        void begin(bool tempUnit);
+
+        void add(uint32_t stamp, int16_t temp, int16_t hum, int16_t lux);
+
+        bool getStats(int ch, bool month, int16_t& vmin, int16_t& vmax, int16_t& vavg);
+        int16_t getSample(int ch, uint16_t minsAgo);
+
+        void save();
+
+    private:
+
+        struct shAgg {
+            int16_t  min;
+            int16_t  max;
+            int32_t  sum;
+            uint16_t cnt;
+        };
+
+        void reset();
+        bool advanceTo(uint32_t stamp);
+        uint32_t calcSum();
+
+        void aggClear(shAgg *agg, int num = SH_NUMCH);
+        void aggAdd(shAgg *agg, int16_t val);
+        void aggMerge(shAgg& dst, shAgg *agg);
+
+        // Stored as one block, this is what goes to flash/SD
+        struct {
+            uint32_t magic;
+            uint8_t  version;
+            uint8_t  tempUnit;
+            uint16_t reserved;
+            uint32_t lastStamp;
+            int16_t  mins[SH_MINS][SH_NUMCH];
+            shAgg    hours[SH_HOURS][SH_NUMCH];
+            shAgg    days[SH_DAYS][SH_NUMCH];
+            uint32_t sum;
+        } _d;
+
+        bool     _valid = false;
+        bool     _dirty = false;
+        uint32_t _lastSaveStamp = 0;
+};
+
+#endif
+
 #endif  // _TCSENSOR_H
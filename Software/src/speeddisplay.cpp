@@ -43,6 +43,8 @@
 #include "speeddisplay.h"
 #include <Wire.h>
 
+extern uint32_t i2cErrCount;
+
 // The segments' wiring to buffer bits
 // This reflects the actual hardware wiring
 
@@ -382,7 +384,7 @@ void speedDisplay::lampTest()
     for(int i = 0; i < _buf_size*2; i++) {
         Wire.write(0xFF);
     }
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 
     _lastBufPosCol = 0xffff;
 }
@@ -490,7 +492,7 @@ void speedDisplay::show()
         _lastBufPosCol = _displayBuffer[_colon_pos];
     }
 
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 
@@ -781,7 +783,7 @@ void speedDisplay::directCol(int col, int segments)
     Wire.write(col * 2);  // 2 bytes per col * position
     Wire.write(segments & 0xFF);
     Wire.write(segments >> 8);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 
     if(col == _colon_pos)
         _lastBufPosCol = segments;
@@ -798,7 +800,7 @@ void speedDisplay::clearDisplay()
         Wire.write(0x0);
     }
 
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 
     _lastBufPosCol = 0;
 }
@@ -807,7 +809,7 @@ void speedDisplay::directCmd(uint8_t val)
 {
     Wire.beginTransmission(_address);
     Wire.write(val);
-    Wire.endTransmission();
+    if(Wire.endTransmission()) i2cErrCount++;
 }
 
 #endif
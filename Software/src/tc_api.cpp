@@ -0,0 +1,162 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * REST API request checks
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "tc_time.h"
+#include "tc_api.h"
+
+/*
+ * REST API request checks
+ *
+ * The handlers in tc_wifi.cpp only act on what passed these
+ * checks, and send the response. apiParseBody() returns the 
+ * HTTP status code (200, 400 for a bad body, 503 if busy), 
+ * the apiCheckXXX() functions return false if a parameter is 
+ * missing or out of range (400). Optional parameters not 
+ * given are returned as -1.
+ */
+
+int apiParseBody(bool busy, const char *body, JsonDocument& json)
+{
+    if(busy) 
+        return 503;
+
+    if(body) {
+        if(deserializeJson(json, body) || !json.is<JsonObject>())
+            return 400;
+    }
+
+    return 200;
+}
+
+// Check an optional integer parameter; false if present but invalid
+bool apiGetInt(JsonDocument& json, const char *key, int minVal, int maxVal, int& val)
+{
+    val = -1;
+
+    if(json[key].isNull()) return true;
+    if(!json[key].is<int>()) return false;
+
+    val = json[key].as<int>();
+    
+    return (val >= minVal && val <= maxVal);
+}
+
+// Check an optional boolean parameter; false if present but invalid
+bool apiGetBool(JsonDocument& json, const char *key, int& val)
+{
+    val = -1;
+
+    if(json[key].isNull()) return true;
+    if(!json[key].is<bool>()) return false;
+
+    val = json[key].as<bool>() ? 1 : 0;
+
+    return true;
+}
+
+bool apiCheckTimeTravel(JsonDocument& json, int& speed)
+{
+    return apiGetInt(json, "speed", 0, 88, speed);
+}
+
+// All required
+bool apiCheckDestination(JsonDocument& json, int& year, int& month, int& day, int& hour, int& minute)
+{
+    return (apiGetInt(json, "year", 1, 9999, year)      && year >= 0   &&
+            apiGetInt(json, "month", 1, 12, month)      && month >= 0  &&
+            apiGetInt(json, "day", 1, 31, day)          && day >= 0    &&
+            apiGetInt(json, "hour", 0, 23, hour)        && hour >= 0   &&
+            apiGetInt(json, "minute", 0, 59, minute)    && minute >= 0 &&
+            day <= daysInMonth(month, year));
+}
+
+// All optional, but hour and minute only together
+bool apiCheckAlarm(JsonDocument& json, int& onOff, int& hour, int& minute)
+{
+    return (apiGetInt(json, "hour", 0, 23, hour)     &&
+            apiGetInt(json, "minute", 0, 59, minute) &&
+            ((hour < 0) == (minute < 0))             &&
+            apiGetBool(json, "on", onOff));
+}
+
+bool apiCheckVolume(JsonDocument& json, int& vol)
+{
+    return (apiGetInt(json, "volume", 0, 19, vol) && vol >= 0);
+}
+
+// b[3]: destination, present, departed
+bool apiCheckBrightness(JsonDocument& json, int *b)
+{
+    const char *keys[3] = { "destination", "present", "departed" };
+
+    for(int i = 0; i < 3; i++) {
+        if(!apiGetInt(json, keys[i], 0, 15, b[i]))
+            return false;
+    }
+
+    return true;
+}
+
+bool apiCheckMusic(JsonDocument& json, int& action, int& track, int& shuffle)
+{
+    const char *actions[4] = { "play", "stop", "next", "prev" };
+
+    action = API_MP_NONE;
+
+    if(!apiGetInt(json, "track", 0, 999, track) ||
+       !apiGetBool(json, "shuffle", shuffle))
+        return false;
+
+    if(json["action"].isNull())
+        return true;
+
+    if(json["action"].is<const char *>()) {
+        for(int i = 0; i < 4; i++) {
+            if(!strcmp(json["action"].as<const char *>(), actions[i])) {
+                action = API_MP_PLAY + i;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool apiCheckBeep(JsonDocument& json, int& mode)
+{
+    return (apiGetInt(json, "mode", 0, 3, mode) && mode >= 0);
+}
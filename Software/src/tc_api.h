@@ -0,0 +1,56 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * REST API request checks
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_API_H
+#define _TC_API_H
+
+#include <ArduinoJson.h>
+
+// Music actions
+#define API_MP_NONE 0
+#define API_MP_PLAY 1
+#define API_MP_STOP 2
+#define API_MP_NEXT 3
+#define API_MP_PREV 4
+
+int  apiParseBody(bool busy, const char *body, JsonDocument& json);
+bool apiGetInt(JsonDocument& json, const char *key, int minVal, int maxVal, int& val);
+bool apiGetBool(JsonDocument& json, const char *key, int& val);
+
+bool apiCheckTimeTravel(JsonDocument& json, int& speed);
+bool apiCheckDestination(JsonDocument& json, int& year, int& month, int& day, int& hour, int& minute);
+bool apiCheckAlarm(JsonDocument& json, int& onOff, int& hour, int& minute);
+bool apiCheckVolume(JsonDocument& json, int& vol);
+bool apiCheckBrightness(JsonDocument& json, int *b);
+bool apiCheckMusic(JsonDocument& json, int& action, int& track, int& shuffle);
+bool apiCheckBeep(JsonDocument& json, int& mode);
+
+#endif
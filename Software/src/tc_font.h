@@ -133,6 +133,18 @@ static const uint16_t alphaChars[127-31-1] = {
 };
 #endif
 
+// 7-segment digit patterns
+#define ND_0 0b00111111
+#define ND_1 0b00000110
+#define ND_2 0b01011011
+#define ND_3 0b01001111
+#define ND_4 0b01100110
+#define ND_5 0b01101101
+#define ND_6 0b01111100
+#define ND_7 0b00000111
+#define ND_8 0b01111111
+#define ND_9 0b01100111
+
 static const uint8_t numDigs[127-31-1+2] = {
     0b00000000, // space
     0b00000010, // !
@@ -150,16 +162,16 @@ static const uint8_t numDigs[127-31-1+2] = {
     0b01000000, // -
     0b00001000, // .
     0b01000010, // /
-    0b00111111, // 0
-    0b00000110, // 1
-    0b01011011, // 2
-    0b01001111, // 3
-    0b01100110, // 4
-    0b01101101, // 5
-    0b01111100, // 6
-    0b00000111, // 7
-    0b01111111, // 8
-    0b01100111, // 9
+    ND_0,       // 0
+    ND_1,       // 1
+    ND_2,       // 2
+    ND_3,       // 3
+    ND_4,       // 4
+    ND_5,       // 5
+    ND_6,       // 6
+    ND_7,       // 7
+    ND_8,       // 8
+    ND_9,       // 9
     0b01001000, // :
     0b01001100, // ;
     0b01100001, // <
@@ -233,4 +245,18 @@ static const uint8_t numDigs[127-31-1+2] = {
     0b01011101  // %2  (encoded as \x80)
 };
 
+// Two-digit numbers 00-99 for a 7-segment pair,
+// as used by clockDisplay::makeNum(): MSB = 1s, LSB = 10s
+#define NUM2(t, o) ((ND_##o << 8) | ND_##t)
+#define NUM2ROW(t) NUM2(t, 0), NUM2(t, 1), NUM2(t, 2), NUM2(t, 3), NUM2(t, 4), \
+                   NUM2(t, 5), NUM2(t, 6), NUM2(t, 7), NUM2(t, 8), NUM2(t, 9)
+
+static const uint16_t numPairs[100] = {
+    NUM2ROW(0), NUM2ROW(1), NUM2ROW(2), NUM2ROW(3), NUM2ROW(4),
+    NUM2ROW(5), NUM2ROW(6), NUM2ROW(7), NUM2ROW(8), NUM2ROW(9)
+};
+
+#undef NUM2ROW
+#undef NUM2
+
 #endif
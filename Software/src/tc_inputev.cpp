@@ -0,0 +1,158 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * Input event queue
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+
+#include "tc_inputev.h"
+
+// Ring buffer; size must be power of 2
+#define TCI_QUEUE_SIZE  16
+
+static inputEvent       inputEvQueue[TCI_QUEUE_SIZE];
+static volatile uint8_t inputEvHead = 0;
+static volatile uint8_t inputEvTail = 0;
+
+static bool inputEvPut(uint8_t type, char key, unsigned long time);
+static bool inputEvRemove(uint8_t type, bool firstOnly);
+
+/*
+ * Input event queue
+ *
+ * Keypad keys, ENTER, the external time travel button and MQTT
+ * commands are queued as timestamped events and consumed by 
+ * keypad_loop() in order of arrival. Keys entered during a 
+ * sequence are therefore not lost. Coalescing: An action (ie 
+ * anything but a digit) identical to the last queued event is 
+ * not queued again, and actions older than TCI_MAX_AGE are not 
+ * returned by inputEvGet(). Digits expire after TCI_KEY_MAX_AGE, 
+ * like an unfinished entry does. If the queue is full, new events 
+ * are dropped.
+ */
+bool inputEvAdd(uint8_t type, char key)
+{
+    return inputEvPut(type, key, millis());
+}
+
+/*
+ * Queue a recorded list of events, keeping their timestamps.
+ * For tests and debugging; same rules as for live input apply.
+ * Returns the number of events queued.
+ */
+int inputEvReplay(const inputEvent *evs, int num)
+{
+    int queued = 0;
+
+    for(int i = 0; i < num; i++) {
+        if(inputEvPut(evs[i].type, evs[i].key, evs[i].time)) queued++;
+    }
+
+    return queued;
+}
+
+static bool inputEvPut(uint8_t type, char key, unsigned long time)
+{
+    uint8_t next = (inputEvHead + 1) & (TCI_QUEUE_SIZE - 1);
+
+    if(type != TCI_KEY && inputEvHead != inputEvTail) {
+        inputEvent *last = &inputEvQueue[(inputEvHead - 1) & (TCI_QUEUE_SIZE - 1)];
+        if(last->type == type && last->key == key) {
+            last->time = time;
+            return true;
+        }
+    }
+
+    if(next == inputEvTail) {
+        #ifdef TC_DBG
+        Serial.printf("Input queue full, dropping event %d\n", type);
+        #endif
+        return false;
+    }
+
+    inputEvQueue[inputEvHead].type = type;
+    inputEvQueue[inputEvHead].key = key;
+    inputEvQueue[inputEvHead].time = time;
+    inputEvHead = next;
+
+    return true;
+}
+
+// Fetch oldest event; expired events are discarded on the way
+bool inputEvGet(inputEvent& ev)
+{
+    unsigned long now = millis();
+
+    while(inputEvHead != inputEvTail) {
+        ev = inputEvQueue[inputEvTail];
+        inputEvTail = (inputEvTail + 1) & (TCI_QUEUE_SIZE - 1);
+        if(now - ev.time <= ((ev.type == TCI_KEY) ? TCI_KEY_MAX_AGE : TCI_MAX_AGE))
+            return true;
+    }
+
+    return false;
+}
+
+// Remove first event of given type from queue, return true if found
+bool inputEvTake(uint8_t type)
+{
+    return inputEvRemove(type, true);
+}
+
+// Remove all events of given type (0 = all) from queue
+void inputEvFlush(uint8_t type)
+{
+    if(!type) {
+        inputEvTail = inputEvHead;
+    } else {
+        inputEvRemove(type, false);
+    }
+}
+
+static bool inputEvRemove(uint8_t type, bool firstOnly)
+{
+    uint8_t r = inputEvTail, w = inputEvTail;
+    bool found = false;
+
+    while(r != inputEvHead) {
+        if(inputEvQueue[r].type == type && !(firstOnly && found)) {
+            found = true;
+        } else {
+            if(w != r) inputEvQueue[w] = inputEvQueue[r];
+            w = (w + 1) & (TCI_QUEUE_SIZE - 1);
+        }
+        r = (r + 1) & (TCI_QUEUE_SIZE - 1);
+    }
+    inputEvHead = w;
+
+    return found;
+}
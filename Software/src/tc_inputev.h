@@ -0,0 +1,59 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * Input event queue
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_INPUTEV_H
+#define _TC_INPUTEV_H
+
+// Input event types
+#define TCI_KEY         1   // Keypad digit
+#define TCI_KEYHOLD     2   // Keypad key held
+#define TCI_ENTER       3   // ENTER pressed
+#define TCI_ENTERHOLD   4   // ENTER held
+#define TCI_ETT         5   // External time travel (button or MQTT)
+#define TCI_ETTHOLD     6   // External time travel held (= return)
+
+// Queued events older than this (ms) are discarded
+#define TCI_MAX_AGE     2000            // Actions
+#define TCI_KEY_MAX_AGE (2*60*1000)     // Digits (= keypad entry timeout)
+
+typedef struct {
+    uint8_t       type;
+    char          key;
+    unsigned long time;
+} inputEvent;
+
+bool inputEvAdd(uint8_t type, char key = 0);
+int  inputEvReplay(const inputEvent *evs, int num);
+bool inputEvGet(inputEvent& ev);
+bool inputEvTake(uint8_t type);
+void inputEvFlush(uint8_t type = 0);
+
+#endif
@@ -89,15 +89,11 @@ static const uint8_t colPins[3] = {2, 0, 4};
 
 static Keypad_I2C keypad((char *)keys, rowPins, colPins, 4, 3, KEYPAD_ADDR);
 
-bool isEnterKeyPressed = false;
-bool isEnterKeyHeld    = false;
 static bool enterWasPressed = false;
 
 static bool needDepTime = false;
 
 #ifdef EXTERNAL_TIMETRAVEL_IN
-bool                 isEttKeyPressed = false;
-bool                 isEttKeyHeld = false;
 static unsigned long ettNow = 0;
 static bool          ettDelayed = false;
 static unsigned long ettDelay = 0; // ms
@@ -131,6 +127,9 @@ bool menuActive = false;
 
 static bool doKey = false;
 
+// Keypad input is discarded after this period of inactivity
+#define KEY_ENTRY_TIMEOUT TCI_KEY_MAX_AGE
+
 static unsigned long enterDelay = 0;
 
 static TCButton enterKey = TCButton(ENTER_BUTTON_PIN,
@@ -146,6 +145,7 @@ static TCButton ettKey = TCButton(EXTERNAL_TIMETRAVEL_IN_PIN,
 #endif
 
 static void keypadEvent(char key, KeyState kstate);
+static void keyHeld(char key);
 static void recordKey(char key);
 static void recordSetTimeKey(char key);
 static void recordSetYearKey(char key);
@@ -161,7 +161,6 @@ static void ettKeyHeld();
 static void setupWCMode();
 static void buildRemString(char *buf);
 static void buildRemOffString(char *buf);
-static void mykpddelay(unsigned int mydel);
 
 /*
  * keypad_setup()
@@ -173,11 +172,6 @@ void keypad_setup()
 
     keypad.addEventListener(keypadEvent);
 
-    // Set custom delay function
-    // Called between i2c key scan iterations
-    // (calls audio_loop() while waiting)
-    keypad.setCustomDelayFunc(mykpddelay);
-
     keypad.setScanInterval(20);
     keypad.setHoldTime(ENTER_HOLD_TIME);
 
@@ -220,13 +214,16 @@ bool scanKeypad()
 
 /*
  *  The keypad event handler
+ *
+ *  Keys are not acted upon here, but queued as input events 
+ *  for keypad_loop(). Only in menu mode they are recorded 
+ *  directly.
  */
 static void keypadEvent(char key, KeyState kstate)
 {
-    bool mpWasActive = false;
-    bool playBad = false;
-    
-    if(!FPBUnitIsOn || startup || timeTravelP0 || timeTravelP1 || timeTravelRE)
+    bool isBusy = (startup || timeTravelP0 || timeTravelP1 || timeTravelRE);
+
+    if(!FPBUnitIsOn)
         return;
 
     pwrNeedFullNow();
@@ -234,97 +231,17 @@ static void keypadEvent(char key, KeyState kstate)
     switch(kstate) {
     case TCKS_PRESSED:
         if(key != '#' && key != '*') {
-            play_keypad_sound(key);
+            // No click sound during sequences; the key is queued silently
+            if(!isBusy) play_keypad_sound(key);
             doKey = true;
         }
         break;
         
     case TCKS_HOLD:
         if(keypadInMenu) break;    // Don't do anything while in menu
-
-        switch(key) {
-        case '0':    // "0" held down -> time travel
-            doKey = false;
-            // Complete timeTravel, with speedo
-            timeTravel(true, true);
-            break;
-        case '9':    // "9" held down -> return from time travel
-            doKey = false;
-            resetPresentTime();
-            break;
-        case '1':    // "1" held down -> toggle alarm on/off
-            doKey = false;
-            switch(toggleAlarm()) {
-            case -1:
-                playBad = true;
-                break;
-            case 0:
-                play_file("/alarmoff.mp3", PA_CHECKNM|PA_ALLOWSD|PA_DYNVOL);
-                break;
-            case 1:
-                play_file("/alarmon.mp3", PA_CHECKNM|PA_ALLOWSD|PA_DYNVOL);
-                break;
-            }
-            break;
-        case '4':    // "4" held down -> toggle night-mode on/off
-            doKey = false;
-            if(toggleNightMode()) {
-                manualNightMode = 1;
-                play_file("/nmon.mp3", PA_ALLOWSD|PA_DYNVOL);
-            } else {
-                manualNightMode = 0;
-                play_file("/nmoff.mp3", PA_ALLOWSD|PA_DYNVOL);
-            }
-            manualNMNow = millis();
-            break;
-        case '3':    // "3" held down -> play audio file "key3.mp3"
-            doKey = false;
-            play_file("/key3.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
-            break;
-        case '6':    // "6" held down -> play audio file "key6.mp3"
-            doKey = false;
-            play_file("/key6.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
-            break;
-        case '7':    // "7" held down -> re-enable/re-connect WiFi
-            doKey = false;
-            if(!wifiOnWillBlock()) {
-                play_file("/ping.mp3", PA_CHECKNM|PA_ALLOWSD);
-            } else {
-                if(haveMusic) mpWasActive = mp_stop();
-                play_file("/ping.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD);
-                waitAudioDone();
-            }
-            // Enable WiFi / even if in AP mode / with CP
-            wifiOn(0, true, false);
-            syncTrigger = true;
-            // Restart mp if it was active before
-            if(mpWasActive) mp_play();   
-            break;
-        case '2':    // "2" held down -> musicplayer prev
-            doKey = false;
-            if(haveMusic) {
-                mp_prev(mpActive);
-            } else playBad = true;
-            break;
-        case '5':    // "5" held down -> musicplayer start/stop
-            doKey = false;
-            if(haveMusic) {
-                if(mpActive) {
-                    mp_stop();
-                } else {
-                    mp_play();
-                }
-            } else playBad = true;
-            break;
-        case '8':   // "8" held down -> musicplayer next
+        if(key != '#' && key != '*') {
             doKey = false;
-            if(haveMusic) {
-                mp_next(mpActive);
-            } else playBad = true;
-            break;
-        }
-        if(playBad) {
-            play_file("/baddate.mp3", PA_CHECKNM|PA_ALLOWSD);
+            inputEvAdd(TCI_KEYHOLD, key);
         }
         break;
         
@@ -337,13 +254,97 @@ static void keypadEvent(char key, KeyState kstate)
                     recordSetTimeKey(key);
                 }
             } else {
-                recordKey(key);
+                inputEvAdd(TCI_KEY, key);
             }
         }
         break;
     }
 }
 
+/*
+ *  Execute action for held key
+ */
+static void keyHeld(char key)
+{
+    bool mpWasActive = false;
+    bool playBad = false;
+
+    switch(key) {
+    case '0':    // "0" held down -> time travel
+        // Complete timeTravel, with speedo
+        timeTravel(true, true);
+        break;
+    case '9':    // "9" held down -> return from time travel
+        resetPresentTime();
+        break;
+    case '1':    // "1" held down -> toggle alarm on/off
+        switch(toggleAlarm()) {
+        case -1:
+            playBad = true;
+            break;
+        case 0:
+            play_file("/alarmoff.mp3", PA_CHECKNM|PA_ALLOWSD|PA_DYNVOL);
+            break;
+        case 1:
+            play_file("/alarmon.mp3", PA_CHECKNM|PA_ALLOWSD|PA_DYNVOL);
+            break;
+        }
+        break;
+    case '4':    // "4" held down -> toggle night-mode on/off
+        if(toggleNightMode()) {
+            manualNightMode = 1;
+            play_file("/nmon.mp3", PA_ALLOWSD|PA_DYNVOL);
+        } else {
+            manualNightMode = 0;
+            play_file("/nmoff.mp3", PA_ALLOWSD|PA_DYNVOL);
+        }
+        manualNMNow = millis();
+        break;
+    case '3':    // "3" held down -> play audio file "key3.mp3"
+        play_file("/key3.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
+        break;
+    case '6':    // "6" held down -> play audio file "key6.mp3"
+        play_file("/key6.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD|PA_DYNVOL);
+        break;
+    case '7':    // "7" held down -> re-enable/re-connect WiFi
+        if(!wifiOnWillBlock()) {
+            play_file("/ping.mp3", PA_CHECKNM|PA_ALLOWSD);
+        } else {
+            if(haveMusic) mpWasActive = mp_stop();
+            play_file("/ping.mp3", PA_CHECKNM|PA_INTRMUS|PA_ALLOWSD);
+            waitAudioDone();
+        }
+        // Enable WiFi / even if in AP mode / with CP
+        wifiOn(0, true, false);
+        syncTrigger = true;
+        // Restart mp if it was active before
+        if(mpWasActive) mp_play();   
+        break;
+    case '2':    // "2" held down -> musicplayer prev
+        if(haveMusic) {
+            mp_prev(mpActive);
+        } else playBad = true;
+        break;
+    case '5':    // "5" held down -> musicplayer start/stop
+        if(haveMusic) {
+            if(mpActive) {
+                mp_stop();
+            } else {
+                mp_play();
+            }
+        } else playBad = true;
+        break;
+    case '8':   // "8" held down -> musicplayer next
+        if(haveMusic) {
+            mp_next(mpActive);
+        } else playBad = true;
+        break;
+    }
+    if(playBad) {
+        play_file("/baddate.mp3", PA_CHECKNM|PA_ALLOWSD);
+    }
+}
+
 void resetKeypadState()
 {
     doKey = false;
@@ -351,26 +352,26 @@ void resetKeypadState()
 
 static void enterKeyPressed()
 {
-    isEnterKeyPressed = true;
+    inputEvAdd(TCI_ENTER);
     pwrNeedFullNow();
 }
 
 static void enterKeyHeld()
 {
-    isEnterKeyHeld = true;
+    inputEvAdd(TCI_ENTERHOLD);
     pwrNeedFullNow();
 }
 
 #ifdef EXTERNAL_TIMETRAVEL_IN
 static void ettKeyPressed()
 {
-    isEttKeyPressed = true;
+    inputEvAdd(TCI_ETT);
     pwrNeedFullNow();
 }
 
 static void ettKeyHeld()
 {
-    isEttKeyHeld = true;
+    inputEvAdd(TCI_ETTHOLD);
     pwrNeedFullNow();
 }
 #endif
@@ -427,44 +428,69 @@ void keypad_loop()
     #define EE1_KL2 12
     char spTxtS2[EE1_KL2] = { 181, 224, 179, 231, 199, 140, 197, 129, 197, 140, 194, 133 };
     const char *tmr = "TIMER   ";
+    inputEvent ev;
+    bool enterPressed = false;
+    bool enterHeld = false;
 
     enterkeyScan();
 
     // Discard keypad input after 2 minutes of inactivity
-    if(millis() - lastKeyPressed >= 2*60*1000) {
+    if(millis() - lastKeyPressed >= KEY_ENTRY_TIMEOUT) {
         dateBuffer[0] = '\0';
         dateIndex = 0;
     }
 
-    // Bail out if sequence played or device is fake-"off"
-    if(!FPBUnitIsOn || startup || timeTravelP0 || timeTravelP1 || timeTravelRE) {
-
-        isEnterKeyHeld = false;
-        isEnterKeyPressed = false;
-        #ifdef EXTERNAL_TIMETRAVEL_IN
-        isEttKeyPressed = false;
-        isEttKeyHeld = false;
-        #endif
+    // Discard all input if device is fake-"off"
+    if(!FPBUnitIsOn) {
+        inputEvFlush();
+        return;
+    }
 
+    // Bail out if sequence played; queued input is
+    // processed (or expires) afterwards
+    if(startup || timeTravelP0 || timeTravelP1 || timeTravelRE)
         return;
 
-    }
+    // Process queued input in order of arrival. Any action
+    // ends this pass, so that subsequent input is processed
+    // after the action (eg goes into the next date entry).
+    while(inputEvGet(ev)) {
 
-#ifdef EXTERNAL_TIMETRAVEL_IN
-    if(isEttKeyHeld) {
-        resetPresentTime();
-        isEttKeyPressed = isEttKeyHeld = false;
-    } else if(isEttKeyPressed) {
-        if(!ettDelay) {
-            timeTravel(ettLong, true);
-            ettDelayed = false;
-        } else {
-            ettNow = millis();
-            ettDelayed = true;
-            startBeepTimer();
+        if(ev.type == TCI_KEY) {
+            recordKey(ev.key);
+            continue;
         }
-        isEttKeyPressed = isEttKeyHeld = false;
+
+        switch(ev.type) {
+        case TCI_KEYHOLD:
+            keyHeld(ev.key);
+            break;
+        case TCI_ENTER:
+            enterPressed = true;
+            break;
+        case TCI_ENTERHOLD:
+            enterHeld = true;
+            break;
+        #ifdef EXTERNAL_TIMETRAVEL_IN
+        case TCI_ETTHOLD:
+            resetPresentTime();
+            break;
+        case TCI_ETT:
+            if(!ettDelay) {
+                timeTravel(ettLong, true);
+                ettDelayed = false;
+            } else {
+                ettNow = millis();
+                ettDelayed = true;
+                startBeepTimer();
+            }
+            break;
+        #endif
+        }
+        break;
     }
+
+#ifdef EXTERNAL_TIMETRAVEL_IN
     if(ettDelayed) {
         if(millis() - ettNow >= ettDelay) {
             timeTravel(ettLong, true);
@@ -474,10 +500,8 @@ void keypad_loop()
 #endif
 
     // If enter key is held, go into keypad menu
-    if(isEnterKeyHeld) {
+    if(enterHeld) {
 
-        isEnterKeyHeld = false;
-        isEnterKeyPressed = false;
         cancelEnterAnim();
         cancelETTAnim();
 
@@ -488,28 +512,22 @@ void keypad_loop()
 
         enter_menu();
 
-        isEnterKeyHeld = false;
-        isEnterKeyPressed = false;
-
-        #ifdef EXTERNAL_TIMETRAVEL_IN
-        // No external tt while in menu mode,
-        // so reset flag upon menu exit
-        isEttKeyPressed = isEttKeyHeld = false;
-        #endif
+        // No input is taken while in menu mode,
+        // so discard whatever was queued
+        inputEvFlush();
 
         menuActive = false;
 
     }
 
     // if enter key is merely pressed, copy dateBuffer to destination time (if valid)
-    if(isEnterKeyPressed) {
+    if(enterPressed) {
 
         int  strLen = strlen(dateBuffer);
         bool invalidEntry = false;
         bool validEntry = false;
         uint16_t enterInterruptsMusic = 0;
 
-        isEnterKeyPressed = false;
         enterWasPressed = true;
 
         cancelETTAnim();
@@ -1283,7 +1301,7 @@ void cancelETTAnim()
 
 bool keypadIsIdle()
 {
-    return (!lastKeyPressed || (millis() - lastKeyPressed >= 2*60*1000));
+    return (!lastKeyPressed || (millis() - lastKeyPressed >= KEY_ENTRY_TIMEOUT));
 }
 
 static void setupWCMode()
@@ -1331,20 +1349,6 @@ static void buildRemOffString(char *buf)
     #endif
 }
 
-/*
- * Custom delay function for key scan in keypad_i2c
- */
-static void mykpddelay(unsigned int mydel)
-{
-    unsigned long startNow = millis();
-    audio_loop();
-    while(millis() - startNow < mydel) {
-        delay(1);
-        ntp_short_loop();
-        audio_loop();
-    }
-}
-
 /*
  * Beep
  */
@@ -33,12 +33,8 @@
 #ifndef _TC_KEYPAD_H
 #define _TC_KEYPAD_H
 
-extern bool isEnterKeyPressed;
-extern bool isEnterKeyHeld;
-#ifdef EXTERNAL_TIMETRAVEL_IN
-extern bool isEttKeyPressed;
-extern bool isEttKeyHeld;
-#endif
+#include "tc_inputev.h"
+
 extern bool menuActive;
 
 extern char timeBuffer[];
@@ -0,0 +1,99 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * Light sensor night mode
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "tc_global.h"
+
+#ifdef TC_HAVELIGHT
+
+#include <Arduino.h>
+
+#include "tc_luxnm.h"
+
+static int32_t luxLimit = 3;
+static int32_t luxHyst = LUX_HYST_MIN;
+static int8_t  luxNMCur = LUXNM_NONE;
+static int8_t  luxNMNew = LUXNM_NONE;   // Change to be confirmed
+static uint8_t luxNMCount = 0;
+
+void luxNMSetup(int32_t limit)
+{
+    luxLimit = limit;
+    luxHyst = max((int32_t)LUX_HYST_MIN, luxLimit * LUX_HYST_PCT / 100);
+    luxNMCur = luxNMNew = LUXNM_NONE;
+    luxNMCount = 0;
+}
+
+/*
+ * Evaluate a new lux reading for night mode. Night mode is due
+ * if lux <= luxLimit, and over only if lux exceeds luxLimit plus
+ * a hysteresis. Changes need LUX_CONFIRM consecutive readings 
+ * calling for the same state, except for the first reading and 
+ * bad readings (overload).
+ */
+int8_t luxNMEval(int32_t lux)
+{
+    int8_t newState;
+
+    if(lux < 0) {
+        newState = LUXNM_BAD;
+    } else if(lux <= luxLimit) {
+        newState = LUXNM_ON;
+    } else if((lux > luxLimit + luxHyst) || (luxNMCur < 0)) {
+        newState = LUXNM_OFF;
+    } else {
+        newState = luxNMCur;    // within hysteresis band
+    }
+
+    if(newState == luxNMCur) {
+        luxNMCount = 0;
+        return luxNMCur;
+    }
+
+    if(newState != luxNMNew) {
+        luxNMNew = newState;
+        luxNMCount = 0;
+    }
+
+    if((luxNMCur == LUXNM_NONE) || (newState < 0) || (++luxNMCount >= LUX_CONFIRM)) {
+        luxNMCur = newState;
+        luxNMCount = 0;
+    }
+
+    return luxNMCur;
+}
+
+int8_t luxNMState()
+{
+    return luxNMCur;
+}
+
+#endif
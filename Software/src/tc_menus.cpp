@@ -337,8 +337,7 @@ void enter_menu()
 
     pwrNeedFullNow();
 
-    isEnterKeyHeld = false;
-    isEnterKeyPressed = false;
+    inputEvFlush();
 
     destinationTime.setNightMode(false);
     presentTime.setNightMode(false);
@@ -474,6 +473,7 @@ void enter_menu()
             displaySet->setYearOffset(tyroffs);
 
             rtc.adjust(0, minSet, hourSet, dayOfWeek(daySet, monthSet, yearSet), daySet, monthSet, newYear-2000U);
+            timeBaseInvalidate();
 
             // User entered current local time; set DST flag accordingly
             // (This assumes user did not set time in the "loop-hour" when
@@ -1753,6 +1753,7 @@ static void doShowSensors()
     uint8_t numIdx = 0, maxIdx = 0;
     int hum;
     float temp;
+    int16_t hmin, hmax, havg;
 
     #ifdef TC_HAVELIGHT
     if(useLight) numberArr[numIdx++] = 0;
@@ -1772,7 +1773,7 @@ static void doShowSensors()
     presentTime.on();
     departedTime.off();
 
-    isEnterKeyHeld = false;
+    inputEvFlush(TCI_ENTERHOLD);
 
     sensNow = millis();
 
@@ -1791,6 +1792,7 @@ static void doShowSensors()
                     if(numIdx > maxIdx) numIdx = 0;
                     destinationTime.showTextDirect("WAIT");
                     presentTime.showTextDirect("");
+                    departedTime.off();
                 }
             }
             
@@ -1850,6 +1852,39 @@ static void doShowSensors()
                     break;
                 }
                 presentTime.showTextDirect(buf);
+
+                // Show min-max of last 24 hours on departed time
+                buf[0] = 0;
+                switch(numberArr[numIdx]) {
+                case 0:
+                    if(sensHist.getStats(SH_LUX, false, hmin, hmax, havg)) {
+                        snprintf(buf, sizeof(buf), "%d-%d LUX", hmin, hmax);
+                    }
+                    break;
+                case 1:
+                    #ifdef TC_HAVETEMP
+                    if(sensHist.getStats(SH_TEMP, false, hmin, hmax, havg)) {
+                        snprintf(buf, sizeof(buf), "%.1f-%.1f~%c", (float)hmin / 10.0f, (float)hmax / 10.0f, tempUnit ? 'C' : 'F');
+                    }
+                    #endif
+                    break;
+                case 2:
+                    if(sensHist.getStats(SH_HUM, false, hmin, hmax, havg)) {
+                        #ifdef IS_ACAR_DISPLAY
+                        snprintf(buf, sizeof(buf), "%d-%d\x7f\x80", hmin, hmax);
+                        #else
+                        snprintf(buf, sizeof(buf), "%d-%d \x7f\x80", hmin, hmax);
+                        #endif
+                    }
+                    break;
+                }
+                if(buf[0]) {
+                    departedTime.showTextDirect(buf);
+                    departedTime.on();
+                } else {
+                    departedTime.off();
+                }
+
                 sensNow = millis();
             }
 
@@ -1893,7 +1928,7 @@ static void doShowNetInfo()
 
     displayIP();
 
-    isEnterKeyHeld = false;
+    inputEvFlush(TCI_ENTERHOLD);
 
     timeout = 0;  // reset timeout
 
@@ -2133,8 +2168,7 @@ static bool menuWaitForRelease()
 {
     while(checkEnterPress()) {
         myloop();
-        if(isEnterKeyHeld) {
-            isEnterKeyHeld = false;
+        if(inputEvTake(TCI_ENTERHOLD)) {
             return true;
         }
         delay(10);
@@ -2174,8 +2208,8 @@ void waitForEnterRelease()
             break;
     }
     
-    isEnterKeyPressed = false;
-    isEnterKeyHeld = false;
+    inputEvFlush(TCI_ENTER);
+    inputEvFlush(TCI_ENTERHOLD);
 }
 
 void waitAudioDone()
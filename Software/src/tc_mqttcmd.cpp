@@ -0,0 +1,206 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * MQTT commands
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "tc_global.h"
+
+#ifdef TC_HAVEMQTT
+
+#include <Arduino.h>
+
+#include "tc_time.h"
+#include "tc_mqttcmd.h"
+
+/*
+ * MQTT command table
+ *
+ * Commands are given as "COMMAND" or "COMMAND <argument>".
+ * The table must be kept sorted (strcmp order), it is looked
+ * up by binary search.
+ */
+
+// Argument types
+#define MQA_NONE    0   // No argument
+#define MQA_INT     1   // Integer within argMin-argMax
+#define MQA_OPTINT  2   // Optional integer within argMin-argMax
+#define MQA_DATE    3   // MMDDYYYYHHMM (as entered on keypad)
+
+static const struct {
+    const char *name;
+    uint8_t     id;
+    uint8_t     argType;
+    int16_t     argMin;
+    int16_t     argMax;
+} mqttCmds[] = {
+    { "ALARM_OFF",          MQC_ALARM_OFF,          MQA_NONE,   0,   0 },
+    { "ALARM_ON",           MQC_ALARM_ON,           MQA_NONE,   0,   0 },
+    { "BEEP_30",            MQC_BEEP_30,            MQA_NONE,   0,   0 },
+    { "BEEP_60",            MQC_BEEP_60,            MQA_NONE,   0,   0 },
+    { "BEEP_OFF",           MQC_BEEP_OFF,           MQA_NONE,   0,   0 },
+    { "BEEP_ON",            MQC_BEEP_ON,            MQA_NONE,   0,   0 },
+    { "BRIGHTNESS_DEPART",  MQC_BRIGHTNESS_DEPART,  MQA_INT,    0,  15 },
+    { "BRIGHTNESS_DEST",    MQC_BRIGHTNESS_DEST,    MQA_INT,    0,  15 },
+    { "BRIGHTNESS_PRESENT", MQC_BRIGHTNESS_PRESENT, MQA_INT,    0,  15 },
+    { "DESTINATION",        MQC_DESTINATION,        MQA_DATE,   0,   0 },
+    { "MP_NEXT",            MQC_MP_NEXT,            MQA_NONE,   0,   0 },
+    { "MP_PLAY",            MQC_MP_PLAY,            MQA_NONE,   0,   0 },
+    { "MP_PREV",            MQC_MP_PREV,            MQA_NONE,   0,   0 },
+    { "MP_SHUFFLE_OFF",     MQC_MP_SHUFFLE_OFF,     MQA_NONE,   0,   0 },
+    { "MP_SHUFFLE_ON",      MQC_MP_SHUFFLE_ON,      MQA_NONE,   0,   0 },
+    { "MP_STOP",            MQC_MP_STOP,            MQA_NONE,   0,   0 },
+    { "MP_TRACK",           MQC_MP_TRACK,           MQA_INT,    0, 999 },
+    { "NIGHTMODE_OFF",      MQC_NIGHTMODE_OFF,      MQA_NONE,   0,   0 },
+    { "NIGHTMODE_ON",       MQC_NIGHTMODE_ON,       MQA_NONE,   0,   0 },
+    { "RETURN",             MQC_RETURN,             MQA_NONE,   0,   0 },
+    { "SENSOR_HISTORY",     MQC_SENSOR_HISTORY,     MQA_NONE,   0,   0 },
+    { "TIMETRAVEL",         MQC_TIMETRAVEL,         MQA_OPTINT, 0,  88 },
+    { "VOLUME",             MQC_VOLUME,             MQA_INT,    0,  19 }
+};
+
+static int mqttFindCmd(const char *cmd)
+{
+    int l = 0, r = (sizeof(mqttCmds) / sizeof(mqttCmds[0])) - 1, m, c;
+
+    while(l <= r) {
+        m = (l + r) / 2;
+        c = strcmp(cmd, mqttCmds[m].name);
+        if(!c) return m;
+        if(c < 0) r = m - 1;
+        else      l = m + 1;
+    }
+
+    return -1;
+}
+
+/*
+ * Parse a decimal number of exactly "digs" digits, or - if 
+ * digs is 0 - of up to 5 digits terminated by blank or 0.
+ * Returns -1 if invalid.
+ */
+static int32_t mqttParseNum(const char *s, int digs)
+{
+    int32_t v = 0;
+    int i = 0, maxd = digs ? digs : 5;
+
+    while(i < maxd && s[i] >= '0' && s[i] <= '9') {
+        v = (v * 10) + (s[i++] - '0');
+    }
+    if(!i || (digs && i != digs) || (!digs && s[i] > ' ')) 
+        return -1;
+
+    return v;
+}
+
+static bool mqttParseDate(const char *s, int& year, int& month, int& day, int& hour, int& minute)
+{
+    for(int i = 0; i < 12; i++) {
+        if(s[i] < '0' || s[i] > '9') return false;
+    }
+    if(s[12] > ' ') return false;
+
+    month  = mqttParseNum(s, 2);
+    day    = mqttParseNum(s + 2, 2);
+    year   = mqttParseNum(s + 4, 4);
+    hour   = mqttParseNum(s + 8, 2);
+    minute = mqttParseNum(s + 10, 2);
+
+    if(month < 1 || month > 12 || hour > 23 || minute > 59)
+        return false;
+    if(day < 1 || day > daysInMonth(month, year))
+        return false;
+
+    return true;
+}
+
+/*
+ * Parse a command (bttf/tcd/cmd), cut to MQTT_MSG_LEN.
+ * The command is case-insensitive and ends at the first blank 
+ * or control character; the argument, if any, follows after 
+ * blanks. Returns false if the command is unknown, or its 
+ * argument is missing or bad.
+ */
+bool mqttParseCmd(const uint8_t *payload, unsigned int length, mqttCommand& cmd)
+{
+    int i, j, ml = (length <= MQTT_MSG_LEN) ? length : MQTT_MSG_LEN;
+    char tempBuf[MQTT_MSG_LEN + 1];
+    char *argp;
+
+    memcpy(tempBuf, (const char *)payload, ml);
+    tempBuf[ml] = 0;
+
+    // Upper-case command and split off argument
+    for(j = 0; j < ml; j++) {
+        if(tempBuf[j] >= 'a' && tempBuf[j] <= 'z') tempBuf[j] &= ~0x20;
+        else if(tempBuf[j] <= ' ') break;
+    }
+    argp = tempBuf + j;
+    if(*argp) {
+        *argp++ = 0;
+        while(*argp == ' ') argp++;
+    }
+
+    if((i = mqttFindCmd(tempBuf)) < 0) {
+        #ifdef TC_DBG
+        Serial.printf("MQTT: Unknown command [%s]\n", tempBuf);
+        #endif
+        return false;
+    }
+
+    cmd.id = mqttCmds[i].id;
+    cmd.arg = -1;
+
+    switch(mqttCmds[i].argType) {
+    case MQA_OPTINT:
+        if(!*argp) break;
+        // fall through
+    case MQA_INT:
+        cmd.arg = mqttParseNum(argp, 0);
+        if(cmd.arg < mqttCmds[i].argMin || cmd.arg > mqttCmds[i].argMax) {
+            #ifdef TC_DBG
+            Serial.printf("MQTT: Bad argument for %s [%s]\n", tempBuf, argp);
+            #endif
+            return false;
+        }
+        break;
+    case MQA_DATE:
+        if(!mqttParseDate(argp, cmd.year, cmd.month, cmd.day, cmd.hour, cmd.minute)) {
+            #ifdef TC_DBG
+            Serial.printf("MQTT: Bad date for %s [%s]\n", tempBuf, argp);
+            #endif
+            return false;
+        }
+        break;
+    }
+
+    return true;
+}
+
+#endif  // TC_HAVEMQTT
@@ -0,0 +1,71 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * MQTT commands
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_MQTTCMD_H
+#define _TC_MQTTCMD_H
+
+// Commands (bttf/tcd/cmd); names and arguments in tc_mqttcmd.cpp
+
+enum {
+    MQC_TIMETRAVEL = 0,
+    MQC_RETURN,
+    MQC_ALARM_ON,
+    MQC_ALARM_OFF,
+    MQC_NIGHTMODE_ON,
+    MQC_NIGHTMODE_OFF,
+    MQC_MP_SHUFFLE_ON,
+    MQC_MP_SHUFFLE_OFF,
+    MQC_MP_PLAY,
+    MQC_MP_STOP,
+    MQC_MP_NEXT,
+    MQC_MP_PREV,
+    MQC_BEEP_OFF,
+    MQC_BEEP_ON,
+    MQC_BEEP_30,
+    MQC_BEEP_60,
+    MQC_SENSOR_HISTORY,
+    MQC_DESTINATION,
+    MQC_MP_TRACK,
+    MQC_VOLUME,
+    MQC_BRIGHTNESS_DEST,
+    MQC_BRIGHTNESS_PRESENT,
+    MQC_BRIGHTNESS_DEPART
+};
+
+typedef struct {
+    uint8_t id;         // MQC_xxx
+    int     arg;        // Integer argument, -1 if none given
+    int     year, month, day, hour, minute;     // Date argument
+} mqttCommand;
+
+bool mqttParseCmd(const uint8_t *payload, unsigned int length, mqttCommand& cmd);
+
+#endif
@@ -40,6 +40,7 @@
 #include <SD.h>
 #include <SPI.h>
 #include <FS.h>
+#include <Preferences.h>
 #ifdef USE_SPIFFS
 #include <SPIFFS.h>
 #else
@@ -56,9 +57,35 @@
 // Needs to be adapted when config grows
 #define JSON_SIZE 2048
 
+/* JSON document shared by all settings I/O
+ * Statically allocated to avoid a (fragmenting) heap allocation 
+ * on every load/save. Users must not nest: Each call to getJsonDoc() 
+ * invalidates what a previous user had in there.
+ */
+static StaticJsonDocument<JSON_SIZE> jsonDoc;
+
+static JsonDocument& getJsonDoc()
+{
+    jsonDoc.clear();
+    return jsonDoc;
+}
+
 /* If SPIFFS/LittleFS is mounted */
 static bool haveFS = false;
 
+/* NVS namespace for frequently written small data */
+static Preferences nvsPrefs;
+static bool haveNVS = false;
+
+/* Binary snapshot of settings (NVS) */
+#define SNAP_ID  TC_VERSION " " TC_VERSION_EXTRA
+struct SettingsSnapHdr {
+    char     id[32];
+    uint32_t size;
+    uint32_t cfgSize;   // Size and CRC of config file the
+    uint32_t cfgCRC;    // snapshot was taken from
+};
+
 /* If a SD card is found */
 bool haveSD = false;
 
@@ -113,14 +140,149 @@ static const char *volCfgName = "/tcdvolcfg.json";  // Volume config (flash/SD)
 static const char *musCfgName = "/tcdmcfg.json";    // Music config (SD)
 static const char *ipCfgName  = "/ipconfig.json";   // IP config (flash)
 
+static const char *cfgFiles[] = { 
+    cfgName, almCfgName, remCfgName, volCfgName, musCfgName, ipCfgName 
+};
+
 static const char *fsNoAvail = "File System not available";
 static const char *badConfig = "Settings bad/missing/incomplete; writing new file";
 static const char *failFileWrite = "Failed to open file for writing";
 
+/*
+ * Settings schema
+ *
+ * One entry per setting in config.json: JSON key, location and size
+ * in struct Settings, type, valid range and default (numerical 
+ * types only; strings keep their struct default if missing), and 
+ * what needs to be done if the setting is changed at runtime 
+ * (RCF_*). read_settings(), write_settings() and applyRemoteConfig()
+ * are driven by this table; adding a setting means adding it to
+ * struct Settings and here. The Config Portal has its own table
+ * (portalParms in tc_wifi.cpp), as it needs form field details
+ * this table doesn't carry.
+ * Settings marked SCF_LOCAL cannot be changed remotely; a bad 
+ * value there (network, MQTT) would lock us out.
+ * Settings marked SCF_TZ are time zone strings which are parsed
+ * before being accepted remotely.
+ */
+#define SCT_NUM   0
+#define SCT_FLOAT 1
+#define SCT_STR   2
+
+#define SCF_LOCAL (1UL << 31)
+#define SCF_TZ    (1UL << 30)
+
+#define SET_ENT(k, m, t, l, u, d, f) { k, offsetof(struct Settings, m), sizeof(settings.m), t, l, u, d, f }
+
+static const struct {
+    const char *key;
+    uint16_t    offs;
+    uint16_t    size;
+    uint8_t     type;
+    float       lowerLim;
+    float       upperLim;
+    float       defVal;
+    uint32_t    flag;
+} settingsSchema[] = {
+    SET_ENT("timeTrPers",      timesPers,       SCT_NUM,   0, 1,  DEF_TIMES_PERS,      RCF_REBOOT),
+    SET_ENT("alarmRTC",        alarmRTC,        SCT_NUM,   0, 1,  DEF_ALARM_RTC,       RCF_REBOOT),
+    SET_ENT("playIntro",       playIntro,       SCT_NUM,   0, 1,  DEF_PLAY_INTRO,      RCF_REBOOT),
+    SET_ENT("mode24",          mode24,          SCT_NUM,   0, 1,  DEF_MODE24,          RCF_REBOOT),
+    SET_ENT("beep",            beep,            SCT_NUM,   0, 3,  DEF_BEEP,            RCF_BEEP),
+    SET_ENT("autoRotateTimes", autoRotateTimes, SCT_NUM,   0, 5,  DEF_AUTOROTTIMES,    RCF_AUTOROT),
+
+    SET_ENT("hostName",        hostName,        SCT_STR,   0, 0,  0,                   SCF_LOCAL),
+    SET_ENT("wifiConRetries",  wifiConRetries,  SCT_NUM,   1, 15, DEF_WIFI_RETRY,      SCF_LOCAL),
+    SET_ENT("wifiConTimeout",  wifiConTimeout,  SCT_NUM,   7, 25, DEF_WIFI_TIMEOUT,    SCF_LOCAL),
+    SET_ENT("wifiOffDelay",    wifiOffDelay,    SCT_NUM,   0, 99, DEF_WIFI_OFFDELAY,   SCF_LOCAL),
+    SET_ENT("wifiAPOffDelay",  wifiAPOffDelay,  SCT_NUM,   0, 99, DEF_WIFI_APOFFDELAY, SCF_LOCAL),
+    SET_ENT("wifiPRetry",      wifiPRetry,      SCT_NUM,   0, 1,  DEF_WIFI_PRETRY,     SCF_LOCAL),
+
+    SET_ENT("timeZone",        timeZone,        SCT_STR,   0, 0,  0,                   RCF_TZ|SCF_TZ),
+    SET_ENT("ntpServer",       ntpServer,       SCT_STR,   0, 0,  0,                   RCF_REBOOT),
+    SET_ENT("timeZoneDest",    timeZoneDest,    SCT_STR,   0, 0,  0,                   RCF_REBOOT|SCF_TZ),
+    SET_ENT("timeZoneDep",     timeZoneDep,     SCT_STR,   0, 0,  0,                   RCF_REBOOT|SCF_TZ),
+    SET_ENT("timeZoneNDest",   timeZoneNDest,   SCT_STR,   0, 0,  0,                   RCF_REBOOT),
+    SET_ENT("timeZoneNDep",    timeZoneNDep,    SCT_STR,   0, 0,  0,                   RCF_REBOOT),
+
+    SET_ENT("destTimeBright",  destTimeBright,  SCT_NUM,   0, 15, DEF_BRIGHT_DEST,     RCF_BRIGHT_DEST),
+    SET_ENT("presTimeBright",  presTimeBright,  SCT_NUM,   0, 15, DEF_BRIGHT_PRES,     RCF_BRIGHT_PRES),
+    SET_ENT("lastTimeBright",  lastTimeBright,  SCT_NUM,   0, 15, DEF_BRIGHT_DEPA,     RCF_BRIGHT_DEPA),
+
+    SET_ENT("dtNmOff",         dtNmOff,         SCT_NUM,   0, 1,  DEF_DT_OFF,          RCF_NMOFF),
+    SET_ENT("ptNmOff",         ptNmOff,         SCT_NUM,   0, 1,  DEF_PT_OFF,          RCF_NMOFF),
+    SET_ENT("ltNmOff",         ltNmOff,         SCT_NUM,   0, 1,  DEF_LT_OFF,          RCF_NMOFF),
+
+    SET_ENT("autoNMPreset",    autoNMPreset,    SCT_NUM,   0, 10, DEF_AUTONM_PRESET,   RCF_AUTONM),
+    SET_ENT("autoNMOn",        autoNMOn,        SCT_NUM,   0, 23, DEF_AUTONM_ON,       RCF_AUTONM),
+    SET_ENT("autoNMOff",       autoNMOff,       SCT_NUM,   0, 23, DEF_AUTONM_OFF,      RCF_AUTONM),
+    #ifdef TC_HAVELIGHT
+    SET_ENT("useLight",        useLight,        SCT_NUM,   0, 1,  DEF_USE_LIGHT,       RCF_REBOOT),
+    SET_ENT("luxLimit",        luxLimit,        SCT_NUM,   0, 50000, DEF_LUX_LIMIT,    RCF_REBOOT),
+    #endif
+
+    #ifdef TC_HAVETEMP
+    SET_ENT("tempUnit",        tempUnit,        SCT_NUM,   0, 1,  DEF_TEMP_UNIT,       RCF_REBOOT),
+    SET_ENT("tempOffs",        tempOffs,        SCT_FLOAT, -3.0, 3.0, DEF_TEMP_OFFS,   RCF_REBOOT),
+    #endif
+
+    #ifdef TC_HAVESPEEDO
+    SET_ENT("speedoType",      speedoType,      SCT_NUM,   SP_MIN_TYPE, 99, DEF_SPEEDO_TYPE, RCF_REBOOT),
+    SET_ENT("speedoBright",    speedoBright,    SCT_NUM,   0, 15, DEF_BRIGHT_SPEEDO,   RCF_SPEEDOBRI),
+    SET_ENT("speedoFact",      speedoFact,      SCT_FLOAT, 0.5, 5.0, DEF_SPEEDO_FACT,  RCF_REBOOT),
+    #ifdef TC_HAVEGPS
+    SET_ENT("useGPSSpeed",     useGPSSpeed,     SCT_NUM,   0, 1,  DEF_USE_GPS_SPEED,   RCF_REBOOT),
+    #endif
+    #ifdef TC_HAVETEMP
+    SET_ENT("dispTemp",        dispTemp,        SCT_NUM,   0, 1,  DEF_DISP_TEMP,       RCF_REBOOT),
+    SET_ENT("tempBright",      tempBright,      SCT_NUM,   0, 15, DEF_TEMP_BRIGHT,     RCF_REBOOT),
+    SET_ENT("tempOffNM",       tempOffNM,       SCT_NUM,   0, 1,  DEF_TEMP_OFF_NM,     RCF_REBOOT),
+    #endif
+    #endif // HAVESPEEDO
+
+    #ifdef FAKE_POWER_ON
+    SET_ENT("fakePwrOn",       fakePwrOn,       SCT_NUM,   0, 1,  DEF_FAKE_PWR,        RCF_REBOOT),
+    #endif
+
+    #ifdef EXTERNAL_TIMETRAVEL_IN
+    SET_ENT("ettDelay",        ettDelay,        SCT_NUM,   0, ETT_MAX_DEL, DEF_ETT_DELAY, RCF_REBOOT),
+    //SET_ENT("ettLong",         ettLong,         SCT_NUM,   0, 1,  DEF_ETT_LONG,        RCF_REBOOT),
+    #endif
+
+    #ifdef EXTERNAL_TIMETRAVEL_OUT
+    SET_ENT("useETTO",         useETTO,         SCT_NUM,   0, 1,  DEF_USE_ETTO,        RCF_REBOOT),
+    #endif
+    SET_ENT("playTTsnds",      playTTsnds,      SCT_NUM,   0, 1,  DEF_PLAY_TT_SND,     RCF_REBOOT),
+
+    #ifdef TC_HAVEMQTT
+    SET_ENT("useMQTT",         useMQTT,         SCT_NUM,   0, 1,  0,                   SCF_LOCAL),
+    SET_ENT("mqttServer",      mqttServer,      SCT_STR,   0, 0,  0,                   SCF_LOCAL),
+    SET_ENT("mqttUser",        mqttUser,        SCT_STR,   0, 0,  0,                   SCF_LOCAL),
+    SET_ENT("mqttTopic",       mqttTopic,       SCT_STR,   0, 0,  0,                   SCF_LOCAL),
+    #ifdef EXTERNAL_TIMETRAVEL_OUT
+    SET_ENT("pubMQTT",         pubMQTT,         SCT_NUM,   0, 1,  0,                   RCF_REBOOT),
+    #endif
+    SET_ENT("mqttTelem",       mqttTelem,       SCT_NUM,   0, 1,  0,                   RCF_TELEM),
+    #endif
+
+    SET_ENT("shuffle",         shuffle,         SCT_NUM,   0, 1,  DEF_SHUFFLE,         RCF_SHUFFLE),
+
+    SET_ENT("CfgOnSD",         CfgOnSD,         SCT_NUM,   0, 1,  DEF_CFG_ON_SD,       SCF_LOCAL),
+    //SET_ENT("sdFreq",          sdFreq,          SCT_NUM,   0, 1,  DEF_SD_FREQ,         SCF_LOCAL)
+};
+
+#define NUM_SETTINGS (int)(sizeof(settingsSchema) / sizeof(settingsSchema[0]))
+
 static bool read_settings(File configFile);
+static bool loadSettingsSnapshot();
+static void saveSettingsSnapshot();
 
 static void deleteReminder();
 
+static File openCfgFileW(const char *fn, bool onSD);
+static bool closeCfgFileW(File& configFile, const char *fn, bool onSD, size_t written, size_t expected);
+static void recoverCfgFiles(bool onSD);
+
 static bool CopyCheckValidNumParm(const char *json, char *text, uint8_t psize, int lowerLim, int upperLim, int setDefault);
 static bool CopyCheckValidNumParmF(const char *json, char *text, uint8_t psize, float lowerLim, float upperLim, float setDefault);
 static bool checkValidNumParm(char *text, int lowerLim, int upperLim, int setDefault);
@@ -156,6 +318,12 @@ void settings_setup()
     pinMode(ENTER_BUTTON_PIN, INPUT_PULLUP);
     delay(20);
 
+    // Open our NVS namespace
+    haveNVS = nvsPrefs.begin("tcd", false);
+    #ifdef TC_DBG
+    if(!haveNVS) Serial.printf("%s: Failed to open NVS\n", funcName);
+    #endif
+
     #ifdef TC_DBG
     Serial.printf("%s: Mounting flash FS... ", funcName);
     #endif
@@ -182,14 +350,25 @@ void settings_setup()
         #ifdef TC_DBG
         Serial.println(F("ok, loading settings"));
         #endif
+
+        recoverCfgFiles(false);
         
         if(SPIFFS.exists(cfgName)) {
-            File configFile = SPIFFS.open(cfgName, "r");
-            if(configFile) {
-                writedefault = read_settings(configFile);
-                configFile.close();
+            if(loadSettingsSnapshot()) {
+                #ifdef TC_DBG
+                Serial.printf("%s: Loaded settings snapshot\n", funcName);
+                #endif
             } else {
-                writedefault = true;
+                File configFile = SPIFFS.open(cfgName, "r");
+                if(configFile) {
+                    writedefault = read_settings(configFile);
+                    configFile.close();
+                    // If settings were ok, snapshot them for next boot;
+                    // otherwise write_settings() below will do that.
+                    if(!writedefault) saveSettingsSnapshot();
+                } else {
+                    writedefault = true;
+                }
             }
         } else {
             writedefault = true;
@@ -240,6 +419,7 @@ void settings_setup()
     }
 
     if(haveSD) {
+        recoverCfgFiles(true);
         if(SD.exists("/TCD_FLASH_RO") || !haveFS) {
             bool writedefault2 = false;
             FlashROMode = true;
@@ -304,8 +484,7 @@ static bool read_settings(File configFile)
     const char *funcName = "read_settings";
     bool wd = false;
     size_t jsonSize = 0;
-    //StaticJsonDocument<JSON_SIZE> json;
-    DynamicJsonDocument json(JSON_SIZE);
+    JsonDocument& json = getJsonDoc();
     
     DeserializationError error = deserializeJson(json, configFile);
 
@@ -325,134 +504,45 @@ static bool read_settings(File configFile)
 
     if(!error) {
 
-        wd |= CopyCheckValidNumParm(json["timeTrPers"], settings.timesPers, sizeof(settings.timesPers), 0, 1, DEF_TIMES_PERS);
-        wd |= CopyCheckValidNumParm(json["alarmRTC"], settings.alarmRTC, sizeof(settings.alarmRTC), 0, 1, DEF_ALARM_RTC);
-        wd |= CopyCheckValidNumParm(json["playIntro"], settings.playIntro, sizeof(settings.playIntro), 0, 1, DEF_PLAY_INTRO);
-        wd |= CopyCheckValidNumParm(json["mode24"], settings.mode24, sizeof(settings.mode24), 0, 1, DEF_MODE24);
-        wd |= CopyCheckValidNumParm(json["beep"], settings.beep, sizeof(settings.beep), 0, 3, DEF_BEEP);
-        wd |= CopyCheckValidNumParm(json["autoRotateTimes"], settings.autoRotateTimes, sizeof(settings.autoRotateTimes), 0, 5, DEF_AUTOROTTIMES);
-
-        if(json["hostName"]) {
-            memset(settings.hostName, 0, sizeof(settings.hostName));
-            strncpy(settings.hostName, json["hostName"], sizeof(settings.hostName) - 1);
-        } else wd = true;
-        wd |= CopyCheckValidNumParm(json["wifiConRetries"], settings.wifiConRetries, sizeof(settings.wifiConRetries), 1, 15, DEF_WIFI_RETRY);
-        wd |= CopyCheckValidNumParm(json["wifiConTimeout"], settings.wifiConTimeout, sizeof(settings.wifiConTimeout), 7, 25, DEF_WIFI_TIMEOUT);
-        wd |= CopyCheckValidNumParm(json["wifiOffDelay"], settings.wifiOffDelay, sizeof(settings.wifiOffDelay), 0, 99, DEF_WIFI_OFFDELAY);
-        wd |= CopyCheckValidNumParm(json["wifiAPOffDelay"], settings.wifiAPOffDelay, sizeof(settings.wifiAPOffDelay), 0, 99, DEF_WIFI_APOFFDELAY);
-        wd |= CopyCheckValidNumParm(json["wifiPRetry"], settings.wifiPRetry, sizeof(settings.wifiPRetry), 0, 1, DEF_WIFI_PRETRY);
-        
-        if(json["timeZone"]) {
-            memset(settings.timeZone, 0, sizeof(settings.timeZone));
-            strncpy(settings.timeZone, json["timeZone"], sizeof(settings.timeZone) - 1);
-        } else wd = true;
-        if(json["ntpServer"]) {
-            memset(settings.ntpServer, 0, sizeof(settings.ntpServer));
-            strncpy(settings.ntpServer, json["ntpServer"], sizeof(settings.ntpServer) - 1);
-        } else wd = true;
-
-        if(json["timeZoneDest"]) {
-            memset(settings.timeZoneDest, 0, sizeof(settings.timeZoneDest));
-            strncpy(settings.timeZoneDest, json["timeZoneDest"], sizeof(settings.timeZoneDest) - 1);
-        } else wd = true;
-        if(json["timeZoneDep"]) {
-            memset(settings.timeZoneDep, 0, sizeof(settings.timeZoneDep));
-            strncpy(settings.timeZoneDep, json["timeZoneDep"], sizeof(settings.timeZoneDep) - 1);
-        } else wd = true;
-        if(json["timeZoneNDest"]) {
-            memset(settings.timeZoneNDest, 0, sizeof(settings.timeZoneNDest));
-            strncpy(settings.timeZoneNDest, json["timeZoneNDest"], sizeof(settings.timeZoneNDest) - 1);
-        } else wd = true;
-        if(json["timeZoneNDep"]) {
-            memset(settings.timeZoneNDep, 0, sizeof(settings.timeZoneNDep));
-            strncpy(settings.timeZoneNDep, json["timeZoneNDep"], sizeof(settings.timeZoneNDep) - 1);
-        } else wd = true;
-
-        wd |= CopyCheckValidNumParm(json["destTimeBright"], settings.destTimeBright, sizeof(settings.destTimeBright), 0, 15, DEF_BRIGHT_DEST);
-        wd |= CopyCheckValidNumParm(json["presTimeBright"], settings.presTimeBright, sizeof(settings.presTimeBright), 0, 15, DEF_BRIGHT_PRES);
-        wd |= CopyCheckValidNumParm(json["lastTimeBright"], settings.lastTimeBright, sizeof(settings.lastTimeBright), 0, 15, DEF_BRIGHT_DEPA);
-
-        wd |= CopyCheckValidNumParm(json["dtNmOff"], settings.dtNmOff, sizeof(settings.dtNmOff), 0, 1, DEF_DT_OFF);
-        wd |= CopyCheckValidNumParm(json["ptNmOff"], settings.ptNmOff, sizeof(settings.ptNmOff), 0, 1, DEF_PT_OFF);
-        wd |= CopyCheckValidNumParm(json["ltNmOff"], settings.ltNmOff, sizeof(settings.ltNmOff), 0, 1, DEF_LT_OFF);
-
-        wd |= CopyCheckValidNumParm(json["autoNMPreset"], settings.autoNMPreset, sizeof(settings.autoNMPreset), 0, 10, DEF_AUTONM_PRESET);
+        for(int i = 0; i < NUM_SETTINGS; i++) {
+
+            char *dst = (char *)&settings + settingsSchema[i].offs;
+            const char *key = settingsSchema[i].key;
+
+            switch(settingsSchema[i].type) {
+            case SCT_NUM:
+                wd |= CopyCheckValidNumParm(json[key], dst, settingsSchema[i].size, 
+                                            (int)settingsSchema[i].lowerLim, (int)settingsSchema[i].upperLim,
+                                            (int)settingsSchema[i].defVal);
+                break;
+            case SCT_FLOAT:
+                wd |= CopyCheckValidNumParmF(json[key], dst, settingsSchema[i].size, 
+                                             settingsSchema[i].lowerLim, settingsSchema[i].upperLim,
+                                             settingsSchema[i].defVal);
+                break;
+            case SCT_STR:
+                if(json[key]) {
+                    memset(dst, 0, settingsSchema[i].size);
+                    strncpy(dst, json[key], settingsSchema[i].size - 1);
+                } else wd = true;
+                break;
+            }
+        }
+
         if(json["autoNM"]) {    // transition old boolean "autoNM" setting
             char temp[4] = { '0', 0, 0, 0 };
             CopyCheckValidNumParm(json["autoNM"], temp, sizeof(temp), 0, 1, 0);
             if(temp[0] == '0') strcpy(settings.autoNMPreset, "10");
         }
-        
-        wd |= CopyCheckValidNumParm(json["autoNMOn"], settings.autoNMOn, sizeof(settings.autoNMOn), 0, 23, DEF_AUTONM_ON);
-        wd |= CopyCheckValidNumParm(json["autoNMOff"], settings.autoNMOff, sizeof(settings.autoNMOff), 0, 23, DEF_AUTONM_OFF);
-        #ifdef TC_HAVELIGHT
-        wd |= CopyCheckValidNumParm(json["useLight"], settings.useLight, sizeof(settings.useLight), 0, 1, DEF_USE_LIGHT);
-        wd |= CopyCheckValidNumParm(json["luxLimit"], settings.luxLimit, sizeof(settings.luxLimit), 0, 50000, DEF_LUX_LIMIT);
-        #endif
-
-        #ifdef TC_HAVETEMP
-        wd |= CopyCheckValidNumParm(json["tempUnit"], settings.tempUnit, sizeof(settings.tempUnit), 0, 1, DEF_TEMP_UNIT);
-        wd |= CopyCheckValidNumParmF(json["tempOffs"], settings.tempOffs, sizeof(settings.tempOffs), -3.0, 3.0, DEF_TEMP_OFFS);
-        #endif
 
         #ifdef TC_HAVESPEEDO
-        wd |= CopyCheckValidNumParm(json["speedoType"], settings.speedoType, sizeof(settings.speedoType), SP_MIN_TYPE, 99, DEF_SPEEDO_TYPE);
         if(json["useSpeedo"]) {    // transition old boolean "useSpeedo" setting
             char temp[4] = { '0', 0, 0, 0 };
             CopyCheckValidNumParm(json["useSpeedo"], temp, sizeof(temp), 0, 1, 0);
             if(temp[0] == '0') strcpy(settings.speedoType, "99");
         }
-        
-        wd |= CopyCheckValidNumParm(json["speedoBright"], settings.speedoBright, sizeof(settings.speedoBright), 0, 15, DEF_BRIGHT_SPEEDO);
-        wd |= CopyCheckValidNumParmF(json["speedoFact"], settings.speedoFact, sizeof(settings.speedoFact), 0.5, 5.0, DEF_SPEEDO_FACT);
-        #ifdef TC_HAVEGPS
-        wd |= CopyCheckValidNumParm(json["useGPSSpeed"], settings.useGPSSpeed, sizeof(settings.useGPSSpeed), 0, 1, DEF_USE_GPS_SPEED);
-        #endif
-        #ifdef TC_HAVETEMP
-        wd |= CopyCheckValidNumParm(json["dispTemp"], settings.dispTemp, sizeof(settings.dispTemp), 0, 1, DEF_DISP_TEMP);
-        wd |= CopyCheckValidNumParm(json["tempBright"], settings.tempBright, sizeof(settings.tempBright), 0, 15, DEF_TEMP_BRIGHT);
-        wd |= CopyCheckValidNumParm(json["tempOffNM"], settings.tempOffNM, sizeof(settings.tempOffNM), 0, 1, DEF_TEMP_OFF_NM);
-        #endif
-        #endif // HAVESPEEDO
-        
-        #ifdef FAKE_POWER_ON
-        wd |= CopyCheckValidNumParm(json["fakePwrOn"], settings.fakePwrOn, sizeof(settings.fakePwrOn), 0, 1, DEF_FAKE_PWR);
         #endif
 
-        #ifdef EXTERNAL_TIMETRAVEL_IN
-        wd |= CopyCheckValidNumParm(json["ettDelay"], settings.ettDelay, sizeof(settings.ettDelay), 0, ETT_MAX_DEL, DEF_ETT_DELAY);
-        //wd |= CopyCheckValidNumParm(json["ettLong"], settings.ettLong, sizeof(settings.ettLong), 0, 1, DEF_ETT_LONG);
-        #endif
-        
-        #ifdef EXTERNAL_TIMETRAVEL_OUT
-        wd |= CopyCheckValidNumParm(json["useETTO"], settings.useETTO, sizeof(settings.useETTO), 0, 1, DEF_USE_ETTO);
-        #endif
-        wd |= CopyCheckValidNumParm(json["playTTsnds"], settings.playTTsnds, sizeof(settings.playTTsnds), 0, 1, DEF_PLAY_TT_SND);
-
-        #ifdef TC_HAVEMQTT
-        wd |= CopyCheckValidNumParm(json["useMQTT"], settings.useMQTT, sizeof(settings.useMQTT), 0, 1, 0);
-        if(json["mqttServer"]) {
-            memset(settings.mqttServer, 0, sizeof(settings.mqttServer));
-            strncpy(settings.mqttServer, json["mqttServer"], sizeof(settings.mqttServer) - 1);
-        } else wd = true;
-        if(json["mqttUser"]) {
-            memset(settings.mqttUser, 0, sizeof(settings.mqttUser));
-            strncpy(settings.mqttUser, json["mqttUser"], sizeof(settings.mqttUser) - 1);
-        } else wd = true;
-        if(json["mqttTopic"]) {
-            memset(settings.mqttTopic, 0, sizeof(settings.mqttTopic));
-            strncpy(settings.mqttTopic, json["mqttTopic"], sizeof(settings.mqttTopic) - 1);
-        } else wd = true;
-        #ifdef EXTERNAL_TIMETRAVEL_OUT
-        wd |= CopyCheckValidNumParm(json["pubMQTT"], settings.pubMQTT, sizeof(settings.pubMQTT), 0, 1, 0);
-        #endif
-        #endif
-
-        wd |= CopyCheckValidNumParm(json["shuffle"], settings.shuffle, sizeof(settings.shuffle), 0, 1, DEF_SHUFFLE);
-
-        wd |= CopyCheckValidNumParm(json["CfgOnSD"], settings.CfgOnSD, sizeof(settings.CfgOnSD), 0, 1, DEF_CFG_ON_SD);
-        //wd |= CopyCheckValidNumParm(json["sdFreq"], settings.sdFreq, sizeof(settings.sdFreq), 0, 1, DEF_SD_FREQ);
-
     } else {
 
         wd = true;
@@ -465,8 +555,7 @@ static bool read_settings(File configFile)
 void write_settings()
 {
     const char *funcName = "write_settings";
-    DynamicJsonDocument json(JSON_SIZE);
-    //StaticJsonDocument<JSON_SIZE> json;
+    JsonDocument& json = getJsonDoc();
 
     if(!haveFS && !FlashROMode) {
         Serial.printf("%s: %s\n", funcName, fsNoAvail);
@@ -477,108 +566,118 @@ void write_settings()
     Serial.printf("%s: Writing config file\n", funcName);
     #endif
     
-    json["timeTrPers"] = settings.timesPers;
-    json["alarmRTC"] = settings.alarmRTC;
-    json["mode24"] = settings.mode24;
-    json["beep"] = settings.beep;
-    json["playIntro"] = settings.playIntro;
-    json["autoRotateTimes"] = settings.autoRotateTimes;
-
-    json["hostName"] = settings.hostName;
-    json["wifiConRetries"] = settings.wifiConRetries;
-    json["wifiConTimeout"] = settings.wifiConTimeout;
-    json["wifiOffDelay"] = settings.wifiOffDelay;
-    json["wifiAPOffDelay"] = settings.wifiAPOffDelay;
-    json["wifiPRetry"] = settings.wifiPRetry;
-    
-    json["timeZone"] = settings.timeZone;
-    json["ntpServer"] = settings.ntpServer;
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        json[settingsSchema[i].key] = (char *)&settings + settingsSchema[i].offs;
+    }
 
-    json["timeZoneDest"] = settings.timeZoneDest;
-    json["timeZoneDep"] = settings.timeZoneDep;
-    json["timeZoneNDest"] = settings.timeZoneNDest;
-    json["timeZoneNDep"] = settings.timeZoneNDep;
-    
-    json["destTimeBright"] = settings.destTimeBright;
-    json["presTimeBright"] = settings.presTimeBright;
-    json["lastTimeBright"] = settings.lastTimeBright;
+    File configFile = openCfgFileW(cfgName, FlashROMode);
 
-    json["dtNmOff"] = settings.dtNmOff;
-    json["ptNmOff"] = settings.ptNmOff;
-    json["ltNmOff"] = settings.ltNmOff;
-    
-    json["autoNMPreset"] = settings.autoNMPreset;
-    json["autoNMOn"] = settings.autoNMOn;
-    json["autoNMOff"] = settings.autoNMOff;
-    #ifdef TC_HAVELIGHT
-    json["useLight"] = settings.useLight;
-    json["luxLimit"] = settings.luxLimit;
-    #endif
+    if(configFile) {
 
-    #ifdef TC_HAVETEMP
-    json["tempUnit"] = settings.tempUnit;
-    json["tempOffs"] = settings.tempOffs;
-    #endif
+        #ifdef TC_DBG
+        serializeJson(json, Serial);
+        Serial.println(F(" "));
+        #endif
+        
+        // Keep snapshot in sync with config file in flash
+        if(closeCfgFileW(configFile, cfgName, FlashROMode, serializeJson(json, configFile), measureJson(json)) &&
+           !FlashROMode) {
+            saveSettingsSnapshot();
+        }
 
-    #ifdef TC_HAVESPEEDO    
-    json["speedoType"] = settings.speedoType;
-    json["speedoBright"] = settings.speedoBright;
-    json["speedoFact"] = settings.speedoFact;
-    #ifdef TC_HAVEGPS
-    json["useGPSSpeed"] = settings.useGPSSpeed;
-    #endif
-    #ifdef TC_HAVETEMP
-    json["dispTemp"] = settings.dispTemp;
-    json["tempBright"] = settings.tempBright;
-    json["tempOffNM"] = settings.tempOffNM;
-    #endif
-    #endif // HAVESPEEDO
-    
-    #ifdef FAKE_POWER_ON
-    json["fakePwrOn"] = settings.fakePwrOn;
-    #endif
+    } else {
 
-    #ifdef EXTERNAL_TIMETRAVEL_IN
-    json["ettDelay"] = settings.ettDelay;
-    //json["ettLong"] = settings.ettLong;
-    #endif
+        Serial.printf("%s: %s\n", funcName, failFileWrite);
 
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    json["useETTO"] = settings.useETTO;
-    #endif
-    json["playTTsnds"] = settings.playTTsnds;
+    }
+}
 
-    #ifdef TC_HAVEMQTT
-    json["useMQTT"] = settings.useMQTT;
-    json["mqttServer"] = settings.mqttServer;
-    json["mqttUser"] = settings.mqttUser;
-    json["mqttTopic"] = settings.mqttTopic;
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    json["pubMQTT"] = settings.pubMQTT;
-    #endif
-    #endif
+/*
+ * Settings snapshot
+ *
+ * A binary copy of the (validated) settings is kept in NVS,
+ * alongside the config file in flash. At boot, it is loaded 
+ * with one read instead of parsing the JSON file. A snapshot 
+ * from a different firmware version (struct layout might 
+ * differ) is ignored, and settings are read from the JSON file 
+ * as usual. NVS checksums its entries, so a damaged snapshot 
+ * fails to load as well.
+ * The header holds size and CRC of the config file; if the file
+ * was replaced by other means than write_settings() (eg uploaded
+ * or edited on a computer), the snapshot is ignored.
+ */
+static uint32_t crc32Update(uint32_t crc, const uint8_t *buf, int len)
+{
+    crc = ~crc;
+    while(len--) {
+        crc ^= *buf++;
+        for(int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
 
-    json["shuffle"] = settings.shuffle;
+static bool getCfgFileSig(uint32_t& size, uint32_t& crc)
+{
+    uint8_t buf[128];
+    int len;
 
-    json["CfgOnSD"] = settings.CfgOnSD;
-    //json["sdFreq"] = settings.sdFreq;
+    File configFile = SPIFFS.open(cfgName, "r");
+    if(!configFile)
+        return false;
 
-    File configFile = FlashROMode ? SD.open(cfgName, FILE_WRITE) : SPIFFS.open(cfgName, FILE_WRITE);
+    size = configFile.size();
+    crc = 0;
+    while((len = configFile.read(buf, sizeof(buf))) > 0) {
+        crc = crc32Update(crc, buf, len);
+    }
+    configFile.close();
 
-    if(configFile) {
+    return true;
+}
 
+static bool loadSettingsSnapshot()
+{
+    SettingsSnapHdr hdr;
+    uint32_t cfgSize, cfgCRC;
+
+    if(!readBlobFromNVS("cfghdr", (uint8_t *)&hdr, sizeof(hdr)))
+        return false;
+
+    if(strncmp(hdr.id, SNAP_ID, sizeof(hdr.id)) || hdr.size != sizeof(settings)) {
         #ifdef TC_DBG
-        serializeJson(json, Serial);
-        Serial.println(F(" "));
+        Serial.println(F("Settings snapshot outdated"));
         #endif
-        
-        serializeJson(json, configFile);
-        configFile.close();
+        return false;
+    }
 
-    } else {
+    if(!getCfgFileSig(cfgSize, cfgCRC) || hdr.cfgSize != cfgSize || hdr.cfgCRC != cfgCRC) {
+        #ifdef TC_DBG
+        Serial.println(F("Settings snapshot does not match config file"));
+        #endif
+        return false;
+    }
 
-        Serial.printf("%s: %s\n", funcName, failFileWrite);
+    return readBlobFromNVS("cfg", (uint8_t *)&settings, sizeof(settings));
+}
+
+static void saveSettingsSnapshot()
+{
+    SettingsSnapHdr hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    strncpy(hdr.id, SNAP_ID, sizeof(hdr.id) - 1);
+    hdr.size = sizeof(settings);
+    if(!getCfgFileSig(hdr.cfgSize, hdr.cfgCRC))
+        return;
+
+    // Invalidate header first, in case we are interrupted
+    // between writing the settings and the header
+    if(haveNVS) nvsPrefs.remove("cfghdr");
 
+    if(writeBlobToNVS("cfg", (uint8_t *)&settings, sizeof(settings))) {
+        writeBlobToNVS("cfghdr", (uint8_t *)&hdr, sizeof(hdr));
     }
 }
 
@@ -588,6 +687,117 @@ bool checkConfigExists()
 }
 
 
+#ifdef TC_HAVEMQTT
+/*
+ * Apply a settings delta, formatted as JSON: {"key":value,...}
+ * Values may be strings or numbers (booleans for 0/1 settings).
+ * All or nothing: If a key is unknown or a value is invalid (out
+ * of range values are refused, not corrected as when reading the
+ * config file), nothing is changed, and the key is returned in 
+ * errKey. Otherwise the settings are updated and written, and 
+ * "changed" holds the RCF_* flags of the settings that actually 
+ * changed; RCF_REBOOT if any of those requires a restart.
+ * json is parsed in place, ie modified.
+ */
+bool applyRemoteConfig(char *json, unsigned int len, uint32_t& changed, char *errKey, int errKeyLen)
+{
+    static struct Settings newSettings;
+    JsonDocument& doc = getJsonDoc();
+    char temp[64];
+    int i, n = NUM_SETTINGS;
+
+    changed = 0;
+    errKey[0] = 0;
+
+    if(deserializeJson(doc, json, len) || !doc.is<JsonObject>()) {
+        strncpy(errKey, "(json)", errKeyLen - 1);
+        return false;
+    }
+
+    newSettings = settings;
+
+    for(JsonPair kv : doc.as<JsonObject>()) {
+
+        const char *key = kv.key().c_str();
+        JsonVariant v = kv.value();
+        char *dst;
+        bool bad = false;
+
+        for(i = 0; i < n; i++) {
+            if(!(settingsSchema[i].flag & SCF_LOCAL) && !strcmp(key, settingsSchema[i].key)) break;
+        }
+
+        if(i < n) {
+          
+            dst = (char *)&newSettings + settingsSchema[i].offs;
+
+            if(v.is<const char *>()) {
+                bad = (strlen(v.as<const char *>()) >= settingsSchema[i].size);
+                strncpy(temp, v.as<const char *>(), sizeof(temp) - 1);
+                temp[sizeof(temp) - 1] = 0;
+            } else if(v.is<bool>() && settingsSchema[i].type == SCT_NUM) {
+                strcpy(temp, v.as<bool>() ? "1" : "0");
+            } else if(v.is<long>() && settingsSchema[i].type != SCT_STR) {
+                snprintf(temp, sizeof(temp), "%ld", v.as<long>());
+            } else if(v.is<float>() && settingsSchema[i].type == SCT_FLOAT) {
+                snprintf(temp, sizeof(temp), "%1.1f", v.as<float>());
+            } else {
+                bad = true;
+            }
+
+            if(!bad) {
+                switch(settingsSchema[i].type) {
+                case SCT_NUM:
+                    bad = (strlen(temp) >= settingsSchema[i].size) ||
+                          checkValidNumParm(temp, (int)settingsSchema[i].lowerLim, (int)settingsSchema[i].upperLim, 0);
+                    break;
+                case SCT_FLOAT:
+                    bad = (strlen(temp) >= settingsSchema[i].size) ||
+                          checkValidNumParmF(temp, settingsSchema[i].lowerLim, settingsSchema[i].upperLim, 0.0);
+                    break;
+                }
+            }
+
+            if(!bad) {
+                memset(dst, 0, settingsSchema[i].size);
+                strncpy(dst, temp, settingsSchema[i].size - 1);
+                if(settingsSchema[i].flag & SCF_TZ) {
+                    bad = !checkTZ(dst);
+                }
+            }
+            
+        } else {
+
+            bad = true;
+
+        }
+
+        if(bad) {
+            strncpy(errKey, key, errKeyLen - 1);
+            errKey[errKeyLen - 1] = 0;
+            #ifdef TC_DBG
+            Serial.printf("applyRemoteConfig: Bad key or value [%s]\n", key);
+            #endif
+            return false;
+        }
+    }
+
+    for(i = 0; i < n; i++) {
+        if(strcmp((char *)&newSettings + settingsSchema[i].offs, (char *)&settings + settingsSchema[i].offs)) {
+            changed |= (settingsSchema[i].flag & ~SCF_TZ);
+        }
+    }
+
+    // doc is done with; write_settings() re-uses it
+    if(changed) {
+        settings = newSettings;
+        write_settings();
+    }
+
+    return true;
+}
+#endif
+
 /*
  *  Helpers for parm copying & checking
  */
@@ -712,7 +922,7 @@ bool loadAlarm()
     }
 
     if(haveConfigFile) {
-        StaticJsonDocument<512> json;
+        JsonDocument& json = getJsonDoc();
         
         if(!deserializeJson(json, configFile)) {
             if(json["alarmonoff"] && json["alarmhour"] && json["alarmmin"]) {
@@ -750,7 +960,7 @@ void saveAlarm()
     char minBuf[8];
     bool haveConfigFile = false;
     File configFile;
-    StaticJsonDocument<512> json;
+    JsonDocument& json = getJsonDoc();
 
     if(!haveFS && !configOnSD) {
         Serial.printf("%s: %s\n", funcName, fsNoAvail);
@@ -770,15 +980,10 @@ void saveAlarm()
     json["alarmhour"] = (char *)hourBuf;
     json["alarmmin"] = (char *)minBuf;
 
-    if(configOnSD) {
-        haveConfigFile = (configFile = SD.open(almCfgName, FILE_WRITE));
-    } else {
-        haveConfigFile = (configFile = SPIFFS.open(almCfgName, FILE_WRITE));
-    }
+    haveConfigFile = (configFile = openCfgFileW(almCfgName, configOnSD));
 
     if(haveConfigFile) {
-        serializeJson(json, configFile);
-        configFile.close();
+        closeCfgFileW(configFile, almCfgName, configOnSD, serializeJson(json, configFile), measureJson(json));
     } else {
         Serial.printf("%s: %s\n", funcName, failFileWrite);
     }
@@ -815,7 +1020,7 @@ bool loadReminder()
     }
 
     if(haveConfigFile) {
-        StaticJsonDocument<512> json;
+        JsonDocument& json = getJsonDoc();
         
         if(!deserializeJson(json, configFile)) {
             if(json["month"] && json["hour"] && json["min"]) {
@@ -852,7 +1057,7 @@ void saveReminder()
     char minBuf[8];
     bool haveConfigFile = false;
     File configFile;
-    StaticJsonDocument<512> json;
+    JsonDocument& json = getJsonDoc();
 
     if(!haveFS && !configOnSD) {
         Serial.printf("%s: %s\n", funcName, fsNoAvail);
@@ -878,15 +1083,10 @@ void saveReminder()
     json["hour"] = (char *)hourBuf;
     json["min"] = (char *)minBuf;
 
-    if(configOnSD) {
-        haveConfigFile = (configFile = SD.open(remCfgName, FILE_WRITE));
-    } else {
-        haveConfigFile = (configFile = SPIFFS.open(remCfgName, FILE_WRITE));
-    }
+    haveConfigFile = (configFile = openCfgFileW(remCfgName, configOnSD));
 
     if(haveConfigFile) {
-        serializeJson(json, configFile);
-        configFile.close();
+        closeCfgFileW(configFile, remCfgName, configOnSD, serializeJson(json, configFile), measureJson(json));
     } else {
         Serial.printf("%s: %s\n", funcName, failFileWrite);
     }
@@ -938,7 +1138,7 @@ bool loadCurVolume()
     }
 
     if(haveConfigFile) {
-        StaticJsonDocument<512> json;
+        JsonDocument& json = getJsonDoc();
         if(!deserializeJson(json, configFile)) {
             if(!CopyCheckValidNumParm(json["volume"], temp, sizeof(temp), 0, 255, 255)) {
                 uint8_t ncv = atoi(temp);
@@ -965,7 +1165,7 @@ void saveCurVolume()
     char buf[6];
     bool haveConfigFile = false;
     File configFile;
-    StaticJsonDocument<512> json;
+    JsonDocument& json = getJsonDoc();
 
     if(!haveFS && !configOnSD) {
         Serial.printf("%s: %s\n", funcName, fsNoAvail);
@@ -979,11 +1179,7 @@ void saveCurVolume()
     sprintf(buf, "%d", curVolume);
     json["volume"] = (char *)buf;
 
-    if(configOnSD) {
-        haveConfigFile = (configFile = SD.open(volCfgName, FILE_WRITE));
-    } else {
-        haveConfigFile = (configFile = SPIFFS.open(volCfgName, FILE_WRITE));
-    }
+    haveConfigFile = (configFile = openCfgFileW(volCfgName, configOnSD));
 
     #ifdef TC_DBG
     serializeJson(json, Serial);
@@ -991,8 +1187,7 @@ void saveCurVolume()
     #endif
 
     if(haveConfigFile) {
-        serializeJson(json, configFile);
-        configFile.close();
+        closeCfgFileW(configFile, volCfgName, configOnSD, serializeJson(json, configFile), measureJson(json));
     } else {
         Serial.printf("%s: %s\n", funcName, failFileWrite);
     }
@@ -1037,7 +1232,7 @@ bool loadMusFoldNum()
 
         File configFile = SD.open(musCfgName, "r");
         if(configFile) {
-            StaticJsonDocument<512> json;
+            JsonDocument& json = getJsonDoc();
             if(!deserializeJson(json, configFile)) {
                 if(!CopyCheckValidNumParm(json["folder"], temp, sizeof(temp), 0, 9, 0)) {
                     musFolderNum = atoi(temp);
@@ -1060,7 +1255,7 @@ bool loadMusFoldNum()
 void saveMusFoldNum()
 {
     const char *funcName = "saveMusFoldNum";
-    StaticJsonDocument<512> json;
+    JsonDocument& json = getJsonDoc();
     char buf[4];
 
     if(!haveSD)
@@ -1069,11 +1264,10 @@ void saveMusFoldNum()
     sprintf(buf, "%1d", musFolderNum);
     json["folder"] = buf;
     
-    File configFile = SD.open(musCfgName, FILE_WRITE);
+    File configFile = openCfgFileW(musCfgName, true);
 
     if(configFile) {
-        serializeJson(json, configFile);
-        configFile.close();
+        closeCfgFileW(configFile, musCfgName, true, serializeJson(json, configFile), measureJson(json));
     } else {
         Serial.printf("%s: %s\n", funcName, failFileWrite);
     }
@@ -1098,7 +1292,7 @@ bool loadIpSettings()
 
         if(configFile) {
 
-            StaticJsonDocument<512> json;
+            JsonDocument& json = getJsonDoc();
             DeserializationError error = deserializeJson(json, configFile);
 
             #ifdef TC_DBG
@@ -1159,7 +1353,7 @@ static bool CopyIPParm(const char *json, char *text, uint8_t psize)
 
 void writeIpSettings()
 {
-    StaticJsonDocument<512> json;
+    JsonDocument& json = getJsonDoc();
 
     if(!haveFS && !FlashROMode)
         return;
@@ -1176,7 +1370,7 @@ void writeIpSettings()
     json["Netmask"] = ipsettings.netmask;
     json["DNS"] = ipsettings.dns;
 
-    File configFile = FlashROMode ? SD.open(ipCfgName, FILE_WRITE) : SPIFFS.open(ipCfgName, FILE_WRITE);
+    File configFile = openCfgFileW(ipCfgName, FlashROMode);
 
     #ifdef TC_DBG
     serializeJson(json, Serial);
@@ -1184,8 +1378,7 @@ void writeIpSettings()
     #endif
 
     if(configFile) {
-        serializeJson(json, configFile);
-        configFile.close();
+        closeCfgFileW(configFile, ipCfgName, FlashROMode, serializeJson(json, configFile), measureJson(json));
     } else {
         Serial.printf("writeIpSettings: %s\n", failFileWrite);
     }
@@ -1456,6 +1649,102 @@ void rewriteSecondarySettings()
     // Music Folder Number is always on SD only
 }
 
+/*
+ * Crash-safe config file writing
+ *
+ * A config file is written to a temporary file first, which then
+ * replaces the original. Power loss while writing leaves the old
+ * file intact. If power is lost after removing the old file but 
+ * before renaming the new one, recoverCfgFiles() (at boot) finds 
+ * only the temporary file and renames it if it parses.
+ * If not all data made it into the temporary file (file system
+ * full, write error), it is discarded and the original is kept.
+ * Only one file may be written at a time.
+ */
+static char cfgTmpName[32];
+
+static void makeTmpName(const char *fn, char *tmpName)
+{
+    const char *t = strrchr(fn, '.');
+    size_t len = t ? t - fn : strlen(fn);
+
+    // "/name.json" -> "/name.tmp"
+    if(len > sizeof(cfgTmpName) - 5) len = sizeof(cfgTmpName) - 5;
+    memcpy(tmpName, fn, len);
+    strcpy(tmpName + len, ".tmp");
+}
+
+static File openCfgFileW(const char *fn, bool onSD)
+{
+    fs::FS& fs = onSD ? (fs::FS&)SD : (fs::FS&)SPIFFS;
+
+    makeTmpName(fn, cfgTmpName);
+
+    return fs.open(cfgTmpName, FILE_WRITE);
+}
+
+static bool closeCfgFileW(File& configFile, const char *fn, bool onSD, size_t written, size_t expected)
+{
+    fs::FS& fs = onSD ? (fs::FS&)SD : (fs::FS&)SPIFFS;
+    size_t fsize = 0;
+    bool ret;
+
+    configFile.close();
+
+    if(written == expected) {
+        configFile = fs.open(cfgTmpName, "r");
+        if(configFile) {
+            fsize = configFile.size();
+            configFile.close();
+        }
+    }
+
+    if(written != expected || fsize != expected) {
+        Serial.printf("closeCfgFileW: Short write (%d/%d), keeping %s\n", (int)fsize, (int)expected, fn);
+        fs.remove(cfgTmpName);
+        return false;
+    }
+
+    // Not all file systems overwrite on rename
+    if(fs.exists(fn)) fs.remove(fn);
+
+    if(!(ret = fs.rename(cfgTmpName, fn))) {
+        Serial.printf("closeCfgFileW: Failed to rename %s\n", cfgTmpName);
+    }
+
+    return ret;
+}
+
+static void recoverCfgFiles(bool onSD)
+{
+    fs::FS& fs = onSD ? (fs::FS&)SD : (fs::FS&)SPIFFS;
+    char tmpName[32];
+
+    for(unsigned int i = 0; i < sizeof(cfgFiles) / sizeof(cfgFiles[0]); i++) {
+        makeTmpName(cfgFiles[i], tmpName);
+        if(fs.exists(tmpName)) {
+            if(!fs.exists(cfgFiles[i])) {
+                bool isGood = false;
+                File tmpFile = fs.open(tmpName, "r");
+                if(tmpFile) {
+                    isGood = !deserializeJson(getJsonDoc(), tmpFile);
+                    tmpFile.close();
+                }
+                if(isGood) {
+                    Serial.printf("Recovering %s\n", cfgFiles[i]);
+                    fs.rename(tmpName, cfgFiles[i]);
+                } else {
+                    Serial.printf("Discarding incomplete %s\n", tmpName);
+                    fs.remove(tmpName);
+                }
+            } else {
+                // Interrupted while writing; old file is intact
+                fs.remove(tmpName);
+            }
+        }
+    }
+}
+
 bool readFileFromSD(const char *fn, uint8_t *buf, int len)
 {
     size_t bytesr;
@@ -1522,3 +1811,36 @@ bool writeFileToFS(const char *fn, uint8_t *buf, int len)
     } else
         return false;
 }
+
+void removeFileFromFS(const char *fn)
+{
+    if(haveFS && SPIFFS.exists(fn)) {
+        SPIFFS.remove(fn);
+    }
+}
+
+/*
+ * NVS (the ESP32's key/value store in its own flash partition)
+ * is log-structured: Writes append a CRC-checked entry, pages 
+ * are compacted when full, and wear is spread over the whole 
+ * partition. No file system overhead. Used for small, often 
+ * written data.
+ */
+bool readBlobFromNVS(const char *key, uint8_t *buf, int len)
+{
+    if(!haveNVS)
+        return false;
+
+    if(!nvsPrefs.isKey(key))
+        return false;
+
+    return (nvsPrefs.getBytes(key, buf, len) == (size_t)len);
+}
+
+bool writeBlobToNVS(const char *key, uint8_t *buf, int len)
+{
+    if(!haveNVS)
+        return false;
+
+    return (nvsPrefs.putBytes(key, buf, len) == (size_t)len);
+}
@@ -156,6 +156,7 @@ struct Settings {
     char mqttUser[128]      = "";  // user[:pass] (UTF8)
     char mqttTopic[512]     = "";  // topic (UTF8)
     char pubMQTT[4]         = "0"; // publish to broker (timetravel)
+    char mqttTelem[4]       = "0"; // publish telemetry
 #endif    
 };
 
@@ -190,6 +191,24 @@ void saveMusFoldNum();
 
 void copySettings();
 
+// Settings schema: What to do if a setting is changed at runtime
+#define RCF_REBOOT      (1 << 0)
+#define RCF_BRIGHT_DEST (1 << 1)
+#define RCF_BRIGHT_PRES (1 << 2)
+#define RCF_BRIGHT_DEPA (1 << 3)
+#define RCF_NMOFF       (1 << 4)
+#define RCF_BEEP        (1 << 5)
+#define RCF_AUTOROT     (1 << 6)
+#define RCF_TZ          (1 << 7)
+#define RCF_AUTONM      (1 << 8)
+#define RCF_SHUFFLE     (1 << 9)
+#define RCF_SPEEDOBRI   (1 << 10)
+#define RCF_TELEM       (1 << 11)
+
+#ifdef TC_HAVEMQTT
+bool applyRemoteConfig(char *json, unsigned int len, uint32_t& changed, char *errKey, int errKeyLen);
+#endif
+
 bool loadIpSettings();
 void writeIpSettings();
 void deleteIpSettings();
@@ -212,6 +231,9 @@ bool readFileFromSD(const char *fn, uint8_t *buf, int len);
 bool writeFileToSD(const char *fn, uint8_t *buf, int len);
 bool readFileFromFS(const char *fn, uint8_t *buf, int len);
 bool writeFileToFS(const char *fn, uint8_t *buf, int len);
+void removeFileFromFS(const char *fn);
+bool readBlobFromNVS(const char *key, uint8_t *buf, int len);
+bool writeBlobToNVS(const char *key, uint8_t *buf, int len);
 
 
 #endif
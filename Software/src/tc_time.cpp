@@ -49,6 +49,9 @@
 #endif
 
 #include "tc_time.h"
+#ifdef TC_HAVELIGHT
+#include "tc_luxnm.h"
+#endif
 
 // i2c slave addresses
 
@@ -117,11 +120,24 @@
 // Native NTP
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_MAX_RTT     1000    // ms; replies taking longer are re-requested...
+#define NTP_RTT_RETRIES 3       // ...this many times, then accepted
 
 unsigned long        powerupMillis = 0;
 static unsigned long lastMillis = 0;
 uint64_t             millisEpoch = 0;
 
+// I2C transmission errors (displays, RTC, sensors)
+uint32_t             i2cErrCount = 0;
+
+// Heap statistics, sampled once per minute
+#define HEAP_SAMPLE_INT (60*1000)
+static unsigned long heapSampleNow = 0;
+uint32_t             heapMaxBlk    = 0;           // Largest free block at last sample
+uint32_t             heapMaxBlkMin = 0xffffffff;  // Lowest largest free block since boot
+uint8_t              heapFrag      = 0;           // Fragmentation (%) at last sample
+uint8_t              heapFragMax   = 0;           // Highest fragmentation since boot
+
 static bool    couldHaveAuthTime = false;
 static bool    haveAuthTime = false;
 uint16_t       lastYear = 0;
@@ -216,12 +232,23 @@ int  specDisp = 0;
 
 uint8_t  mqttDisp = 0;
 #ifdef TC_HAVEMQTT
+#define MQTT_MSGQ_SIZE  4
 uint8_t  mqttOldDisp = 0;
-char     mqttMsg[256];
 uint16_t mqttIdx = 0;
-int16_t  mqttMaxIdx = 0;
-bool     mqttST = false;
+static int16_t   mqttMaxIdx = 0;
+static bool      mqttST = false;
+static uint8_t   mqttPrio = 0;
+static uint16_t  mqttSpeed = MQTT_SPEED_DEF;
+static stripChar mqttStrip[MQTT_MSG_LEN];
+static int16_t   mqttStripLen = 0;
 static unsigned long mqttStartNow = 0;
+static struct {
+    char     text[MQTT_MSG_LEN + 1];
+    uint8_t  prio;
+    uint16_t speed;
+    bool     sound;
+} mqttMsgQ[MQTT_MSGQ_SIZE];
+static int       mqttMsgQCount = 0;
 #endif
 
 // CPU power management
@@ -254,17 +281,20 @@ bool useGPS      = true;
 bool useGPSSpeed = false;
 
 // TZ/DST status & data
+// Index 3 is a scratch slot for checkTZ()
+#define TZ_CHECK_IDX 3
 static bool checkDST        = false;
-bool        couldDST[3]     = { false, false, false };   // Could use own DST management (and DST is defined in TZ)
-static int  tzForYear[3]    = { 0, 0, 0 };               // Parsing done for this very year
-static int8_t tzIsValid[3]  = { -1, -1, -1 };
-static int8_t tzHasDST[3]   = { -1, -1, -1 };
-static char *tzDSTpart[3]   = { NULL, NULL, NULL };
-static int  tzDiffGMT[3]    = { 0, 0, 0 };               // Difference to UTC in nonDST time
-static int  tzDiffGMTDST[3] = { 0, 0, 0 };               // Difference to UTC in DST time
-static int  tzDiff[3]       = { 0, 0, 0 };               // difference between DST and non-DST in minutes
-static int  DSTonMins[3]    = { -1, -1, -1 };            // DST-on date/time in minutes since 1/1 00:00 (in non-DST time)
-static int  DSToffMins[3]   = { 600000, 600000, 600000}; // DST-off date/time in minutes since 1/1 00:00 (in DST time)
+bool        couldDST[4]     = { false, false, false, false };   // Could use own DST management (and DST is defined in TZ)
+static int  tzForYear[4]    = { 0, 0, 0, 0 };               // Parsing done for this very year
+static int8_t tzIsValid[4]  = { -1, -1, -1, -1 };
+static int8_t tzHasDST[4]   = { -1, -1, -1, -1 };
+static char *tzDSTpart[4]   = { NULL, NULL, NULL, NULL };
+static int  tzDiffGMT[4]    = { 0, 0, 0, 0 };               // Difference to UTC in nonDST time
+static int  tzDiffGMTDST[4] = { 0, 0, 0, 0 };               // Difference to UTC in DST time
+static int  tzDiff[4]       = { 0, 0, 0, 0 };               // difference between DST and non-DST in minutes
+static int  DSTonMins[4]    = { -1, -1, -1, -1 };            // DST-on date/time in minutes since 1/1 00:00 (in non-DST time)
+static int  DSToffMins[4]   = { 600000, 600000, 600000, 600000 }; // DST-off date/time in minutes since 1/1 00:00 (in DST time)
+static char *tzCheckStr     = NULL;
 
 // WC stuff
 bool        WcHaveTZ1  = false;
@@ -290,7 +320,10 @@ static uint32_t      NTPmsSinceSecond = 0;
 static bool          NTPPacketDue = false;
 static bool          NTPWiFiUp = false;
 static uint8_t       NTPfailCount = 0;
+static uint8_t       NTPRTTRetries = 0;
 static uint8_t       NTPUDPID[4] = { 0, 0, 0, 0};
+unsigned long        NTPLastRTT = 0;    // Round-trip time of last valid packet (ms)
+unsigned long        NTPLastRcvd = 0;   // millis() of last valid packet
  
 // The RTC object
 tcRTC rtc(2, (uint8_t[2*2]){ PCF2129_ADDR, RTCT_PCF2129, 
@@ -395,7 +428,6 @@ static int8_t  timedNightMode = -1;
 static int8_t  sensorNightMode = -1;
 int8_t         manualNightMode = -1;
 unsigned long  manualNMNow = 0;
-int32_t        luxLimit = 3;
 static const uint32_t autoNMhomePreset[7] = {     // Mo-Th 5pm-11pm, Fr 1pm-1am, Sa 9am-1am, Su 9am-11pm
         0b011111111000000000000001,   //Sun
         0b111111111111111110000001,   //Mon
@@ -441,6 +473,10 @@ bool useLight = false;
 #ifdef TC_HAVELIGHT
 static unsigned long lastLoopLight = 0;
 #endif
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+sensHistory sensHist;
+static int  shLastMin = -1;
+#endif
 
 unsigned long ctDown = 0;
 unsigned long ctDownNow = 0;
@@ -532,16 +568,24 @@ static void dispGPSSpeed(bool force = false);
 #endif
 
 #ifdef TC_HAVETEMP
-static void updateTemperature(bool force = false);
+static bool updateTemperature(bool force = false);
 #ifdef TC_HAVESPEEDO
 static bool dispTemperature(bool force = false);
 #endif
 #endif
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+static void addSensorHistory(DateTime& dt);
+#endif
 #ifdef TC_HAVESPEEDO
 #ifdef SP_ALWAYS_ON
 static void dispIdleZero(bool force = false);
 #endif
 #endif
+#ifdef TC_HAVEMQTT
+static void mqttStartMsg(const char *text, uint8_t prio, uint16_t speed, bool sound);
+static void mqttNextMsg();
+static void mqttTickerLoop();
+#endif
 
 static void triggerLongTT();
 
@@ -556,6 +600,8 @@ static void localToDST(int index, int& year, int& month, int& day, int& hour, in
 static void updateDSTFlag(int nisDST = -1);
 
 /// Native NTP
+static void heapSample();
+
 static void ntp_setup();
 static bool NTPHaveTime();
 static bool NTPTriggerUpdate();
@@ -716,6 +762,15 @@ void time_setup()
     }
     #endif
 
+    // Send first NTP request now; the round trip overlaps
+    // with GPS receiver bring-up below. If the reply is only 
+    // fetched after that, NTPCheckPacket() discards it for its
+    // long round trip and asks again.
+    ntp_setup();
+    if((settings.ntpServer[0] != 0) && (WiFi.status() == WL_CONNECTED)) {
+        ntp_loop();
+    }
+
     // Set up GPS receiver
     #ifdef TC_HAVEGPS
     useGPS = true;    // Use by default if detected
@@ -770,15 +825,15 @@ void time_setup()
         couldHaveAuthTime = true;
     
     // Try to obtain initial authoritative time
-
-    ntp_setup();
+    // (Request was sent above; poll in short intervals so
+    // we don't sit idle after the packet has arrived)
     if((settings.ntpServer[0] != 0) && (WiFi.status() == WL_CONNECTED)) {
-        int timeout = 50;
-        do {
+        int timeout = 250;
+        ntp_loop();
+        while(!NTPHaveTime() && timeout--) {
+            delay(20);
             ntp_loop();
-            delay(100);
-            timeout--;
-        } while (!NTPHaveTime() && timeout);
+        }
     }
 
     // Parse TZ to check validity.
@@ -1005,26 +1060,7 @@ void time_setup()
     loadReminder();
 
     // Auto-NightMode
-    autoNightModeMode = (int)atoi(settings.autoNMPreset);
-    if(autoNightModeMode > AUTONM_NUM_PRESETS) autoNightModeMode = 10;
-    autoNightMode = (autoNightModeMode != 10);
-    autoNMOnHour = (int)atoi(settings.autoNMOn);
-    if(autoNMOnHour > 23) autoNMOnHour = 0;
-    autoNMOffHour = (int)atoi(settings.autoNMOff);
-    if(autoNMOffHour > 23) autoNMOffHour = 0;
-    if(autoNightMode && (autoNightModeMode == 0)) {
-        if((autoNightMode = (autoNMOnHour != autoNMOffHour))) {
-            if(autoNMOnHour < autoNMOffHour) {
-                for(int i = autoNMOnHour; i < autoNMOffHour; i++)
-                    autoNMdailyPreset |= (1 << (23-i));
-            } else {
-                autoNMdailyPreset = 0b111111111111111111111111;
-                for(int i = autoNMOffHour; i < autoNMOnHour; i++)
-                    autoNMdailyPreset &= ~(1 << (23-i));
-            }
-        }
-    }
-    if(autoNightMode) forceReEvalANM = true;
+    loadAutoNM();
 
     // If using auto times, put up the first one
     if(autoTimeIntervals[autoInterval]) {
@@ -1141,7 +1177,7 @@ void time_setup()
 
     #ifdef TC_HAVELIGHT
     useLight = ((int)atoi(settings.useLight) > 0);
-    luxLimit = atoi(settings.luxLimit);
+    luxNMSetup(atoi(settings.luxLimit));
     if(useLight) {
         if(lightSens.begin(haveGPS, powerupMillis)) {
             lightSens.setCustomDelayFunc(myCustomDelay);
@@ -1153,6 +1189,16 @@ void time_setup()
     useLight = false;
     #endif
 
+    #if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+    if(useTemp || useLight) {
+        #ifdef TC_HAVETEMP
+        sensHist.begin(tempUnit);
+        #else
+        sensHist.begin(false);
+        #endif
+    }
+    #endif
+
     // Set up tt trigger for external props (wired & mqtt)
     #ifdef EXTERNAL_TIMETRAVEL_OUT
     useETTO = useETTOWired = ((int)atoi(settings.useETTO) > 0);
@@ -1196,12 +1242,7 @@ void time_setup()
         // if the menu timed-out
         allOff();
         waitForEnterRelease();
-        isEnterKeyHeld = false;
-        isEnterKeyPressed = false;
-        #ifdef EXTERNAL_TIMETRAVEL_IN
-        isEttKeyPressed = false;
-        isEttKeyHeld = false;
-        #endif
+        inputEvFlush();
     }
 
     if(!audio_files_present()) {
@@ -1291,6 +1332,91 @@ void time_setup()
     
 }
 
+/*
+ * Set up Auto-NightMode from settings (in memory)
+ * Called on boot, and when changed at runtime.
+ */
+void loadAutoNM()
+{
+    autoNightModeMode = (int)atoi(settings.autoNMPreset);
+    if(autoNightModeMode > AUTONM_NUM_PRESETS) autoNightModeMode = 10;
+    autoNightMode = (autoNightModeMode != 10);
+    autoNMOnHour = (int)atoi(settings.autoNMOn);
+    if(autoNMOnHour > 23) autoNMOnHour = 0;
+    autoNMOffHour = (int)atoi(settings.autoNMOff);
+    if(autoNMOffHour > 23) autoNMOffHour = 0;
+    autoNMdailyPreset = 0;
+    if(autoNightMode && (autoNightModeMode == 0)) {
+        if((autoNightMode = (autoNMOnHour != autoNMOffHour))) {
+            if(autoNMOnHour < autoNMOffHour) {
+                for(int i = autoNMOnHour; i < autoNMOffHour; i++)
+                    autoNMdailyPreset |= (1 << (23-i));
+            } else {
+                autoNMdailyPreset = 0b111111111111111111111111;
+                for(int i = autoNMOffHour; i < autoNMOnHour; i++)
+                    autoNMdailyPreset &= ~(1 << (23-i));
+            }
+        }
+    }
+    if(autoNightMode) forceReEvalANM = true;
+}
+
+static void resetTZSlot(int index)
+{
+    tzIsValid[index] = tzHasDST[index] = -1;
+    tzDSTpart[index] = NULL;
+}
+
+/*
+ * Check a TZ string (including its DST part) without
+ * touching the live TZ data. Used to validate time zones
+ * received remotely before they are committed.
+ */
+bool checkTZ(const char *tz)
+{
+    char buf[64];
+    DateTime dt;
+
+    if(strlen(tz) >= sizeof(buf)) return false;
+    strcpy(buf, tz);
+    tzCheckStr = buf;
+
+    myrtcnow(dt);
+
+    resetTZSlot(TZ_CHECK_IDX);
+    bool ret = parseTZ(TZ_CHECK_IDX, dt.year() - presentTime.getYearOffset());
+    resetTZSlot(TZ_CHECK_IDX);
+    tzCheckStr = NULL;
+
+    return ret;
+}
+
+/*
+ * Re-parse main time zone after it was changed at runtime.
+ * The RTC is corrected with the next NTP/GPS sync, which
+ * we trigger here.
+ */
+bool reloadTZ()
+{
+    DateTime dt;
+
+    myrtcnow(dt);
+
+    // Drop cached results from the previous string
+    resetTZSlot(0);
+
+    if(!(parseTZ(0, dt.year() - presentTime.getYearOffset()))) {
+        #ifdef TC_DBG
+        Serial.println(F("reloadTZ: Failed to parse TZ"));
+        #endif
+        return false;
+    }
+
+    syncTrigger = true;
+
+    return true;
+}
+
 /*
  * time_loop()
  *
@@ -1308,6 +1434,11 @@ void time_loop()
     }
     lastMillis = millisNow;
 
+    if(!heapSampleNow || (millisNow - heapSampleNow >= HEAP_SAMPLE_INT)) {
+        heapSample();
+        heapSampleNow = millisNow;
+    }
+
     #ifdef FAKE_POWER_ON
     if(waitForFakePowerButton) {
         fakePowerOnKey.scan();
@@ -1389,6 +1520,15 @@ void time_loop()
     if(startup && (millis() - startupNow >= STARTUP_DELAY)) {
         animate();
         startup = false;
+        #ifdef TC_DBG
+        {
+            static bool firstOn = true;
+            if(firstOn) {
+                Serial.printf("time_loop: Displays on %lums after power-up\n", millis() - powerupMillis);
+                firstOn = false;
+            }
+        }
+        #endif
         #ifdef TC_HAVESPEEDO
         if(useSpeedo && !useGPSSpeed) {
             #ifdef TC_HAVETEMP
@@ -1424,7 +1564,7 @@ void time_loop()
         ettoPulseNow = millis();
         #ifdef TC_HAVEMQTT
         if(useMQTT && pubMQTT) {
-            mqttPublish("bttf/tcd/pub", "TIMETRAVEL\0", 11);
+            mqttPublish("bttf/tcd/pub", "TIMETRAVEL\0", 11, true);
         }
         #endif
         #ifdef TC_DBG
@@ -1598,6 +1738,11 @@ void time_loop()
             #endif
         }   
 
+        #ifdef TC_HAVEMQTT
+        // Scroll MQTT message
+        mqttTickerLoop();
+        #endif
+
         // Beep auto modes
         if(beepTimer && (millisNow - beepTimerNow > beepTimeout)) {
             muteBeep = true;
@@ -1607,9 +1752,11 @@ void time_loop()
         // Update sensors
 
         #ifdef TC_HAVETEMP
-        updateTemperature();
         #ifdef TC_HAVESPEEDO
-        didUpdSpeedo = dispTemperature();
+        // Redisplay if a pending reading came in
+        didUpdSpeedo = dispTemperature(updateTemperature());
+        #else
+        updateTemperature();
         #endif
         #endif
 
@@ -1624,7 +1771,9 @@ void time_loop()
         #ifdef TC_HAVELIGHT
         if(useLight && (millisNow - lastLoopLight >= 3000)) {
             lastLoopLight = millisNow;
-            lightSens.loop();
+            if(lightSens.loop()) {
+                luxNMEval(lightSens.readLux());
+            }
         }
         #endif
 
@@ -1670,8 +1819,9 @@ void time_loop()
             bool GPShasTime = false;
             #endif
 
-            // Read RTC
-            myrtcnow(dt);
+            // Get current time: Advance software time
+            // base, or read RTC if due
+            timeBaseNow(dt);
 
             // Re-adjust time periodically through NTP/GPS
             //
@@ -1994,6 +2144,10 @@ void time_loop()
             // Write time to presentTime display
             presentTime.setDateTimeDiff(dt);
 
+            // dt is final now (including any adjustments
+            // above); continue counting from here
+            timeBaseSet(dt);
+
             // Handle WC mode (load dates/times for dest/dep display)
             // (Restoring not needed, done elsewhere)
             if(isWcMode()) {
@@ -2025,6 +2179,14 @@ void time_loop()
             }
             #endif
 
+            // Sensor history: One sample per minute
+            #if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+            if((useTemp || useLight) && (dt.minute() != shLastMin)) {
+                shLastMin = dt.minute();
+                addSensorHistory(dt);
+            }
+            #endif
+
             // Alarm, count-down timer, Sound-on-the-Hour, Reminder
 
             {
@@ -2102,7 +2264,7 @@ void time_loop()
                             alarmDone = true;
                             #ifdef TC_HAVEMQTT
                             if(useMQTT && pubMQTT) {
-                                mqttPublish("bttf/tcd/pub", "ALARM\0", 6);
+                                mqttPublish("bttf/tcd/pub", "ALARM\0", 6, true);
                             }
                             #endif
                         }
@@ -2151,9 +2313,8 @@ void time_loop()
                 #ifdef TC_HAVELIGHT
                 // Light sensor overrules scheduled NM only in non-NightMode periods
                 if(useLight && (manualNightMode < 0) && (timedNightMode < 1)) {
-                    int32_t myLux = lightSens.readLux();
-                    if(myLux >= 0) {
-                        if(myLux > luxLimit) {
+                    if(luxNMState() >= 0) {
+                        if(luxNMState() == LUXNM_OFF) {
                             sensorNightMode = 0;
                             switchNMoff = true;
                         } else {
@@ -2334,7 +2495,7 @@ void time_loop()
             #ifdef TC_HAVEMQTT
             if(mqttDisp) { 
                 if(!specDisp) {
-                    destinationTime.showTextDirect(mqttMsg + mqttIdx);
+                    destinationTime.showStripDirect(mqttStrip, mqttStripLen, mqttIdx);
                     if(mqttST) {
                         if(!presentTime.getNightMode()) {
                             play_file(mqttAudioFile, PA_CHECKNM|PA_ALLOWSD);
@@ -2345,17 +2506,10 @@ void time_loop()
                         mqttStartNow = millis();
                         mqttOldDisp = mqttDisp;
                     }
+                    // Scrolling is done in mqttTickerLoop()
                     if(mqttMaxIdx < 0) {
                         if(millis() - mqttStartNow > 5000) {
-                            mqttDisp = mqttOldDisp = 0;
-                        }
-                    } else {
-                        if(millis() - mqttStartNow > 200) { // useless actually, we are in .5 second steps here
-                            mqttStartNow = millis();
-                            mqttIdx++;
-                            if(mqttIdx > mqttMaxIdx) {
-                                mqttDisp = mqttOldDisp = 0;
-                            }
+                            mqttNextMsg();
                         }
                     }
                 } else {
@@ -2401,6 +2555,97 @@ void time_loop()
     } 
 }
 
+#ifdef TC_HAVEMQTT
+/*
+ * MQTT message ticker
+ *
+ * Messages are queued by priority (FIFO within same priority).
+ * A message with higher priority than the one currently shown
+ * replaces it immediately. Each message is rendered into segment 
+ * patterns once when it is started, scrolling then only copies
+ * the respective window to the display.
+ */
+void mqttTickerAdd(const char *text, uint8_t prio, uint16_t speed, bool sound)
+{
+    int i;
+    
+    if(!*text) return;
+
+    if(speed < MQTT_SPEED_MIN) speed = MQTT_SPEED_MIN;
+    else if(speed > MQTT_SPEED_MAX) speed = MQTT_SPEED_MAX;
+    
+    if(!mqttDisp || prio > mqttPrio) {
+        mqttStartMsg(text, prio, speed, sound);
+        return;
+    }
+
+    // Find insert position; if queue is full, drop the last
+    // (ie lowest priority) entry unless it ranks higher
+    for(i = 0; i < mqttMsgQCount; i++) {
+        if(prio > mqttMsgQ[i].prio) break;
+    }
+    if(i >= MQTT_MSGQ_SIZE) return;
+    if(mqttMsgQCount == MQTT_MSGQ_SIZE) mqttMsgQCount--;
+    
+    memmove(&mqttMsgQ[i+1], &mqttMsgQ[i], (mqttMsgQCount - i) * sizeof(mqttMsgQ[0]));
+    mqttMsgQCount++;
+    
+    strncpy(mqttMsgQ[i].text, text, MQTT_MSG_LEN);
+    mqttMsgQ[i].text[MQTT_MSG_LEN] = 0;
+    mqttMsgQ[i].prio = prio;
+    mqttMsgQ[i].speed = speed;
+    mqttMsgQ[i].sound = sound;
+}
+
+static void mqttStartMsg(const char *text, uint8_t prio, uint16_t speed, bool sound)
+{
+    mqttStripLen = destinationTime.renderStrip(text, mqttStrip, MQTT_MSG_LEN);
+    mqttMaxIdx = (mqttStripLen > DISP_LEN) ? mqttStripLen : -1;
+    mqttIdx = 0;
+    mqttPrio = prio;
+    mqttSpeed = speed;
+    mqttST = sound;
+    mqttDisp = 1;
+    mqttOldDisp = 0;
+
+    #ifdef TC_DBG
+    Serial.printf("MQTT: Showing message (prio %d, %d ms): %s\n", prio, speed, text);
+    #endif
+}
+
+static void mqttNextMsg()
+{
+    if(mqttMsgQCount) {
+        mqttStartMsg(mqttMsgQ[0].text, mqttMsgQ[0].prio, mqttMsgQ[0].speed, mqttMsgQ[0].sound);
+        mqttMsgQCount--;
+        memmove(&mqttMsgQ[0], &mqttMsgQ[1], mqttMsgQCount * sizeof(mqttMsgQ[0]));
+    } else {
+        mqttDisp = mqttOldDisp = 0;
+    }
+}
+
+static void mqttTickerLoop()
+{
+    // Only scroll if message has been started (which also
+    // means it is not blocked by something else)
+    if(!mqttDisp || mqttOldDisp != mqttDisp || mqttMaxIdx < 0)
+        return;
+
+    if(timeTravelP1 > 1 || autoIntAnimRunning || startup || timeTravelRE || !FPBUnitIsOn || specDisp)
+        return;
+
+    if(millis() - mqttStartNow >= mqttSpeed) {
+        mqttStartNow = millis();
+        mqttIdx++;
+        if(mqttIdx > mqttMaxIdx) {
+            mqttNextMsg();
+        } else {
+            destinationTime.showStripDirect(mqttStrip, mqttStripLen, mqttIdx);
+        }
+    }
+}
+#endif
+
 
 /* Time Travel:
  *
@@ -2433,7 +2678,7 @@ void time_loop()
  *  This is also called from tc_keypad.cpp
  */
 
-void timeTravel(bool doComplete, bool withSpeedo)
+void timeTravel(bool doComplete, bool withSpeedo, int startSpeed)
 {
     int   tyr = 0;
     int   tyroffs = 0;
@@ -2491,6 +2736,15 @@ void timeTravel(bool doComplete, bool withSpeedo)
         }
         #endif
 
+        // Explicit start speed overrules GPS speed
+        if(startSpeed >= 0) {
+            timeTravelP0Speed = (startSpeed < 88) ? startSpeed : 88;
+            timetravelP0Delay = 0;
+            if(timeTravelP0Speed < 88) {
+                currTotDur = tt_p0_totDelays[timeTravelP0Speed];
+            }
+        }
+
         if(timeTravelP0Speed < 88) {
 
             // If time needed to reach 88mph is shorter than ettoLeadTime
@@ -2675,7 +2929,7 @@ void timeTravel(bool doComplete, bool withSpeedo)
         ettoPulseEnd();
         #ifdef TC_HAVEMQTT
         if(useMQTT && pubMQTT) {
-            mqttPublish("bttf/tcd/pub", "REENTRY\0", 8);
+            mqttPublish("bttf/tcd/pub", "REENTRY\0", 8, true);
         }
         #endif
     }
@@ -2965,15 +3219,54 @@ bool isRcMode()
 }
 
 #ifdef TC_HAVETEMP
-static void updateTemperature(bool force)
+/*
+ * Read temperature sensor. The sensor is not waited for; if 
+ * its conversion is still running, the reading is collected 
+ * by a later call. Returns true if such a pending reading 
+ * came in, so that the caller can update the display.
+ */
+static bool updateTemperature(bool force)
 {
     if(!useTemp)
-        return;
+        return false;
         
     if(force || (millis() - tempReadNow >= tempUpdInt)) {
         tempSens.readTemp(tempUnit);
         tempReadNow = millis();
+        return false;
+    }
+
+    return tempSens.loop();
+}
+#endif
+
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+static void addSensorHistory(DateTime& dt)
+{
+    int16_t temp = SH_INVALID, hum = SH_INVALID, lux = SH_INVALID;
+
+    #ifdef TC_HAVETEMP
+    if(useTemp) {
+        float t = tempSens.readLastTemp();
+        if(!isnan(t)) temp = (int16_t)lroundf(t * 10.0f);
+        if(tempSens.haveHum() && (tempSens.readHum() >= 0)) hum = tempSens.readHum();
     }
+    #endif
+    #ifdef TC_HAVELIGHT
+    if(useLight) {
+        int32_t l = lightSens.readLux();
+        if(l >= 0) lux = (l > 32767) ? 32767 : l;
+    }
+    #endif
+
+    // Stamp with UTC, so DST changes don't step back in time
+    uint64_t utcMins = dateToMins(dt.year() - presentTime.getYearOffset(), 
+                                  dt.month(), dt.day(), dt.hour(), dt.minute());
+    if(presentTime.getDST() > 0)
+        utcMins -= tzDiff[0];
+    utcMins += tzDiffGMT[0];
+
+    sensHist.add((uint32_t)utcMins, temp, hum, lux);
 }
 #endif
 
@@ -3757,6 +4050,7 @@ bool parseTZ(int index, int currYear, bool doparseDST)
     case 0: tz = settings.timeZone;     break;
     case 1: tz = settings.timeZoneDest; break;
     case 2: tz = settings.timeZoneDep;  break;
+    case TZ_CHECK_IDX: tz = tzCheckStr; break;
     default:
       return false;
     }
@@ -4138,6 +4432,31 @@ void setDatesTimesWC(DateTime& dt)
     }
 }
 
+/*
+ * Heap statistics
+ * 
+ * Fragmentation is the part of free heap that is not available
+ * as one block, ie not usable for the largest allocation we could
+ * do. A fragmentation creeping up, or a largest free block 
+ * creeping down, over days of uptime means trouble ahead.
+ * Published with MQTT telemetry.
+ */
+static void heapSample()
+{
+    uint32_t heapFree = ESP.getFreeHeap();
+    
+    heapMaxBlk = ESP.getMaxAllocHeap();
+    if(heapMaxBlk < heapMaxBlkMin) heapMaxBlkMin = heapMaxBlk;
+    
+    heapFrag = (heapFree && heapMaxBlk < heapFree) ? 100 - (uint8_t)(((uint64_t)heapMaxBlk * 100) / heapFree) : 0;
+    if(heapFrag > heapFragMax) heapFragMax = heapFrag;
+
+    #ifdef TC_DBG
+    Serial.printf("Heap: free %u (min %u), largest block %u (min %u), fragmentation %d%% (max %d%%)\n",
+                  heapFree, ESP.getMinFreeHeap(), heapMaxBlk, heapMaxBlkMin, heapFrag, heapFragMax);
+    #endif
+}
+
 /**************************************************************
  ***                                                        ***
  ***                       Native NTP                       ***
@@ -4276,9 +4595,25 @@ static void NTPCheckPacket()
     // If it's our expected packet, no other is due for now
     NTPPacketDue = false;
 
+    // A reply is only noticed when we look for it; if we were
+    // busy elsewhere (eg GPS bring-up at boot), the measured round 
+    // trip is too long and would skew the correction. Ask again.
+    if((mymillis - NTPTSRQAge > NTP_MAX_RTT) && (NTPRTTRetries < NTP_RTT_RETRIES)) {
+        NTPRTTRetries++;
+        NTPUpdateNow = 0;
+        #ifdef TC_DBG
+        Serial.printf("NTPCheckPacket: RTT %lums too long, re-requesting\n", mymillis - NTPTSRQAge);
+        #endif
+        return;
+    }
+    NTPRTTRetries = 0;
+
     // Baseline for round-trip correction
     NTPTSAge = mymillis - ((mymillis - NTPTSRQAge) / 2);
 
+    NTPLastRTT = mymillis - NTPTSRQAge;
+    NTPLastRcvd = mymillis;
+
     // Evaluate data
     uint64_t secsSince1900 = ((uint32_t)NTPUDPBuf[40] << 24) |
                              ((uint32_t)NTPUDPBuf[41] << 16) |
@@ -34,6 +34,7 @@
 #define _TC_TIME_H
 
 #include "rtc.h"
+#include "tc_timebase.h"
 #include "clockdisplay.h"
 #ifdef TC_HAVEGPS
 #include "gps.h"
@@ -54,7 +55,7 @@ extern unsigned long powerupMillis;
 
 extern uint16_t lastYear;
 
-extern bool couldDST[3];
+extern bool couldDST[4];
 extern bool haveWcMode;
 extern bool WcHaveTZ1;
 extern bool WcHaveTZ2;
@@ -66,6 +67,14 @@ extern bool doAPretry;
 extern uint64_t lastAuthTime64;
 extern uint64_t millisEpoch;
 
+extern uint32_t i2cErrCount;
+extern uint32_t heapMaxBlk;
+extern uint32_t heapMaxBlkMin;
+extern uint8_t  heapFrag;
+extern uint8_t  heapFragMax;
+extern unsigned long NTPLastRTT;
+extern unsigned long NTPLastRcvd;
+
 extern clockDisplay destinationTime;
 extern clockDisplay presentTime;
 extern clockDisplay departedTime;
@@ -83,6 +92,9 @@ extern bool useLight;
 #ifdef TC_HAVELIGHT
 extern lightSensor lightSens;
 #endif
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+extern sensHistory sensHist;
+#endif
 
 extern tcRTC rtc;
 
@@ -109,11 +121,12 @@ extern int  specDisp;
 
 extern uint8_t  mqttDisp;
 #ifdef TC_HAVEMQTT
+#define MQTT_MSG_LEN    255
+#define MQTT_SPEED_DEF  500     // ms per scroll step
+#define MQTT_SPEED_MIN  100
+#define MQTT_SPEED_MAX  2000
 extern uint8_t  mqttOldDisp;
-extern char mqttMsg[256];
 extern uint16_t mqttIdx;
-extern int16_t  mqttMaxIdx;
-extern bool     mqttST;
 #endif
 
 // Time Travel difference to RTC
@@ -134,11 +147,14 @@ extern unsigned long beepTimerNow;
 void time_boot();
 void time_setup();
 void time_loop();
-void timeTravel(bool doComplete, bool withSpeedo = false);
+void timeTravel(bool doComplete, bool withSpeedo = false, int startSpeed = -1);
 void resetPresentTime();
 void pauseAuto();
 bool checkIfAutoPaused();
 void endPauseAuto(void);
+void loadAutoNM();
+bool reloadTZ();
+bool checkTZ(const char *tz);
 
 void enableWcMode(bool onOff);
 bool toggleWcMode();
@@ -183,4 +199,8 @@ void  setDatesTimesWC(DateTime& dt);
 void  ntp_loop();
 void  ntp_short_loop();
 
+#ifdef TC_HAVEMQTT
+void  mqttTickerAdd(const char *text, uint8_t prio = 0, uint16_t speed = MQTT_SPEED_DEF, bool sound = false);
+#endif
+
 #endif
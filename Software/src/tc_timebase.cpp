@@ -0,0 +1,93 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * Software time base
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "tc_global.h"
+
+#include <Arduino.h>
+
+#include "tc_time.h"
+#include "tc_timebase.h"
+
+static DateTime tbTime;
+static bool     tbValid = false;
+static uint32_t tbTickNow = 0;
+
+/*
+ * Software time base
+ * 
+ * Saves reading the RTC via i2c every second: The time is
+ * advanced in memory on every SQW tick, and only re-read
+ * from the RTC periodically, at least daily, and whenever 
+ * ticks seem to have been missed.
+ * (Tick stamps are 32 bit, as is millis() on the ESP32, so
+ * the difference stays correct when millis() wraps.)
+ */
+void timeBaseNow(DateTime& dt)
+{
+    uint32_t millisNow = millis();
+    uint32_t tickDiff = millisNow - tbTickNow;
+
+    tbTickNow = millisNow;
+
+    if(tbValid && (tickDiff > SQW_TICK_MIN) && (tickDiff < SQW_TICK_MAX)) {
+        tbTime.addSecond();
+        if(tbTime.second() || (tbTime.minute() % RTC_RESYNC_MINS)) {
+            dt = tbTime;
+            return;
+        }
+    }
+
+    myrtcnow(dt);
+
+    #ifdef TC_DBG
+    if(tbValid && (tickDiff > SQW_TICK_MIN) && (tickDiff < SQW_TICK_MAX)) {
+        if(dt.second() != tbTime.second() || dt.minute() != tbTime.minute() ||
+           dt.hour()   != tbTime.hour()   || dt.day()    != tbTime.day()) {
+            Serial.printf("timeBaseNow: Drift detected: %02d:%02d:%02d vs RTC %02d:%02d:%02d\n",
+                tbTime.hour(), tbTime.minute(), tbTime.second(),
+                dt.hour(), dt.minute(), dt.second());
+        }
+    }
+    #endif
+}
+
+void timeBaseSet(DateTime& dt)
+{
+    tbTime = dt;
+    tbValid = true;
+}
+
+// Call this after adjusting the RTC outside of time_loop()
+void timeBaseInvalidate()
+{
+    tbValid = false;
+}
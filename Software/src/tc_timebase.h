@@ -0,0 +1,51 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2022-2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display-A10001986
+ *
+ * Software time base
+ *
+ * -------------------------------------------------------------------
+ * License: MIT
+ * 
+ * Permission is hereby granted, free of charge, to any person 
+ * obtaining a copy of this software and associated documentation 
+ * files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, 
+ * merge, publish, distribute, sublicense, and/or sell copies of the 
+ * Software, and to permit persons to whom the Software is furnished to 
+ * do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be 
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TC_TIMEBASE_H
+#define _TC_TIMEBASE_H
+
+#include "rtc.h"
+
+// Software time base:
+// The RTC is only read every RTC_RESYNC_MINS minutes (at second 0); in
+// between, the time is advanced in memory on each falling edge of the
+// RTC's 1Hz signal. If the time between two ticks is outside of the
+// window below (ie a tick was missed or time_loop was blocked), the
+// RTC is read regardless.
+#define RTC_RESYNC_MINS  10     // Must be a divisor of 60
+#define SQW_TICK_MIN    500     // ms
+#define SQW_TICK_MAX   1500     // ms
+
+void timeBaseNow(DateTime& dt);
+void timeBaseSet(DateTime& dt);
+void timeBaseInvalidate();
+
+#endif
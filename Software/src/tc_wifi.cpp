@@ -47,9 +47,11 @@
 #include "tc_audio.h"
 #include "tc_settings.h"
 #include "tc_wifi.h"
+#include "tc_keypad.h"
+#include "tc_api.h"
 #ifdef TC_HAVEMQTT
 #include "mqtt.h"
-#include "tc_keypad.h"
+#include "tc_mqttcmd.h"
 #endif
 
 // If undefined, use the checkbox/dropdown-hacks.
@@ -262,6 +264,11 @@ WiFiManagerParameter custom_pubMQTT("pMQTT", "Send commands for external props",
 #else // -------------------- Checkbox hack: --------------
 WiFiManagerParameter custom_pubMQTT("pMQTT", "Send commands for external props", settings.pubMQTT, 1, "type='checkbox' style='margin-top:5px'", WFM_LABEL_AFTER);
 #endif // -------------------------------------------------
+#ifdef TC_NOCHECKBOXES  // --- Standard text boxes: -------
+WiFiManagerParameter custom_mqttTelem("mTel", "Publish telemetry (0=no, 1=yes)", settings.mqttTelem, 1, "autocomplete='off'");
+#else // -------------------- Checkbox hack: --------------
+WiFiManagerParameter custom_mqttTelem("mTel", "Publish telemetry", settings.mqttTelem, 1, "type='checkbox' style='margin-top:5px'", WFM_LABEL_AFTER);
+#endif // -------------------------------------------------
 #endif // HAVEMQTT
 
 #ifdef TC_NOCHECKBOXES  // --- Standard text boxes: -------
@@ -296,12 +303,108 @@ WiFiManagerParameter custom_sectstart_mp("</div><div class='sects'><div class='h
 
 WiFiManagerParameter custom_sectend_foot("</div><p></p>");
 
+/*
+ * Plain numerical and checkbox parameters; copied from and to
+ * the settings by loops over this table. Parameters needing
+ * special treatment (selects, trimmed/filtered strings) are
+ * handled individually.
+ */
+#define WPT_NUM 0     // Text/number field
+#define WPT_CB  1     // Checkbox (text field if TC_NOCHECKBOXES)
+
+#define WP_ENT(e, m, l, t) { &e, offsetof(struct Settings, m), l, t }
+
+static const struct {
+    WiFiManagerParameter *el;
+    uint16_t             offs;
+    uint8_t              len;
+    uint8_t              type;
+} portalParms[] = {
+    WP_ENT(custom_wifiConRetries, wifiConRetries, 2, WPT_NUM),
+    WP_ENT(custom_wifiConTimeout, wifiConTimeout, 2, WPT_NUM),
+    WP_ENT(custom_wifiOffDelay,   wifiOffDelay,   2, WPT_NUM),
+    WP_ENT(custom_wifiAPOffDelay, wifiAPOffDelay, 2, WPT_NUM),
+    WP_ENT(custom_autoNMOn,       autoNMOn,       2, WPT_NUM),
+    WP_ENT(custom_autoNMOff,      autoNMOff,      2, WPT_NUM),
+    #ifdef TC_HAVELIGHT
+    WP_ENT(custom_lxLim,          luxLimit,       6, WPT_NUM),
+    #endif
+    #ifdef EXTERNAL_TIMETRAVEL_IN
+    WP_ENT(custom_ettDelay,       ettDelay,       5, WPT_NUM),
+    #endif
+    #ifdef TC_HAVETEMP
+    WP_ENT(custom_tempOffs,       tempOffs,       4, WPT_NUM),
+    #endif
+    #ifdef TC_HAVESPEEDO
+    WP_ENT(custom_speedoBright,   speedoBright,   2, WPT_NUM),
+    WP_ENT(custom_speedoFact,     speedoFact,     3, WPT_NUM),
+    #ifdef TC_HAVETEMP
+    WP_ENT(custom_tempBright,     tempBright,     2, WPT_NUM),
+    #endif
+    #endif
+
+    WP_ENT(custom_ttrp,           timesPers,      1, WPT_CB),
+    WP_ENT(custom_alarmRTC,       alarmRTC,       1, WPT_CB),
+    WP_ENT(custom_playIntro,      playIntro,      1, WPT_CB),
+    WP_ENT(custom_mode24,         mode24,         1, WPT_CB),
+    WP_ENT(custom_wifiPRe,        wifiPRetry,     1, WPT_CB),
+    WP_ENT(custom_dtNmOff,        dtNmOff,        1, WPT_CB),
+    WP_ENT(custom_ptNmOff,        ptNmOff,        1, WPT_CB),
+    WP_ENT(custom_ltNmOff,        ltNmOff,        1, WPT_CB),
+    #ifdef TC_HAVELIGHT
+    WP_ENT(custom_uLS,            useLight,       1, WPT_CB),
+    #endif
+    #ifdef TC_HAVETEMP
+    WP_ENT(custom_tempUnit,       tempUnit,       1, WPT_CB),
+    #endif
+    #ifdef TC_HAVESPEEDO
+    #ifdef TC_HAVEGPS
+    WP_ENT(custom_useGPSS,        useGPSSpeed,    1, WPT_CB),
+    #endif
+    #ifdef TC_HAVETEMP
+    WP_ENT(custom_useDpTemp,      dispTemp,       1, WPT_CB),
+    WP_ENT(custom_tempOffNM,      tempOffNM,      1, WPT_CB),
+    #endif
+    #endif
+    //#ifdef EXTERNAL_TIMETRAVEL_IN
+    //WP_ENT(custom_ettLong,        ettLong,        1, WPT_CB),
+    //#endif
+    #ifdef FAKE_POWER_ON
+    WP_ENT(custom_fakePwrOn,      fakePwrOn,      1, WPT_CB),
+    #endif
+    #ifdef EXTERNAL_TIMETRAVEL_OUT
+    WP_ENT(custom_useETTO,        useETTO,        1, WPT_CB),
+    #endif
+    WP_ENT(custom_playTTSnd,      playTTsnds,     1, WPT_CB),
+    #ifdef TC_HAVEMQTT
+    WP_ENT(custom_useMQTT,        useMQTT,        1, WPT_CB),
+    #ifdef EXTERNAL_TIMETRAVEL_OUT
+    WP_ENT(custom_pubMQTT,        pubMQTT,        1, WPT_CB),
+    #endif
+    WP_ENT(custom_mqttTelem,      mqttTelem,      1, WPT_CB),
+    #endif
+    WP_ENT(custom_shuffle,        shuffle,        1, WPT_CB),
+    WP_ENT(custom_CfgOnSD,        CfgOnSD,        1, WPT_CB),
+    //WP_ENT(custom_sdFrq,          sdFreq,         1, WPT_CB),
+};
+
+#define NUM_PORTAL_PARMS (int)(sizeof(portalParms) / sizeof(portalParms[0]))
+
+// Same version string in asset URLs and ETag
+#define WM_ASSET_VER  TC_VERSION "-" TC_VERSION_EXTRA
+#define WM_ASSET_ETAG "\"" WM_ASSET_VER "\""
+
 #define TC_MENUSIZE 7
 static const char* wifiMenu[TC_MENUSIZE] = {"wifi", "param", "sep", "restart", "update", "sep", "custom" };
 
-static const char* myHead = "<link rel='shortcut icon' type='image/png' href='data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAABAAAAAQCAMAAAAoLQ9TAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAA9QTFRFjpCRzMvH9tgx8iU9Q7YkHP8yywAAAC1JREFUeNpiYEQDDIwMKAAkwIwEiBTAMIMFCRApgGEGExIgUgDDDHQBNAAQYADhYgGBZLgAtAAAAABJRU5ErkJggg=='><script>function wlp(){return window.location.pathname;}function getn(x){return document.getElementsByTagName(x)}function ge(x){return document.getElementById(x)}function c(l){ge('s').value=l.getAttribute('data-ssid')||l.innerText||l.textContent;p=l.nextElementSibling.classList.contains('l');ge('p').disabled=!p;if(p){ge('p').placeholder='';ge('p').focus();}}window.onload=function(){xx=false;document.title='Time Circuits';if(ge('s')&&ge('dns')){xx=true;xxx=document.title;yyy='Configure WiFi';aa=ge('s').parentElement;bb=aa.innerHTML;dd=bb.search('<hr>');ee=bb.search('<button');cc='<div class=\"sects\">'+bb.substring(0,dd)+'</div><div class=\"sects\">'+bb.substring(dd+4,ee)+'</div>'+bb.substring(ee);aa.innerHTML=cc;document.querySelectorAll('a[href=\"#p\"]').forEach((userItem)=>{userItem.onclick=function(){c(this);return false;}});if(aa=ge('s')){aa.oninput=function(){if(this.placeholder.length>0&&this.value.length==0){ge('p').placeholder='********';}}}}if(ge('uploadbin')||wlp()=='/u'||wlp()=='/wifisave'){xx=true;xxx=document.title;yyy=(wlp()=='/wifisave')?'Configure WiFi':'Firmware update';aa=document.getElementsByClassName('wrap');if(aa.length>0){if((bb=ge('uploadbin'))){aa[0].style.textAlign='center';bb.parentElement.onsubmit=function(){aa=ge('uploadbin');if(aa){aa.disabled=true;aa.innerHTML='Please wait'}}}aa=getn('H3');if(aa.length>0){aa[0].remove()}aa=getn('H1');if(aa.length>0){aa[0].remove()}}}if(ge('ttrp')||wlp()=='/param'){xx=true;xxx=document.title;yyy='Setup';}if(ge('ebnew')){xx=true;bb=getn('H3');aa=getn('H1');xxx=aa[0].innerHTML;yyy=bb[0].innerHTML;ff=aa[0].parentNode;ff.style.position='relative';}if(xx){zz=(Math.random()>0.8);dd=document.createElement('div');dd.classList.add('tpm0');dd.innerHTML='<div class=\"tpm\"><div class=\"tpm2\"><img src=\"data:image/png;base64,'+(zz?'iVBORw0KGgoAAAANSUhEUgAAAEAAAABACAMAAACdt4HsAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAAZQTFRFSp1tAAAA635cugAAAAJ0Uk5T/wDltzBKAAAAbUlEQVR42tzXwRGAQAwDMdF/09QQQ24MLkDj77oeTiPA1wFGQiHATOgDGAp1AFOhDWAslAHMhS6AQKgCSIQmgEgoAsiEHoBQqAFIhRaAWCgByIVXAMuAdcA6YBlwALAKePzgd71QAByP71uAAQC+xwvdcFg7UwAAAABJRU5ErkJggg==':'iVBORw0KGgoAAAANSUhEUgAAAEAAAABACAMAAACdt4HsAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAAZQTFRFSp1tAAAA635cugAAAAJ0Uk5T/wDltzBKAAAAgElEQVR42tzXQQqDABAEwcr/P50P2BBUdMhee6j7+lw8i4BCD8MiQAjHYRAghAh7ADWMMAcQww5jADHMsAYQwwxrADHMsAYQwwxrADHMsAYQwwxrgLgOPwKeAjgrrACcFkYAzgu3AN4C3AV4D3AP4E3AHcDF+8d/YQB4/Pn+CjAAMaIIJuYVQ04AAAAASUVORK5CYII=')+'\" class=\"tpm3\"></div><H1 class=\"tpmh1\"'+(zz?' style=\"margin-left:1.2em\"':'')+'>'+xxx+'</H1>'+'<H3 class=\"tpmh3\"'+(zz?' style=\"padding-left:4.5em\"':'')+'>'+yyy+'</div></div>';}if(ge('ebnew')){bb[0].remove();aa[0].replaceWith(dd);}if((ge('s')&&ge('dns'))||ge('uploadbin')||wlp()=='/u'||wlp()=='/wifisave'||ge('ttrp')||wlp()=='/param'){aa=document.getElementsByClassName('wrap');if(aa.length>0){aa[0].insertBefore(dd,aa[0].firstChild);aa[0].style.position='relative';}}}</script><style type='text/css'>body{font-family:-apple-system,BlinkMacSystemFont,system-ui,'Segoe UI',Roboto,'Helvetica Neue',Verdana,Helvetica}H1,H2{margin-top:0px;margin-bottom:0px;text-align:center;}H3{margin-top:0px;margin-bottom:5px;text-align:center;}div.msg{border:1px solid #ccc;border-left-width:15px;border-radius:20px;background:linear-gradient(320deg,rgb(255,255,255) 0%,rgb(235,234,233) 100%);}button{transition-delay:250ms;margin-top:10px;margin-bottom:10px;color:#fff;background-color:#225a98;font-variant-caps:all-small-caps;}button.DD{color:#000;border:4px ridge #999;border-radius:2px;background:#e0c942;background-image:url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAADBQTFRF////AAAAMyks8+AAuJYi3NHJo5aQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAbP19EwAAAAh0Uk5T/////////wDeg71ZAAAA4ElEQVR42qSTyxLDIAhF7yChS/7/bwtoFLRNF2UmRr0H8IF4/TBsY6JnQFvTJ8D0ncChb0QGlDvA+hkw/yC4xED2Z2L35xwDRSdqLZpFIOU3gM2ox6mA3tnDPa8UZf02v3q6gKRH/Eyg6JZBqRUCRW++yFYIvCjNFIt9OSC4hol/ItH1FkKRQgAbi0ty9f/F7LM6FimQacPbAdG5zZVlWdfvg+oEpl0Y+jzqIJZ++6fLqlmmnq7biZ4o67lgjBhA0kvJyTww/VK0hJr/LHvBru8PR7Dpx9MT0f8e72lvAQYALlAX+Kfw0REAAAAASUVORK5CYII=');background-repeat:no-repeat;background-origin:content-box;background-size:contain;}br{display:block;font-size:1px;content:''}input[type='checkbox']{display:inline-block;margin-top:10px}input{border:thin inset}small{display:none}em > small{display:inline}form{margin-block-end:0;}.tpm{border:1px solid black;border-radius:5px;padding:0 0 0 0px;min-width:18em;}.tpm2{position:absolute;top:-0.7em;z-index:130;left:0.7em;}.tpm3{width:4em;height:4em;}.tpmh1{font-variant-caps:all-small-caps;margin-left:2em;}.tpmh3{background:#000;font-size:0.6em;color:#ffa;padding-left:7em;margin-left:0.5em;margin-right:0.5em;border-radius:5px}.sects{background-color:#eee;border-radius:7px;margin-bottom:20px;padding-bottom:7px;padding-top:7px}.tpm0{position:relative;width:300px;margin:0 auto 0 auto;}.headl{margin:0 0 3px 0;padding:0}.cmp0{margin:0;padding:0;}.sel0{font-size:90%;width:auto;margin-left:10px;vertical-align:baseline;}</style>";
+static const char* myHead = "<link rel='shortcut icon' type='image/png' href='data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAABAAAAAQCAMAAAAoLQ9TAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAA9QTFRFjpCRzMvH9tgx8iU9Q7YkHP8yywAAAC1JREFUeNpiYEQDDIwMKAAkwIwEiBTAMIMFCRApgGEGExIgUgDDDHQBNAAQYADhYgGBZLgAtAAAAABJRU5ErkJggg=='><link rel='stylesheet' href='/tcd.css?v=" WM_ASSET_VER "'><script src='/tcd.js?v=" WM_ASSET_VER "'></script>";
+
+// Static portal assets; served by wmAssetHandler() so that browsers can cache them
+static const char myJS[] PROGMEM = "function wlp(){return window.location.pathname;}function getn(x){return document.getElementsByTagName(x)}function ge(x){return document.getElementById(x)}function c(l){ge('s').value=l.getAttribute('data-ssid')||l.innerText||l.textContent;p=l.nextElementSibling.classList.contains('l');ge('p').disabled=!p;if(p){ge('p').placeholder='';ge('p').focus();}}window.onload=function(){xx=false;document.title='Time Circuits';if(ge('s')&&ge('dns')){xx=true;xxx=document.title;yyy='Configure WiFi';aa=ge('s').parentElement;bb=aa.innerHTML;dd=bb.search('<hr>');ee=bb.search('<button');cc='<div class=\"sects\">'+bb.substring(0,dd)+'</div><div class=\"sects\">'+bb.substring(dd+4,ee)+'</div>'+bb.substring(ee);aa.innerHTML=cc;document.querySelectorAll('a[href=\"#p\"]').forEach((userItem)=>{userItem.onclick=function(){c(this);return false;}});if(aa=ge('s')){aa.oninput=function(){if(this.placeholder.length>0&&this.value.length==0){ge('p').placeholder='********';}}}}if(ge('uploadbin')||wlp()=='/u'||wlp()=='/wifisave'){xx=true;xxx=document.title;yyy=(wlp()=='/wifisave')?'Configure WiFi':'Firmware update';aa=document.getElementsByClassName('wrap');if(aa.length>0){if((bb=ge('uploadbin'))){aa[0].style.textAlign='center';bb.parentElement.onsubmit=function(){aa=ge('uploadbin');if(aa){aa.disabled=true;aa.innerHTML='Please wait'}}}aa=getn('H3');if(aa.length>0){aa[0].remove()}aa=getn('H1');if(aa.length>0){aa[0].remove()}}}if(ge('ttrp')||wlp()=='/param'){xx=true;xxx=document.title;yyy='Setup';}if(ge('ebnew')){xx=true;bb=getn('H3');aa=getn('H1');xxx=aa[0].innerHTML;yyy=bb[0].innerHTML;ff=aa[0].parentNode;ff.style.position='relative';}if(xx){zz=(Math.random()>0.8);dd=document.createElement('div');dd.classList.add('tpm0');dd.innerHTML='<div class=\"tpm\"><div class=\"tpm2\"><img src=\"data:image/png;base64,'+(zz?'iVBORw0KGgoAAAANSUhEUgAAAEAAAABACAMAAACdt4HsAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAAZQTFRFSp1tAAAA635cugAAAAJ0Uk5T/wDltzBKAAAAbUlEQVR42tzXwRGAQAwDMdF/09QQQ24MLkDj77oeTiPA1wFGQiHATOgDGAp1AFOhDWAslAHMhS6AQKgCSIQmgEgoAsiEHoBQqAFIhRaAWCgByIVXAMuAdcA6YBlwALAKePzgd71QAByP71uAAQC+xwvdcFg7UwAAAABJRU5ErkJggg==':'iVBORw0KGgoAAAANSUhEUgAAAEAAAABACAMAAACdt4HsAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAAAZQTFRFSp1tAAAA635cugAAAAJ0Uk5T/wDltzBKAAAAgElEQVR42tzXQQqDABAEwcr/P50P2BBUdMhee6j7+lw8i4BCD8MiQAjHYRAghAh7ADWMMAcQww5jADHMsAYQwwxrADHMsAYQwwxrADHMsAYQwwxrgLgOPwKeAjgrrACcFkYAzgu3AN4C3AV4D3AP4E3AHcDF+8d/YQB4/Pn+CjAAMaIIJuYVQ04AAAAASUVORK5CYII=')+'\" class=\"tpm3\"></div><H1 class=\"tpmh1\"'+(zz?' style=\"margin-left:1.2em\"':'')+'>'+xxx+'</H1>'+'<H3 class=\"tpmh3\"'+(zz?' style=\"padding-left:4.5em\"':'')+'>'+yyy+'</div></div>';}if(ge('ebnew')){bb[0].remove();aa[0].replaceWith(dd);}if((ge('s')&&ge('dns'))||ge('uploadbin')||wlp()=='/u'||wlp()=='/wifisave'||ge('ttrp')||wlp()=='/param'){aa=document.getElementsByClassName('wrap');if(aa.length>0){aa[0].insertBefore(dd,aa[0].firstChild);aa[0].style.position='relative';}}}";
+
+static const char myCSS[] PROGMEM = "body{font-family:-apple-system,BlinkMacSystemFont,system-ui,'Segoe UI',Roboto,'Helvetica Neue',Verdana,Helvetica}H1,H2{margin-top:0px;margin-bottom:0px;text-align:center;}H3{margin-top:0px;margin-bottom:5px;text-align:center;}div.msg{border:1px solid #ccc;border-left-width:15px;border-radius:20px;background:linear-gradient(320deg,rgb(255,255,255) 0%,rgb(235,234,233) 100%);}button{transition-delay:250ms;margin-top:10px;margin-bottom:10px;color:#fff;background-color:#225a98;font-variant-caps:all-small-caps;}button.DD{color:#000;border:4px ridge #999;border-radius:2px;background:#e0c942;background-image:url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAAADBQTFRF////AAAAMyks8+AAuJYi3NHJo5aQAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAbP19EwAAAAh0Uk5T/////////wDeg71ZAAAA4ElEQVR42qSTyxLDIAhF7yChS/7/bwtoFLRNF2UmRr0H8IF4/TBsY6JnQFvTJ8D0ncChb0QGlDvA+hkw/yC4xED2Z2L35xwDRSdqLZpFIOU3gM2ox6mA3tnDPa8UZf02v3q6gKRH/Eyg6JZBqRUCRW++yFYIvCjNFIt9OSC4hol/ItH1FkKRQgAbi0ty9f/F7LM6FimQacPbAdG5zZVlWdfvg+oEpl0Y+jzqIJZ++6fLqlmmnq7biZ4o67lgjBhA0kvJyTww/VK0hJr/LHvBru8PR7Dpx9MT0f8e72lvAQYALlAX+Kfw0REAAAAASUVORK5CYII=');background-repeat:no-repeat;background-origin:content-box;background-size:contain;}br{display:block;font-size:1px;content:''}input[type='checkbox']{display:inline-block;margin-top:10px}input{border:thin inset}small{display:none}em > small{display:inline}form{margin-block-end:0;}.tpm{border:1px solid black;border-radius:5px;padding:0 0 0 0px;min-width:18em;}.tpm2{position:absolute;top:-0.7em;z-index:130;left:0.7em;}.tpm3{width:4em;height:4em;}.tpmh1{font-variant-caps:all-small-caps;margin-left:2em;}.tpmh3{background:#000;font-size:0.6em;color:#ffa;padding-left:7em;margin-left:0.5em;margin-right:0.5em;border-radius:5px}.sects{background-color:#eee;border-radius:7px;margin-bottom:20px;padding-bottom:7px;padding-top:7px}.tpm0{position:relative;width:300px;margin:0 auto 0 auto;}.headl{margin:0 0 3px 0;padding:0}.cmp0{margin:0;padding:0;}.sel0{font-size:90%;width:auto;margin-left:10px;vertical-align:baseline;}.tcdlogo{display:block;margin:10px auto 10px auto;width:287px;height:50px;background-image:url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAAR8AAAAyCAYAAABlEt8RAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAADQ9JREFUeNrsXTFzG7sRhjTuReYPiGF+gJhhetEzTG2moFsrjVw+vYrufOqoKnyl1Zhq7SJ0Lc342EsT6gdIof+AefwFCuksnlerBbAA7ygeH3bmRvTxgF3sLnY/LMDzjlKqsbgGiqcJXEPD97a22eJKoW2mVqMB8HJRK7D/1DKG5fhH8NdHrim0Gzl4VxbXyeLqLK4DuDcGvXF6P4KLG3OF8JtA36a2J/AMvc/xTh3f22Q00QnSa0r03hGOO/Wws5Y7RD6brbWPpJ66SNHl41sTaDMSzMkTxndriysBHe/BvVs0XyeCuaEsfqblODHwGMD8+GHEB8c1AcfmJrurbSYMHK7g8CC4QknS9zBQrtSgO22gzJNnQp5pWOyROtqa7k8cOkoc+kyEOm1ZbNAQyv7gcSUryJcG+kiyZt9qWcagIBhkjn5PPPWbMgHX1eZoVzg5DzwzDKY9aFtT5aY3gknH0aEF/QxRVpDyTBnkxH3WvGmw0zR32Pu57XVUUh8ZrNm3hh7PVwQ+p1F7KNWEOpjuenR6wEArnwCUqPJT6IQ4ZDLQEVpm2eg9CQQZY2wuuJicD0NlG3WeWdedkvrILxak61rihbR75bGyOBIEHt+lLDcOEY8XzM0xYt4i2fPEEdV+RUu0I1BMEc70skDnuUVBtgWTX9M+GHrikEuvqffJ+FOiS6r3AYLqB6TtwBA0ahbko8eQMs9OBY46KNhetgDo0rWp76/o8wVBBlOH30rloz5CJ1zHgkg0rw4EKpygTe0wP11Lob41EdiBzsEvyMZ6HFNlrtFeGOTLLAnwC/hzBfGYmNaICWMAaY2h5WgbCuXTnGo7kppPyhT+pHUAGhRM/dYcNRbX95mhXpB61FUSQV2illPNJ7TulgT0KZEzcfitywdTZlJL5W5Z2g2E/BoW32p5+GuN8bvOCrU+zo4VhscPmSTLrgGTSaU0smTpslAoBLUhixZT+6Ftb8mS15SRJciH031IpoxLLxmCqwXOj0YgvxCaMz46Ve7dWd9VRMbwSKXBZxKooEhmkgSC1BKwpoaAc+DB0wStv+VQ48qLNqHwHZJoKiWQea+guTyX2i8k+Pg4Q8UDDWwqdQrIOjWBXjKhsx8wur5gkkVFiOj2Eep6rsn/pWTop1aAjxRBGYO48w5AEymPF2ucuPMcg08ivBfqSAnK/LiwN1byA5Mt4VLJFHxsQX/CBPmGAxn5OFmKglpL+W3nSu01tPjDlKCvQcF+emRYCk8DbS1tV8lhXvmUBpbPvSKJ6z+L6xR0nAnGmTBjHRIeeJPqEPFIQoLPNzIJXUasgIL2LevbVeh9gcFn39D/rSALJyhQvHGs732zVM3yXYM48hTZjAs6YwfvpTP9ghx9WIC9UsskzUDfB2tCX2885cMJqqWenqdKcw4itZx8a6D4Ix7v4f6Jo69DZqxj4h8DJmljHr/vzEmDzxR1VvE0okY9iSovzUFxWcAk08uINEd5uL4o8tE222Oys2scExS8Xj1TDWPp0P/a0KXXvsXWpw7k00D2OBEu12z8LjyXeXry7zE8hiDXKstG/dOY1MAjBR2IDxlWPByXQ02tktZ7NOlT2kcBbS9UMYXbOYHD9ADhxBCYpDWJ0TPXXUYEUZeBTgVJdhlQv0Iw2SPzxBcd/xagmyn4wxeDnw9z0MMEeIwNPEY+yOdgBUFSlX8BrshDhmOydEwQgvjogOOmDJ7lIFfGGPjQEGAy8nyFPDsVyo2XXmMGcq9ir4lgkuClV5FFXO6QYQi/VSZuyK8HQksZU7BpC2TeJ3O9Y+ibO2SYWXi00LJ9j/Bo7BZgxJck4r0pALanzJU3ZernL6CVMAsvx/4Pj+eVZSnbckyGzIB8bpnnG4xjSLKX3nZfdenF2SvznMxFHvGYeMp3C7b+1VHDkSLYfzoCye0KvuWyS0M9PlNm0/WU0ZMrSC/HVWN4tHYDJkYmMOIwB6NsCqVCw+hnR0TRXPD16dOmaw6dZobgFJLVRzmh3zx0f7BBPqFfFzMgy19JMLiA5dkpBJOaADFlBt/q5DSWZA36ojuWFUnwCXHc0RYFHwlKccHvjiOA15g+XHWaqUGmlJm4Pgkkr2VEXojk24b7Aw3QDYFOE7hGAUvyEamf5DG3pmvQ0xMekuATcqYgI0svCtv1j8z0Vct5oDXSf2XFvlZdi7t02GECHA763xR/TN2FCnRWxrWacckm/0htNo1yXgoVmdgrhrmQp8xiHruOThL1ePt87lFfsRllmR2+oitvgx2R/kPrBR0GLkrGPyXwmAbfCYHrr9TPX/5qGL7n4DkRLFUmWzD5hyUIPvM1onyaEDqe82IKfyvoXidHJITfjqksPFIu+Cy3AJe/Rp2pp2cLRis4bZ4BRvLmuVA6RP39Wz0+EepjGNfSa8jofanz/zI8BwZ0GQKnU099pAXaKwmYbEXQ1xXkozraV8X//jF06dVSP3dtZzDGj+rpgUDTPH+v3G8RbUF/H9F3H0kynZuCj7JAeJ/tQJr9y/IjQZcORoGTljpIouxvE9T0xYJgxg6+08CgZcvscen1/EuvYSA/SXL+Ta12NERyHGMgrfnoSdcKEMqV/ctGRx46oBmbLr0ygdPcOp7JDDUeW/CZlHDyl2HptU4/d/kWRw3lfsPgrVpt50sS3PTLxZzBZynMhZK9UW4TjFIEjUEHfw6YhK7xL7//q3p62nQOPF0B33Uwbipcim168Nn0Xa+M2HDdSy/J3Frq8CX41Zzxt9NAgEFRt4nHN+CxTTvfW0WNLViaRioH1VQxO81iHjsPDw/RDJEiRVo77UYVRIoUKQafSJEixeATKVKkSDH4RIoUKQafSJEiRYrBJ1KkSDH4RIoUKVIMPpEiRYrBJ1KkSJFi8IkUKVIMPpEiRYrBJ1KkSJFi8IkUKdIfg15s02B2dnaWf+qLq7u4qur/r4r8vLjuDU168PfM0fUx9Ef7ou17TNurxXUTMJwq4jtDY5kxz2hafncOn9uLqwm8r9C/OaLynxM+PdS3lomjG9BPFz2v7SF9ntO7MsjlIuoL96BDZRmHloPTF7YB1v2ZxV/qxA5UNqyLK6FsmE8d6eSHf5bmTRVLQbflAkNw75ftGgIPff+siS7huTZVH2lver/tB0+zLMfxnennGj3TNDxzR8bXY8Zrev/uA2mD718SXXBXD3SEn297Pq+D6jXz/HdLAKXUNfDsO8Zx6dAXluEO7tUJb32/ythBBw2bn7hkUwb9/OBZlvm6VcgHMpvOIFdg5C78/Uycu4cyWN70jvA5hux4L2yPM+c5fG6TrP8J7t+gsXUFKOuKZGCO+hbE+Bm178Mz5yh722xzziAfE/8mjPcMBdumB4rsIVvcIKRB25+Tcc4s+uqCDEv7vAVd9OA+lrMObWaGxPIB6fIGySuVrYt0cQb320hnEfk8A/JRTDDR2UqRiXuNslLeyEfSNoRfFTm4Rjl0vE0H8unZ3AGhqU8G5KMc903I59LAk/tey9A0jE3k2gbbVoV24fRFZe0yunLpvce00XLVV5Dt97FF5PN8NCNZhmbYNjjN3zwDgq/zr0I3INsnyGy6bjRDYzDVQFzIoE7GfU+yq67DHMNzVzmNqUr4zgyytuFZrlZ246nDJiSZc+jvntFXk2knRQ+fiT1wf1eWYKsYFDjzkO0eIcQqQmezUs3ULUQ+FOE8oMJgFdBCn2QQKRLxqZn0AF7TWo10ot4x6/2qB4qR1nx6DPLRNafrHJGPqX7hi5Sk1GZqYn2BTdtEX5fInndMDfETQWnfUd2Ns4MECbtkw3xxra8Zkc9mkF6Ln6MsI93dMhFdg/ctNQucHd8GoLe/QNBswjjaEMxer6gXWvO5YQLfPeiorx7vpq2KSG8CUUzoOKkOe6SOxNn0nglibTSG16R+eIPsU0W1ujzIJttrJFsXEsYyaP0pIp/nRT7HaF1dJZn6Dox0iTKZK8v61nzaJHOuSnXC61i5d9FCaz4PBH3drbnmU1ePd+3yomPF79q56iof4Jk7w/N1gpAoMqJ6/0DQuI+/2ZCy3v1ql2W+buMhw2Mw8Dlkh5mh5tFGNaF2zjJcQXbVtZtj4ow99XR7FlPXINOM1BOOSd/tnJHKmUPOIkjXoOokuNYdgZMLHnVHTVAqz1Lf71Dw4OTFCOnKUYvS6LhJ5JXWFKku8K5t3O16RuTjqstw2U1a8/Hd7WozWfxBkNWuCUr7ztQs+urx2ZPvSnbOByM/fTUN8uOxr3O3q8vUM/RnSTCsqsdno3ANpUvGdc3ow4QULw2opa/4szimfq4NY/sglK2P7I4R/HWs+USi9RW9DJPWms5RraKO6lS4/TvIcj2U9e4FPOrMBLaddTorABm66DOg1j6SVyMxaWZ/h3SIkRytx/jsYGpd6HNQM6Z+Jdkd/Duqp9VRO6lsV+rnuSWMtt6WaXJs1X8aCD+v2DaqK/nhxEh/PB0+GVtZ5vT/BBgARwZUDnOS4TkAAAAASUVORK5CYII=');}";
 
-static const char* myCustMenu = "<form action='/erase' method='get' onsubmit='return confirm(\"This erases the WiFi config and reboots. The clock will restart in access point mode. Are you sure?\");'><button id='ebnew' class='DD'>Erase WiFi Config</button></form><br/><img style='display:block;margin:10px auto 10px auto;' src='data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAAR8AAAAyCAYAAABlEt8RAAAAGXRFWHRTb2Z0d2FyZQBBZG9iZSBJbWFnZVJlYWR5ccllPAAADQ9JREFUeNrsXTFzG7sRhjTuReYPiGF+gJhhetEzTG2moFsrjVw+vYrufOqoKnyl1Zhq7SJ0Lc342EsT6gdIof+AefwFCuksnlerBbAA7ygeH3bmRvTxgF3sLnY/LMDzjlKqsbgGiqcJXEPD97a22eJKoW2mVqMB8HJRK7D/1DKG5fhH8NdHrim0Gzl4VxbXyeLqLK4DuDcGvXF6P4KLG3OF8JtA36a2J/AMvc/xTh3f22Q00QnSa0r03hGOO/Wws5Y7RD6brbWPpJ66SNHl41sTaDMSzMkTxndriysBHe/BvVs0XyeCuaEsfqblODHwGMD8+GHEB8c1AcfmJrurbSYMHK7g8CC4QknS9zBQrtSgO22gzJNnQp5pWOyROtqa7k8cOkoc+kyEOm1ZbNAQyv7gcSUryJcG+kiyZt9qWcagIBhkjn5PPPWbMgHX1eZoVzg5DzwzDKY9aFtT5aY3gknH0aEF/QxRVpDyTBnkxH3WvGmw0zR32Pu57XVUUh8ZrNm3hh7PVwQ+p1F7KNWEOpjuenR6wEArnwCUqPJT6IQ4ZDLQEVpm2eg9CQQZY2wuuJicD0NlG3WeWdedkvrILxak61rihbR75bGyOBIEHt+lLDcOEY8XzM0xYt4i2fPEEdV+RUu0I1BMEc70skDnuUVBtgWTX9M+GHrikEuvqffJ+FOiS6r3AYLqB6TtwBA0ahbko8eQMs9OBY46KNhetgDo0rWp76/o8wVBBlOH30rloz5CJ1zHgkg0rw4EKpygTe0wP11Lob41EdiBzsEvyMZ6HFNlrtFeGOTLLAnwC/hzBfGYmNaICWMAaY2h5WgbCuXTnGo7kppPyhT+pHUAGhRM/dYcNRbX95mhXpB61FUSQV2illPNJ7TulgT0KZEzcfitywdTZlJL5W5Z2g2E/BoW32p5+GuN8bvOCrU+zo4VhscPmSTLrgGTSaU0smTpslAoBLUhixZT+6Ftb8mS15SRJciH031IpoxLLxmCqwXOj0YgvxCaMz46Ve7dWd9VRMbwSKXBZxKooEhmkgSC1BKwpoaAc+DB0wStv+VQ48qLNqHwHZJoKiWQea+guTyX2i8k+Pg4Q8UDDWwqdQrIOjWBXjKhsx8wur5gkkVFiOj2Eep6rsn/pWTop1aAjxRBGYO48w5AEymPF2ucuPMcg08ivBfqSAnK/LiwN1byA5Mt4VLJFHxsQX/CBPmGAxn5OFmKglpL+W3nSu01tPjDlKCvQcF+emRYCk8DbS1tV8lhXvmUBpbPvSKJ6z+L6xR0nAnGmTBjHRIeeJPqEPFIQoLPNzIJXUasgIL2LevbVeh9gcFn39D/rSALJyhQvHGs732zVM3yXYM48hTZjAs6YwfvpTP9ghx9WIC9UsskzUDfB2tCX2885cMJqqWenqdKcw4itZx8a6D4Ix7v4f6Jo69DZqxj4h8DJmljHr/vzEmDzxR1VvE0okY9iSovzUFxWcAk08uINEd5uL4o8tE222Oys2scExS8Xj1TDWPp0P/a0KXXvsXWpw7k00D2OBEu12z8LjyXeXry7zE8hiDXKstG/dOY1MAjBR2IDxlWPByXQ02tktZ7NOlT2kcBbS9UMYXbOYHD9ADhxBCYpDWJ0TPXXUYEUZeBTgVJdhlQv0Iw2SPzxBcd/xagmyn4wxeDnw9z0MMEeIwNPEY+yOdgBUFSlX8BrshDhmOydEwQgvjogOOmDJ7lIFfGGPjQEGAy8nyFPDsVyo2XXmMGcq9ir4lgkuClV5FFXO6QYQi/VSZuyK8HQksZU7BpC2TeJ3O9Y+ibO2SYWXi00LJ9j/Bo7BZgxJck4r0pALanzJU3ZernL6CVMAsvx/4Pj+eVZSnbckyGzIB8bpnnG4xjSLKX3nZfdenF2SvznMxFHvGYeMp3C7b+1VHDkSLYfzoCye0KvuWyS0M9PlNm0/WU0ZMrSC/HVWN4tHYDJkYmMOIwB6NsCqVCw+hnR0TRXPD16dOmaw6dZobgFJLVRzmh3zx0f7BBPqFfFzMgy19JMLiA5dkpBJOaADFlBt/q5DSWZA36ojuWFUnwCXHc0RYFHwlKccHvjiOA15g+XHWaqUGmlJm4Pgkkr2VEXojk24b7Aw3QDYFOE7hGAUvyEamf5DG3pmvQ0xMekuATcqYgI0svCtv1j8z0Vct5oDXSf2XFvlZdi7t02GECHA763xR/TN2FCnRWxrWacckm/0htNo1yXgoVmdgrhrmQp8xiHruOThL1ePt87lFfsRllmR2+oitvgx2R/kPrBR0GLkrGPyXwmAbfCYHrr9TPX/5qGL7n4DkRLFUmWzD5hyUIPvM1onyaEDqe82IKfyvoXidHJITfjqksPFIu+Cy3AJe/Rp2pp2cLRis4bZ4BRvLmuVA6RP39Wz0+EepjGNfSa8jofanz/zI8BwZ0GQKnU099pAXaKwmYbEXQ1xXkozraV8X//jF06dVSP3dtZzDGj+rpgUDTPH+v3G8RbUF/H9F3H0kynZuCj7JAeJ/tQJr9y/IjQZcORoGTljpIouxvE9T0xYJgxg6+08CgZcvscen1/EuvYSA/SXL+Ta12NERyHGMgrfnoSdcKEMqV/ctGRx46oBmbLr0ygdPcOp7JDDUeW/CZlHDyl2HptU4/d/kWRw3lfsPgrVpt50sS3PTLxZzBZynMhZK9UW4TjFIEjUEHfw6YhK7xL7//q3p62nQOPF0B33Uwbipcim168Nn0Xa+M2HDdSy/J3Frq8CX41Zzxt9NAgEFRt4nHN+CxTTvfW0WNLViaRioH1VQxO81iHjsPDw/RDJEiRVo77UYVRIoUKQafSJEixeATKVKkSDH4RIoUKQafSJEiRYrBJ1KkSDH4RIoUKVIMPpEiRYrBJ1KkSJFi8IkUKVIMPpEiRYrBJ1KkSJFi8IkUKdIfg15s02B2dnaWf+qLq7u4qur/r4r8vLjuDU168PfM0fUx9Ef7ou17TNurxXUTMJwq4jtDY5kxz2hafncOn9uLqwm8r9C/OaLynxM+PdS3lomjG9BPFz2v7SF9ntO7MsjlIuoL96BDZRmHloPTF7YB1v2ZxV/qxA5UNqyLK6FsmE8d6eSHf5bmTRVLQbflAkNw75ftGgIPff+siS7huTZVH2lver/tB0+zLMfxnennGj3TNDxzR8bXY8Zrev/uA2mD718SXXBXD3SEn297Pq+D6jXz/HdLAKXUNfDsO8Zx6dAXluEO7tUJb32/ythBBw2bn7hkUwb9/OBZlvm6VcgHMpvOIFdg5C78/Uycu4cyWN70jvA5hux4L2yPM+c5fG6TrP8J7t+gsXUFKOuKZGCO+hbE+Bm178Mz5yh722xzziAfE/8mjPcMBdumB4rsIVvcIKRB25+Tcc4s+uqCDEv7vAVd9OA+lrMObWaGxPIB6fIGySuVrYt0cQb320hnEfk8A/JRTDDR2UqRiXuNslLeyEfSNoRfFTm4Rjl0vE0H8unZ3AGhqU8G5KMc903I59LAk/tey9A0jE3k2gbbVoV24fRFZe0yunLpvce00XLVV5Dt97FF5PN8NCNZhmbYNjjN3zwDgq/zr0I3INsnyGy6bjRDYzDVQFzIoE7GfU+yq67DHMNzVzmNqUr4zgyytuFZrlZ246nDJiSZc+jvntFXk2knRQ+fiT1wf1eWYKsYFDjzkO0eIcQqQmezUs3ULUQ+FOE8oMJgFdBCn2QQKRLxqZn0AF7TWo10ot4x6/2qB4qR1nx6DPLRNafrHJGPqX7hi5Sk1GZqYn2BTdtEX5fInndMDfETQWnfUd2Ns4MECbtkw3xxra8Zkc9mkF6Ln6MsI93dMhFdg/ctNQucHd8GoLe/QNBswjjaEMxer6gXWvO5YQLfPeiorx7vpq2KSG8CUUzoOKkOe6SOxNn0nglibTSG16R+eIPsU0W1ujzIJttrJFsXEsYyaP0pIp/nRT7HaF1dJZn6Dox0iTKZK8v61nzaJHOuSnXC61i5d9FCaz4PBH3drbnmU1ePd+3yomPF79q56iof4Jk7w/N1gpAoMqJ6/0DQuI+/2ZCy3v1ql2W+buMhw2Mw8Dlkh5mh5tFGNaF2zjJcQXbVtZtj4ow99XR7FlPXINOM1BOOSd/tnJHKmUPOIkjXoOokuNYdgZMLHnVHTVAqz1Lf71Dw4OTFCOnKUYvS6LhJ5JXWFKku8K5t3O16RuTjqstw2U1a8/Hd7WozWfxBkNWuCUr7ztQs+urx2ZPvSnbOByM/fTUN8uOxr3O3q8vUM/RnSTCsqsdno3ANpUvGdc3ow4QULw2opa/4szimfq4NY/sglK2P7I4R/HWs+USi9RW9DJPWms5RraKO6lS4/TvIcj2U9e4FPOrMBLaddTorABm66DOg1j6SVyMxaWZ/h3SIkRytx/jsYGpd6HNQM6Z+Jdkd/Duqp9VRO6lsV+rnuSWMtt6WaXJs1X8aCD+v2DaqK/nhxEh/PB0+GVtZ5vT/BBgARwZUDnOS4TkAAAAASUVORK5CYII='><div style='font-size:9px;margin-left:auto;margin-right:auto;text-align:center;'>Version " TC_VERSION " (" TC_VERSION_EXTRA ")<br>Powered by <a href='https://github.com/realA10001986/Time-Circuits-Display' target=_blank>A10001986</a></div>";
+static const char* myCustMenu = "<form action='/erase' method='get' onsubmit='return confirm(\"This erases the WiFi config and reboots. The clock will restart in access point mode. Are you sure?\");'><button id='ebnew' class='DD'>Erase WiFi Config</button></form><br/><div class='tcdlogo'></div><div style='font-size:9px;margin-left:auto;margin-right:auto;text-align:center;'>Version " TC_VERSION " (" TC_VERSION_EXTRA ")<br>Powered by <a href='https://github.com/realA10001986/Time-Circuits-Display' target=_blank>A10001986</a></div>";
 
 static int  shouldSaveConfig = 0;
 static bool shouldSaveIPConfig = false;
@@ -326,8 +429,9 @@ unsigned long wifiOffDelay     = 0;   // default: never
 unsigned long origWiFiOffDelay = 0;
 
 #ifdef TC_HAVEMQTT
-#define       MQTT_SHORT_INT  (30*1000)
-#define       MQTT_LONG_INT   (5*60*1000)
+#define       MQTT_BACKOFF_MIN  (2*1000)
+#define       MQTT_BACKOFF_MAX  (5*60*1000)
+#define       MQTT_STABLE_INT   (60*1000)
 bool          useMQTT = false;
 char          mqttUser[64] = { 0 };
 char          mqttPass[64] = { 0 };
@@ -337,23 +441,45 @@ bool          haveMQTTaudio = false;
 const char    *mqttAudioFile = "/ha-alert.mp3";
 bool          pubMQTT = false;
 static unsigned long mqttReconnectNow = 0;
-static unsigned long mqttReconnectInt = MQTT_SHORT_INT;
+static unsigned long mqttReconnectInt = 0;
 static uint16_t      mqttReconnFails = 0;
 static bool          mqttSubAttempted = false;
-static bool          mqttOldState = true;
-static bool          mqttDoPing = true;
-static bool          mqttRestartPing = false;
-static bool          mqttPingDone = false;
-static unsigned long mqttPingNow = 0;
-static unsigned long mqttPingInt = MQTT_SHORT_INT;
-static uint16_t      mqttPingsExpired = 0;
+static bool          mqttOldState = false;
+static bool          mqttConnPending = false;
+static bool          mqttHadSession = false;
+static unsigned long mqttConnNow = 0;
+static unsigned long mqttLostNow = 0;
+static unsigned long mqttTTRLast = 0;
+static unsigned long mqttTTRMax = 0;
+#define       MQTT_LONG_LEN   1024
+#define       MQTT_STATE_INT  1000
+#define       MQTT_NUM_STATES 6
+static unsigned long mqttStateNow = 0;
+static char          mqttStateCache[MQTT_NUM_STATES][24];
+#define       MQTT_TELEM_INT  (60*1000)
+static bool          mqttTelem = false;
+static bool          mqttDiscDone = false;
+static unsigned long mqttTelemNow = 0;
+static uint16_t      mqttConnects = 0;
+static unsigned long mqttCfgRebootNow = 0;
+static uint16_t      wifiConnects = 0;
+static bool          wifiWasUp = false;
+static uint32_t      loopTimeMax = 0;
+static uint32_t      loopTimeSum = 0;
+static uint32_t      loopCount = 0;
 #endif
 
 static void wifiOff(bool force);
+static void rebootForSettings();
 static void wifiConnect(bool deferConfigPortal = false);
 static void saveParamsCallback();
 static void saveConfigCallback();
 static void preUpdateCallback();
+static void wmServerCallback();
+static void wmAssetHandler(const char *type, const char *data);
+static void wmParamPage();
+static void apiRegister();
+static void setDestinationTime(int year, int month, int day, int hour, int minute);
 static void preSaveConfigCallback();
 static void waitConnectCallback();
 
@@ -374,11 +500,18 @@ static void setCBVal(WiFiManagerParameter *el, char *sv);
 
 #ifdef TC_HAVEMQTT
 static void strcpyutf8(char *dst, const char *src, unsigned int len);
-static void mqttPing();
-static bool mqttReconnect(bool force = false);
-static void mqttLooper();
+static void mqttReconnect(bool force = false);
+static void mqttBackoff();
 static void mqttCallback(char *topic, byte *payload, unsigned int length);
+static void mqttStreamCallback(char *topic, byte *chunk, unsigned int length, uint32_t offset, uint32_t total);
+static void mqttConfig(char *payload, unsigned int length);
 static void mqttSubscribe();
+static void mqttPublishState();
+static void mqttPublishTelemetry();
+static void mqttPublishDiscovery();
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+static void mqttPublishSensHist();
+#endif
 #endif
 
 
@@ -404,6 +537,7 @@ void wifi_setup()
     wm.setSaveConfigCallback(saveConfigCallback);
     wm.setSaveParamsCallback(saveParamsCallback);
     wm.setPreOtaUpdateCallback(preUpdateCallback);
+    wm.setWebServerCallback(wmServerCallback);
     wm.setHostname(settings.hostName);
     wm.setCaptivePortalEnable(false);
     
@@ -519,6 +653,7 @@ void wifi_setup()
     #ifdef EXTERNAL_TIMETRAVEL_OUT
     wm.addParameter(&custom_pubMQTT);
     #endif
+    wm.addParameter(&custom_mqttTelem);
     #endif
     
     wm.addParameter(&custom_sectstart_mp);  // 2
@@ -579,6 +714,7 @@ void wifi_setup()
     #ifdef EXTERNAL_TIMETRAVEL_OUT
     pubMQTT = ((int)atoi(settings.pubMQTT) > 0);
     #endif
+    mqttTelem = ((int)atoi(settings.mqttTelem) > 0);
     
     if((!settings.mqttServer[0]) || // No server -> no MQTT
        (wifiInAPMode))              // WiFi in AP mode -> no MQTT
@@ -612,14 +748,12 @@ void wifi_setup()
                 mqttClient.setServer(remote_addr, mqttPort);
             } else {
                 mqttClient.setServer(mqttServer, mqttPort);
-                // Disable PING if we can't resolve domain
-                mqttDoPing = false;
                 Serial.printf("MQTT: Failed to resolve '%s'\n", mqttServer);
             }
         }
         
         mqttClient.setCallback(mqttCallback);
-        mqttClient.setLooper(mqttLooper);
+        mqttClient.setStreamCallback(mqttStreamCallback);
 
         if(settings.mqttUser[0] != 0) {
             if((t = strchr(settings.mqttUser, ':'))) {
@@ -664,33 +798,78 @@ void wifi_loop()
 
 #ifdef TC_HAVEMQTT
     if(useMQTT) {
-        if(mqttClient.state() != MQTT_CONNECTING) {
+        int mqttState = mqttClient.state();
+        if(mqttState != MQTT_CONNECTING && mqttState != MQTT_TCP_CONNECTING) {
             if(!mqttClient.connected()) {
-                if(mqttOldState || mqttRestartPing) {
+                if(mqttOldState) {
                     // Disconnection first detected:
-                    mqttPingDone = mqttDoPing ? false : true;
-                    mqttPingNow = mqttRestartPing ? millis() : 0;
+                    // Reconnect after a short (jittered) delay; if
+                    // the connection was short-lived, keep backing off
                     mqttOldState = false;
-                    mqttRestartPing = false;
-                    mqttSubAttempted = false;
-                }
-                if(mqttDoPing && !mqttPingDone) {
-                    audio_loop();
-                    mqttPing();
-                    audio_loop();
-                }
-                if(mqttPingDone) {
-                    audio_loop();
-                    mqttReconnect();
-                    audio_loop();
+                    mqttDiscDone = false;
+                    mqttLostNow = millis();
+                    if(millis() - mqttConnNow >= MQTT_STABLE_INT) {
+                        mqttReconnFails = 0;
+                    }
+                    mqttBackoff();
+                } else if(mqttConnPending) {
+                    // Connection attempt failed
+                    mqttConnPending = false;
+                    mqttBackoff();
                 }
+                audio_loop();
+                mqttReconnect();
+                audio_loop();
             } else {
+                if(!mqttOldState) {
+                    // Connection (re)established
+                    mqttConnPending = false;
+                    mqttConnNow = millis();
+                    mqttConnects++;
+                    if(mqttLostNow) {
+                        mqttTTRLast = mqttConnNow - mqttLostNow;
+                        if(mqttTTRLast > mqttTTRMax) mqttTTRMax = mqttTTRLast;
+                        #ifdef TC_DBG
+                        Serial.printf("MQTT: Reconnected after %lums\n", mqttTTRLast);
+                        #endif
+                    }
+                    // Broker kept our subscriptions if session was resumed
+                    mqttSubAttempted = mqttClient.sessionPresent();
+                    mqttHadSession = true;
+                    mqttOldState = true;
+                }
                 // Only call Subscribe() if connected
                 mqttSubscribe();
-                mqttOldState = true;
             }
         }
         mqttClient.loop();
+        if(millis() - mqttStateNow >= MQTT_STATE_INT) {
+            mqttPublishState();
+            mqttStateNow = millis();
+        }
+        if(mqttCfgRebootNow && (millis() - mqttCfgRebootNow > 2000)) {
+            // Remote config changed settings that require a reboot;
+            // the delay gives the result message a chance to go out
+            #ifdef TC_DBG
+            Serial.println(F("MQTT: Remote config: Restarting ESP...."));
+            #endif
+            rebootForSettings();
+        }
+        if(mqttTelem) {
+            bool wifiUp = (WiFi.status() == WL_CONNECTED);
+            if(wifiUp && !wifiWasUp) wifiConnects++;
+            wifiWasUp = wifiUp;
+            if(mqttClient.connected()) {
+                if(!mqttDiscDone) {
+                    mqttPublishDiscovery();
+                    mqttDiscDone = true;
+                }
+                if(!mqttTelemNow || (millis() - mqttTelemNow >= MQTT_TELEM_INT)) {
+                    mqttPublishTelemetry();
+                    mqttTelemNow = millis();
+                }
+            }
+        }
     }
 #endif
     
@@ -744,10 +923,6 @@ void wifi_loop()
                 char *s = settings.hostName;
                 for ( ; *s; ++s) *s = tolower(*s);
             }
-            mystrcpy(settings.wifiConRetries, &custom_wifiConRetries);
-            mystrcpy(settings.wifiConTimeout, &custom_wifiConTimeout);
-            mystrcpy(settings.wifiOffDelay, &custom_wifiOffDelay);
-            mystrcpy(settings.wifiAPOffDelay, &custom_wifiAPOffDelay);
             strcpytrim(settings.ntpServer, custom_ntpServer.getValue());
             strcpytrim(settings.timeZone, custom_timeZone.getValue());
 
@@ -768,30 +943,11 @@ void wifi_loop()
             if(strlen(settings.autoNMPreset) == 0) {
                 sprintf(settings.autoNMPreset, "%d", DEF_AUTONM_PRESET);
             }
-            mystrcpy(settings.autoNMOn, &custom_autoNMOn);
-            mystrcpy(settings.autoNMOff, &custom_autoNMOff);
-            #ifdef TC_HAVELIGHT
-            mystrcpy(settings.luxLimit, &custom_lxLim);
-            #endif
-            
-            #ifdef EXTERNAL_TIMETRAVEL_IN
-            mystrcpy(settings.ettDelay, &custom_ettDelay);
-            #endif
-
-            #ifdef TC_HAVETEMP
-            mystrcpy(settings.tempOffs, &custom_tempOffs);
-            #endif
-            
             #ifdef TC_HAVESPEEDO
             getParam("speedo_type", settings.speedoType, 2);
             if(strlen(settings.speedoType) == 0) {
                 sprintf(settings.speedoType, "%d", DEF_SPEEDO_TYPE);
             }
-            mystrcpy(settings.speedoBright, &custom_speedoBright);
-            mystrcpy(settings.speedoFact, &custom_speedoFact);
-            #ifdef TC_HAVETEMP
-            mystrcpy(settings.tempBright, &custom_tempBright);
-            #endif
             #endif
 
             #ifdef TC_HAVEMQTT
@@ -800,119 +956,18 @@ void wifi_loop()
             strcpyutf8(settings.mqttTopic, custom_mqttTopic.getValue(), sizeof(settings.mqttTopic));
             #endif
             
-            #ifdef TC_NOCHECKBOXES // --------- Plain text boxes:
-
-            mystrcpy(settings.timesPers, &custom_ttrp);
-            mystrcpy(settings.alarmRTC, &custom_alarmRTC);
-            mystrcpy(settings.playIntro, &custom_playIntro);
-            mystrcpy(settings.mode24, &custom_mode24);
-
-            mystrcpy(settings.wifiPRetry, &custom_wifiPRe);
-            
-            mystrcpy(settings.dtNmOff, &custom_dtNmOff);
-            mystrcpy(settings.ptNmOff, &custom_ptNmOff);
-            mystrcpy(settings.ltNmOff, &custom_ltNmOff);
-            #ifdef TC_HAVELIGHT
-            mystrcpy(settings.useLight, &custom_uLS);
-            #endif
-            
-            #ifdef TC_HAVETEMP
-            mystrcpy(settings.tempUnit, &custom_tempUnit);
-            #endif
-            
-            #ifdef TC_HAVESPEEDO
-            #ifdef TC_HAVEGPS
-            mystrcpy(settings.useGPSSpeed, &custom_useGPSS);
-            #endif
-            #ifdef TC_HAVETEMP
-            mystrcpy(settings.dispTemp, &custom_useDpTemp);
-            mystrcpy(settings.tempOffNM, &custom_tempOffNM);
-            #endif
-            #endif
-            
-            //#ifdef EXTERNAL_TIMETRAVEL_IN
-            //mystrcpy(settings.ettLong, &custom_ettLong);
-            //#endif
-
-            #ifdef FAKE_POWER_ON
-            mystrcpy(settings.fakePwrOn, &custom_fakePwrOn);
-            #endif
-            
-            #ifdef EXTERNAL_TIMETRAVEL_OUT
-            mystrcpy(settings.useETTO, &custom_useETTO);
-            #endif
-            mystrcpy(settings.playTTsnds, &custom_playTTSnd);
-
-            #ifdef TC_HAVEMQTT
-            mystrcpy(settings.useMQTT, &custom_useMQTT);
-            #ifdef EXTERNAL_TIMETRAVEL_OUT
-            mystrcpy(settings.pubMQTT, &custom_pubMQTT);
-            #endif
-            #endif
-
-            mystrcpy(settings.shuffle, &custom_shuffle);
-
-            oldCfgOnSD = settings.CfgOnSD[0];
-            mystrcpy(settings.CfgOnSD, &custom_CfgOnSD);
-            //mystrcpy(settings.sdFreq, &custom_sdFrq);
-
-            #else // -------------------------- Checkboxes:
-
-            strcpyCB(settings.timesPers, &custom_ttrp);
-            strcpyCB(settings.alarmRTC, &custom_alarmRTC);
-            strcpyCB(settings.playIntro, &custom_playIntro);
-            strcpyCB(settings.mode24, &custom_mode24);
-
-            strcpyCB(settings.wifiPRetry, &custom_wifiPRe);
-
-            strcpyCB(settings.dtNmOff, &custom_dtNmOff);
-            strcpyCB(settings.ptNmOff, &custom_ptNmOff);
-            strcpyCB(settings.ltNmOff, &custom_ltNmOff);
-            #ifdef TC_HAVELIGHT
-            strcpyCB(settings.useLight, &custom_uLS);
-            #endif
-            
-            #ifdef TC_HAVETEMP
-            strcpyCB(settings.tempUnit, &custom_tempUnit);
-            #endif
-            
-            #ifdef TC_HAVESPEEDO
-            #ifdef TC_HAVEGPS
-            strcpyCB(settings.useGPSSpeed, &custom_useGPSS);
-            #endif
-            #ifdef TC_HAVETEMP
-            strcpyCB(settings.dispTemp, &custom_useDpTemp);
-            strcpyCB(settings.tempOffNM, &custom_tempOffNM);
-            #endif
-            #endif
-            
-            //#ifdef EXTERNAL_TIMETRAVEL_IN
-            //strcpyCB(settings.ettLong, &custom_ettLong);
-            //#endif
-            
-            #ifdef FAKE_POWER_ON
-            strcpyCB(settings.fakePwrOn, &custom_fakePwrOn);
-            #endif
-            
-            #ifdef EXTERNAL_TIMETRAVEL_OUT
-            strcpyCB(settings.useETTO, &custom_useETTO);
-            #endif
-            strcpyCB(settings.playTTsnds, &custom_playTTSnd);
-
-            #ifdef TC_HAVEMQTT
-            strcpyCB(settings.useMQTT, &custom_useMQTT);
-            #ifdef EXTERNAL_TIMETRAVEL_OUT
-            strcpyCB(settings.pubMQTT, &custom_pubMQTT);
-            #endif
-            #endif
-
-            strcpyCB(settings.shuffle, &custom_shuffle);
-
             oldCfgOnSD = settings.CfgOnSD[0];
-            strcpyCB(settings.CfgOnSD, &custom_CfgOnSD);
-            //strcpyCB(settings.sdFreq, &custom_sdFrq);
 
-            #endif  // -------------------------
+            for(int i = 0; i < NUM_PORTAL_PARMS; i++) {
+                char *sv = (char *)&settings + portalParms[i].offs;
+                #ifndef TC_NOCHECKBOXES
+                if(portalParms[i].type == WPT_CB) {
+                    strcpyCB(sv, portalParms[i].el);
+                    continue;
+                }
+                #endif
+                mystrcpy(sv, portalParms[i].el);
+            }
 
             // Copy alarm/volume settings to other medium if
             // user changed respective option
@@ -931,23 +986,11 @@ void wifi_loop()
 
         // Reset esp32 to load new settings
 
-        stopAudio();
-
-        allOff();
-        #ifdef TC_HAVESPEEDO
-        if(useSpeedo) speedo.off();
-        #endif
-        destinationTime.resetBrightness();
-        destinationTime.showTextDirect("REBOOTING");
-        destinationTime.on();
-
         #ifdef TC_DBG
         Serial.println(F("Config Portal: Restarting ESP...."));
         #endif
 
-        Serial.flush();
-
-        esp_restart();
+        rebootForSettings();
     }
 
     // WiFi power management
@@ -1083,6 +1126,24 @@ static void wifiConnect(bool deferConfigPortal)
     lastConnect = millis();
 }
 
+// Reboot to make changed settings effective
+static void rebootForSettings()
+{
+    stopAudio();
+
+    allOff();
+    #ifdef TC_HAVESPEEDO
+    if(useSpeedo) speedo.off();
+    #endif
+    destinationTime.resetBrightness();
+    destinationTime.showTextDirect("REBOOTING");
+    destinationTime.on();
+
+    Serial.flush();
+
+    esp_restart();
+}
+
 // This must not be called if no power-saving
 // timers are configured.
 static void wifiOff(bool force)
@@ -1313,6 +1374,163 @@ static void preUpdateCallback()
     origWiFiOffDelay = 0;
 }
 
+// This is called when WiFiManager (re)creates its web server.
+// Register our static assets. They are referenced from every
+// page's head with the firmware version as query, so browsers
+// may cache them forever; the ETag allows cheap revalidation.
+static void wmServerCallback()
+{
+    static const char *hdrs[] = { "If-None-Match" };
+
+    wm.server->collectHeaders(hdrs, 1);
+    wm.server->on("/tcd.js", HTTP_GET, []() { wmAssetHandler("application/javascript", myJS); });
+    wm.server->on("/tcd.css", HTTP_GET, []() { wmAssetHandler("text/css", myCSS); });
+    // Registered before WiFiManager's own handler, so ours is used
+    wm.server->on("/param", HTTP_GET, wmParamPage);
+
+    apiRegister();
+}
+
+static void wmAssetHandler(const char *type, const char *data)
+{
+    wm.server->sendHeader("ETag", WM_ASSET_ETAG);
+    wm.server->sendHeader("Cache-Control", "max-age=31536000");
+    
+    if(wm.server->header("If-None-Match") == WM_ASSET_ETAG) {
+        wm.server->send(304);
+        return;
+    }
+
+    wm.server->send_P(200, type, data);
+}
+
+/*
+ * Settings page
+ *
+ * Replaces WiFiManager's /param handler, which assembles the 
+ * whole page (~80 parameters) in one String on the heap before
+ * sending it. Here, the page is rendered into a small static
+ * buffer, which is sent as a chunk whenever it is full; audio 
+ * is serviced in between. The markup is that of WiFiManager.
+ * Saving is still handled by WiFiManager (/paramsave).
+ */
+#define WM_PAGE_BUF 1024
+static char wmPageBuf[WM_PAGE_BUF];
+static int  wmPageLen = 0;
+
+static void wmPageFlush()
+{
+    if(wmPageLen) {
+        wm.server->sendContent(wmPageBuf, wmPageLen);
+        wmPageLen = 0;
+        audio_loop();
+    }
+}
+
+static void wmPageAdd(const char *str, int len = -1)
+{
+    if(!str) return;
+    
+    if(len < 0) len = strlen(str);
+    
+    while(len) {
+        int n = min(len, WM_PAGE_BUF - wmPageLen);
+        memcpy(wmPageBuf + wmPageLen, str, n);
+        wmPageLen += n;
+        str += n;
+        len -= n;
+        if(wmPageLen == WM_PAGE_BUF) wmPageFlush();
+    }
+}
+
+// Add template, replacing token by given string
+static void wmPageAddTpl(const char *tpl, const char *tok, const char *val)
+{
+    const char *t = strstr(tpl, tok);
+
+    if(!t) {
+        wmPageAdd(tpl);
+        return;
+    }
+    wmPageAdd(tpl, t - tpl);
+    wmPageAdd(val);
+    wmPageAdd(t + strlen(tok));
+}
+
+static void wmParamLabel(WiFiManagerParameter *p)
+{
+    wmPageAdd("<label for='");
+    wmPageAdd(p->getID());
+    wmPageAdd("'>");
+    wmPageAdd(p->getLabel());
+    wmPageAdd("</label>");
+}
+
+static void wmParamInput(WiFiManagerParameter *p)
+{
+    char lenBuf[8];
+
+    snprintf(lenBuf, sizeof(lenBuf), "%d", p->getValueLength());
+    
+    wmPageAdd("<br/><input id='");
+    wmPageAdd(p->getID());
+    wmPageAdd("' name='");
+    wmPageAdd(p->getID());
+    wmPageAdd("' maxlength='");
+    wmPageAdd(lenBuf);
+    wmPageAdd("' value='");
+    wmPageAdd(p->getValue());
+    wmPageAdd("' ");
+    wmPageAdd(p->getCustomHTML());
+    wmPageAdd(">\n");
+}
+
+static void wmParamPage()
+{
+    WiFiManagerParameter **params = wm.getParameters();
+    int num = wm.getParametersCount();
+
+    wm.server->sendHeader("Cache-Control", "no-cache, no-store, must-revalidate");
+    wm.server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    wm.server->send(200, "text/html", "");
+
+    wmPageLen = 0;
+
+    wmPageAddTpl(HTTP_HEAD_START, "{v}", "Setup");
+    wmPageAdd(HTTP_SCRIPT);
+    wmPageAdd(HTTP_STYLE);
+    wmPageAdd(myHead);
+    wmPageAddTpl(HTTP_HEAD_END, "{c}", "");
+
+    wmPageAdd("<form method='POST' action='paramsave'>");
+
+    for(int i = 0; i < num; i++) {
+        WiFiManagerParameter *p = params[i];
+        if(!p->getID()) {
+            wmPageAdd(p->getCustomHTML());
+            continue;
+        }
+        switch(p->getLabelPlacement()) {
+        case WFM_LABEL_AFTER:
+            wmParamInput(p);
+            wmParamLabel(p);
+            break;
+        case WFM_NO_LABEL:
+            wmParamInput(p);
+            break;
+        default:
+            wmParamLabel(p);
+            wmParamInput(p);
+        }
+    }
+
+    wmPageAdd(HTTP_FORM_END);
+    wmPageAdd(HTTP_END);
+
+    wmPageFlush();
+    wm.server->sendContent("");
+}
+
 // Grab static IP parameters from WiFiManager's server.
 // Since there is no public method for this, we steal
 // the html form parameters in this callback.
@@ -1444,10 +1662,6 @@ void updateConfigPortalValues()
     strcat(beepaintCustHTML, aintCustHTML8);
 
     custom_hostName.setValue(settings.hostName, 31);
-    custom_wifiConTimeout.setValue(settings.wifiConTimeout, 2);
-    custom_wifiConRetries.setValue(settings.wifiConRetries, 2);
-    custom_wifiOffDelay.setValue(settings.wifiOffDelay, 2);
-    custom_wifiAPOffDelay.setValue(settings.wifiAPOffDelay, 2);
     custom_ntpServer.setValue(settings.ntpServer, 63);
     custom_timeZone.setValue(settings.timeZone, 63);
 
@@ -1472,20 +1686,6 @@ void updateConfigPortalValues()
     if(tnm == 4) strcat(anmCustHTML, custHTMLSel);
     strcat(anmCustHTML, anmCustHTML8);
 
-    custom_autoNMOn.setValue(settings.autoNMOn, 2);
-    custom_autoNMOff.setValue(settings.autoNMOff, 2);
-    #ifdef TC_HAVELIGHT
-    custom_lxLim.setValue(settings.luxLimit, 6);
-    #endif
-    
-    #ifdef EXTERNAL_TIMETRAVEL_IN
-    custom_ettDelay.setValue(settings.ettDelay, 5);
-    #endif
-
-    #ifdef TC_HAVETEMP
-    custom_tempOffs.setValue(settings.tempOffs, 4);
-    #endif
-
     #ifdef TC_HAVESPEEDO
     strcpy(spTyCustHTML, spTyCustHTML1);
     strcat(spTyCustHTML, settings.speedoType);
@@ -1505,11 +1705,6 @@ void updateConfigPortalValues()
         strcat(spTyCustHTML, spTyOptP3);
     }
     strcat(spTyCustHTML, spTyCustHTMLE);
-    custom_speedoBright.setValue(settings.speedoBright, 2);
-    custom_speedoFact.setValue(settings.speedoFact, 3);
-    #ifdef TC_HAVETEMP
-    custom_tempBright.setValue(settings.tempBright, 2);
-    #endif
     #endif
 
     #ifdef TC_HAVEMQTT
@@ -1518,97 +1713,16 @@ void updateConfigPortalValues()
     custom_mqttTopic.setValue(settings.mqttTopic, 63);
     #endif
 
-    #ifdef TC_NOCHECKBOXES  // Standard text boxes: -------
-
-    custom_ttrp.setValue(settings.timesPers, 1);
-    custom_alarmRTC.setValue(settings.alarmRTC, 1);
-    custom_playIntro.setValue(settings.playIntro, 1);
-    custom_mode24.setValue(settings.mode24, 1);
-    custom_wifiPRe.setValue(settings.wifiPRetry, 1);
-    custom_dtNmOff.setValue(settings.dtNmOff, 1);
-    custom_ptNmOff.setValue(settings.ptNmOff, 1);
-    custom_ltNmOff.setValue(settings.ltNmOff, 1);
-    #ifdef TC_HAVELIGHT
-    custom_uLS.setValue(settings.useLight, 1);
-    #endif
-    #ifdef TC_HAVETEMP
-    custom_tempUnit.setValue(settings.tempUnit, 1);
-    #endif
-    #ifdef TC_HAVESPEEDO
-    #ifdef TC_HAVEGPS
-    custom_useGPSS.setValue(settings.useGPSSpeed, 1);
-    #endif
-    #ifdef TC_HAVETEMP
-    custom_useDpTemp.setValue(settings.dispTemp, 1);
-    custom_tempOffNM.setValue(settings.tempOffNM, 1);
-    #endif
-    #endif
-    #ifdef FAKE_POWER_ON
-    custom_fakePwrOn.setValue(settings.fakePwrOn, 1);
-    #endif
-    //#ifdef EXTERNAL_TIMETRAVEL_IN
-    //custom_ettLong.setValue(settings.ettLong, 1);
-    //#endif
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    custom_useETTO.setValue(settings.useETTO, 1);
-    #endif
-    custom_playTTSnd.setValue(settings.playTTsnds, 1);
-    #ifdef TC_HAVEMQTT
-    custom_useMQTT.setValue(settings.useMQTT, 1);
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    custom_pubMQTT.setValue(settings.pubMQTT, 1);
-    #endif
-    #endif
-    custom_shuffle.setValue(settings.shuffle, 1);
-    custom_CfgOnSD.setValue(settings.CfgOnSD, 1);
-    //custom_sdFrq.setValue(settings.sdFreq, 1);
-
-    #else   // For checkbox hack --------------------------
-
-    setCBVal(&custom_ttrp, settings.timesPers);
-    setCBVal(&custom_alarmRTC, settings.alarmRTC);
-    setCBVal(&custom_playIntro, settings.playIntro);
-    setCBVal(&custom_mode24, settings.mode24);
-    setCBVal(&custom_wifiPRe, settings.wifiPRetry);
-    setCBVal(&custom_dtNmOff, settings.dtNmOff);
-    setCBVal(&custom_ptNmOff, settings.ptNmOff);
-    setCBVal(&custom_ltNmOff, settings.ltNmOff);
-    #ifdef TC_HAVELIGHT
-    setCBVal(&custom_uLS, settings.useLight);
-    #endif
-    #ifdef TC_HAVETEMP
-    setCBVal(&custom_tempUnit, settings.tempUnit);
-    #endif
-    #ifdef TC_HAVESPEEDO
-    #ifdef TC_HAVEGPS
-    setCBVal(&custom_useGPSS, settings.useGPSSpeed);
-    #endif
-    #ifdef TC_HAVETEMP
-    setCBVal(&custom_useDpTemp, settings.dispTemp);
-    setCBVal(&custom_tempOffNM, settings.tempOffNM);
-    #endif
-    #endif
-    #ifdef FAKE_POWER_ON
-    setCBVal(&custom_fakePwrOn, settings.fakePwrOn);
-    #endif
-    //#ifdef EXTERNAL_TIMETRAVEL_IN
-    //setCBVal(&custom_ettLong, settings.ettLong);
-    //#endif
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    setCBVal(&custom_useETTO, settings.useETTO);
-    #endif
-    setCBVal(&custom_playTTSnd, settings.playTTsnds);
-    #ifdef TC_HAVEMQTT
-    setCBVal(&custom_useMQTT, settings.useMQTT);
-    #ifdef EXTERNAL_TIMETRAVEL_OUT
-    setCBVal(&custom_pubMQTT, settings.pubMQTT);
-    #endif
-    #endif
-    setCBVal(&custom_shuffle, settings.shuffle);
-    setCBVal(&custom_CfgOnSD, settings.CfgOnSD);
-    //setCBVal(&custom_sdFrq, settings.sdFreq);
-
-    #endif // ---------------------------------------------    
+    for(int i = 0; i < NUM_PORTAL_PARMS; i++) {
+        char *sv = (char *)&settings + portalParms[i].offs;
+        #ifndef TC_NOCHECKBOXES
+        if(portalParms[i].type == WPT_CB) {
+            setCBVal(portalParms[i].el, sv);
+            continue;
+        }
+        #endif
+        portalParms[i].el->setValue(sv, portalParms[i].len);
+    }
 }
 
 int wifi_getStatus()
@@ -1783,19 +1897,318 @@ static void setCBVal(WiFiManagerParameter *el, char *sv)
 }
 #endif
 
-#ifdef TC_HAVEMQTT
-static void strcpyutf8(char *dst, const char *src, unsigned int len)
+/*
+ * REST API
+ *
+ * GET  /api/state        State as JSON
+ * POST /api/timetravel   {"speed":n}: Time travel; speed (0-88, optional) 
+ *                        is the speedo start speed
+ * POST /api/return       Return from time travel
+ * POST /api/destination  {"year":y,"month":m,"day":d,"hour":h,"minute":m}
+ * POST /api/alarm        {"on":bool,"hour":h,"minute":m} (all optional)
+ * POST /api/volume       {"volume":0-19}
+ * POST /api/brightness   {"destination":n,"present":n,"departed":n} (0-15, 
+ *                        all optional)
+ * POST /api/music        {"action":"play|stop|next|prev","track":n,"shuffle":bool}
+ * POST /api/beep         {"mode":0-3}
+ *
+ * POST requests are answered with {"result":"ok"}, {"result":"busy"} (503)
+ * or {"result":"error"} (400). Commands are not taken while the device is 
+ * off, in the menu or during a time travel (same as MQTT and keypad).
+ * Responses are built in a static buffer, no heap allocations.
+ */
+
+#define API_STATE_SIZE 448
+
+static char apiBuf[API_STATE_SIZE];
+
+static void apiSend(int code, int len)
 {
-    strncpy(dst, src, len - 1);
-    dst[len - 1] = 0;
+    wm.server->sendHeader("Cache-Control", "no-store");
+    wm.server->send_P(code, "application/json", apiBuf, len);
 }
 
-static int16_t filterOutUTF8(char *src, char *dst)
+static void apiResult(int code, const char *result)
 {
-    int i, j, slen = strlen(src);
-    unsigned char c, d, e, f;
+    apiSend(code, snprintf(apiBuf, sizeof(apiBuf), "{\"result\":\"%s\"}", result));
+}
 
-    for(i = 0, j = 0; i < slen; i++) {
+static bool apiIsBusy()
+{
+    return (!FPBUnitIsOn || menuActive   || startup || 
+            timeTravelP0 || timeTravelP1 || timeTravelRE);
+}
+
+static int apiPrintDisp(char *buf, int size, clockDisplay& disp)
+{
+    return snprintf(buf, size, "\"%04d-%02d-%02d %02d:%02d\"", 
+                    disp.getYear(), disp.getMonth(), disp.getDay(),
+                    disp.getHour(), disp.getMinute());
+}
+
+static void apiGetState()
+{
+    int len = 0, mp = mp_get_currently_playing();
+
+    len += snprintf(apiBuf + len, sizeof(apiBuf) - len, "{\"present\":");
+    len += apiPrintDisp(apiBuf + len, sizeof(apiBuf) - len, presentTime);
+    len += snprintf(apiBuf + len, sizeof(apiBuf) - len, ",\"destination\":");
+    len += apiPrintDisp(apiBuf + len, sizeof(apiBuf) - len, destinationTime);
+    len += snprintf(apiBuf + len, sizeof(apiBuf) - len, ",\"departed\":");
+    len += apiPrintDisp(apiBuf + len, sizeof(apiBuf) - len, departedTime);
+    len += snprintf(apiBuf + len, sizeof(apiBuf) - len, 
+                ",\"on\":%s,\"busy\":%s,\"nightmode\":%s,"
+                "\"alarm\":{\"on\":%s,\"hour\":%d,\"minute\":%d},"
+                "\"music\":{\"available\":%s,\"playing\":%d},"
+                "\"volume\":%d,\"beep\":%d,"
+                "\"brightness\":{\"destination\":%d,\"present\":%d,\"departed\":%d}}",
+                FPBUnitIsOn ? "true" : "false",
+                apiIsBusy() ? "true" : "false",
+                presentTime.getNightMode() ? "true" : "false",
+                alarmOnOff ? "true" : "false", alarmHour, alarmMinute,
+                haveMusic ? "true" : "false", mp,
+                (curVolume == 255) ? -1 : curVolume, beepMode,
+                destinationTime.getBrightness(), presentTime.getBrightness(), 
+                departedTime.getBrightness());
+
+    if(len >= (int)sizeof(apiBuf)) {
+        apiResult(500, "error");
+        return;
+    }
+
+    apiSend(200, len);
+}
+
+// Common entry for POST handlers: Check if we are allowed
+// to take commands, and parse the body. Returns false if
+// an error response has already been sent.
+// (Requests are checked in tc_api.cpp)
+static bool apiPrepare(JsonDocument& json)
+{
+    int code = apiParseBody(apiIsBusy(), 
+                    wm.server->hasArg("plain") ? wm.server->arg("plain").c_str() : NULL, 
+                    json);
+
+    if(code != 200) {
+        apiResult(code, (code == 503) ? "busy" : "error");
+        return false;
+    }
+
+    return true;
+}
+
+static void apiTimeTravel()
+{
+    StaticJsonDocument<64> json;
+    int speed;
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckTimeTravel(json, speed)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    if(speed >= 0) {
+        timeTravel(true, true, speed);
+    } else {
+        timeTravel(true, true);
+    }
+
+    apiResult(200, "ok");
+}
+
+static void apiReturn()
+{
+    StaticJsonDocument<64> json;
+
+    if(!apiPrepare(json)) return;
+
+    resetPresentTime();
+
+    apiResult(200, "ok");
+}
+
+static void apiDestination()
+{
+    StaticJsonDocument<128> json;
+    int year, month, day, hour, minute;
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckDestination(json, year, month, day, hour, minute)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    setDestinationTime(year, month, day, hour, minute);
+
+    apiResult(200, "ok");
+}
+
+static void apiAlarm()
+{
+    StaticJsonDocument<128> json;
+    int onOff, hour, minute;
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckAlarm(json, onOff, hour, minute)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    if(hour >= 0) {
+        alarmHour = hour;
+        alarmMinute = minute;
+    }
+
+    // Like keypad: Setting a time enables the alarm
+    if((onOff >= 0) ? onOff : (hour >= 0)) {
+        if(!alarmOn()) {
+            // No alarm time set yet
+            apiResult(400, "error");
+            return;
+        }
+    } else if(onOff >= 0) {
+        alarmOff();
+    }
+
+    apiResult(200, "ok");
+}
+
+static void apiVolume()
+{
+    StaticJsonDocument<64> json;
+    int vol;
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckVolume(json, vol)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    // Not saved; volume knob is re-enabled through menu
+    curVolume = vol;
+
+    apiResult(200, "ok");
+}
+
+static void apiBrightness()
+{
+    StaticJsonDocument<128> json;
+    int b[3];
+    clockDisplay *disps[3] = { &destinationTime, &presentTime, &departedTime };
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckBrightness(json, b)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        if(b[i] >= 0) disps[i]->setBrightness(b[i], true);
+    }
+
+    apiResult(200, "ok");
+}
+
+static void apiMusic()
+{
+    StaticJsonDocument<128> json;
+    int action, track, shuffle;
+
+    if(!apiPrepare(json)) return;
+
+    if(!haveMusic) {
+        apiResult(400, "error");
+        return;
+    }
+
+    if(!apiCheckMusic(json, action, track, shuffle)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    if(shuffle >= 0) {
+        mp_makeShuffle(shuffle);
+    }
+
+    if(track >= 0) {
+        mp_gotonum(track, true);
+    }
+
+    switch(action) {
+    case API_MP_PLAY: mp_play();          break;
+    case API_MP_STOP: mp_stop();          break;
+    case API_MP_NEXT: mp_next(mpActive);  break;
+    case API_MP_PREV: mp_prev(mpActive);  break;
+    }
+
+    apiResult(200, "ok");
+}
+
+static void apiBeep()
+{
+    StaticJsonDocument<64> json;
+    int mode;
+
+    if(!apiPrepare(json)) return;
+
+    if(!apiCheckBeep(json, mode)) {
+        apiResult(400, "error");
+        return;
+    }
+
+    setBeepMode(mode);
+
+    apiResult(200, "ok");
+}
+
+static void apiRegister()
+{
+    wm.server->on("/api/state", HTTP_GET, apiGetState);
+    wm.server->on("/api/timetravel", HTTP_POST, apiTimeTravel);
+    wm.server->on("/api/return", HTTP_POST, apiReturn);
+    wm.server->on("/api/destination", HTTP_POST, apiDestination);
+    wm.server->on("/api/alarm", HTTP_POST, apiAlarm);
+    wm.server->on("/api/volume", HTTP_POST, apiVolume);
+    wm.server->on("/api/brightness", HTTP_POST, apiBrightness);
+    wm.server->on("/api/music", HTTP_POST, apiMusic);
+    wm.server->on("/api/beep", HTTP_POST, apiBeep);
+}
+
+// Shared by REST API and MQTT
+static void setDestinationTime(int year, int month, int day, int hour, int minute)
+{
+    enableRcMode(false);
+    if(isWcMode() && WcHaveTZ1) enableWcMode(false);
+    pauseAuto();
+    destinationTime.setYear(year);
+    destinationTime.setMonth(month);
+    destinationTime.setDay(day);
+    destinationTime.setHour(hour);
+    destinationTime.setMinute(minute);
+    if(timetravelPersistent) {
+        destinationTime.save();
+    }
+}
+
+#ifdef TC_HAVEMQTT
+static void strcpyutf8(char *dst, const char *src, unsigned int len)
+{
+    strncpy(dst, src, len - 1);
+    dst[len - 1] = 0;
+}
+
+static int16_t filterOutUTF8(const char *src, char *dst)
+{
+    int i, j, slen = strlen(src);
+    unsigned char c, d, e, f;
+
+    for(i = 0, j = 0; i < slen; i++) {
         c = (unsigned char)src[i];
         if(c >= 32 && c < 127 - 1) {    // 127 = °, non-std, skip
             if(c >= 'a' && c <= 'z') c &= ~0x20;
@@ -1824,38 +2237,13 @@ static int16_t filterOutUTF8(char *src, char *dst)
     return j;
 }
 
-static void mqttLooper()
-{
-    ntp_loop();
-    audio_loop();
-    #ifdef TC_HAVEGPS
-    gps_loop();   // does not call any other loops
-    #endif
-}
-
 static void mqttCallback(char *topic, byte *payload, unsigned int length)
 {
-    int i = 0, j, ml = (length <= 255) ? length : 255;
-    char tempBuf[256];
-    static const char *cmdList[] = {
-      "TIMETRAVEL",       // 0
-      "RETURN",           // 1
-      "ALARM_ON",         // 2
-      "ALARM_OFF",        // 3
-      "NIGHTMODE_ON",     // 4
-      "NIGHTMODE_OFF",    // 5
-      "MP_SHUFFLE_ON",    // 6
-      "MP_SHUFFLE_OFF",   // 7
-      "MP_PLAY",          // 8
-      "MP_STOP",          // 9
-      "MP_NEXT",          // 10
-      "MP_PREV",          // 11
-      "BEEP_OFF",         // 12
-      "BEEP_ON",          // 13
-      "BEEP_30",          // 14
-      "BEEP_60",          // 15
-      NULL
-    };
+    // Commands and plain text messages are cut to MQTT_MSG_LEN,
+    // JSON is parsed from the full payload (up to MQTT_LONG_LEN)
+    int ml = (length <= MQTT_MSG_LEN) ? length : MQTT_MSG_LEN;
+    char tempBuf[MQTT_MSG_LEN + 1];
+    mqttCommand cmd;
 
     if(!length) return;
 
@@ -1866,181 +2254,261 @@ static void mqttCallback(char *topic, byte *payload, unsigned int length)
            timeTravelP0 || timeTravelP1 || timeTravelRE)
             return;
 
-        memcpy(tempBuf, (const char *)payload, ml);
-        tempBuf[ml] = 0;
-
-        for(j = 0; j < ml; j++) {
-            if(tempBuf[j] >= 'a' && tempBuf[j] <= 'z') tempBuf[j] &= ~0x20;
-        }
+        if(!mqttParseCmd(payload, length, cmd))
+            return;
 
-        while(cmdList[i]) {
-            j = strlen(cmdList[i]);
-            if((ml >= j) && !strncmp((const char *)tempBuf, cmdList[i], j)) {
-                break;
+        switch(cmd.id) {
+        case MQC_TIMETRAVEL:
+            if(cmd.arg >= 0) {
+                // Complete sequence, speedo starting at given speed
+                timeTravel(true, true, cmd.arg);
+            } else {
+                #ifdef EXTERNAL_TIMETRAVEL_IN
+                inputEvAdd(TCI_ETT);
+                #endif
             }
-            i++;          
-        }
-
-        if(!cmdList[i]) return;
-
-        switch(i) {
-        case 0:
-            #ifdef EXTERNAL_TIMETRAVEL_IN
-            isEttKeyPressed = true;
-            #endif
             break;
-        case 1:
+        case MQC_RETURN:
             #ifdef EXTERNAL_TIMETRAVEL_IN
-            isEttKeyHeld = true;
+            inputEvAdd(TCI_ETTHOLD);
             #endif
             break;
-        case 2:
+        case MQC_ALARM_ON:
             alarmOn();
             break;
-        case 3:
+        case MQC_ALARM_OFF:
             alarmOff();
             break;
-        case 4:
+        case MQC_NIGHTMODE_ON:
             nightModeOn();
             manualNightMode = 1;
             manualNMNow = millis();
             break;
-        case 5:
+        case MQC_NIGHTMODE_OFF:
             nightModeOff();
             manualNightMode = 0;
             manualNMNow = millis();
             break;
-        case 6:
-        case 7:
-            if(haveMusic) mp_makeShuffle((i == 6));
+        case MQC_MP_SHUFFLE_ON:
+        case MQC_MP_SHUFFLE_OFF:
+            if(haveMusic) mp_makeShuffle((cmd.id == MQC_MP_SHUFFLE_ON));
             break;
-        case 8:    
+        case MQC_MP_PLAY:    
             if(haveMusic) mp_play();
             break;
-        case 9:
+        case MQC_MP_STOP:
             if(haveMusic) mp_stop();
             break;
-        case 10:
+        case MQC_MP_NEXT:
             if(haveMusic) mp_next(mpActive);
             break;
-        case 11:
+        case MQC_MP_PREV:
             if(haveMusic) mp_prev(mpActive);
             break;
-        case 12:
-        case 13:
-        case 14:
-        case 15:
-            setBeepMode(i-12);
+        case MQC_MP_TRACK:
+            if(haveMusic) mp_gotonum(cmd.arg, true);
+            break;
+        case MQC_BEEP_OFF:
+        case MQC_BEEP_ON:
+        case MQC_BEEP_30:
+        case MQC_BEEP_60:
+            setBeepMode(cmd.id - MQC_BEEP_OFF);
+            break;
+        case MQC_SENSOR_HISTORY:
+            #if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+            mqttPublishSensHist();
+            #endif
+            break;
+        case MQC_DESTINATION:
+            setDestinationTime(cmd.year, cmd.month, cmd.day, cmd.hour, cmd.minute);
+            break;
+        case MQC_VOLUME:
+            // Not saved; volume knob is re-enabled through menu
+            curVolume = cmd.arg;
+            break;
+        case MQC_BRIGHTNESS_DEST:
+            destinationTime.setBrightness(cmd.arg, true);
+            break;
+        case MQC_BRIGHTNESS_PRESENT:
+            presentTime.setBrightness(cmd.arg, true);
+            break;
+        case MQC_BRIGHTNESS_DEPART:
+            departedTime.setBrightness(cmd.arg, true);
             break;
         }
             
+    } else if(!strcmp(topic, "bttf/tcd/config")) {
+
+        mqttConfig((char *)payload, length);
+            
     } else if(!strcmp(topic, settings.mqttTopic)) {
 
+        uint8_t  prio = 0;
+        uint16_t speed = MQTT_SPEED_DEF;
+        
         memcpy(tempBuf, (const char *)payload, ml);
         tempBuf[ml] = 0;
 
-        j = filterOutUTF8(tempBuf, mqttMsg);
-        
-        mqttIdx = 0;
-        mqttMaxIdx = (j > DISP_LEN) ? j : -1;
-        mqttDisp = 1;
-        mqttOldDisp = 0;
-        mqttST = haveMQTTaudio;
+        // JSON format: {"text":"...","prio":n,"speed":ms}
+        // Parsed in place from the full payload (zero-copy)
+        if(tempBuf[0] == '{') {
+            StaticJsonDocument<512> json;
+            if(!deserializeJson(json, (char *)payload, length) && json["text"].is<const char *>()) {
+                if(json["prio"].is<int>())  prio = json["prio"].as<uint8_t>();
+                if(json["speed"].is<int>()) speed = json["speed"].as<uint16_t>();
+                strcpyutf8(tempBuf, json["text"].as<const char *>(), sizeof(tempBuf));
+            }
+        }
+
+        filterOutUTF8(tempBuf, tempBuf);
+
+        mqttTickerAdd(tempBuf, prio, speed, haveMQTTaudio);
     
         #ifdef TC_DBG
-        Serial.printf("MQTT: Message about [%s]: %s\n", topic, mqttMsg);
+        Serial.printf("MQTT: Message about [%s]: %s\n", topic, tempBuf);
         #endif
     }
 }
 
-#ifdef TC_DBG
-#define MQTT_FAILCOUNT 6 //120
-#else
-#define MQTT_FAILCOUNT 120
-#endif
+/*
+ * Remote configuration
+ *
+ * A JSON object of settings ("key":value, keys as in config.json)
+ * sent to bttf/tcd/config is checked and applied as a whole (see
+ * applyRemoteConfig()) and saved. Most settings take effect right
+ * away; if any of the changed settings requires a reboot, we reboot
+ * shortly after. The result is published to bttf/tcd/config/result.
+ */
+static void mqttConfig(char *payload, unsigned int length)
+{
+    uint32_t changed = 0;
+    char errKey[32];
+    char buf[96];
+    int len;
 
-static void mqttPing()
-{
-    switch(mqttClient.pstate()) {
-    case PING_IDLE:
-        if(WiFi.status() == WL_CONNECTED) {
-            if(!mqttPingNow || (millis() - mqttPingNow > mqttPingInt)) {
-                mqttPingNow = millis();
-                if(!mqttClient.sendPing()) {
-                    // Mostly fails for internal reasons;
-                    // skip ping test in that case
-                    mqttDoPing = false;
-                    mqttPingDone = true;  // allow mqtt-connect attempt
-                }
-            }
+    if(menuActive || startup || timeTravelP0 || timeTravelP1 || timeTravelRE) {
+
+        // Menu might write settings, sequences might change brightness
+        len = snprintf(buf, sizeof(buf), "{\"result\":\"busy\"}");
+
+    } else if(!applyRemoteConfig(payload, length, changed, errKey, sizeof(errKey))) {
+
+        len = snprintf(buf, sizeof(buf), "{\"result\":\"error\",\"key\":\"%s\"}", errKey);
+
+    } else {
+
+        if(changed & RCF_BRIGHT_DEST) destinationTime.setBrightness((int)atoi(settings.destTimeBright), true);
+        if(changed & RCF_BRIGHT_PRES) presentTime.setBrightness((int)atoi(settings.presTimeBright), true);
+        if(changed & RCF_BRIGHT_DEPA) departedTime.setBrightness((int)atoi(settings.lastTimeBright), true);
+        if(changed & RCF_NMOFF) {
+            destinationTime.setNMOff(((int)atoi(settings.dtNmOff) > 0));
+            presentTime.setNMOff(((int)atoi(settings.ptNmOff) > 0));
+            departedTime.setNMOff(((int)atoi(settings.ltNmOff) > 0));
         }
-        break;
-    case PING_PINGING:
-        if(mqttClient.pollPing()) {
-            mqttPingDone = true;          // allow mqtt-connect attempt
-            mqttPingNow = 0;
-            mqttPingsExpired = 0;
-            mqttPingInt = MQTT_SHORT_INT; // Overwritten on fail in reconnect
-            // Delay re-connection for 5 seconds after first ping echo
-            mqttReconnectNow = millis() - (mqttReconnectInt - 5000);
-        } else if(millis() - mqttPingNow > 5000) {
-            mqttClient.cancelPing();
-            mqttPingNow = millis();
-            mqttPingsExpired++;
-            mqttPingInt = MQTT_SHORT_INT * (1 << (mqttPingsExpired / MQTT_FAILCOUNT));
-            mqttReconnFails = 0;
+        if(changed & RCF_BEEP)    setBeepMode((int)atoi(settings.beep));
+        if(changed & RCF_AUTOROT) loadAutoInterval();
+        if(changed & RCF_TZ)      reloadTZ();
+        if(changed & RCF_AUTONM)  loadAutoNM();
+        if((changed & RCF_SHUFFLE) && haveMusic) {
+            mp_makeShuffle((settings.shuffle[0] != '0'));
         }
-        break;
-    } 
+        #ifdef TC_HAVESPEEDO
+        if((changed & RCF_SPEEDOBRI) && useSpeedo) {
+            speedo.setBrightness((int)atoi(settings.speedoBright), true);
+        }
+        #endif
+        if(changed & RCF_TELEM) {
+            mqttTelem = ((int)atoi(settings.mqttTelem) > 0);
+            mqttDiscDone = false;
+        }
+        if(changed & RCF_REBOOT) {
+            mqttCfgRebootNow = millis();
+        }
+        
+        len = snprintf(buf, sizeof(buf), "{\"result\":\"ok\",\"reboot\":%s}", 
+                          (changed & RCF_REBOOT) ? "true" : "false");
+    }
+
+    #ifdef TC_DBG
+    Serial.printf("MQTT: Remote config: %s\n", buf);
+    #endif
+
+    mqttPublish("bttf/tcd/config/result", buf, len);
 }
 
-static bool mqttReconnect(bool force)
+/*
+ * Messages too large for the MQTT client's buffer arrive in chunks.
+ * We collect up to MQTT_LONG_LEN bytes (static, no heap) and then
+ * handle the message like any other; anything beyond is cut off.
+ */
+static void mqttStreamCallback(char *topic, byte *chunk, unsigned int length, uint32_t offset, uint32_t total)
 {
-    bool success = false;
+    static char longBuf[MQTT_LONG_LEN];
+    
+    if(offset < MQTT_LONG_LEN) {
+        memcpy(longBuf + offset, chunk, min(length, (unsigned int)(MQTT_LONG_LEN - offset)));
+    }
 
-    if(useMQTT && (WiFi.status() == WL_CONNECTED)) {
+    if(offset + length >= total) {
+        #ifdef TC_DBG
+        Serial.printf("MQTT: Received streamed message (%u bytes) about [%s]\n", total, topic);
+        #endif
+        mqttCallback(topic, (byte *)longBuf, min(total, (uint32_t)MQTT_LONG_LEN));
+    }
+}
 
-        if(!mqttClient.connected()) {
-    
-            if(force || !mqttReconnectNow || (millis() - mqttReconnectNow > mqttReconnectInt)) {
+/*
+ * Connection manager
+ *
+ * connect() is non-blocking; the outcome is evaluated in wifi_loop().
+ * Failed attempts are retried with exponential backoff (2s up to 5min),
+ * with jitter (50-100% of the interval) so that multiple devices don't
+ * hammer a restarted broker in lockstep.
+ * The first connection after boot starts with a clean session; later
+ * reconnections resume the session, so the broker retains our 
+ * subscriptions and we only re-subscribe if it did not.
+ */
+static void mqttReconnect(bool force)
+{
+    if(!useMQTT || (WiFi.status() != WL_CONNECTED))
+        return;
 
-                #ifdef TC_DBG
-                Serial.println("MQTT: Attempting to (re)connect");
-                #endif
-    
-                if(strlen(mqttUser)) {
-                    success = mqttClient.connect(settings.hostName, mqttUser, strlen(mqttPass) ? mqttPass : NULL);
-                } else {
-                    success = mqttClient.connect(settings.hostName);
-                }
-    
-                mqttReconnectNow = millis();
-                
-                if(!success) {
-                    mqttRestartPing = true;  // Force PING check before reconnection attempt
-                    mqttReconnFails++;
-                    if(mqttDoPing) {
-                        mqttPingInt = MQTT_SHORT_INT * (1 << (mqttReconnFails / MQTT_FAILCOUNT));
-                    } else {
-                        mqttReconnectInt = MQTT_SHORT_INT * (1 << (mqttReconnFails / MQTT_FAILCOUNT));
-                    }
-                    #ifdef TC_DBG
-                    Serial.printf("MQTT: Failed to reconnect (%d)\n", mqttReconnFails);
-                    #endif
-                } else {
-                    mqttReconnFails = 0;
-                    mqttReconnectInt = MQTT_SHORT_INT;
-                    #ifdef TC_DBG
-                    Serial.println("MQTT: Connected to broker, waiting for CONNACK");
-                    #endif
-                }
-    
-                return success;
-            } 
-        }
+    if(!force && (millis() - mqttReconnectNow < mqttReconnectInt))
+        return;
+
+    #ifdef TC_DBG
+    Serial.printf("MQTT: Attempting to (re)connect (%d)\n", mqttReconnFails);
+    #endif
+
+    mqttReconnectNow = millis();
+
+    if(mqttClient.connect(settings.hostName, 
+                          strlen(mqttUser) ? mqttUser : NULL, 
+                          strlen(mqttPass) ? mqttPass : NULL, 
+                          !mqttHadSession)) {
+        mqttConnPending = true;
+    } else {
+        mqttBackoff();
     }
-      
-    return true;
+}
+
+static void mqttBackoff()
+{
+    unsigned long t = MQTT_BACKOFF_MIN;
+
+    for(int i = 0; i < mqttReconnFails && t < MQTT_BACKOFF_MAX; i++) {
+        t <<= 1;
+    }
+    if(t > MQTT_BACKOFF_MAX) t = MQTT_BACKOFF_MAX;
+
+    if(mqttReconnFails < 0xffff) mqttReconnFails++;
+
+    mqttReconnectInt = (t / 2) + (esp_random() % ((t / 2) + 1));
+    mqttReconnectNow = millis();
+
+    #ifdef TC_DBG
+    Serial.printf("MQTT: Next connection attempt in %lums\n", mqttReconnectInt);
+    #endif
 }
 
 static void mqttSubscribe()
@@ -2058,19 +2526,217 @@ static void mqttSubscribe()
             Serial.println("MQTT: Subscribed to all topics");
             #endif
         }
+        if(!mqttClient.subscribe("bttf/tcd/config")) {
+            Serial.println("MQTT: Failed to subscribe to config topic");
+        }
         mqttSubAttempted = true;
     }
 }
 
+#if defined(TC_HAVETEMP) || defined(TC_HAVELIGHT)
+/*
+ * Publish min/max/avg of the sensor history (24 hours and
+ * 30 days) to bttf/tcd/sensors, formatted as JSON:
+ * {"temp":{"24h":[min,max,avg],"30d":[min,max,avg]},"hum":...}
+ * Channels without data are skipped.
+ */
+static void mqttPublishSensHist()
+{
+    char buf[256];
+    int len = 0, nch = 0;
+    int16_t vmin, vmax, vavg;
+    static const char *chNames[SH_NUMCH] = { "temp", "hum", "lux" };
+    static const char *rNames[2] = { "24h", "30d" };
+
+    len = sprintf(buf, "{");
+    
+    for(int i = 0; i < SH_NUMCH; i++) {
+        int nr = 0;
+        for(int j = 0; j < 2; j++) {
+            if(!sensHist.getStats(i, (j > 0), vmin, vmax, vavg))
+                continue;
+            if(!nr) {
+                len += sprintf(buf + len, "%s\"%s\":{", nch ? "," : "", chNames[i]);
+                nch++;
+            }
+            if(i == SH_TEMP) {
+                len += sprintf(buf + len, "%s\"%s\":[%.1f,%.1f,%.1f]", nr ? "," : "", rNames[j],
+                            (float)vmin / 10.0f, (float)vmax / 10.0f, (float)vavg / 10.0f);
+            } else {
+                len += sprintf(buf + len, "%s\"%s\":[%d,%d,%d]", nr ? "," : "", rNames[j], vmin, vmax, vavg);
+            }
+            nr++;
+        }
+        if(nr) len += sprintf(buf + len, "}");
+    }
+
+    len += sprintf(buf + len, "}");
+
+    mqttPublish("bttf/tcd/sensors", buf, len);
+}
+#endif
+
+/*
+ * Publish state to retained topics below bttf/tcd/state/
+ * Topics are only published when their value changed since the
+ * last time; messages are queued as QoS1 so that they survive
+ * a reconnect, and multiple changes of a topic while queued 
+ * are coalesced into the latest one.
+ */
+static void mqttPublishState()
+{
+    char buf[24];
+    int  len, mp;
+    static const char *stateTopics[MQTT_NUM_STATES] = {
+        "bttf/tcd/state/present",
+        "bttf/tcd/state/destination",
+        "bttf/tcd/state/departed",
+        "bttf/tcd/state/nightmode",
+        "bttf/tcd/state/alarm",
+        "bttf/tcd/state/music"
+    };
+    clockDisplay *disps[3] = { &presentTime, &destinationTime, &departedTime };
+
+    for(int i = 0; i < MQTT_NUM_STATES; i++) {
+        switch(i) {
+        case 0:
+        case 1:
+        case 2:
+            len = snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d", 
+                            disps[i]->getYear(), disps[i]->getMonth(), disps[i]->getDay(),
+                            disps[i]->getHour(), disps[i]->getMinute());
+            break;
+        case 3:
+            len = snprintf(buf, sizeof(buf), "%s", presentTime.getNightMode() ? "ON" : "OFF");
+            break;
+        case 4:
+            if(alarmOnOff && alarmHour <= 23 && alarmMinute <= 59) {
+                len = snprintf(buf, sizeof(buf), "ON %02d:%02d", alarmHour, alarmMinute);
+            } else {
+                len = snprintf(buf, sizeof(buf), "OFF");
+            }
+            break;
+        default:
+            if((mp = mp_get_currently_playing()) >= 0) {
+                len = snprintf(buf, sizeof(buf), "PLAYING %d", mp);
+            } else {
+                len = snprintf(buf, sizeof(buf), "STOPPED");
+            }
+        }
+        if(strcmp(buf, mqttStateCache[i])) {
+            if(mqttClient.queuePublish(stateTopics[i], (uint8_t *)buf, len, true)) {
+                strcpy(mqttStateCache[i], buf);
+            }
+        }
+    }
+}
+
+/*
+ * Telemetry
+ *
+ * Device health metrics are published to bttf/tcd/telemetry
+ * once per minute (if enabled), as JSON:
+ * uptime (s), free heap/min free heap (bytes), largest free heap
+ * block/its minimum (bytes), heap fragmentation/its maximum (%), 
+ * average and max loop time (us, since last report), WiFi RSSI (dBm), WiFi and 
+ * MQTT (re)connects, last and max MQTT time-to-reconnect (ms),
+ * round-trip time (ms) and age (s) of last NTP response, I2C errors,
+ * millis() rollovers.
+ */
+void mqttLoopStats(uint32_t us)
+{
+    if(us > loopTimeMax) loopTimeMax = us;
+    loopTimeSum += us;
+    loopCount++;
+}
+
+static void mqttPublishTelemetry()
+{
+    char buf[400];
+    int len;
+    
+    len = snprintf(buf, sizeof(buf),
+              "{\"uptime\":%llu,\"heap\":%u,\"heapmin\":%u,"
+              "\"heapblk\":%u,\"heapblkmin\":%u,\"heapfrag\":%d,\"heapfragmax\":%d,"
+              "\"loopavg\":%u,\"loopmax\":%u,"
+              "\"rssi\":%d,\"wifiConn\":%u,\"mqttConn\":%u,\"mqttTTR\":%lu,\"mqttTTRMax\":%lu,"
+              "\"ntpRTT\":%lu,\"ntpAge\":%ld,"
+              "\"i2cErr\":%u,\"rollovers\":%u}",
+              (((uint64_t)millis() + millisEpoch) / 1000ULL),
+              ESP.getFreeHeap(), ESP.getMinFreeHeap(),
+              heapMaxBlk, heapMaxBlkMin, heapFrag, heapFragMax,
+              loopCount ? loopTimeSum / loopCount : 0, loopTimeMax,
+              WiFi.RSSI(), wifiConnects, mqttConnects, mqttTTRLast, mqttTTRMax,
+              NTPLastRTT, NTPLastRcvd ? (long)((millis() - NTPLastRcvd) / 1000) : -1L,
+              i2cErrCount, (uint32_t)(millisEpoch >> 32));
+
+    loopTimeMax = loopTimeSum = loopCount = 0;
+
+    if(len > 0 && len < (int)sizeof(buf)) {
+        mqttPublish("bttf/tcd/telemetry", buf, len);
+    }
+}
+
+/*
+ * Home Assistant MQTT discovery for the telemetry values
+ * Sent (retained) after each connect.
+ */
+static void mqttPublishDiscovery()
+{
+    char topic[96], buf[400];
+    int len;
+    static const struct {
+        const char *key;
+        const char *name;
+        const char *unit;
+    } telemVals[] = {
+        { "uptime",   "Uptime",         "s"   },
+        { "heap",     "Free heap",      "B"   },
+        { "heapmin",  "Min free heap",  "B"   },
+        { "heapblk",  "Largest free heap block", "B" },
+        { "heapfrag", "Heap fragmentation", "%" },
+        { "loopmax",  "Max loop time",  "us"  },
+        { "rssi",     "WiFi RSSI",      "dBm" },
+        { "mqttTTR",  "MQTT reconnect time", "ms" },
+        { "ntpRTT",   "NTP round-trip", "ms"  },
+        { "i2cErr",   "I2C errors",     NULL  }
+    };
+
+    for(unsigned int i = 0; i < sizeof(telemVals) / sizeof(telemVals[0]); i++) {
+        snprintf(topic, sizeof(topic), "homeassistant/sensor/%s_%s/config", settings.hostName, telemVals[i].key);
+        len = snprintf(buf, sizeof(buf),
+              "{\"name\":\"%s\",\"uniq_id\":\"%s_%s\",\"stat_t\":\"bttf/tcd/telemetry\","
+              "\"val_tpl\":\"{{value_json.%s}}\",%s%s%s\"ent_cat\":\"diagnostic\","
+              "\"dev\":{\"ids\":[\"%s\"],\"name\":\"%s\",\"mf\":\"CircuitSetup\",\"mdl\":\"Time Circuits Display\"}}",
+              telemVals[i].name, settings.hostName, telemVals[i].key, telemVals[i].key,
+              telemVals[i].unit ? "\"unit_of_meas\":\"" : "",
+              telemVals[i].unit ? telemVals[i].unit : "",
+              telemVals[i].unit ? "\"," : "",
+              settings.hostName, settings.hostName);
+        if(len > 0 && len < (int)sizeof(buf)) {
+            mqttClient.publish(topic, (uint8_t *)buf, len, true);
+        }
+    }
+}
+
 bool mqttState()
 {
     return (useMQTT && mqttClient.connected());
 }
 
-void mqttPublish(const char *topic, const char *pl, unsigned int len)
+/*
+ * Publish a message. If "reliable" is set, the message is
+ * queued and sent with QoS1, so it is delivered even if the
+ * connection to the broker is temporarily lost.
+ */
+void mqttPublish(const char *topic, const char *pl, unsigned int len, bool reliable)
 {
     if(useMQTT) {
-        mqttClient.publish(topic, (uint8_t *)pl, len, false);
+        if(reliable) {
+            mqttClient.queuePublish(topic, (uint8_t *)pl, len, false);
+        } else {
+            mqttClient.publish(topic, (uint8_t *)pl, len, false);
+        }
     }
 }
 
@@ -59,7 +59,8 @@ void wifi_getMAC(char *buf);
 
 #ifdef TC_HAVEMQTT
 bool mqttState();
-void mqttPublish(const char *topic, const char *pl, unsigned int len);
+void mqttPublish(const char *topic, const char *pl, unsigned int len, bool reliable = false);
+void mqttLoopStats(uint32_t us);
 #endif
 
 #endif
@@ -793,6 +793,32 @@
 #include "tc_time.h"
 #include "tc_wifi.h"
 
+#ifdef TC_DBG
+static unsigned long bootStageNow = 0;
+
+static void bootStageDone(const char *stage)
+{
+    unsigned long now = millis();
+    Serial.printf("Boot: %s took %lums (%lums since power-up)\n", stage, now - bootStageNow, now - powerupMillis);
+    bootStageNow = now;
+}
+#define BOOT_STAGE_DONE(s) bootStageDone(s)
+#else
+#define BOOT_STAGE_DONE(s)
+#endif
+
+/*
+ * Boot stages and their dependencies:
+ * - time_boot:      none; clears displays, LEDs on as power-on feedback
+ * - settings_setup: FS/SD mount, config
+ * - wifi_setup:     settings (host name, timeouts, static IP)
+ * - audio_setup:    settings, SD
+ * - keypad_setup:   settings
+ * - time_setup:     all of the above (intro, NTP through WiFi)
+ * Peripherals with a power-up delay (RTC, GPS, sensors) count it 
+ * from powerupMillis, so their waits overlap with the stages 
+ * before time_setup instead of adding up.
+ */
 void setup() 
 {
     powerupMillis = millis();
@@ -803,18 +829,32 @@ void setup()
     Wire.begin(-1, -1, 100000);
 
     Serial.println();
+
+    #ifdef TC_DBG
+    bootStageNow = powerupMillis;
+    #endif
     
     time_boot();
+    BOOT_STAGE_DONE("time_boot");
     settings_setup();
+    BOOT_STAGE_DONE("settings_setup");
     wifi_setup();
+    BOOT_STAGE_DONE("wifi_setup");
     audio_setup();
+    BOOT_STAGE_DONE("audio_setup");
     keypad_setup();
+    BOOT_STAGE_DONE("keypad_setup");
     time_setup();
+    BOOT_STAGE_DONE("time_setup");
 }
 
 
 void loop() 
 {
+    #ifdef TC_HAVEMQTT
+    unsigned long loopStart = micros();
+    #endif
+    
     keypad_loop();
     scanKeypad();
     ntp_loop();
@@ -822,4 +862,8 @@ void loop()
     audio_loop();
     wifi_loop();
     audio_loop();
+
+    #ifdef TC_HAVEMQTT
+    mqttLoopStats(micros() - loopStart);
+    #endif
 }
\ No newline at end of file
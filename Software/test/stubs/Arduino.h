@@ -0,0 +1,91 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Minimal Arduino environment
+ *
+ * Only what the modules under test actually use. millis() is
+ * driven by the tests through stubMillis(), digitalRead() 
+ * through stubPinLevel(); Serial is mute.
+ * Stand-ins that use the host heap for their own bookkeeping
+ * open a StubHeapScope, so tests counting allocations of the
+ * code under test can tell them apart.
+ * -------------------------------------------------------------------
+ */
+
+#ifndef _TEST_ARDUINO_H
+#define _TEST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "binary.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define DEC 10
+#define HEX 16
+
+#define F(x) x
+
+inline unsigned long &stubMillis()
+{
+    static unsigned long t = 0;
+    return t;
+}
+
+inline int &stubHeap()
+{
+    static int depth = 0;
+    return depth;
+}
+
+struct StubHeapScope {
+    StubHeapScope()  { stubHeap()++; }
+    ~StubHeapScope() { stubHeap()--; }
+};
+
+inline int &stubPinLevel()
+{
+    static int level = HIGH;
+    return level;
+}
+
+inline unsigned long millis()            { return stubMillis(); }
+inline unsigned long micros()            { return stubMillis() * 1000UL; }
+inline void delay(unsigned long ms)      { stubMillis() += ms; }
+inline void yield()                      { }
+inline void pinMode(int, int)            { }
+inline void digitalWrite(int, int)       { }
+inline int  digitalRead(int)             { return stubPinLevel(); }
+inline uint32_t esp_random()             { return (uint32_t)rand(); }
+
+class HardwareSerial {
+    public:
+        void begin(unsigned long)        { }
+        size_t print(...)                { return 0; }
+        size_t println(...)              { return 0; }
+        size_t printf(const char *, ...) { return 0; }
+};
+
+static HardwareSerial Serial;
+
+#endif
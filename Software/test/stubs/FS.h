@@ -0,0 +1,180 @@
+/*
+ * Native unit tests: In-memory file system
+ *
+ * Files live in a map per file system; a File shares its data
+ * with the file system, so writes are visible as they happen.
+ * Fault injection:
+ * - spaceLeft: Bytes that can still be written (-1: unlimited);
+ *   writes beyond that are short ("file system full"), or, 
+ *   with silentFull set, claim success but store nothing.
+ * - failOpenW: Opening for writing fails.
+ * - failRename: rename() fails.
+ * - powerLeft: Power cut. Only that many bytes written, files
+ *   opened for writing, removed or renamed (-1: unlimited); 
+ *   after that, nothing changes anymore.
+ * The file system's own heap use is within a StubHeapScope; on
+ * the ESP32, the VFS allocates per open file, too.
+ */
+
+#ifndef _TEST_FS_H
+#define _TEST_FS_H
+
+#include "Arduino.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+class FS;
+
+class File {
+    public:
+        File() : _fs(NULL), _pos(0) { _name[0] = 0; }
+        File(FS *fs, const char *name, bool canWrite) : _fs(fs), _pos(0), _canWrite(canWrite)
+        {
+            strncpy(_name, name, sizeof(_name) - 1);
+            _name[sizeof(_name) - 1] = 0;
+        }
+
+        operator bool() const   { return _fs != NULL; }
+        const char *name() const { return _name; }
+
+        size_t size();
+        int    available()      { return (int)size() - (int)_pos; }
+        int    read();
+        size_t read(uint8_t *buf, size_t len);
+        size_t readBytes(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+        size_t write(uint8_t data)              { return write(&data, 1); }
+        size_t write(const uint8_t *buf, size_t len);
+        void   flush()          { }
+        void   close()          { _fs = NULL; }
+
+    private:
+        std::vector<uint8_t> *data();
+
+        FS          *_fs;
+        char        _name[64];
+        size_t      _pos;
+        bool        _canWrite = false;
+};
+
+class FS {
+    public:
+        File open(const char *path, const char *mode = FILE_READ, bool create = false)
+        {
+            StubHeapScope hs;
+            if(*mode == 'r') {
+                if(!exists(path)) return File();
+                return File(this, path, false);
+            }
+            if(failOpenW || !usePower()) return File();
+            if(*mode == 'w') files[path].clear();
+            else             files[path];
+            opensW++;
+            return File(this, path, true);
+        }
+
+        bool exists(const char *path) { StubHeapScope hs; return files.count(path) > 0; }
+        bool remove(const char *path) { StubHeapScope hs; return usePower() && files.erase(path) > 0; }
+
+        bool rename(const char *from, const char *to)
+        {
+            StubHeapScope hs;
+            if(failRename || !exists(from) || !usePower()) return false;
+            files[to] = files[from];
+            files.erase(from);
+            return true;
+        }
+
+        // Test side
+        void reset()
+        {
+            files.clear();
+            spaceLeft = -1;
+            silentFull = failOpenW = failRename = false;
+            opensW = 0;
+            powerLeft = -1;
+        }
+
+        bool usePower()
+        {
+            if(!powerLeft) return false;
+            if(powerLeft > 0) powerLeft--;
+            return true;
+        }
+
+        std::string content(const char *path)
+        {
+            std::vector<uint8_t>& d = files[path];
+            return std::string(d.begin(), d.end());
+        }
+
+        void setContent(const char *path, const char *text) { files[path].assign(text, text + strlen(text)); }
+
+        std::map<std::string, std::vector<uint8_t> > files;
+        long spaceLeft = -1;
+        bool silentFull = false;
+        bool failOpenW = false;
+        bool failRename = false;
+        int  opensW = 0;
+        long powerLeft = -1;
+};
+
+inline std::vector<uint8_t> *File::data()
+{
+    StubHeapScope hs;
+    if(!_fs || !_fs->exists(_name)) return NULL;
+    return &_fs->files[_name];
+}
+
+inline size_t File::size()
+{
+    std::vector<uint8_t> *d = data();
+    return d ? d->size() : 0;
+}
+
+inline int File::read()
+{
+    uint8_t c;
+    return read(&c, 1) ? c : -1;
+}
+
+inline size_t File::read(uint8_t *buf, size_t len)
+{
+    std::vector<uint8_t> *d = data();
+    if(!d || _pos >= d->size()) return 0;
+    if(len > d->size() - _pos) len = d->size() - _pos;
+    memcpy(buf, d->data() + _pos, len);
+    _pos += len;
+    return len;
+}
+
+inline size_t File::write(const uint8_t *buf, size_t len)
+{
+    StubHeapScope hs;
+    std::vector<uint8_t> *d = data();
+    size_t n = len;
+    if(!d || !_canWrite) return 0;
+    if(_fs->spaceLeft >= 0 && (long)n > _fs->spaceLeft) n = _fs->spaceLeft;
+    if(_fs->powerLeft >= 0 && (long)n > _fs->powerLeft) n = _fs->powerLeft;
+    d->insert(d->end(), buf, buf + n);
+    if(_fs->spaceLeft >= 0) _fs->spaceLeft -= n;
+    if(_fs->powerLeft >= 0) _fs->powerLeft -= n;
+    return _fs->silentFull ? len : n;
+}
+
+}   // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Native unit tests: IPAddress stub
+ */
+
+#ifndef _TEST_IPADDRESS_H
+#define _TEST_IPADDRESS_H
+
+#include <stdint.h>
+
+class IPAddress {
+    public:
+        IPAddress() : _addr(0) { }
+        IPAddress(uint32_t addr) : _addr(addr) { }
+        operator uint32_t() const { return _addr; }
+    private:
+        uint32_t _addr;
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Native unit tests: NVS stand-in
+ *
+ * Keys live in a map; failWrites makes putBytes() fail, as it 
+ * does when the NVS partition is full. The map's heap use is 
+ * within a StubHeapScope.
+ * powerLeft: Power cut after that many putBytes()/remove() 
+ * (-1: unlimited); NVS entries are written atomically.
+ */
+
+#ifndef _TEST_PREFERENCES_H
+#define _TEST_PREFERENCES_H
+
+#include "Arduino.h"
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+    public:
+        bool begin(const char *name, bool readOnly = false) { return available; }
+        void end() { }
+
+        bool   isKey(const char *key)  { StubHeapScope hs; return keys.count(key) > 0; }
+        bool   remove(const char *key) { StubHeapScope hs; return usePower() && keys.erase(key) > 0; }
+        bool   clear()                 { keys.clear(); return true; }
+
+        size_t getBytes(const char *key, void *buf, size_t len)
+        {
+            StubHeapScope hs;
+            if(!isKey(key)) return 0;
+            std::vector<uint8_t>& d = keys[key];
+            if(d.size() > len) return 0;
+            memcpy(buf, d.data(), d.size());
+            return d.size();
+        }
+
+        size_t putBytes(const char *key, const void *buf, size_t len)
+        {
+            StubHeapScope hs;
+            if(failWrites || !usePower()) return 0;
+            keys[key].assign((const uint8_t *)buf, (const uint8_t *)buf + len);
+            return len;
+        }
+
+        // Test side
+        bool usePower()
+        {
+            if(!powerLeft) return false;
+            if(powerLeft > 0) powerLeft--;
+            return true;
+        }
+
+        std::map<std::string, std::vector<uint8_t> > keys;
+        bool available = true;
+        bool failWrites = false;
+        long powerLeft = -1;
+};
+
+#endif
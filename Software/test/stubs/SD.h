@@ -0,0 +1,29 @@
+/*
+ * Native unit tests: SD card (in-memory file system, see FS.h)
+ */
+
+#ifndef _TEST_SD_H
+#define _TEST_SD_H
+
+#include "FS.h"
+#include "SPI.h"
+
+typedef enum {
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+class SDFS : public fs::FS {
+    public:
+        bool    begin(uint8_t ssPin = 5, SPIClass& spi = SPI, uint32_t frequency = 4000000) { return present; }
+        uint8_t cardType() { return present ? CARD_SDHC : CARD_NONE; }
+
+        bool present = false;
+};
+
+static SDFS SD;
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * Native unit tests: SPI stand-in
+ */
+
+#ifndef _TEST_SPI_H
+#define _TEST_SPI_H
+
+class SPIClass {
+    public:
+        void begin(int = -1, int = -1, int = -1, int = -1) { }
+};
+
+static SPIClass SPI;
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Native unit tests: Flash file system (in-memory, see FS.h)
+ */
+
+#ifndef _TEST_SPIFFS_H
+#define _TEST_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+    public:
+        bool begin(bool formatOnFail = false) { return mountable; }
+        bool format()                         { files.clear(); return true; }
+
+        bool mountable = true;
+};
+
+static SPIFFSFS SPIFFS;
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * Native unit tests: WiFi stub
+ */
+
+#ifndef _TEST_WIFI_H
+#define _TEST_WIFI_H
+
+#include "IPAddress.h"
+
+class WiFiClass {
+    public:
+        int hostByName(const char *, IPAddress &result) { result = IPAddress(0x0100007f); return 1; }
+};
+
+static WiFiClass WiFi;
+
+#endif
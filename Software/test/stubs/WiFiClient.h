@@ -0,0 +1,71 @@
+/*
+ * Native unit tests: Scripted WiFiClient
+ *
+ * Incoming data is whatever the test put in rx. Knobs:
+ * maxRead limits what a single read() hands out (like a socket
+ * returning short), failReads makes the next n reads fail with
+ * -1 without consuming anything. Outgoing data is collected in tx.
+ */
+
+#ifndef _TEST_WIFICLIENT_H
+#define _TEST_WIFICLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+class WiFiClient {
+    public:
+        WiFiClient() { }
+        WiFiClient(int) { }
+
+        // Test side
+        void feed(const uint8_t *buf, size_t len) { rx.insert(rx.end(), buf, buf + len); }
+        size_t pending()                          { return rx.size() - rxPos; }
+
+        std::vector<uint8_t> rx;
+        std::vector<uint8_t> tx;
+        size_t rxPos = 0;
+        size_t maxRead = 0;     // 0 = no limit
+        int    failReads = 0;
+        int    readCalls = 0;
+        bool   isConnected = true;
+
+        // Client side
+        int available() { return isConnected ? (int)pending() : 0; }
+
+        int read()
+        {
+            uint8_t c;
+            return (read(&c, 1) == 1) ? c : -1;
+        }
+
+        int read(uint8_t *buf, size_t size)
+        {
+            readCalls++;
+            if(failReads > 0) {
+                failReads--;
+                return -1;
+            }
+            if(maxRead && size > maxRead) size = maxRead;
+            if(size > pending()) size = pending();
+            if(!size) return -1;
+            memcpy(buf, &rx[rxPos], size);
+            rxPos += size;
+            return (int)size;
+        }
+
+        size_t write(const uint8_t *buf, size_t size)
+        {
+            if(!isConnected) return 0;
+            tx.insert(tx.end(), buf, buf + size);
+            return size;
+        }
+
+        uint8_t connected() { return isConnected; }
+        void stop()         { isConnected = false; }
+        void flush()        { }
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Native unit tests: Mock i2c bus
+ *
+ * Devices are attached to the bus by address; an address without
+ * a device NACKs. Every transmission (beginTransmission() up to
+ * endTransmission()) is handed to the device's write(), every
+ * requestFrom() to its read().
+ * I2CRegDevice is a plain register-mapped device: The first byte
+ * written selects the register, further bytes are stored from
+ * there; reads return the bytes starting at the selected register.
+ */
+
+#ifndef _TEST_WIRE_H
+#define _TEST_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class I2CDevice {
+    public:
+        virtual ~I2CDevice() { }
+        virtual void   write(const uint8_t *buf, size_t len) = 0;
+        virtual size_t read(uint8_t *buf, size_t len) = 0;
+};
+
+class I2CRegDevice : public I2CDevice {
+    public:
+        // regWidth: Bytes per register address
+        I2CRegDevice(int regWidth = 1) : _width(regWidth) { memset(regs, 0, sizeof(regs)); }
+
+        void write(const uint8_t *buf, size_t len)
+        {
+            if(!len) return;
+            ptr = buf[0];
+            for(size_t i = 1; i < len; i++) {
+                regs[(ptr * _width + i - 1) % sizeof(regs)] = buf[i];
+            }
+            writes++;
+        }
+
+        size_t read(uint8_t *buf, size_t len)
+        {
+            for(size_t i = 0; i < len; i++) {
+                buf[i] = regs[(ptr * _width + i) % sizeof(regs)];
+            }
+            reads++;
+            return len;
+        }
+
+        void set16(uint8_t reg, uint16_t val)   { regs[reg * _width] = val >> 8; regs[reg * _width + 1] = val & 0xff; }
+        void set16LE(uint8_t reg, uint16_t val) { regs[reg * _width] = val & 0xff; regs[reg * _width + 1] = val >> 8; }
+        uint16_t get16LE(uint8_t reg)           { return regs[reg * _width] | (regs[reg * _width + 1] << 8); }
+
+        uint8_t regs[512];
+        uint8_t ptr = 0;
+        int     writes = 0;
+        int     reads = 0;
+
+    private:
+        int     _width;
+};
+
+class TwoWire {
+    public:
+        TwoWire() { detachAll(); }
+
+        bool begin(int = -1, int = -1, uint32_t = 0) { return true; }
+        void setClock(uint32_t)                      { }
+
+        void beginTransmission(uint8_t address)
+        {
+            _txAddr = address;
+            _txLen = 0;
+        }
+
+        size_t write(uint8_t data)
+        {
+            if(_txLen >= sizeof(_txBuf)) return 0;
+            _txBuf[_txLen++] = data;
+            return 1;
+        }
+
+        size_t write(const uint8_t *data, size_t len)
+        {
+            for(size_t i = 0; i < len; i++) {
+                if(!write(data[i])) return i;
+            }
+            return len;
+        }
+
+        uint8_t endTransmission(bool sendStop = true)
+        {
+            I2CDevice *dev = device(_txAddr);
+            transactions++;
+            if(!dev) return 2;      // NACK on address
+            if(_txLen) dev->write(_txBuf, _txLen);
+            return 0;
+        }
+
+        uint8_t requestFrom(uint8_t address, uint8_t len)
+        {
+            I2CDevice *dev = device(address);
+            transactions++;
+            _rxLen = _rxPos = 0;
+            if(!dev) return 0;
+            if(len > sizeof(_rxBuf)) len = sizeof(_rxBuf);
+            _rxLen = dev->read(_rxBuf, len);
+            return _rxLen;
+        }
+
+        int read()      { return (_rxPos < _rxLen) ? _rxBuf[_rxPos++] : -1; }
+        int available() { return _rxLen - _rxPos; }
+
+        // Test side
+        void attach(uint8_t address, I2CDevice *dev) { _devs[address & 0x7f] = dev; }
+        void detachAll()                             { memset(_devs, 0, sizeof(_devs)); transactions = 0; }
+
+        int transactions;
+
+    private:
+        I2CDevice *device(uint8_t address) { return _devs[address & 0x7f]; }
+
+        I2CDevice *_devs[128];
+        uint8_t   _txAddr = 0;
+        uint8_t   _txBuf[32];
+        size_t    _txLen = 0;
+        uint8_t   _rxBuf[32];
+        size_t    _rxLen = 0;
+        size_t    _rxPos = 0;
+};
+
+static TwoWire Wire;
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Native unit tests: lwip socket API mapped to POSIX
+ */
+
+#ifndef _TEST_LWIP_SOCKETS_H
+#define _TEST_LWIP_SOCKETS_H
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define closesocket   close
+#define lwip_connect  ::connect
+
+#endif
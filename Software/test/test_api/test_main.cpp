@@ -0,0 +1,334 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: REST API request checks
+ *
+ * What the handlers answer with 503 (busy) or 400 (bad body,
+ * missing or bad parameter) is decided in tc_api.cpp.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "tc_api.cpp"
+
+// Stand-ins for what other modules provide
+
+int daysInMonth(int month, int year)
+{
+    const int mDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (!(year % 4) && (year % 100)) || !(year % 400);
+
+    return (month == 2 && leap) ? 29 : mDays[month - 1];
+}
+
+static StaticJsonDocument<256> json;
+
+// Parse body as apiPrepare() does; must be fine
+static void body(const char *s)
+{
+    json.clear();
+    TEST_ASSERT_EQUAL_INT_MESSAGE(200, apiParseBody(false, s, json), s);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_busy_and_body(void)
+{
+    // Busy wins, whatever the body
+    TEST_ASSERT_EQUAL(503, apiParseBody(true, NULL, json));
+    TEST_ASSERT_EQUAL(503, apiParseBody(true, "{}", json));
+    TEST_ASSERT_EQUAL(503, apiParseBody(true, "{bad", json));
+
+    // No body is fine (all parameters missing)
+    TEST_ASSERT_EQUAL(200, apiParseBody(false, NULL, json));
+    TEST_ASSERT_EQUAL(200, apiParseBody(false, "{}", json));
+    TEST_ASSERT_EQUAL(200, apiParseBody(false, " { \"speed\" : 5 } ", json));
+
+    // Not JSON, or not an object
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "{", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "{\"speed\":}", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "speed=5", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "5", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "\"speed\"", json));
+    TEST_ASSERT_EQUAL(400, apiParseBody(false, "true", json));
+}
+
+void test_getint(void)
+{
+    int v;
+
+    // Missing or null: Fine, -1
+    body("{}");
+    TEST_ASSERT_TRUE(apiGetInt(json, "n", 0, 10, v));
+    TEST_ASSERT_EQUAL(-1, v);
+    body("{\"n\":null}");
+    TEST_ASSERT_TRUE(apiGetInt(json, "n", 0, 10, v));
+    TEST_ASSERT_EQUAL(-1, v);
+
+    // Range, inclusive
+    body("{\"n\":0}");
+    TEST_ASSERT_TRUE(apiGetInt(json, "n", 0, 10, v));
+    TEST_ASSERT_EQUAL(0, v);
+    body("{\"n\":10}");
+    TEST_ASSERT_TRUE(apiGetInt(json, "n", 0, 10, v));
+    TEST_ASSERT_EQUAL(10, v);
+    body("{\"n\":11}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":-1}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":4294967296}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":1}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 2, 10, v));
+
+    // Wrong type
+    body("{\"n\":\"5\"}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":5.5}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":true}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+    body("{\"n\":{}}");
+    TEST_ASSERT_FALSE(apiGetInt(json, "n", 0, 10, v));
+}
+
+void test_timetravel(void)
+{
+    int speed;
+
+    body("{}");
+    TEST_ASSERT_TRUE(apiCheckTimeTravel(json, speed));
+    TEST_ASSERT_EQUAL(-1, speed);
+    body("{\"speed\":0}");
+    TEST_ASSERT_TRUE(apiCheckTimeTravel(json, speed));
+    TEST_ASSERT_EQUAL(0, speed);
+    body("{\"speed\":88}");
+    TEST_ASSERT_TRUE(apiCheckTimeTravel(json, speed));
+    TEST_ASSERT_EQUAL(88, speed);
+
+    body("{\"speed\":89}");
+    TEST_ASSERT_FALSE(apiCheckTimeTravel(json, speed));
+    body("{\"speed\":-1}");
+    TEST_ASSERT_FALSE(apiCheckTimeTravel(json, speed));
+    body("{\"speed\":\"88\"}");
+    TEST_ASSERT_FALSE(apiCheckTimeTravel(json, speed));
+}
+
+static bool dest(const char *s)
+{
+    int y, m, d, h, mi;
+
+    body(s);
+    return apiCheckDestination(json, y, m, d, h, mi);
+}
+
+void test_destination(void)
+{
+    int y, m, d, h, mi;
+
+    body("{\"year\":1985,\"month\":10,\"day\":26,\"hour\":1,\"minute\":21}");
+    TEST_ASSERT_TRUE(apiCheckDestination(json, y, m, d, h, mi));
+    TEST_ASSERT_EQUAL(1985, y);
+    TEST_ASSERT_EQUAL(10, m);
+    TEST_ASSERT_EQUAL(26, d);
+    TEST_ASSERT_EQUAL(1, h);
+    TEST_ASSERT_EQUAL(21, mi);
+
+    // All required
+    TEST_ASSERT_FALSE(dest("{}"));
+    TEST_ASSERT_FALSE(dest("{\"month\":10,\"day\":26,\"hour\":1,\"minute\":21}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"day\":26,\"hour\":1,\"minute\":21}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":10,\"hour\":1,\"minute\":21}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":10,\"day\":26,\"minute\":21}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":10,\"day\":26,\"hour\":1}"));
+
+    // Ranges
+    TEST_ASSERT_TRUE(dest("{\"year\":1,\"month\":1,\"day\":1,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_TRUE(dest("{\"year\":9999,\"month\":12,\"day\":31,\"hour\":23,\"minute\":59}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":0,\"month\":1,\"day\":1,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":10000,\"month\":1,\"day\":1,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":0,\"day\":1,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":13,\"day\":1,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":1,\"day\":0,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":1,\"day\":1,\"hour\":24,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":1,\"day\":1,\"hour\":0,\"minute\":60}"));
+
+    // Days per month
+    TEST_ASSERT_TRUE(dest("{\"year\":1985,\"month\":1,\"day\":31,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":4,\"day\":31,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_TRUE(dest("{\"year\":1985,\"month\":4,\"day\":30,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1985,\"month\":2,\"day\":29,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_TRUE(dest("{\"year\":1984,\"month\":2,\"day\":29,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":1900,\"month\":2,\"day\":29,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_TRUE(dest("{\"year\":2000,\"month\":2,\"day\":29,\"hour\":0,\"minute\":0}"));
+    TEST_ASSERT_FALSE(dest("{\"year\":2000,\"month\":2,\"day\":30,\"hour\":0,\"minute\":0}"));
+}
+
+void test_alarm(void)
+{
+    int onOff, h, m;
+
+    body("{}");
+    TEST_ASSERT_TRUE(apiCheckAlarm(json, onOff, h, m));
+    TEST_ASSERT_EQUAL(-1, onOff);
+    TEST_ASSERT_EQUAL(-1, h);
+    TEST_ASSERT_EQUAL(-1, m);
+
+    body("{\"hour\":7,\"minute\":30}");
+    TEST_ASSERT_TRUE(apiCheckAlarm(json, onOff, h, m));
+    TEST_ASSERT_EQUAL(7, h);
+    TEST_ASSERT_EQUAL(30, m);
+    TEST_ASSERT_EQUAL(-1, onOff);
+
+    body("{\"on\":false,\"hour\":0,\"minute\":0}");
+    TEST_ASSERT_TRUE(apiCheckAlarm(json, onOff, h, m));
+    TEST_ASSERT_EQUAL(0, onOff);
+
+    body("{\"on\":true}");
+    TEST_ASSERT_TRUE(apiCheckAlarm(json, onOff, h, m));
+    TEST_ASSERT_EQUAL(1, onOff);
+
+    // Hour and minute only together
+    body("{\"hour\":7}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"minute\":30}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"on\":true,\"minute\":0}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+
+    // Ranges, types
+    body("{\"hour\":24,\"minute\":0}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"hour\":23,\"minute\":60}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"hour\":-1,\"minute\":-1}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"on\":1}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+    body("{\"on\":\"true\"}");
+    TEST_ASSERT_FALSE(apiCheckAlarm(json, onOff, h, m));
+}
+
+void test_volume_beep(void)
+{
+    int v;
+
+    body("{\"volume\":0}");
+    TEST_ASSERT_TRUE(apiCheckVolume(json, v));
+    TEST_ASSERT_EQUAL(0, v);
+    body("{\"volume\":19}");
+    TEST_ASSERT_TRUE(apiCheckVolume(json, v));
+    TEST_ASSERT_EQUAL(19, v);
+    body("{\"volume\":20}");
+    TEST_ASSERT_FALSE(apiCheckVolume(json, v));
+    body("{}");
+    TEST_ASSERT_FALSE(apiCheckVolume(json, v));
+    body("{\"vol\":5}");
+    TEST_ASSERT_FALSE(apiCheckVolume(json, v));
+
+    body("{\"mode\":3}");
+    TEST_ASSERT_TRUE(apiCheckBeep(json, v));
+    TEST_ASSERT_EQUAL(3, v);
+    body("{\"mode\":4}");
+    TEST_ASSERT_FALSE(apiCheckBeep(json, v));
+    body("{}");
+    TEST_ASSERT_FALSE(apiCheckBeep(json, v));
+}
+
+void test_brightness(void)
+{
+    int b[3];
+
+    body("{}");
+    TEST_ASSERT_TRUE(apiCheckBrightness(json, b));
+    TEST_ASSERT_EQUAL(-1, b[0]);
+    TEST_ASSERT_EQUAL(-1, b[1]);
+    TEST_ASSERT_EQUAL(-1, b[2]);
+
+    body("{\"present\":15,\"departed\":0}");
+    TEST_ASSERT_TRUE(apiCheckBrightness(json, b));
+    TEST_ASSERT_EQUAL(-1, b[0]);
+    TEST_ASSERT_EQUAL(15, b[1]);
+    TEST_ASSERT_EQUAL(0, b[2]);
+
+    // One bad value fails all
+    body("{\"destination\":5,\"present\":16}");
+    TEST_ASSERT_FALSE(apiCheckBrightness(json, b));
+    body("{\"destination\":5,\"departed\":-1}");
+    TEST_ASSERT_FALSE(apiCheckBrightness(json, b));
+    body("{\"destination\":\"5\"}");
+    TEST_ASSERT_FALSE(apiCheckBrightness(json, b));
+}
+
+void test_music(void)
+{
+    const char *actions[4] = { "play", "stop", "next", "prev" };
+    int a, t, s;
+    char buf[32];
+
+    body("{}");
+    TEST_ASSERT_TRUE(apiCheckMusic(json, a, t, s));
+    TEST_ASSERT_EQUAL(API_MP_NONE, a);
+    TEST_ASSERT_EQUAL(-1, t);
+    TEST_ASSERT_EQUAL(-1, s);
+
+    for(int i = 0; i < 4; i++) {
+        snprintf(buf, sizeof(buf), "{\"action\":\"%s\"}", actions[i]);
+        body(buf);
+        TEST_ASSERT_TRUE_MESSAGE(apiCheckMusic(json, a, t, s), buf);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(API_MP_PLAY + i, a, buf);
+    }
+
+    body("{\"action\":\"next\",\"track\":999,\"shuffle\":true}");
+    TEST_ASSERT_TRUE(apiCheckMusic(json, a, t, s));
+    TEST_ASSERT_EQUAL(API_MP_NEXT, a);
+    TEST_ASSERT_EQUAL(999, t);
+    TEST_ASSERT_EQUAL(1, s);
+
+    body("{\"shuffle\":false}");
+    TEST_ASSERT_TRUE(apiCheckMusic(json, a, t, s));
+    TEST_ASSERT_EQUAL(0, s);
+
+    // Unknown actions, wrong types, ranges
+    body("{\"action\":\"pause\"}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"action\":\"PLAY\"}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"action\":\"play \"}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"action\":\"\"}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"action\":1}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"shuffle\":\"yes\"}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"track\":1000}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+    body("{\"action\":\"play\",\"track\":-1}");
+    TEST_ASSERT_FALSE(apiCheckMusic(json, a, t, s));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_busy_and_body);
+    RUN_TEST(test_getint);
+    RUN_TEST(test_timetravel);
+    RUN_TEST(test_destination);
+    RUN_TEST(test_alarm);
+    RUN_TEST(test_volume_beep);
+    RUN_TEST(test_brightness);
+    RUN_TEST(test_music);
+    return UNITY_END();
+}
@@ -0,0 +1,193 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Heap use of settings I/O
+ *
+ * operator new and malloc() count allocations; saving and loading
+ * the alarm and the main config in a loop must not allocate.
+ * Allocations of the file system and NVS stand-ins for their own
+ * bookkeeping (StubHeapScope) are not counted.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <new>
+
+#include "tc_settings.cpp"
+
+static bool counting = false;
+static int  allocs = 0;
+
+static void countAlloc()
+{
+    if(counting && !stubHeap()) allocs++;
+}
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t num, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    countAlloc();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t num, size_t size)
+{
+    countAlloc();
+    return __libc_calloc(num, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    countAlloc();
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+void *operator new(size_t size)
+{
+    void *p;
+
+    countAlloc();
+    if(!(p = malloc(size ? size : 1))) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)              { return operator new(size); }
+void operator delete(void *ptr) noexcept       { free(ptr); }
+void operator delete[](void *ptr) noexcept     { free(ptr); }
+
+// Stand-ins for what other modules provide
+
+Settings   settings;
+IPSettings ipsettings;
+
+bool    alarmOnOff = false;
+uint8_t alarmHour = 255;
+uint8_t alarmMinute = 255;
+uint8_t alarmWeekday = 0;
+uint8_t remMonth = 0, remDay = 0, remHour = 0, remMin = 0;
+uint8_t curVolume = 0;
+
+bool checkTZ(const char *tz) { return true; }
+
+clockDisplay::clockDisplay(uint8_t did, uint8_t address) { }
+void clockDisplay::showTextDirect(const char *text, uint16_t flags) { }
+clockDisplay destinationTime(DISP_DEST, 0x71);   // Only used for "WAIT" at boot
+
+void start_file_copy() { }
+void file_copy_progress() { }
+void file_copy_done() { }
+void file_copy_error() { }
+
+// Save/load cycles with changing values
+static void cycle(int loops)
+{
+    for(int i = 0; i < loops; i++) {
+        alarmOnOff = i & 1;
+        alarmHour = i % 24;
+        alarmMinute = i % 60;
+        alarmWeekday = i % 10;
+        saveAlarm();
+
+        alarmHour = alarmMinute = 0;
+        loadAlarm();
+
+        sprintf(settings.beep, "%d", i % 4);
+        strcpy(settings.timeZone, (i & 1) ? "CST6CDT,M3.2.0,M11.1.0" : "UTC0");
+        write_settings();
+    }
+}
+
+// Run once to warm up, then count
+static int countCycles(int loops)
+{
+    cycle(1);
+
+    allocs = 0;
+    counting = true;
+    cycle(loops);
+    counting = false;
+
+    return allocs;
+}
+
+void setUp(void)
+{
+    SPIFFS.reset();
+    SD.reset();
+    nvsPrefs.clear();
+    nvsPrefs.failWrites = false;
+    haveFS = haveNVS = true;
+    haveSD = FlashROMode = configOnSD = false;
+    settings = Settings();
+}
+
+void tearDown(void)
+{
+    counting = false;
+}
+
+// The counter itself
+void test_counter(void)
+{
+    counting = true;
+    char *p = (char *)malloc(16);
+    int  *q = new int[4];
+    counting = false;
+
+    free(p);
+    delete [] q;
+
+    TEST_ASSERT_GREATER_OR_EQUAL(2, allocs);
+}
+
+void test_flash_no_heap(void)
+{
+    TEST_ASSERT_EQUAL_INT(0, countCycles(100));
+
+    // Last cycle is on file
+    TEST_ASSERT_TRUE(loadAlarm());
+    TEST_ASSERT_EQUAL_INT(99 % 24, alarmHour);
+    TEST_ASSERT_EQUAL_INT(99 % 60, alarmMinute);
+    TEST_ASSERT_TRUE(SPIFFS.content(cfgName).find("\"beep\":\"3\"") != std::string::npos);
+}
+
+void test_sd_no_heap(void)
+{
+    haveSD = configOnSD = true;
+
+    TEST_ASSERT_EQUAL_INT(0, countCycles(100));
+    TEST_ASSERT_TRUE(SD.exists(almCfgName));
+}
+
+// A bad alarm file is replaced with defaults
+void test_default_no_heap(void)
+{
+    cycle(1);
+    SPIFFS.setContent(almCfgName, "{\"alarmonoff\":");
+
+    allocs = 0;
+    counting = true;
+    loadAlarm();
+    counting = false;
+
+    TEST_ASSERT_EQUAL_INT(0, allocs);
+    TEST_ASSERT_EQUAL_INT(255, alarmHour);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_counter);
+    RUN_TEST(test_flash_no_heap);
+    RUN_TEST(test_sd_no_heap);
+    RUN_TEST(test_default_no_heap);
+    return UNITY_END();
+}
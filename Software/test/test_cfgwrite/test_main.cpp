@@ -0,0 +1,378 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Crash-safe config file writing
+ *
+ * Flash FS, SD and NVS are in-memory; faults (file system full, 
+ * lying writes, failed open/rename) are injected through the 
+ * stubs. Power loss is simulated by leaving files in the state 
+ * an interrupted write would, and running the boot-time recovery,
+ * and by cutting power during write_settings() after every byte 
+ * and file operation, then booting with settings_setup().
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "tc_settings.cpp"
+
+// Stand-ins for what other modules provide
+
+Settings   settings;
+IPSettings ipsettings;
+
+bool    alarmOnOff = false;
+uint8_t alarmHour = 255;
+uint8_t alarmMinute = 255;
+uint8_t alarmWeekday = 0;
+uint8_t remMonth = 0, remDay = 0, remHour = 0, remMin = 0;
+uint8_t curVolume = 0;
+
+bool checkTZ(const char *tz) { return true; }
+
+clockDisplay::clockDisplay(uint8_t did, uint8_t address) { }
+void clockDisplay::showTextDirect(const char *text, uint16_t flags) { }
+clockDisplay destinationTime(DISP_DEST, 0x71);   // Only used for "WAIT" at boot
+
+void start_file_copy() { }
+void file_copy_progress() { }
+void file_copy_done() { }
+void file_copy_error() { }
+
+static const char *oldCfg = "{\"beep\":\"0\"}";
+
+void setUp(void)
+{
+    SPIFFS.reset();
+    SD.reset();
+    nvsPrefs.clear();
+    nvsPrefs.failWrites = false;
+    haveFS = haveNVS = true;
+    haveSD = FlashROMode = configOnSD = false;
+    settings = Settings();
+    SD.present = false;
+    SPIFFS.powerLeft = nvsPrefs.powerLeft = -1;
+    stubPinLevel() = LOW;   // ENTER not held
+}
+
+void tearDown(void)
+{
+}
+
+void test_tmp_name(void)
+{
+    char tmpName[sizeof(cfgTmpName)];
+
+    makeTmpName("/tcdalmcfg.json", tmpName);
+    TEST_ASSERT_EQUAL_STRING("/tcdalmcfg.tmp", tmpName);
+
+    makeTmpName("/noext", tmpName);
+    TEST_ASSERT_EQUAL_STRING("/noext.tmp", tmpName);
+
+    makeTmpName("/a_rather_long_config_file_name.json", tmpName);
+    TEST_ASSERT_EQUAL_INT(sizeof(cfgTmpName) - 1, strlen(tmpName));
+    TEST_ASSERT_EQUAL_STRING(".tmp", tmpName + strlen(tmpName) - 4);
+}
+
+void test_write_replaces(void)
+{
+    SPIFFS.setContent(cfgName, oldCfg);
+    strcpy(settings.beep, "2");
+
+    write_settings();
+
+    TEST_ASSERT_TRUE(SPIFFS.content(cfgName).find("\"beep\":\"2\"") != std::string::npos);
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+    TEST_ASSERT_EQUAL_INT(1, SPIFFS.opensW);
+    // Snapshot follows the file
+    TEST_ASSERT_TRUE(nvsPrefs.isKey("cfghdr"));
+    TEST_ASSERT_TRUE(loadSettingsSnapshot());
+}
+
+void test_fs_full_keeps_original(void)
+{
+    SPIFFS.setContent(cfgName, oldCfg);
+    SPIFFS.spaceLeft = 100;
+    strcpy(settings.beep, "2");
+
+    write_settings();
+
+    TEST_ASSERT_EQUAL_STRING(oldCfg, SPIFFS.content(cfgName).c_str());
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+    TEST_ASSERT_FALSE(nvsPrefs.isKey("cfghdr"));
+}
+
+void test_lying_write_keeps_original(void)
+{
+    // Writes claim success, but the data does not make it
+    SPIFFS.setContent(cfgName, oldCfg);
+    SPIFFS.spaceLeft = 100;
+    SPIFFS.silentFull = true;
+
+    write_settings();
+
+    TEST_ASSERT_EQUAL_STRING(oldCfg, SPIFFS.content(cfgName).c_str());
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+}
+
+void test_open_fails(void)
+{
+    SPIFFS.setContent(cfgName, oldCfg);
+    SPIFFS.failOpenW = true;
+
+    write_settings();
+
+    TEST_ASSERT_EQUAL_STRING(oldCfg, SPIFFS.content(cfgName).c_str());
+    TEST_ASSERT_EQUAL_INT(1, (int)SPIFFS.files.size());
+}
+
+void test_rename_fails_then_recover(void)
+{
+    // Like power loss between removing the old and renaming the new file
+    SPIFFS.setContent(cfgName, oldCfg);
+    SPIFFS.failRename = true;
+    strcpy(settings.beep, "3");
+
+    write_settings();
+
+    TEST_ASSERT_FALSE(SPIFFS.exists(cfgName));
+    TEST_ASSERT_TRUE(SPIFFS.exists("/config.tmp"));
+
+    SPIFFS.failRename = false;
+    recoverCfgFiles(false);
+
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+    TEST_ASSERT_TRUE(SPIFFS.content(cfgName).find("\"beep\":\"3\"") != std::string::npos);
+}
+
+void test_recover_discards_incomplete(void)
+{
+    // Only a truncated temporary file; nothing to recover
+    SPIFFS.setContent("/config.tmp", "{\"timeTrPers\":\"0\",\"beep\":\"1");
+
+    recoverCfgFiles(false);
+
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+    TEST_ASSERT_FALSE(SPIFFS.exists(cfgName));
+}
+
+void test_recover_keeps_original(void)
+{
+    // Interrupted while writing the temporary file
+    SPIFFS.setContent(cfgName, oldCfg);
+    SPIFFS.setContent("/config.tmp", "{\"beep\":\"1\"}");
+
+    recoverCfgFiles(false);
+
+    TEST_ASSERT_FALSE(SPIFFS.exists("/config.tmp"));
+    TEST_ASSERT_EQUAL_STRING(oldCfg, SPIFFS.content(cfgName).c_str());
+}
+
+void test_recover_all_files(void)
+{
+    SD.setContent("/tcdalmcfg.tmp", "{\"alarmonoff\":\"1\",\"alarmhour\":\"7\",\"alarmmin\":\"30\"}");
+    SD.setContent("/tcdvolcfg.tmp", "{\"volume\":");
+    SD.setContent("/tcdmcfg.json", "{\"folder\":\"1\"}");
+    SD.setContent("/tcdmcfg.tmp", "{\"folder\":\"2\"}");
+
+    recoverCfgFiles(true);
+
+    TEST_ASSERT_TRUE(SD.exists(almCfgName));
+    TEST_ASSERT_FALSE(SD.exists("/tcdalmcfg.tmp"));
+    TEST_ASSERT_FALSE(SD.exists(volCfgName));
+    TEST_ASSERT_FALSE(SD.exists("/tcdvolcfg.tmp"));
+    TEST_ASSERT_EQUAL_STRING("{\"folder\":\"1\"}", SD.content(musCfgName).c_str());
+    TEST_ASSERT_FALSE(SD.exists("/tcdmcfg.tmp"));
+    TEST_ASSERT_EQUAL_INT(2, (int)SD.files.size());
+}
+
+void test_sd_alarm(void)
+{
+    const char *oldAlm = "{\"alarmonoff\":\"0\",\"alarmhour\":\"6\",\"alarmmin\":\"0\"}";
+
+    haveSD = configOnSD = true;
+    SD.setContent(almCfgName, oldAlm);
+    alarmOnOff = true;
+    alarmHour = 7;
+    alarmMinute = 45;
+
+    SD.spaceLeft = 10;
+    saveAlarm();
+    TEST_ASSERT_EQUAL_STRING(oldAlm, SD.content(almCfgName).c_str());
+    TEST_ASSERT_FALSE(SD.exists("/tcdalmcfg.tmp"));
+
+    SD.spaceLeft = -1;
+    saveAlarm();
+    TEST_ASSERT_FALSE(SD.exists("/tcdalmcfg.tmp"));
+    TEST_ASSERT_FALSE(SPIFFS.exists(almCfgName));
+
+    alarmOnOff = false;
+    alarmHour = alarmMinute = 0;
+    TEST_ASSERT_TRUE(loadAlarm());
+    TEST_ASSERT_TRUE(alarmOnOff);
+    TEST_ASSERT_EQUAL_INT(7, alarmHour);
+    TEST_ASSERT_EQUAL_INT(45, alarmMinute);
+}
+
+/*
+ * Power cuts: write_settings() replaces config A with config B,
+ * and power is cut after every possible number of bytes and 
+ * file (or NVS) operations. Booting must then always come up
+ * with either A or B, from a valid file, without leftovers; 
+ * once B made it, it must stay.
+ */
+struct FSImage {
+    std::map<std::string, std::vector<uint8_t> > flash, sd, nvs;
+
+    void save()    { flash = SPIFFS.files; sd = SD.files; nvs = nvsPrefs.keys; }
+    void restore() { SPIFFS.files = flash; SD.files = sd; nvsPrefs.keys = nvs; }
+};
+
+static void boot()
+{
+    settings = Settings();
+    haveSD = FlashROMode = configOnSD = false;
+    settings_setup();
+}
+
+static bool sameSettings(const Settings& a, const Settings& b)
+{
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        if(strcmp((const char *)&a + settingsSchema[i].offs, (const char *)&b + settingsSchema[i].offs))
+            return false;
+    }
+    return true;
+}
+
+static void setConfigA()
+{
+    settings = Settings();
+    strcpy(settings.beep, "1");
+    strcpy(settings.timeZone, "UTC0");
+}
+
+static void setConfigB()
+{
+    settings = Settings();
+    strcpy(settings.beep, "2");
+    strcpy(settings.timeZone, "CST6CDT,M3.2.0,M11.1.0");
+    strcpy(settings.autoRotateTimes, "3");
+}
+
+static void powerCuts(FS& fs, bool cutNVS)
+{
+    FSImage img;
+    Settings expA, expB;
+    std::string fileA, fileB;
+    int numA = 0, numB = 0, numGap = 0;
+    long cut;
+    char msg[32];
+
+    // First boot writes defaults; then A, written properly
+    boot();
+    setConfigA();
+    write_settings();
+    boot();
+    expA = settings;
+    fileA = fs.content(cfgName);
+    img.save();
+
+    // Reference: Replaced with B without interruption
+    setConfigB();
+    write_settings();
+    boot();
+    expB = settings;
+    fileB = fs.content(cfgName);
+
+    TEST_ASSERT_FALSE(sameSettings(expA, expB));
+
+    for(cut = 0; ; cut++) {
+        bool complete;
+
+        snprintf(msg, sizeof(msg), "cut after %ld", cut);
+
+        img.restore();
+        setConfigB();
+        if(cutNVS) nvsPrefs.powerLeft = cut;
+        else       fs.powerLeft = cut;
+
+        write_settings();
+
+        complete = (cutNVS ? nvsPrefs.powerLeft : fs.powerLeft) > 0;
+        fs.powerLeft = nvsPrefs.powerLeft = -1;
+
+        // Old file removed, new one not yet renamed
+        if(!fs.exists(cfgName) && fs.exists("/config.tmp")) numGap++;
+
+        boot();
+
+        if(sameSettings(settings, expB)) {
+            numB++;
+            TEST_ASSERT_TRUE_MESSAGE(fileB == fs.content(cfgName), msg);
+        } else {
+            TEST_ASSERT_TRUE_MESSAGE(sameSettings(settings, expA), msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(0, numB, msg);
+            TEST_ASSERT_TRUE_MESSAGE(fileA == fs.content(cfgName), msg);
+            numA++;
+        }
+        TEST_ASSERT_FALSE_MESSAGE(fs.exists("/config.tmp"), msg);
+
+        // Next boot is the same
+        boot();
+        TEST_ASSERT_TRUE_MESSAGE(sameSettings(settings, numB ? expB : expA), msg);
+
+        if(complete) break;
+    }
+
+    if(cutNVS) {
+        // Config file was complete before NVS was touched
+        TEST_ASSERT_EQUAL_INT(0, numA);
+    } else {
+        // Before opening, and after each byte of the temporary file
+        TEST_ASSERT_EQUAL_INT((int)fileB.size() + 2, numA);
+        TEST_ASSERT_EQUAL_INT(1, numGap);
+    }
+    TEST_ASSERT_GREATER_THAN(0, numB);
+}
+
+void test_power_cut_flash(void)
+{
+    powerCuts(SPIFFS, false);
+}
+
+void test_power_cut_nvs(void)
+{
+    // While updating the settings snapshot
+    powerCuts(SPIFFS, true);
+}
+
+void test_power_cut_sd(void)
+{
+    // Flash-RO mode: Config on SD only
+    SD.present = true;
+    SD.setContent("/TCD_FLASH_RO", "");
+    powerCuts(SD, false);
+    TEST_ASSERT_FALSE(SPIFFS.exists(cfgName));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tmp_name);
+    RUN_TEST(test_write_replaces);
+    RUN_TEST(test_fs_full_keeps_original);
+    RUN_TEST(test_lying_write_keeps_original);
+    RUN_TEST(test_open_fails);
+    RUN_TEST(test_rename_fails_then_recover);
+    RUN_TEST(test_recover_discards_incomplete);
+    RUN_TEST(test_recover_keeps_original);
+    RUN_TEST(test_recover_all_files);
+    RUN_TEST(test_sd_alarm);
+    RUN_TEST(test_power_cut_flash);
+    RUN_TEST(test_power_cut_nvs);
+    RUN_TEST(test_power_cut_sd);
+    return UNITY_END();
+}
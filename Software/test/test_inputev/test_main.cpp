@@ -0,0 +1,267 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Input event queue
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "tc_inputev.cpp"
+
+#define QUEUE_CAP (TCI_QUEUE_SIZE - 1)
+
+void setUp(void)
+{
+    stubMillis() = 100000;
+    inputEvFlush();
+}
+
+void tearDown(void)
+{
+}
+
+static int drain(char *keys)
+{
+    inputEvent ev;
+    int n = 0;
+
+    while(inputEvGet(ev)) {
+        if(keys) keys[n] = ev.key;
+        n++;
+    }
+    if(keys) keys[n] = 0;
+
+    return n;
+}
+
+void test_fifo(void)
+{
+    inputEvent ev;
+
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_KEY, '2');
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_KEY, '3');
+
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_KEY, ev.type);
+    TEST_ASSERT_EQUAL_INT('1', ev.key);
+    TEST_ASSERT_EQUAL_INT(100000, ev.time);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT('2', ev.key);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_ENTER, ev.type);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT('3', ev.key);
+    TEST_ASSERT_FALSE(inputEvGet(ev));
+}
+
+void test_full_drops_new(void)
+{
+    char keys[TCI_QUEUE_SIZE + 1];
+
+    for(int i = 0; i < QUEUE_CAP; i++) {
+        TEST_ASSERT_TRUE(inputEvAdd(TCI_KEY, 'a' + i));
+    }
+    TEST_ASSERT_FALSE(inputEvAdd(TCI_KEY, 'z'));
+    TEST_ASSERT_FALSE(inputEvAdd(TCI_ENTER));
+
+    TEST_ASSERT_EQUAL_INT(QUEUE_CAP, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("abcdefghijklmno", keys);
+}
+
+/*
+ * Someone hammering the keypad at 20 keys/s while the main loop 
+ * is busy playing a sequence for 700ms at a time: Nothing may
+ * get lost, nothing may be reordered.
+ */
+void test_20_keys_per_second(void)
+{
+    char sent[256], got[256];
+    int ns = 0, ng = 0;
+    unsigned long busyUntil = millis() + 700;
+
+    for(int t = 0; t < 10000; t += 10) {
+        if(!(t % 50)) {
+            sent[ns] = '0' + (ns % 10);
+            TEST_ASSERT_TRUE(inputEvAdd(TCI_KEY, sent[ns]));
+            ns++;
+        }
+        if(millis() >= busyUntil) {
+            ng += drain(got + ng);
+            if(!(t % 1000)) busyUntil = millis() + 700;
+        }
+        stubMillis() += 10;
+    }
+    ng += drain(got + ng);
+    sent[ns] = 0;
+
+    TEST_ASSERT_EQUAL_INT(200, ns);
+    TEST_ASSERT_EQUAL_INT(ns, ng);
+    TEST_ASSERT_EQUAL_STRING(sent, got);
+}
+
+void test_replay(void)
+{
+    inputEvent evs[20];
+    char keys[21];
+    unsigned long t0 = millis();
+
+    for(int i = 0; i < 20; i++) {
+        evs[i].type = TCI_KEY;
+        evs[i].key = 'A' + i;
+        evs[i].time = t0 + i * 50;
+    }
+
+    TEST_ASSERT_EQUAL_INT(QUEUE_CAP, inputEvReplay(evs, 20));
+
+    stubMillis() = t0 + 1000;
+    TEST_ASSERT_EQUAL_INT(QUEUE_CAP, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("ABCDEFGHIJKLMNO", keys);
+}
+
+void test_coalesce_actions(void)
+{
+    inputEvent ev;
+
+    inputEvAdd(TCI_ENTER);
+    stubMillis() += 100;
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_ETT);
+    inputEvAdd(TCI_ETT);
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_KEYHOLD, '1');
+    inputEvAdd(TCI_KEYHOLD, '2');
+
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_ENTER, ev.type);
+    TEST_ASSERT_EQUAL_INT(100100, ev.time);     // time of the last one
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_ETT, ev.type);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_ENTER, ev.type);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT('1', ev.key);
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT('2', ev.key);
+    TEST_ASSERT_FALSE(inputEvGet(ev));
+}
+
+void test_digits_not_coalesced(void)
+{
+    char keys[8];
+
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_KEY, '1');
+
+    TEST_ASSERT_EQUAL_INT(3, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("111", keys);
+}
+
+void test_expiry(void)
+{
+    inputEvent ev;
+
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_KEY, '5');
+    inputEvAdd(TCI_ETT);
+
+    // Actions are stale after TCI_MAX_AGE, digits live on
+    stubMillis() += TCI_MAX_AGE + 1;
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_KEY, ev.type);
+    TEST_ASSERT_FALSE(inputEvGet(ev));
+
+    inputEvAdd(TCI_KEY, '6');
+    stubMillis() += TCI_KEY_MAX_AGE;
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT('6', ev.key);
+
+    inputEvAdd(TCI_KEY, '7');
+    stubMillis() += TCI_KEY_MAX_AGE + 1;
+    TEST_ASSERT_FALSE(inputEvGet(ev));
+}
+
+void test_expiry_across_wrap(void)
+{
+    inputEvent ev;
+
+    // millis() rolling over must not make events expire
+    stubMillis() = (unsigned long)-500;
+    inputEvAdd(TCI_ENTER);
+    stubMillis() += 1000;
+    TEST_ASSERT_TRUE(inputEvGet(ev));
+    TEST_ASSERT_EQUAL_INT(TCI_ENTER, ev.type);
+}
+
+void test_take(void)
+{
+    char keys[8];
+
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_ENTERHOLD);
+    inputEvAdd(TCI_KEY, '2');
+    inputEvAdd(TCI_ENTERHOLD);
+    inputEvAdd(TCI_KEY, '3');
+
+    TEST_ASSERT_TRUE(inputEvTake(TCI_ENTERHOLD));
+    TEST_ASSERT_TRUE(inputEvTake(TCI_ENTERHOLD));
+    TEST_ASSERT_FALSE(inputEvTake(TCI_ENTERHOLD));
+    TEST_ASSERT_FALSE(inputEvTake(TCI_ETT));
+
+    TEST_ASSERT_EQUAL_INT(3, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("123", keys);
+}
+
+void test_flush(void)
+{
+    char keys[8];
+
+    // Wrap the ring first
+    for(int i = 0; i < 10; i++) inputEvAdd(TCI_KEY, 'x');
+    drain(NULL);
+
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_KEY, '2');
+    inputEvAdd(TCI_ENTERHOLD);
+    inputEvAdd(TCI_ENTER);
+    inputEvAdd(TCI_KEY, '3');
+    inputEvAdd(TCI_ENTER);
+
+    inputEvFlush(TCI_ENTER);
+    TEST_ASSERT_TRUE(inputEvTake(TCI_ENTERHOLD));
+    TEST_ASSERT_EQUAL_INT(3, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("123", keys);
+
+    inputEvAdd(TCI_KEY, '1');
+    inputEvAdd(TCI_ENTER);
+    inputEvFlush();
+    TEST_ASSERT_EQUAL_INT(0, drain(NULL));
+
+    // Usable after flushing
+    inputEvAdd(TCI_KEY, '9');
+    TEST_ASSERT_EQUAL_INT(1, drain(keys));
+    TEST_ASSERT_EQUAL_STRING("9", keys);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo);
+    RUN_TEST(test_full_drops_new);
+    RUN_TEST(test_20_keys_per_second);
+    RUN_TEST(test_replay);
+    RUN_TEST(test_coalesce_actions);
+    RUN_TEST(test_digits_not_coalesced);
+    RUN_TEST(test_expiry);
+    RUN_TEST(test_expiry_across_wrap);
+    RUN_TEST(test_take);
+    RUN_TEST(test_flush);
+    return UNITY_END();
+}
@@ -0,0 +1,258 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Keypad scanning
+ *
+ * Keypad_I2C on a mock PCF8574: i2c traffic while idle, and
+ * bouncing contacts reaching the event listener exactly once
+ * per press, hold and release.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "input.cpp"
+
+// As in tc_keypad.cpp
+#define KEYPAD_ADDR     0x20
+#define SCAN_INTERVAL   20
+#define HOLD_TIME       2000
+
+static const char keys[4*3] = {
+     '1', '2', '3',
+     '4', '5', '6',
+     '7', '8', '9',
+     '*', '0', '#'
+};
+
+static const uint8_t rowPins[4] = {1, 6, 5, 3};
+static const uint8_t colPins[3] = {2, 0, 4};
+
+/*
+ * PCF8574: Quasi-bidirectional port. A pin written HIGH is weakly
+ * pulled up and can be pulled LOW from outside; a closed key
+ * connects its row and column pins, so if either is driven LOW,
+ * both read LOW.
+ */
+class PCF8574 : public I2CDevice {
+    public:
+        void write(const uint8_t *buf, size_t len)
+        {
+            if(len) latch = buf[len - 1];
+            writes++;
+        }
+
+        size_t read(uint8_t *buf, size_t len)
+        {
+            uint8_t val = latch;
+
+            if(key >= 0 && closed) {
+                uint8_t pins = (1 << rowPins[key / 3]) | (1 << colPins[key % 3]);
+                if((latch & pins) != pins) val &= ~pins;
+            }
+            for(size_t i = 0; i < len; i++) buf[i] = val;
+            reads++;
+            return len;
+        }
+
+        uint8_t latch = 0xff;
+        int     key = -1;
+        bool    closed = false;
+        int     writes = 0;
+        int     reads = 0;
+};
+
+static PCF8574 *pcf;
+
+static char     evChar[32];
+static KeyState evState[32];
+static int      numEv;
+
+static void listener(char key, KeyState kstate)
+{
+    if(numEv < 32) {
+        evChar[numEv] = key;
+        evState[numEv] = kstate;
+    }
+    numEv++;
+}
+
+static Keypad_I2C *newKeypad()
+{
+    Keypad_I2C *kp = new Keypad_I2C((char *)keys, rowPins, colPins, 4, 3, KEYPAD_ADDR);
+
+    kp->begin();
+    kp->addEventListener(listener);
+    kp->setScanInterval(SCAN_INTERVAL);
+    kp->setHoldTime(HOLD_TIME);
+
+    return kp;
+}
+
+// Poll keypad every millisecond, as the main loop roughly does
+static void runFor(Keypad_I2C *kp, unsigned long ms)
+{
+    while(ms--) {
+        stubMillis()++;
+        kp->scanKeypad();
+    }
+}
+
+// Contacts bounce for bounceMs, changing state every "period" ms
+static void bounce(Keypad_I2C *kp, bool toClosed, int bounceMs, int period)
+{
+    for(int t = 0; t < bounceMs; t++) {
+        pcf->closed = ((t / period) & 1) ? !toClosed : toClosed;
+        stubMillis()++;
+        kp->scanKeypad();
+    }
+    pcf->closed = toClosed;
+}
+
+void setUp(void)
+{
+    Wire.detachAll();
+    pcf = new PCF8574();
+    Wire.attach(KEYPAD_ADDR, pcf);
+    stubMillis() = 100000;
+    numEv = 0;
+}
+
+void tearDown(void)
+{
+    delete pcf;
+}
+
+// Idle: A single read per scan interval, no writes
+void test_idle_hour(void)
+{
+    Keypad_I2C *kp = newKeypad();
+    int writes = pcf->writes, reads = pcf->reads;
+
+    Wire.transactions = 0;
+    runFor(kp, 60*60*1000);
+
+    TEST_ASSERT_LESS_OR_EQUAL(60*60*1000 / SCAN_INTERVAL, Wire.transactions);
+    TEST_ASSERT_GREATER_THAN(60*60*1000 / (SCAN_INTERVAL + 2), Wire.transactions);
+    TEST_ASSERT_EQUAL(Wire.transactions, pcf->reads - reads);
+    TEST_ASSERT_EQUAL(writes, pcf->writes);
+    TEST_ASSERT_EQUAL(0, numEv);
+
+    // Columns LOW, rows pulled up
+    TEST_ASSERT_EQUAL_HEX16(0xff & ~((1 << 2) | (1 << 0) | (1 << 4)), pcf->latch);
+
+    delete kp;
+}
+
+// Each key is found at its position
+void test_all_keys(void)
+{
+    Keypad_I2C *kp = newKeypad();
+
+    for(int k = 0; k < 12; k++) {
+        numEv = 0;
+        pcf->key = k;
+        pcf->closed = true;
+        runFor(kp, 200);
+        pcf->closed = false;
+        runFor(kp, 200);
+        TEST_ASSERT_EQUAL(2, numEv);
+        TEST_ASSERT_EQUAL(keys[k], evChar[0]);
+        TEST_ASSERT_EQUAL(TCKS_PRESSED, evState[0]);
+        TEST_ASSERT_EQUAL(TCKS_RELEASED, evState[1]);
+    }
+
+    delete kp;
+}
+
+// Bouncing press, hold, bouncing release: Each event exactly once,
+// wherever the bounces fall relative to the scans
+void test_bounce_press_hold_release(void)
+{
+    char msg[32];
+
+    for(int period = 1; period <= 3; period++) {
+        for(int phase = 0; phase < SCAN_INTERVAL + 1; phase++) {
+            Keypad_I2C *kp = newKeypad();
+
+            snprintf(msg, sizeof(msg), "period %d, phase %d", period, phase);
+
+            numEv = 0;
+            pcf->key = 4;   // '5'
+            runFor(kp, 100 + phase);
+            bounce(kp, true, 30, period);
+            runFor(kp, HOLD_TIME + 500);
+            bounce(kp, false, 30, period);
+            runFor(kp, 500);
+
+            TEST_ASSERT_EQUAL_INT_MESSAGE(3, numEv, msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(TCKS_PRESSED, evState[0], msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(TCKS_HOLD, evState[1], msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(TCKS_RELEASED, evState[2], msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE('5', evChar[0], msg);
+            TEST_ASSERT_EQUAL_INT_MESSAGE('5', evChar[2], msg);
+
+            delete kp;
+        }
+    }
+}
+
+// Same for a short press
+void test_bounce_short_press(void)
+{
+    char msg[32];
+
+    for(int phase = 0; phase < SCAN_INTERVAL + 1; phase++) {
+        Keypad_I2C *kp = newKeypad();
+
+        snprintf(msg, sizeof(msg), "phase %d", phase);
+
+        numEv = 0;
+        pcf->key = 11;  // '#'
+        runFor(kp, 100 + phase);
+        bounce(kp, true, 30, 2);
+        runFor(kp, 150);
+        bounce(kp, false, 30, 1);
+        runFor(kp, 500);
+
+        TEST_ASSERT_EQUAL_INT_MESSAGE(2, numEv, msg);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(TCKS_PRESSED, evState[0], msg);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(TCKS_RELEASED, evState[1], msg);
+        TEST_ASSERT_EQUAL_INT_MESSAGE('#', evChar[0], msg);
+
+        delete kp;
+    }
+}
+
+// A glitch shorter than the debounce time is not a key press
+void test_glitch_ignored(void)
+{
+    Keypad_I2C *kp = newKeypad();
+
+    pcf->key = 0;
+    for(int phase = 0; phase < SCAN_INTERVAL + 1; phase++) {
+        runFor(kp, 100 + phase);
+        pcf->closed = true;
+        runFor(kp, 5);
+        pcf->closed = false;
+    }
+    runFor(kp, 500);
+
+    TEST_ASSERT_EQUAL(0, numEv);
+
+    delete kp;
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_hour);
+    RUN_TEST(test_all_keys);
+    RUN_TEST(test_bounce_press_hold_release);
+    RUN_TEST(test_bounce_short_press);
+    RUN_TEST(test_glitch_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Light sensors on a mock i2c bus
+ *
+ * The integer lux calculations are checked against the floating
+ * point formulas from the respective data sheets/app notes, for 
+ * whatever gain/integration time the sensor was set to at the 
+ * time (read back from the simulated device's registers).
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#define TC_HAVELIGHT
+#include "sensors.cpp"
+
+bool FlashROMode = false;
+uint32_t i2cErrCount = 0;
+
+bool readFileFromSD(const char *fn, uint8_t *buf, int len)  { return false; }
+bool readFileFromFS(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToSD(const char *fn, uint8_t *buf, int len)   { return false; }
+bool writeFileToFS(const char *fn, uint8_t *buf, int len)   { return false; }
+
+static uint32_t rndState;
+
+static uint32_t rnd(uint32_t range)
+{
+    rndState = rndState * 1103515245 + 12345;
+    return ((rndState >> 8) % range);
+}
+
+// Log-uniform 1..65534
+static uint16_t rndCount()
+{
+    return (uint16_t)std::min(65534.0, exp((double)rnd(1000000) / 1000000.0 * log(65535.0)));
+}
+
+static void checkLux(double ref, int32_t lux, double relTol, int absTol, const char *what)
+{
+    char buf[128];
+    double tol = std::max(ref * relTol, (double)absTol);
+
+    snprintf(buf, sizeof(buf), "%s: ref %.2f, got %d", what, ref, lux);
+    TEST_ASSERT_TRUE_MESSAGE(fabs(ref - lux) <= tol, buf);
+}
+
+/*
+ * BH1750: Mode is set by command, reads return the count
+ */
+class BH1750Dev : public I2CDevice {
+    public:
+        void write(const uint8_t *buf, size_t len)
+        {
+            if(buf[0] >= 0x10 && buf[0] <= 0x23) mode = buf[0];
+        }
+
+        size_t read(uint8_t *buf, size_t len)
+        {
+            buf[0] = count >> 8;
+            buf[1] = count & 0xff;
+            return 2;
+        }
+
+        uint8_t  mode = 0;
+        uint16_t count = 0;
+};
+
+static I2CRegDevice *dev;
+static BH1750Dev    *bh;
+
+void setUp(void)
+{
+    stubMillis() = 1000;
+    rndState = 1955;
+    Wire.detachAll();
+    dev = new I2CRegDevice(1);
+    bh = new BH1750Dev();
+}
+
+void tearDown(void)
+{
+    delete dev;
+    delete bh;
+}
+
+/*
+ * VEML7700: Resolution 0.0036 lux/count at gain 2, 800ms; 
+ * non-linearity correction for gain 1/8 and 1/4 above 1000 lux
+ */
+static double vemlRef(uint16_t cnt, uint16_t con0)
+{
+    static const double gains[4] = { 1.0, 2.0, 0.125, 0.25 };
+    double gain = gains[(con0 >> 11) & 0x03];
+    double it;
+    double lux;
+
+    switch((con0 >> 6) & 0x0f) {
+    case 0x0c: it = 25;  break;
+    case 0x08: it = 50;  break;
+    case 0x00: it = 100; break;
+    case 0x01: it = 200; break;
+    case 0x02: it = 400; break;
+    default:   it = 800; break;
+    }
+
+    lux = cnt * 0.0036 * (800.0 / it) * (2.0 / gain);
+
+    if(gain < 1.0 && lux > 1000) {
+        lux = 6.0135e-13 * pow(lux, 4) - 9.3924e-9 * pow(lux, 3) + 8.1488e-5 * pow(lux, 2) + 1.0023 * lux;
+    }
+
+    return lux;
+}
+
+void test_veml7700(void)
+{
+    uint8_t addr[] = { 0x10, LST_VEML7700 };
+    lightSensor ls(1, addr);
+    uint64_t ranges = 0;
+    int n = 0;
+
+    dev = new I2CRegDevice(2);
+    Wire.attach(0x10, dev);
+    TEST_ASSERT_TRUE(ls.begin(false, 0));
+    TEST_ASSERT_EQUAL_INT(0, dev->get16LE(0) & 0x0001);    // powered on
+
+    while(n < 2000) {
+        uint16_t con0 = dev->get16LE(0);
+        uint16_t cnt = rndCount();
+        dev->set16LE(4, cnt);
+        stubMillis() += 800 * 8;
+        if(ls.loop()) {
+            checkLux(vemlRef(cnt, con0), ls.readLux(), 0.005, 1, "VEML7700");
+            ranges |= 1ULL << ((con0 >> 6) & 0x3f);
+            n++;
+        }
+    }
+
+    TEST_ASSERT_TRUE(__builtin_popcountll(ranges) >= 6);
+}
+
+void test_veml7700_saturated(void)
+{
+    uint8_t addr[] = { 0x10, LST_VEML7700 };
+    lightSensor ls(1, addr);
+
+    dev = new I2CRegDevice(2);
+    Wire.attach(0x10, dev);
+    ls.begin(false, 0);
+
+    // Dark: Re-ranged in one go (gain 2, 400ms; 800ms has the same
+    // resolution at gain 1, the shorter one wins)
+    dev->set16LE(4, 20);
+    stubMillis() += 800 * 8;
+    TEST_ASSERT_TRUE(ls.loop());
+    TEST_ASSERT_EQUAL_INT(0x0800 | (0x02 << 6), dev->get16LE(0));
+
+    // Saturated: No value, restart at least sensitive setting
+    dev->set16LE(4, 0xffff);
+    stubMillis() += 800 * 8;
+    TEST_ASSERT_FALSE(ls.loop());
+    TEST_ASSERT_EQUAL_INT(0x1000 | (0x0c << 6), dev->get16LE(0));
+}
+
+/*
+ * LTR303/329: App note formulas
+ */
+static int32_t ltrRef(uint32_t ch0, uint32_t ch1, uint8_t ctrl, uint8_t mrate, double& lux)
+{
+    static const int gains[8] = { 1, 2, 4, 8, 0, 0, 48, 96 };
+    static const int its[8] = { 100, 50, 200, 400, 150, 250, 300, 350 };
+    double g = gains[(ctrl >> 2) & 0x07];
+    double it = its[(mrate >> 3) & 0x07] / 100.0;
+
+    if(ch1 * 100 < (ch0 + ch1) * 45) {
+        lux = (1.7743 * ch0 + 1.1059 * ch1) / g / it;
+    } else if(ch1 * 100 < (ch0 + ch1) * 64) {
+        lux = (4.2785 * ch0 - 1.9548 * ch1) / g / it;
+    } else if(ch1 * 100 < (ch0 + ch1) * 85) {
+        lux = (0.5926 * ch0 + 0.1185 * ch1) / g / it;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+void test_ltr3xx(void)
+{
+    static const int32_t maxLux[8] = { 64000, 32000, 16000, 8000, 0, 0, 1300, 600 };
+    uint8_t addr[] = { 0x29, LST_LTR3xx };
+    lightSensor ls(1, addr);
+    uint32_t gains = 0;
+    int n = 0, ir = 0;
+
+    dev->regs[0x86] = 0xa0;     // part id
+    dev->regs[0x87] = 0x05;     // manufacturer id
+    Wire.attach(0x29, dev);
+    TEST_ASSERT_TRUE(ls.begin(false, 0));
+    TEST_ASSERT_EQUAL_INT(0x01, dev->regs[0x80] & 0x03);   // active
+
+    while(n < 2000) {
+        uint8_t  ctrl = dev->regs[0x80];
+        uint16_t ch0 = rndCount();
+        uint16_t ch1 = (uint16_t)std::min(65534.0, ch0 * (rnd(700) / 100.0));
+        double   ref;
+
+        dev->regs[0x88] = ch1 & 0xff;
+        dev->regs[0x89] = ch1 >> 8;
+        dev->regs[0x8a] = ch0 & 0xff;
+        dev->regs[0x8b] = ch0 >> 8;
+        stubMillis() += 2500;
+        if(ls.loop()) {
+            if(ch0 + ch1 == 0) {
+                TEST_ASSERT_EQUAL_INT(0, ls.readLux());
+            } else if(ltrRef(ch0, ch1, ctrl, dev->regs[0x85], ref) < 0) {
+                TEST_ASSERT_EQUAL_INT(-1, ls.readLux());
+                ir++;
+            } else {
+                ref = std::min(ref, (double)maxLux[(ctrl >> 2) & 0x07]);
+                checkLux(ref, ls.readLux(), 0, 1, "LTR3xx");
+            }
+            gains |= 1 << ((ctrl >> 2) & 0x07);
+            n++;
+        }
+    }
+
+    TEST_ASSERT_TRUE(ir > 0);
+    TEST_ASSERT_TRUE(__builtin_popcount(gains) >= 4);
+}
+
+/*
+ * TSL2561 (T, FN, CL package): Data sheet formula; the integer
+ * version approximates the (ch1/ch0)^1.4 term piecewise linear.
+ * For ch1/ch0 > 0.5, the driver reports -1.
+ */
+static double tslRef(uint32_t ch0, uint32_t ch1, uint8_t tim)
+{
+    double scale = 322.0 / 81.0;        // 101ms
+    double r;
+
+    if(!(tim & 0x10)) scale *= 16.0;    // low gain
+
+    r = (double)ch1 / ch0;
+
+    return (0.0304 * ch0 - 0.062 * ch0 * pow(r, 1.4)) * scale;
+}
+
+void test_tsl2561(void)
+{
+    uint8_t addr[] = { 0x29, LST_TSL2561 };
+    lightSensor ls(1, addr);
+    uint32_t gains = 0;
+    int n = 0, ir = 0;
+
+    dev->regs[0x8a] = 0x50;     // id
+    Wire.attach(0x29, dev);
+    TEST_ASSERT_TRUE(ls.begin(false, 0));
+    TEST_ASSERT_EQUAL_INT(0x03, dev->regs[0x80]);          // powered up
+
+    while(n < 2000) {
+        uint8_t  tim = dev->regs[0x81];
+        uint16_t ch0 = rndCount() & ((tim & 0x10) ? 0x7fff : 0x1fff);
+        uint16_t ch1 = (uint16_t)(ch0 * (rnd(70) / 100.0));
+
+        dev->regs[0x8c] = ch0 & 0xff;
+        dev->regs[0x8d] = ch0 >> 8;
+        dev->regs[0x8e] = ch1 & 0xff;
+        dev->regs[0x8f] = ch1 >> 8;
+        stubMillis() += 500;
+        if(ls.loop()) {
+            if(!ch1) {
+                TEST_ASSERT_EQUAL_INT(0, ls.readLux());
+            } else if((ch1 << 1) > ch0 || (!(tim & 0x10) && ch0 > 4900)) {
+                TEST_ASSERT_EQUAL_INT(-1, ls.readLux());
+                ir++;
+            } else {
+                checkLux(tslRef(ch0, ch1, tim), ls.readLux(), 0.03, 2, "TSL2561");
+            }
+            gains |= (tim & 0x10) ? 2 : 1;
+            n++;
+        }
+    }
+
+    TEST_ASSERT_TRUE(ir > 0);
+    TEST_ASSERT_EQUAL_INT(3, gains);
+}
+
+/*
+ * BH1750: lux = count / 1.2, or count / 2.4 in HRES2 mode
+ */
+void test_bh1750(void)
+{
+    uint8_t addr[] = { 0x23, LST_BH1750 };
+    lightSensor ls(1, addr);
+    uint32_t modes = 0;
+    int n = 0;
+
+    Wire.attach(0x23, bh);
+    TEST_ASSERT_TRUE(ls.begin(false, 0));
+
+    while(n < 2000) {
+        uint8_t mode = bh->mode;
+        bh->count = rndCount();
+        stubMillis() += 150;
+        if(ls.loop()) {
+            double ref = bh->count / ((mode == 0x11) ? 2.4 : 1.2);
+            checkLux(ref, ls.readLux(), 0, 1, "BH1750");
+            if(ls.readLux() < 1000) {
+                TEST_ASSERT_EQUAL_INT(0x11, bh->mode);
+            }
+            modes |= 1 << (mode & 0x0f);
+            n++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(0x03, modes);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_veml7700);
+    RUN_TEST(test_veml7700_saturated);
+    RUN_TEST(test_ltr3xx);
+    RUN_TEST(test_tsl2561);
+    RUN_TEST(test_bh1750);
+    return UNITY_END();
+}
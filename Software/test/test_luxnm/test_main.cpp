@@ -0,0 +1,278 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Light sensor night mode
+ *
+ * Lux traces (one reading every 3 seconds, as in time_loop) are
+ * replayed through luxNMEval(): Flicker around the limit, slow
+ * ramps with and without noise, single-sample spikes, and the
+ * number of readings it takes to confirm a change.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#define TC_HAVELIGHT
+#include "tc_luxnm.cpp"
+
+#define MAX_TRACE 1000
+
+static int8_t states[MAX_TRACE];
+static int    changeAt[MAX_TRACE];
+static int    numChanges;
+
+// Feed readings; record state after each, and where it changed
+static void replay(const int32_t *trace, int len)
+{
+    int8_t last = luxNMState();
+
+    numChanges = 0;
+    for(int i = 0; i < len; i++) {
+        states[i] = luxNMEval(trace[i]);
+        TEST_ASSERT_EQUAL_INT(states[i], luxNMState());
+        if(states[i] != last) {
+            changeAt[numChanges++] = i;
+            last = states[i];
+        }
+    }
+}
+
+// Set up with limit, and start in the given state
+static void start(int32_t limit, int8_t state)
+{
+    luxNMSetup(limit);
+    TEST_ASSERT_EQUAL_INT(LUXNM_NONE, luxNMState());
+    luxNMEval(state == LUXNM_ON ? 0 : (state == LUXNM_OFF ? limit + 1000 : -1));
+    TEST_ASSERT_EQUAL_INT(state, luxNMState());
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// First reading counts right away, even within the band
+void test_first_reading(void)
+{
+    luxNMSetup(20);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, luxNMEval(20));
+    luxNMSetup(20);
+    TEST_ASSERT_EQUAL_INT(LUXNM_OFF, luxNMEval(21));
+    luxNMSetup(20);
+    TEST_ASSERT_EQUAL_INT(LUXNM_BAD, luxNMEval(-1));
+}
+
+// A change takes exactly LUX_CONFIRM readings; an interruption
+// starts over
+void test_confirm(void)
+{
+    int32_t dark[LUX_CONFIRM + 2];
+
+    for(int i = 0; i < LUX_CONFIRM + 2; i++) dark[i] = 5;
+
+    start(20, LUXNM_OFF);
+    replay(dark, LUX_CONFIRM + 2);
+    TEST_ASSERT_EQUAL_INT(1, numChanges);
+    TEST_ASSERT_EQUAL_INT(LUX_CONFIRM - 1, changeAt[0]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, states[LUX_CONFIRM - 1]);
+
+    // Dark, bright, dark: Not confirmed
+    const int32_t interrupted[] = { 5, 100, 5, 100, 5, 100 };
+    start(20, LUXNM_OFF);
+    replay(interrupted, 6);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    // Dark, band, dark: Band is "no change", not confirmed either
+    const int32_t band[] = { 5, 21, 5, 22, 5 };
+    start(20, LUXNM_OFF);
+    replay(band, 5);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+}
+
+// After a bad reading, readings calling for different states
+// must not confirm each other
+void test_confirm_same_state(void)
+{
+    const int32_t mixed[] = { 100, 5, 100, 5, 100, 5 };
+
+    start(20, LUXNM_BAD);
+    replay(mixed, 6);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    const int32_t darkAfterBad[] = { 100, 5, 5 };
+
+    start(20, LUXNM_BAD);
+    replay(darkAfterBad, 3);
+    TEST_ASSERT_EQUAL_INT(1, numChanges);
+    TEST_ASSERT_EQUAL_INT(1 + LUX_CONFIRM - 1, changeAt[0]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, states[2]);
+}
+
+// Flicker around the limit, within and across the band
+void test_flicker(void)
+{
+    int32_t trace[MAX_TRACE];
+    int32_t limit = 100;
+    int32_t hyst = limit * LUX_HYST_PCT / 100;
+
+    // limit / limit+1 and limit / limit+hyst: Stays on
+    for(int i = 0; i < MAX_TRACE; i++) trace[i] = (i & 1) ? limit + 1 : limit;
+    start(limit, LUXNM_ON);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    for(int i = 0; i < MAX_TRACE; i++) trace[i] = (i & 1) ? limit + hyst : limit - 1;
+    start(limit, LUXNM_ON);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    // Same from off: Stays off
+    for(int i = 0; i < MAX_TRACE; i++) trace[i] = (i & 1) ? limit + 1 : limit;
+    start(limit, LUXNM_OFF);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    // Across the whole band, every other reading: Never confirmed
+    for(int i = 0; i < MAX_TRACE; i++) trace[i] = (i & 1) ? limit + hyst + 1 : limit;
+    start(limit, LUXNM_ON);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+    start(limit, LUXNM_OFF);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    // Slower flicker (LUX_CONFIRM readings each) across the band
+    // does switch, each time after LUX_CONFIRM readings
+    for(int i = 0; i < MAX_TRACE; i++) trace[i] = ((i / LUX_CONFIRM) & 1) ? limit + hyst + 1 : limit;
+    start(limit, LUXNM_ON);
+    replay(trace, MAX_TRACE);
+    TEST_ASSERT_EQUAL_INT(MAX_TRACE / LUX_CONFIRM - 1, numChanges);
+    for(int i = 0; i < numChanges; i++) {
+        TEST_ASSERT_EQUAL_INT((i + 1) * LUX_CONFIRM + LUX_CONFIRM - 1, changeAt[i]);
+    }
+}
+
+// Dusk and dawn: One change each way, at the threshold plus
+// LUX_CONFIRM - 1 readings
+void test_slow_ramp(void)
+{
+    int32_t trace[MAX_TRACE];
+    int32_t limit = 100;
+    int32_t hyst = limit * LUX_HYST_PCT / 100;
+    int len = 0;
+
+    // Dawn: 50 -> 250, 1 lux per reading
+    for(int32_t lux = 50; lux <= 250; lux++) trace[len++] = lux;
+
+    start(limit, LUXNM_ON);
+    replay(trace, len);
+    TEST_ASSERT_EQUAL_INT(1, numChanges);
+    TEST_ASSERT_EQUAL_INT(limit + hyst + 1 + LUX_CONFIRM - 1, trace[changeAt[0]]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_OFF, states[len - 1]);
+
+    // Dusk: 250 -> 50
+    len = 0;
+    for(int32_t lux = 250; lux >= 50; lux--) trace[len++] = lux;
+
+    replay(trace, len);
+    TEST_ASSERT_EQUAL_INT(1, numChanges);
+    TEST_ASSERT_EQUAL_INT(limit - (LUX_CONFIRM - 1), trace[changeAt[0]]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, states[len - 1]);
+}
+
+// Same with noise smaller than the band: Still one change each way
+void test_noisy_ramp(void)
+{
+    int32_t trace[MAX_TRACE];
+    const int32_t noise[8] = { 0, 4, -3, 2, -4, 3, -2, 1 };
+    int32_t limit = 100;
+    int len = 0;
+
+    for(int i = 0; i < 400; i++) {
+        trace[len++] = max((int32_t)0, 50 + i / 2 + noise[i % 8]);
+    }
+    for(int i = 0; i < 400; i++) {
+        trace[len++] = max((int32_t)0, 250 - i / 2 + noise[i % 8]);
+    }
+
+    start(limit, LUXNM_ON);
+    replay(trace, len);
+    TEST_ASSERT_EQUAL_INT(2, numChanges);
+    TEST_ASSERT_EQUAL_INT(LUXNM_OFF, states[changeAt[0]]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, states[changeAt[1]]);
+    TEST_ASSERT_LESS_THAN(400, changeAt[0]);
+    TEST_ASSERT_GREATER_OR_EQUAL(400, changeAt[1]);
+}
+
+// Single-sample spikes (headlights, a lamp switched on and off)
+// are ignored; an overload reading switches right away
+void test_spike(void)
+{
+    const int32_t bright[] = { 5, 5, 5, 40000, 5, 5, 5 };
+    const int32_t dark[]   = { 500, 500, 0, 500, 500 };
+    const int32_t overload[] = { 5, 5, -1, 5, 5, 5 };
+
+    start(20, LUXNM_ON);
+    replay(bright, 7);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    start(20, LUXNM_OFF);
+    replay(dark, 5);
+    TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+    start(20, LUXNM_ON);
+    replay(overload, 6);
+    TEST_ASSERT_EQUAL_INT(2, numChanges);
+    TEST_ASSERT_EQUAL_INT(2, changeAt[0]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_BAD, states[2]);
+    TEST_ASSERT_EQUAL_INT(2 + LUX_CONFIRM, changeAt[1]);
+    TEST_ASSERT_EQUAL_INT(LUXNM_ON, states[5]);
+}
+
+// Hysteresis is a percentage of the limit, but at least LUX_HYST_MIN
+void test_hysteresis(void)
+{
+    const struct {
+        int32_t limit;
+        int32_t hyst;
+    } cases[] = {
+        { 0,     LUX_HYST_MIN },
+        { 3,     LUX_HYST_MIN },
+        { 100,   100 * LUX_HYST_PCT / 100 },
+        { 50000, 50000 * LUX_HYST_PCT / 100 }
+    };
+
+    for(unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int32_t top = cases[i].limit + cases[i].hyst;
+        int32_t trace[LUX_CONFIRM];
+
+        for(int j = 0; j < LUX_CONFIRM; j++) trace[j] = top;
+        start(cases[i].limit, LUXNM_ON);
+        replay(trace, LUX_CONFIRM);
+        TEST_ASSERT_EQUAL_INT(0, numChanges);
+
+        for(int j = 0; j < LUX_CONFIRM; j++) trace[j] = top + 1;
+        replay(trace, LUX_CONFIRM);
+        TEST_ASSERT_EQUAL_INT(1, numChanges);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_reading);
+    RUN_TEST(test_confirm);
+    RUN_TEST(test_confirm_same_state);
+    RUN_TEST(test_flicker);
+    RUN_TEST(test_slow_ramp);
+    RUN_TEST(test_noisy_ramp);
+    RUN_TEST(test_spike);
+    RUN_TEST(test_hysteresis);
+    return UNITY_END();
+}
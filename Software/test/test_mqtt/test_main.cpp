@@ -0,0 +1,691 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: MQTT packet reader, outbound queue
+ *
+ * The broker side is a scripted WiFiClient (see stubs/WiFiClient.h)
+ * which hands out data in short reads and fails reads on demand.
+ * What the client sends is split back into packets to check it.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <string>
+
+#include "mqtt.cpp"
+
+static WiFiClient   *client;
+static PubSubClient *mqtt;
+
+static int         cbCount;
+static std::string cbTopic;
+static std::string cbPayload;
+
+static int         scbCount;
+static std::string scbPayload;
+static uint32_t    scbTotal;
+static bool        scbOrdered;
+static bool        scbTopicOk;
+
+static void testCallback(char *topic, uint8_t *payload, unsigned int length)
+{
+    cbCount++;
+    cbTopic = topic;
+    cbPayload.assign((const char *)payload, length);
+}
+
+static void testStreamCallback(char *topic, uint8_t *payload, unsigned int length, uint32_t offs, uint32_t total)
+{
+    scbCount++;
+    if(strcmp(topic, "bttf/tcd/cmd")) scbTopicOk = false;
+    cbTopic = topic;
+    if(offs != scbPayload.size()) scbOrdered = false;
+    scbPayload.append((const char *)payload, length);
+    scbTotal = total;
+}
+
+/*
+ * Build a PUBLISH packet (QoS 0 or 1)
+ */
+static std::vector<uint8_t> makePublish(const char *topic, const std::string& payload, int qos = 0, uint16_t msgId = 0)
+{
+    std::vector<uint8_t> pkt;
+    uint16_t tl = strlen(topic);
+    uint32_t rl = 2 + tl + (qos ? 2 : 0) + payload.size();
+
+    pkt.push_back(MQTTPUBLISH | (qos ? MQTTQOS1 : MQTTQOS0));
+    do {
+        uint8_t d = rl & 0x7f;
+        rl >>= 7;
+        pkt.push_back(rl ? (d | 0x80) : d);
+    } while(rl);
+    pkt.push_back(tl >> 8);
+    pkt.push_back(tl & 0xff);
+    pkt.insert(pkt.end(), topic, topic + tl);
+    if(qos) {
+        pkt.push_back(msgId >> 8);
+        pkt.push_back(msgId & 0xff);
+    }
+    pkt.insert(pkt.end(), payload.begin(), payload.end());
+
+    return pkt;
+}
+
+static std::string makePayload(size_t len)
+{
+    std::string s;
+    for(size_t i = 0; i < len; i++) {
+        s += (char)('A' + (i % 26));
+    }
+    return s;
+}
+
+/*
+ * Split what the client sent into packets (header byte and
+ * everything after the remaining length) and clear it
+ */
+struct TxPacket {
+    uint8_t              header;
+    std::vector<uint8_t> body;
+};
+
+static std::vector<TxPacket> txPackets()
+{
+    std::vector<TxPacket> pkts;
+    size_t i = 0;
+
+    while(i < client->tx.size()) {
+        TxPacket p;
+        uint32_t rl = 0, mult = 1;
+        p.header = client->tx[i++];
+        do {
+            rl += (client->tx[i] & 0x7f) * mult;
+            mult <<= 7;
+        } while(client->tx[i++] & 0x80);
+        TEST_ASSERT_TRUE(i + rl <= client->tx.size());
+        p.body.assign(client->tx.begin() + i, client->tx.begin() + i + rl);
+        pkts.push_back(p);
+        i += rl;
+    }
+    client->tx.clear();
+
+    return pkts;
+}
+
+static std::string pubTopic(const TxPacket& p)
+{
+    return std::string(p.body.begin() + 2, p.body.begin() + 2 + ((p.body[0] << 8) | p.body[1]));
+}
+
+static uint16_t pubMsgId(const TxPacket& p)
+{
+    size_t o = 2 + ((p.body[0] << 8) | p.body[1]);
+    return (p.body[o] << 8) | p.body[o + 1];
+}
+
+static std::string pubPayload(const TxPacket& p)
+{
+    size_t o = 2 + ((p.body[0] << 8) | p.body[1]) + ((p.header & 0x06) ? 2 : 0);
+    return std::string(p.body.begin() + o, p.body.end());
+}
+
+static void sendPuback(uint16_t msgId)
+{
+    uint8_t puback[4] = { MQTTPUBACK, 2, (uint8_t)(msgId >> 8), (uint8_t)(msgId & 0xff) };
+    client->feed(puback, 4);
+}
+
+static void queueMsg(const char *topic, const char *payload, bool retained = false)
+{
+    TEST_ASSERT_TRUE(mqtt->queuePublish(topic, (const uint8_t *)payload, strlen(payload), retained));
+}
+
+static void connectClient()
+{
+    static const uint8_t connack[4] = { MQTTCONNACK, 2, 0, 0 };
+
+    client->feed(connack, 4);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECTED, mqtt->state());
+    client->tx.clear();
+}
+
+void setUp(void)
+{
+    stubMillis() = 1000;
+    client = new WiFiClient();
+    mqtt = new PubSubClient(*client);
+    mqtt->setCallback(testCallback);
+    cbCount = scbCount = 0;
+    cbTopic.clear();
+    cbPayload.clear();
+    scbPayload.clear();
+    scbTotal = 0;
+    scbOrdered = true;
+    scbTopicOk = true;
+}
+
+void tearDown(void)
+{
+    delete mqtt;
+    delete client;
+}
+
+void test_connect_sends_connect(void)
+{
+    TEST_ASSERT_TRUE(mqtt->connect("tcd"));
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECTING, mqtt->state());
+    TEST_ASSERT_TRUE(client->tx.size() > 2);
+    TEST_ASSERT_EQUAL_HEX16(MQTTCONNECT, client->tx[0]);
+}
+
+void test_connack_dribbled(void)
+{
+    static const uint8_t connack[4] = { MQTTCONNACK, 2, 1, 0 };
+
+    mqtt->connect("tcd");
+    for(int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_INT(MQTT_CONNECTING, mqtt->state());
+        client->feed(&connack[i], 1);
+        TEST_ASSERT_TRUE(mqtt->loop());
+    }
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECTED, mqtt->state());
+    TEST_ASSERT_TRUE(mqtt->sessionPresent());
+}
+
+void test_connack_refused(void)
+{
+    static const uint8_t connack[4] = { MQTTCONNACK, 2, 0, MQTT_CONNECT_BAD_CREDENTIALS };
+
+    mqtt->connect("tcd");
+    client->feed(connack, 4);
+    TEST_ASSERT_FALSE(mqtt->loop());
+    TEST_ASSERT_EQUAL_INT(MQTT_CONNECT_BAD_CREDENTIALS, mqtt->state());
+    TEST_ASSERT_FALSE(client->connected());
+}
+
+void test_publish_in_one_go(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "TIMETRAVEL");
+    client->feed(pkt.data(), pkt.size());
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("bttf/tcd/cmd", cbTopic.c_str());
+    TEST_ASSERT_EQUAL_STRING("TIMETRAVEL", cbPayload.c_str());
+}
+
+void test_publish_trickling_in(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "RETURN");
+    for(size_t i = 0; i < pkt.size(); i++) {
+        TEST_ASSERT_EQUAL_INT(0, cbCount);
+        client->feed(&pkt[i], 1);
+        TEST_ASSERT_TRUE(mqtt->loop());
+        stubMillis() += 10;
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("RETURN", cbPayload.c_str());
+}
+
+void test_publish_short_reads(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    // Two byte remaining length, body handed out 3 bytes at a time
+    std::string payload = makePayload(300);
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", payload);
+    TEST_ASSERT_TRUE(pkt[1] & 0x80);
+    client->maxRead = 3;
+    client->feed(pkt.data(), pkt.size());
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_INT(300, cbPayload.size());
+    TEST_ASSERT_TRUE(cbPayload == payload);
+}
+
+void test_publish_failed_reads(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    // Every byte sees a failing read first; nothing may get lost
+    // or duplicated
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "TCD_EXT_TT");
+    size_t base = client->rxPos;
+    for(size_t i = 0; i < pkt.size(); i++) {
+        client->feed(&pkt[i], 1);
+        client->failReads = 1;
+        TEST_ASSERT_TRUE(mqtt->loop());
+        TEST_ASSERT_EQUAL_INT(base + i, client->rxPos);
+        TEST_ASSERT_TRUE(mqtt->loop());
+        TEST_ASSERT_EQUAL_INT(base + i + 1, client->rxPos);
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("TCD_EXT_TT", cbPayload.c_str());
+}
+
+void test_publish_back_to_back(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> p1 = makePublish("bttf/tcd/cmd", "ONE");
+    std::vector<uint8_t> p2 = makePublish("bttf/tcd/cmd", "TWO");
+    client->feed(p1.data(), p1.size());
+    client->feed(p2.data(), 2);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("ONE", cbPayload.c_str());
+
+    client->feed(p2.data() + 2, p2.size() - 2);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(2, cbCount);
+    TEST_ASSERT_EQUAL_STRING("TWO", cbPayload.c_str());
+}
+
+void test_publish_qos1_acked(void)
+{
+    static const uint8_t puback[4] = { MQTTPUBACK, 2, 0x12, 0x34 };
+
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "ALARM_ON", 1, 0x1234);
+    client->maxRead = 2;
+    client->feed(pkt.data(), pkt.size());
+    mqtt->loop();
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("ALARM_ON", cbPayload.c_str());
+    TEST_ASSERT_EQUAL_INT(4, client->tx.size());
+    TEST_ASSERT_EQUAL_MEMORY(puback, client->tx.data(), 4);
+}
+
+void test_oversized_dropped(void)
+{
+    mqtt->setBufferSize(128);
+    mqtt->connect("tcd");
+    connectClient();
+
+    // Without stream callback, a packet too large for the buffer is
+    // skipped; the next one must still be read correctly
+    std::vector<uint8_t> big = makePublish("bttf/tcd/cmd", makePayload(400));
+    std::vector<uint8_t> small = makePublish("bttf/tcd/cmd", "AFTER");
+    client->maxRead = 7;
+    client->feed(big.data(), big.size());
+    client->feed(small.data(), small.size());
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(0, cbCount);
+    mqtt->loop();
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("AFTER", cbPayload.c_str());
+    TEST_ASSERT_TRUE(mqtt->connected());
+}
+
+void test_oversized_streamed(void)
+{
+    mqtt->setBufferSize(128);
+    mqtt->setStreamCallback(testStreamCallback);
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::string payload = makePayload(1000);
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", payload);
+    client->maxRead = 5;
+    for(size_t i = 0; i < pkt.size(); i += 11) {
+        client->feed(pkt.data() + i, std::min((size_t)11, pkt.size() - i));
+        if(!(i % 3)) client->failReads = 1;
+        mqtt->loop();
+    }
+    mqtt->loop();
+
+    TEST_ASSERT_EQUAL_INT(0, cbCount);
+    TEST_ASSERT_TRUE(scbCount > 1);
+    TEST_ASSERT_TRUE(scbOrdered);
+    TEST_ASSERT_EQUAL_STRING("bttf/tcd/cmd", cbTopic.c_str());
+    TEST_ASSERT_EQUAL_INT(1000, scbTotal);
+    TEST_ASSERT_TRUE(scbPayload == payload);
+}
+
+void test_incomplete_times_out(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "STUCK");
+    client->feed(pkt.data(), pkt.size() - 2);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    TEST_ASSERT_TRUE(mqtt->connected());
+
+    stubMillis() += MQTT_SOCKET_TIMEOUT * 1000;
+    TEST_ASSERT_FALSE(mqtt->loop());
+    TEST_ASSERT_FALSE(mqtt->connected());
+    TEST_ASSERT_EQUAL_INT(0, cbCount);
+}
+
+void test_bad_length_encoding(void)
+{
+    static const uint8_t bad[6] = { MQTTPUBLISH, 0xff, 0xff, 0xff, 0xff, 0x01 };
+
+    mqtt->connect("tcd");
+    connectClient();
+
+    client->feed(bad, 6);
+    TEST_ASSERT_FALSE(mqtt->loop());
+    TEST_ASSERT_FALSE(mqtt->connected());
+}
+
+/*
+ * Sending while a packet is partly received
+ */
+
+void test_send_while_receiving(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "QUEUED");
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "TIMETRAVEL");
+    client->feed(pkt.data(), 8);
+    TEST_ASSERT_TRUE(mqtt->loop());         // Sends queued message
+    TEST_ASSERT_TRUE(mqtt->publish("bttf/tcd/state", (const uint8_t *)"ON", 2, true));
+
+    client->feed(pkt.data() + 8, pkt.size() - 8);
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("bttf/tcd/cmd", cbTopic.c_str());
+    TEST_ASSERT_EQUAL_STRING("TIMETRAVEL", cbPayload.c_str());
+
+    std::vector<TxPacket> tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(2, tx.size());
+    TEST_ASSERT_EQUAL_STRING("QUEUED", pubPayload(tx[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("bttf/tcd/state", pubTopic(tx[1]).c_str());
+    TEST_ASSERT_EQUAL_STRING("ON", pubPayload(tx[1]).c_str());
+}
+
+void test_ping_while_receiving(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "RETURN");
+    client->feed(pkt.data(), 5);
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    // Keepalive due mid-packet; the packet itself has not timed out
+    stubMillis() += MQTT_KEEPALIVE * 1000 + 1;
+    mqtt->setSocketTimeout(MQTT_KEEPALIVE * 2);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    std::vector<TxPacket> tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(1, tx.size());
+    TEST_ASSERT_EQUAL_HEX16(MQTTPINGREQ, tx[0].header);
+
+    client->feed(pkt.data() + 5, pkt.size() - 5);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("RETURN", cbPayload.c_str());
+}
+
+static void publishingCallback(char *topic, uint8_t *payload, unsigned int length)
+{
+    // Answering from within the callback must not clobber its arguments
+    mqtt->publish("bttf/tcd/state", (const uint8_t *)"A much longer reply than the command", 36);
+    testCallback(topic, payload, length);
+}
+
+void test_publish_from_callback(void)
+{
+    mqtt->setCallback(publishingCallback);
+    mqtt->connect("tcd");
+    connectClient();
+
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", "BEEP_ON", 1, 0x4711);
+    client->feed(pkt.data(), pkt.size());
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    TEST_ASSERT_EQUAL_INT(1, cbCount);
+    TEST_ASSERT_EQUAL_STRING("bttf/tcd/cmd", cbTopic.c_str());
+    TEST_ASSERT_EQUAL_STRING("BEEP_ON", cbPayload.c_str());
+
+    std::vector<TxPacket> tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(2, tx.size());
+    TEST_ASSERT_EQUAL_HEX16(MQTTPUBACK, tx[1].header);
+    TEST_ASSERT_EQUAL_HEX16(0x4711, (tx[1].body[0] << 8) | tx[1].body[1]);
+}
+
+void test_stream_while_sending(void)
+{
+    mqtt->setBufferSize(128);
+    mqtt->setStreamCallback(testStreamCallback);
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "QUEUED");
+
+    std::string payload = makePayload(1000);
+    std::vector<uint8_t> pkt = makePublish("bttf/tcd/cmd", payload);
+    for(size_t i = 0; i < pkt.size(); i += 50) {
+        client->feed(pkt.data() + i, std::min((size_t)50, pkt.size() - i));
+        TEST_ASSERT_TRUE(mqtt->loop());
+        TEST_ASSERT_TRUE(mqtt->publish("bttf/tcd/state", (const uint8_t *)"0123456789012345678901234567890123456789", 40));
+        if(i == 500) stubMillis() += MQTT_OUTQ_RETRY;      // Resend
+    }
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    TEST_ASSERT_EQUAL_INT(0, cbCount);
+    TEST_ASSERT_TRUE(scbCount > 1);
+    TEST_ASSERT_TRUE(scbTopicOk);
+    TEST_ASSERT_TRUE(scbOrdered);
+    TEST_ASSERT_TRUE(scbPayload == payload);
+
+    std::vector<TxPacket> tx = txPackets();
+    int queued = 0;
+    for(size_t i = 0; i < tx.size(); i++) {
+        if(pubTopic(tx[i]) == "bttf/tcd/pub") {
+            TEST_ASSERT_EQUAL_STRING("QUEUED", pubPayload(tx[i]).c_str());
+            queued++;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(2, queued);
+}
+
+/*
+ * Outbound QoS1 queue
+ */
+
+void test_queue_sent_when_connected(void)
+{
+    queueMsg("bttf/tcd/pub", "ONE");
+    queueMsg("bttf/tcd/pub", "TWO");
+    TEST_ASSERT_EQUAL_INT(2, mqtt->queueCount());
+
+    mqtt->connect("tcd");
+    connectClient();
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    // One at a time
+    std::vector<TxPacket> tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(1, tx.size());
+    TEST_ASSERT_EQUAL_HEX16(MQTTPUBLISH | MQTTQOS1, tx[0].header);
+    TEST_ASSERT_EQUAL_STRING("ONE", pubPayload(tx[0]).c_str());
+    uint16_t id = pubMsgId(tx[0]);
+    TEST_ASSERT_TRUE(id != 0);
+
+    sendPuback(id);
+    TEST_ASSERT_TRUE(mqtt->loop());
+    TEST_ASSERT_EQUAL_INT(1, mqtt->queueCount());
+    tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(1, tx.size());
+    TEST_ASSERT_EQUAL_STRING("TWO", pubPayload(tx[0]).c_str());
+    TEST_ASSERT_TRUE(pubMsgId(tx[0]) != id);
+
+    sendPuback(pubMsgId(tx[0]));
+    TEST_ASSERT_TRUE(mqtt->loop());
+    TEST_ASSERT_EQUAL_INT(0, mqtt->queueCount());
+    TEST_ASSERT_EQUAL_INT(0, txPackets().size());
+}
+
+void test_queue_retry(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "ONE");
+    mqtt->loop();
+    std::vector<TxPacket> tx = txPackets();
+    uint16_t id = pubMsgId(tx[0]);
+    TEST_ASSERT_FALSE(tx[0].header & 0x08);
+
+    stubMillis() += MQTT_OUTQ_RETRY - 1;
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(0, txPackets().size());
+
+    // Resent with DUP flag and same msgId
+    stubMillis() += 1;
+    mqtt->loop();
+    tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(1, tx.size());
+    TEST_ASSERT_EQUAL_HEX16(MQTTPUBLISH | MQTTQOS1 | 0x08, tx[0].header);
+    TEST_ASSERT_EQUAL_HEX16(id, pubMsgId(tx[0]));
+    TEST_ASSERT_EQUAL_STRING("ONE", pubPayload(tx[0]).c_str());
+}
+
+void test_queue_puback_matching(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "ONE");
+    queueMsg("bttf/tcd/pub", "TWO");
+    mqtt->loop();
+    uint16_t id = pubMsgId(txPackets()[0]);
+
+    // PUBACK for something else is ignored
+    sendPuback(id + 1);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(2, mqtt->queueCount());
+    TEST_ASSERT_EQUAL_INT(0, txPackets().size());
+
+    sendPuback(id);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(1, mqtt->queueCount());
+
+    // Late duplicate PUBACK does not pop the next one
+    sendPuback(id);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(1, mqtt->queueCount());
+}
+
+void test_queue_full(void)
+{
+    char payload[8];
+
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "P0");
+    mqtt->loop();                           // P0 in flight
+    uint16_t id = pubMsgId(txPackets()[0]);
+
+    for(int i = 1; i < MQTT_OUTQ_SIZE; i++) {
+        sprintf(payload, "P%d", i);
+        queueMsg("bttf/tcd/pub", payload);
+    }
+    TEST_ASSERT_EQUAL_INT(MQTT_OUTQ_SIZE, mqtt->queueCount());
+
+    // Retained messages for the same topic replace each other
+    queueMsg("bttf/tcd/ret", "R1", true);   // Drops P1
+    queueMsg("bttf/tcd/ret", "R2", true);
+    TEST_ASSERT_EQUAL_INT(MQTT_OUTQ_SIZE, mqtt->queueCount());
+
+    // Too long for a slot
+    TEST_ASSERT_FALSE(mqtt->queuePublish("bttf/tcd/pub", (const uint8_t *)payload, MQTT_OUTQ_PLLEN + 1));
+
+    // In-flight P0 was kept, P1 dropped
+    std::string order;
+    for(int i = 1; i < MQTT_OUTQ_SIZE; i++) {
+        sendPuback(id);
+        mqtt->loop();
+        std::vector<TxPacket> tx = txPackets();
+        TEST_ASSERT_EQUAL_INT(1, tx.size());
+        id = pubMsgId(tx[0]);
+        order += pubPayload(tx[0]) + " ";
+    }
+    TEST_ASSERT_EQUAL_STRING("P2 P3 P4 P5 P6 P7 R2 ", order.c_str());
+}
+
+void test_queue_replay_after_reconnect(void)
+{
+    mqtt->connect("tcd");
+    connectClient();
+
+    queueMsg("bttf/tcd/pub", "ONE");
+    mqtt->loop();
+    uint16_t id = pubMsgId(txPackets()[0]);
+
+    // Connection lost before PUBACK
+    client->stop();
+    TEST_ASSERT_FALSE(mqtt->loop());
+    TEST_ASSERT_EQUAL_INT(1, mqtt->queueCount());
+
+    client->isConnected = true;
+    mqtt->connect("tcd");
+    connectClient();
+    stubMillis() += 10;
+    TEST_ASSERT_TRUE(mqtt->loop());
+
+    // Resent right away, as duplicate, same msgId
+    std::vector<TxPacket> tx = txPackets();
+    TEST_ASSERT_EQUAL_INT(1, tx.size());
+    TEST_ASSERT_EQUAL_HEX16(MQTTPUBLISH | MQTTQOS1 | 0x08, tx[0].header);
+    TEST_ASSERT_EQUAL_HEX16(id, pubMsgId(tx[0]));
+
+    sendPuback(id);
+    mqtt->loop();
+    TEST_ASSERT_EQUAL_INT(0, mqtt->queueCount());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_connect_sends_connect);
+    RUN_TEST(test_connack_dribbled);
+    RUN_TEST(test_connack_refused);
+    RUN_TEST(test_publish_in_one_go);
+    RUN_TEST(test_publish_trickling_in);
+    RUN_TEST(test_publish_short_reads);
+    RUN_TEST(test_publish_failed_reads);
+    RUN_TEST(test_publish_back_to_back);
+    RUN_TEST(test_publish_qos1_acked);
+    RUN_TEST(test_oversized_dropped);
+    RUN_TEST(test_oversized_streamed);
+    RUN_TEST(test_incomplete_times_out);
+    RUN_TEST(test_bad_length_encoding);
+    RUN_TEST(test_send_while_receiving);
+    RUN_TEST(test_ping_while_receiving);
+    RUN_TEST(test_publish_from_callback);
+    RUN_TEST(test_stream_while_sending);
+    RUN_TEST(test_queue_sent_when_connected);
+    RUN_TEST(test_queue_retry);
+    RUN_TEST(test_queue_puback_matching);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_queue_replay_after_reconnect);
+    return UNITY_END();
+}
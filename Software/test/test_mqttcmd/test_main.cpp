@@ -0,0 +1,277 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: MQTT commands
+ *
+ * The command table (sorted, unique, complete) and the parser:
+ * Keyword boundaries, argument ranges, missing and non-numeric
+ * arguments, dates.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "tc_mqttcmd.cpp"
+
+// Stand-ins for what other modules provide
+
+int daysInMonth(int month, int year)
+{
+    const int mDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (!(year % 4) && (year % 100)) || !(year % 400);
+
+    return (month == 2 && leap) ? 29 : mDays[month - 1];
+}
+
+#define NUM_CMDS (int)(sizeof(mqttCmds) / sizeof(mqttCmds[0]))
+
+static mqttCommand cmd;
+
+static bool parse(const char *s)
+{
+    memset(&cmd, 0x55, sizeof(cmd));
+    return mqttParseCmd((const uint8_t *)s, strlen(s), cmd);
+}
+
+static void expectCmd(const char *s, uint8_t id, int arg)
+{
+    TEST_ASSERT_TRUE_MESSAGE(parse(s), s);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(id, cmd.id, s);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(arg, cmd.arg, s);
+}
+
+static void expectBad(const char *s)
+{
+    TEST_ASSERT_FALSE_MESSAGE(parse(s), s);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Binary search needs strcmp order; no duplicates, no gaps
+void test_table(void)
+{
+    bool seen[MQC_BRIGHTNESS_DEPART + 1] = { false };
+
+    for(int i = 0; i < NUM_CMDS; i++) {
+        const char *n = mqttCmds[i].name;
+
+        if(i) {
+            TEST_ASSERT_TRUE_MESSAGE(strcmp(mqttCmds[i-1].name, n) < 0, n);
+        }
+        for(const char *p = n; *p; p++) {
+            TEST_ASSERT_TRUE_MESSAGE((*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_', n);
+        }
+        TEST_ASSERT_TRUE_MESSAGE(mqttCmds[i].id <= MQC_BRIGHTNESS_DEPART, n);
+        TEST_ASSERT_FALSE_MESSAGE(seen[mqttCmds[i].id], n);
+        seen[mqttCmds[i].id] = true;
+        TEST_ASSERT_TRUE_MESSAGE(mqttCmds[i].argMin <= mqttCmds[i].argMax, n);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(i, mqttFindCmd(n), n);
+    }
+
+    for(int i = 0; i <= MQC_BRIGHTNESS_DEPART; i++) {
+        TEST_ASSERT_TRUE(seen[i]);
+    }
+}
+
+// Every command, upper and lower case, with a valid argument
+void test_all_commands(void)
+{
+    char buf[64];
+
+    for(int i = 0; i < NUM_CMDS; i++) {
+        int arg = -1;
+
+        switch(mqttCmds[i].argType) {
+        case MQA_INT:
+            arg = mqttCmds[i].argMax;
+            snprintf(buf, sizeof(buf), "%s %d", mqttCmds[i].name, arg);
+            break;
+        case MQA_DATE:
+            snprintf(buf, sizeof(buf), "%s 102619850121", mqttCmds[i].name);
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "%s", mqttCmds[i].name);
+        }
+        expectCmd(buf, mqttCmds[i].id, arg);
+
+        for(char *p = buf; *p; p++) {
+            if(*p >= 'A' && *p <= 'Z') *p |= 0x20;
+        }
+        expectCmd(buf, mqttCmds[i].id, arg);
+    }
+}
+
+void test_keyword_boundaries(void)
+{
+    // Prefixes and extensions of valid commands
+    expectBad("");
+    expectBad("A");
+    expectBad("ALARM");
+    expectBad("ALARM_");
+    expectBad("ALARM_O");
+    expectBad("ALARM_ONN");
+    expectBad("ALARM_OFFX");
+    expectBad("ALARM_ON_");
+    expectBad("BEEP_3");
+    expectBad("BEEP_300");
+    expectBad("BRIGHTNESS 5");
+    expectBad("MP_SHUFFLE");
+    expectBad("TIMETRAVEL_");
+    expectBad("TIMETRAVEL88");
+    expectBad("VOLUME5");
+
+    // Outside of table range
+    expectBad("AAA");
+    expectBad("ZZZ");
+    expectBad("0");
+    expectBad("_");
+
+    // Command must come first
+    expectBad(" ALARM_ON");
+    expectBad("\nALARM_ON");
+
+    // Command ends at blank or control character
+    expectCmd("ALARM_ON ", MQC_ALARM_ON, -1);
+    expectCmd("ALARM_ON\r\n", MQC_ALARM_ON, -1);
+    expectCmd("ALARM_ON\tX", MQC_ALARM_ON, -1);
+    expectCmd("Alarm_On", MQC_ALARM_ON, -1);
+    expectCmd("ALARM_OFF", MQC_ALARM_OFF, -1);
+    expectCmd("VOLUME   7", MQC_VOLUME, 7);
+
+    // First and last entry
+    expectCmd(mqttCmds[0].name, mqttCmds[0].id, -1);
+    expectCmd("VOLUME 1", MQC_VOLUME, 1);
+
+    // Only "length" bytes count; binary after the command is cut off
+    TEST_ASSERT_TRUE(mqttParseCmd((const uint8_t *)"ALARM_ONXYZ", 8, cmd));
+    TEST_ASSERT_EQUAL(MQC_ALARM_ON, cmd.id);
+    TEST_ASSERT_TRUE(mqttParseCmd((const uint8_t *)"ALARM_ON\0XYZ", 12, cmd));
+    TEST_ASSERT_EQUAL(MQC_ALARM_ON, cmd.id);
+    TEST_ASSERT_FALSE(mqttParseCmd((const uint8_t *)"ALARM_ON", 7, cmd));
+}
+
+// Payloads longer than MQTT_MSG_LEN are cut
+void test_long_payload(void)
+{
+    char buf[MQTT_MSG_LEN + 100];
+
+    memset(buf, ' ', sizeof(buf));
+    memcpy(buf, "VOLUME 5", 8);
+    TEST_ASSERT_TRUE(mqttParseCmd((const uint8_t *)buf, sizeof(buf), cmd));
+    TEST_ASSERT_EQUAL(5, cmd.arg);
+
+    memset(buf, 'A', sizeof(buf));
+    TEST_ASSERT_FALSE(mqttParseCmd((const uint8_t *)buf, sizeof(buf), cmd));
+}
+
+void test_arg_ranges(void)
+{
+    expectCmd("TIMETRAVEL 0", MQC_TIMETRAVEL, 0);
+    expectCmd("TIMETRAVEL 88", MQC_TIMETRAVEL, 88);
+    expectBad("TIMETRAVEL 89");
+    expectBad("TIMETRAVEL 1000");
+
+    expectCmd("VOLUME 0", MQC_VOLUME, 0);
+    expectCmd("VOLUME 19", MQC_VOLUME, 19);
+    expectBad("VOLUME 20");
+    expectBad("VOLUME 255");
+
+    expectCmd("BRIGHTNESS_DEST 0", MQC_BRIGHTNESS_DEST, 0);
+    expectCmd("BRIGHTNESS_DEST 15", MQC_BRIGHTNESS_DEST, 15);
+    expectBad("BRIGHTNESS_DEST 16");
+    expectCmd("BRIGHTNESS_PRESENT 15", MQC_BRIGHTNESS_PRESENT, 15);
+    expectBad("BRIGHTNESS_PRESENT 16");
+    expectCmd("BRIGHTNESS_DEPART 15", MQC_BRIGHTNESS_DEPART, 15);
+    expectBad("BRIGHTNESS_DEPART 16");
+
+    expectCmd("MP_TRACK 999", MQC_MP_TRACK, 999);
+    expectBad("MP_TRACK 1000");
+
+    // No sign, no overflow
+    expectBad("VOLUME -1");
+    expectBad("VOLUME +1");
+    expectBad("VOLUME 99999");
+    expectBad("VOLUME 123456");
+    expectBad("VOLUME 4294967301");
+    expectBad("TIMETRAVEL 65624");  // 88 + 65536
+
+    // Leading zeros are fine, up to 5 digits
+    expectCmd("VOLUME 00019", MQC_VOLUME, 19);
+    expectBad("VOLUME 000019");
+}
+
+void test_missing_or_bad_arg(void)
+{
+    // Required
+    expectBad("VOLUME");
+    expectBad("VOLUME ");
+    expectBad("BRIGHTNESS_DEST");
+    expectBad("MP_TRACK   ");
+
+    // Non-numeric
+    expectBad("VOLUME abc");
+    expectBad("VOLUME 5x");
+    expectBad("VOLUME x5");
+    expectBad("VOLUME 1.5");
+    expectBad("VOLUME 0x10");
+    expectBad("TIMETRAVEL x");
+    expectBad("TIMETRAVEL 88mph");
+
+    // Optional
+    expectCmd("TIMETRAVEL", MQC_TIMETRAVEL, -1);
+    expectCmd("TIMETRAVEL ", MQC_TIMETRAVEL, -1);
+
+    // Number ends at blank
+    expectCmd("VOLUME 5 6", MQC_VOLUME, 5);
+}
+
+void test_destination(void)
+{
+    TEST_ASSERT_TRUE(parse("DESTINATION 102619850121"));
+    TEST_ASSERT_EQUAL(MQC_DESTINATION, cmd.id);
+    TEST_ASSERT_EQUAL(1985, cmd.year);
+    TEST_ASSERT_EQUAL(10, cmd.month);
+    TEST_ASSERT_EQUAL(26, cmd.day);
+    TEST_ASSERT_EQUAL(1, cmd.hour);
+    TEST_ASSERT_EQUAL(21, cmd.minute);
+
+    TEST_ASSERT_TRUE(parse("DESTINATION 022920240000"));
+    TEST_ASSERT_TRUE(parse("DESTINATION 123100012359"));
+    TEST_ASSERT_TRUE(parse("DESTINATION 010199992359 x"));
+
+    expectBad("DESTINATION");
+    expectBad("DESTINATION 02292023000");
+    expectBad("DESTINATION 0229202300000");
+    expectBad("DESTINATION 022920230000");  // No leap year
+    expectBad("DESTINATION 003119850000");
+    expectBad("DESTINATION 133119850000");
+    expectBad("DESTINATION 100019850000");
+    expectBad("DESTINATION 103219850000");
+    expectBad("DESTINATION 043119850000");
+    expectBad("DESTINATION 102619852400");
+    expectBad("DESTINATION 102619850160");
+    expectBad("DESTINATION 1026198501.1");
+    expectBad("DESTINATION 10/26/1985 01:21");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table);
+    RUN_TEST(test_all_commands);
+    RUN_TEST(test_keyword_boundaries);
+    RUN_TEST(test_long_payload);
+    RUN_TEST(test_arg_ranges);
+    RUN_TEST(test_missing_or_bad_arg);
+    RUN_TEST(test_destination);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Two-digit number table
+ *
+ * numPairs[] must match what makeNum() used to calculate from 
+ * numDigs[] digit by digit; checked on the table itself and on
+ * what actually goes out on the (mock) i2c bus.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "rtc.cpp"
+#include "clockdisplay.cpp"
+
+// Stand-ins for what other modules provide
+
+bool     alarmOnOff = false;
+uint64_t timeDifference = 0;
+bool     timeDiffUp = false;
+bool     FlashROMode = false;
+uint32_t i2cErrCount = 0;
+
+uint64_t dateToMins(int year, int month, int day, int hour, int minute) { return 0; }
+void     minsToDate(uint64_t total, int& year, int& month, int& day, int& hour, int& minute) { }
+int      daysInMonth(int month, int year) { return 31; }
+
+bool readFileFromSD(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToSD(const char *fn, uint8_t *buf, int len)   { return false; }
+bool readFileFromFS(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToFS(const char *fn, uint8_t *buf, int len)   { return false; }
+void removeFileFromFS(const char *fn) { }
+bool readBlobFromNVS(const char *key, uint8_t *buf, int len) { return false; }
+bool writeBlobToNVS(const char *key, uint8_t *buf, int len)  { return false; }
+
+#define DISP_ADDR 0x71
+
+// Digit pattern as the former getLED7NumChar() returned it
+static uint8_t digitSegs(uint8_t value)
+{
+    return (value <= 9) ? numDigs[value + '0' - 32] : 0;
+}
+
+// Former makeNum()
+static uint16_t refNum(uint8_t num, uint16_t dflags)
+{
+    uint16_t segments = digitSegs(num % 10) << 8;
+
+    if(!(dflags & CDD_NOLEAD0) || (num / 10)) {
+        segments |= digitSegs(num / 10);
+    }
+
+    return segments;
+}
+
+static I2CRegDevice *disp;
+
+void setUp(void)
+{
+    Wire.detachAll();
+    disp = new I2CRegDevice(1);
+    Wire.attach(DISP_ADDR, disp);
+}
+
+void tearDown(void)
+{
+    delete disp;
+}
+
+void test_table(void)
+{
+    char msg[16];
+
+    for(int n = 0; n < 100; n++) {
+        snprintf(msg, sizeof(msg), "%d", n);
+        TEST_ASSERT_EQUAL_HEX16_MESSAGE(refNum(n, 0), numPairs[n], msg);
+    }
+}
+
+void test_digits(void)
+{
+    // Sanity check the patterns themselves: 0 = a-f, 1 = b+c, 8 = all
+    TEST_ASSERT_EQUAL_HEX16(0x3f06, numPairs[10]);
+    TEST_ASSERT_EQUAL_HEX16(0x7f7f, numPairs[88]);
+    TEST_ASSERT_EQUAL_HEX16(0x063f, numPairs[1]);
+}
+
+void test_on_bus(void)
+{
+    clockDisplay disp1(DISP_DEST, DISP_ADDR);
+    char msg[24];
+
+    for(int f = 0; f < 2; f++) {
+        uint16_t dflags = f ? CDD_NOLEAD0 : 0;
+        for(int n = 0; n < 256; n++) {
+            disp1.showDayDirect(n, dflags);
+            snprintf(msg, sizeof(msg), "%d, flags %d", n, dflags);
+            TEST_ASSERT_EQUAL_HEX16_MESSAGE(refNum(n, dflags), disp->get16LE(CD_DAY_POS * 2), msg);
+        }
+    }
+}
+
+void test_year_on_bus(void)
+{
+    clockDisplay disp1(DISP_DEST, DISP_ADDR);
+
+    disp1.showYearDirect(1985);
+    TEST_ASSERT_EQUAL_HEX16(refNum(19, 0), disp->get16LE(CD_YEAR_POS * 2));
+    TEST_ASSERT_EQUAL_HEX16(refNum(85, 0), disp->get16LE((CD_YEAR_POS + 1) * 2));
+
+    disp1.showYearDirect(5, CDD_NOLEAD0);
+    TEST_ASSERT_EQUAL_HEX16(0, disp->get16LE(CD_YEAR_POS * 2));
+    TEST_ASSERT_EQUAL_HEX16(refNum(5, CDD_NOLEAD0), disp->get16LE((CD_YEAR_POS + 1) * 2));
+
+    disp1.showYearDirect(105, CDD_NOLEAD0);
+    TEST_ASSERT_EQUAL_HEX16(refNum(1, CDD_NOLEAD0), disp->get16LE(CD_YEAR_POS * 2));
+    TEST_ASSERT_EQUAL_HEX16(refNum(5, 0), disp->get16LE((CD_YEAR_POS + 1) * 2));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_table);
+    RUN_TEST(test_digits);
+    RUN_TEST(test_on_bus);
+    RUN_TEST(test_year_on_bus);
+    return UNITY_END();
+}
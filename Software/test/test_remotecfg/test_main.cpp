@@ -0,0 +1,218 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Remote configuration (MQTT)
+ *
+ * applyRemoteConfig() is all or nothing: Any bad key or value
+ * leaves settings and config file untouched.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#define TC_HAVETEMP
+#include "tc_settings.cpp"
+
+// Stand-ins for what other modules provide
+
+Settings   settings;
+IPSettings ipsettings;
+
+bool    alarmOnOff = false;
+uint8_t alarmHour = 255;
+uint8_t alarmMinute = 255;
+uint8_t alarmWeekday = 0;
+uint8_t remMonth = 0, remDay = 0, remHour = 0, remMin = 0;
+uint8_t curVolume = 0;
+
+// Good enough for the tests: Name of 3+ letters, then the offset
+static int tzChecks;
+bool checkTZ(const char *tz)
+{
+    int i = 0;
+    tzChecks++;
+    if(!*tz) return true;
+    while(isalpha(tz[i])) i++;
+    return (i >= 3 && (isdigit(tz[i]) || tz[i] == '-' || tz[i] == '+'));
+}
+
+clockDisplay::clockDisplay(uint8_t did, uint8_t address) { }
+void clockDisplay::showTextDirect(const char *text, uint16_t flags) { }
+clockDisplay destinationTime(DISP_DEST, 0x71);   // Only used for "WAIT" at boot
+
+void start_file_copy() { }
+void file_copy_progress() { }
+void file_copy_done() { }
+void file_copy_error() { }
+
+static uint32_t changed;
+static char     errKey[32];
+
+static bool apply(const char *json)
+{
+    char buf[256];
+
+    // Parsed in place, like the MQTT payload
+    strcpy(buf, json);
+    return applyRemoteConfig(buf, strlen(buf), changed, errKey, sizeof(errKey));
+}
+
+static bool cfgHas(const char *text)
+{
+    return SPIFFS.content(cfgName).find(text) != std::string::npos;
+}
+
+void setUp(void)
+{
+    SPIFFS.reset();
+    nvsPrefs.clear();
+    haveFS = haveNVS = true;
+    FlashROMode = false;
+    settings = Settings();
+    tzChecks = 0;
+    changed = 0xffffffff;
+    strcpy(errKey, "x");
+}
+
+void tearDown(void)
+{
+}
+
+void test_apply(void)
+{
+    TEST_ASSERT_TRUE(apply("{\"beep\":2,\"destTimeBright\":\"12\"}"));
+    TEST_ASSERT_EQUAL_INT(RCF_BEEP | RCF_BRIGHT_DEST, changed);
+    TEST_ASSERT_EQUAL_STRING("", errKey);
+    TEST_ASSERT_EQUAL_STRING("2", settings.beep);
+    TEST_ASSERT_EQUAL_STRING("12", settings.destTimeBright);
+    TEST_ASSERT_TRUE(cfgHas("\"beep\":\"2\""));
+    TEST_ASSERT_TRUE(cfgHas("\"destTimeBright\":\"12\""));
+}
+
+void test_bool_and_float(void)
+{
+    TEST_ASSERT_TRUE(apply("{\"mode24\":true,\"tempOffs\":-1.5}"));
+    TEST_ASSERT_EQUAL_INT(RCF_REBOOT, changed);
+    TEST_ASSERT_EQUAL_STRING("1", settings.mode24);
+    TEST_ASSERT_EQUAL_STRING("-1.5", settings.tempOffs);
+
+    TEST_ASSERT_TRUE(apply("{\"tempOffs\":\"2\"}"));
+    TEST_ASSERT_EQUAL_STRING("2.0", settings.tempOffs);
+}
+
+void test_unchanged(void)
+{
+    // Same values: Nothing to do, nothing written
+    TEST_ASSERT_TRUE(apply("{\"beep\":\"0\",\"timeZone\":\"UTC0\"}"));
+    TEST_ASSERT_EQUAL_INT(0, changed);
+    TEST_ASSERT_EQUAL_INT(0, SPIFFS.opensW);
+
+    TEST_ASSERT_TRUE(apply("{}"));
+    TEST_ASSERT_EQUAL_INT(0, changed);
+}
+
+void test_bad_json(void)
+{
+    TEST_ASSERT_FALSE(apply("{\"beep\":"));
+    TEST_ASSERT_EQUAL_STRING("(json)", errKey);
+    TEST_ASSERT_FALSE(apply("[1,2]"));
+    TEST_ASSERT_EQUAL_STRING("(json)", errKey);
+    TEST_ASSERT_EQUAL_INT(0, changed);
+}
+
+void test_unknown_key(void)
+{
+    TEST_ASSERT_FALSE(apply("{\"beep\":1,\"noSuchKey\":1}"));
+    TEST_ASSERT_EQUAL_STRING("noSuchKey", errKey);
+    TEST_ASSERT_EQUAL_STRING("0", settings.beep);
+    TEST_ASSERT_EQUAL_INT(0, SPIFFS.opensW);
+}
+
+void test_local_keys(void)
+{
+    // Would lock us out if wrong
+    TEST_ASSERT_FALSE(apply("{\"hostName\":\"other\"}"));
+    TEST_ASSERT_EQUAL_STRING("hostName", errKey);
+    TEST_ASSERT_FALSE(apply("{\"wifiConRetries\":5}"));
+    TEST_ASSERT_EQUAL_STRING("wifiConRetries", errKey);
+    TEST_ASSERT_FALSE(apply("{\"mqttServer\":\"1.2.3.4\"}"));
+    TEST_ASSERT_EQUAL_STRING("mqttServer", errKey);
+    TEST_ASSERT_EQUAL_STRING(DEF_HOSTNAME, settings.hostName);
+}
+
+void test_bad_values(void)
+{
+    static const char *bad[] = {
+        "{\"beep\":4}",                 // Out of range: refused, not clamped
+        "{\"beep\":-1}",
+        "{\"beep\":\"abc\"}",
+        "{\"beep\":1.5}",               // Float for integer setting
+        "{\"beep\":\"1000\"}",          // Too long for field
+        "{\"beep\":[1]}",
+        "{\"tempOffs\":3.5}",
+        "{\"ntpServer\":5}",            // Number for string setting
+        "{\"timeZoneNDest\":\"A name too long for it\"}",
+    };
+
+    for(unsigned int i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        setUp();
+        TEST_ASSERT_FALSE_MESSAGE(apply(bad[i]), bad[i]);
+        TEST_ASSERT_TRUE_MESSAGE(errKey[0] != 0, bad[i]);
+        TEST_ASSERT_EQUAL_INT(0, changed);
+        TEST_ASSERT_EQUAL_INT(0, SPIFFS.opensW);
+    }
+    TEST_ASSERT_EQUAL_STRING("0", settings.beep);
+}
+
+void test_time_zones(void)
+{
+    TEST_ASSERT_TRUE(apply("{\"timeZone\":\"EST5EDT,M3.2.0,M11.1.0\"}"));
+    TEST_ASSERT_EQUAL_INT(RCF_TZ, changed);
+    TEST_ASSERT_EQUAL_STRING("EST5EDT,M3.2.0,M11.1.0", settings.timeZone);
+    TEST_ASSERT_EQUAL_INT(1, tzChecks);
+
+    TEST_ASSERT_TRUE(apply("{\"timeZoneDest\":\"PST8PDT\",\"timeZoneNDest\":\"Hill Valley\"}"));
+    TEST_ASSERT_EQUAL_INT(RCF_REBOOT, changed);
+    TEST_ASSERT_EQUAL_INT(2, tzChecks);     // Names are not checked
+}
+
+void test_bad_time_zone(void)
+{
+    // All or nothing: The good setting before it is dropped as well
+    TEST_ASSERT_FALSE(apply("{\"beep\":1,\"timeZone\":\"XY\"}"));
+    TEST_ASSERT_EQUAL_STRING("timeZone", errKey);
+    TEST_ASSERT_EQUAL_STRING("UTC0", settings.timeZone);
+    TEST_ASSERT_EQUAL_STRING("0", settings.beep);
+
+    TEST_ASSERT_FALSE(apply("{\"timeZoneDep\":\"UTC\"}"));
+    TEST_ASSERT_EQUAL_STRING("timeZoneDep", errKey);
+    TEST_ASSERT_EQUAL_INT(0, SPIFFS.opensW);
+}
+
+void test_err_key_truncated(void)
+{
+    char buf[64], key[4];
+
+    strcpy(buf, "{\"someLongUnknownKey\":1}");
+    TEST_ASSERT_FALSE(applyRemoteConfig(buf, strlen(buf), changed, key, sizeof(key)));
+    TEST_ASSERT_EQUAL_STRING("som", key);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_apply);
+    RUN_TEST(test_bool_and_float);
+    RUN_TEST(test_unchanged);
+    RUN_TEST(test_bad_json);
+    RUN_TEST(test_unknown_key);
+    RUN_TEST(test_local_keys);
+    RUN_TEST(test_bad_values);
+    RUN_TEST(test_time_zones);
+    RUN_TEST(test_bad_time_zone);
+    RUN_TEST(test_err_key_truncated);
+    return UNITY_END();
+}
@@ -0,0 +1,319 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Sensor history
+ *
+ * Flash and SD are replaced by in-memory files.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define TC_HAVETEMP
+#include "sensors.cpp"
+
+// Stand-ins for what tc_settings provides
+
+bool FlashROMode = false;
+uint32_t i2cErrCount = 0;
+
+static std::map<std::string, std::vector<uint8_t> > fsFiles, sdFiles;
+static int fsWrites, sdWrites;
+
+static bool readFile(std::map<std::string, std::vector<uint8_t> >& files, const char *fn, uint8_t *buf, int len)
+{
+    std::map<std::string, std::vector<uint8_t> >::iterator it = files.find(fn);
+    if(it == files.end()) return false;
+    size_t n = std::min((size_t)len, it->second.size());
+    memcpy(buf, it->second.data(), n);
+    return (n == (size_t)len);
+}
+
+bool readFileFromSD(const char *fn, uint8_t *buf, int len)  { return readFile(sdFiles, fn, buf, len); }
+bool readFileFromFS(const char *fn, uint8_t *buf, int len)  { return readFile(fsFiles, fn, buf, len); }
+bool writeFileToSD(const char *fn, uint8_t *buf, int len)   { sdWrites++; sdFiles[fn].assign(buf, buf + len); return true; }
+bool writeFileToFS(const char *fn, uint8_t *buf, int len)   { fsWrites++; fsFiles[fn].assign(buf, buf + len); return true; }
+
+// Midnight, some day in 2023, in minutes since year 0
+#define T0  (738900UL * 24 * 60)
+
+static sensHistory *sh;
+
+static void addTemp(uint32_t stamp, int16_t temp)
+{
+    sh->add(stamp, temp, 40, 100);
+}
+
+void setUp(void)
+{
+    FlashROMode = false;
+    fsFiles.clear();
+    sdFiles.clear();
+    fsWrites = sdWrites = 0;
+    sh = new sensHistory();
+    sh->begin(false);
+}
+
+void tearDown(void)
+{
+    delete sh;
+}
+
+void test_empty(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    TEST_ASSERT_FALSE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_FALSE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_TEMP, 0));
+}
+
+void test_stats(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    for(int i = 0; i < 60; i++) {
+        sh->add(T0 + i, 200 + i, 30 + (i % 10), 1000);
+    }
+
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(200, vmin);
+    TEST_ASSERT_EQUAL_INT(259, vmax);
+    TEST_ASSERT_EQUAL_INT(230, vavg);    // 229.5, rounded
+
+    TEST_ASSERT_TRUE(sh->getStats(SH_HUM, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(30, vmin);
+    TEST_ASSERT_EQUAL_INT(39, vmax);
+    TEST_ASSERT_EQUAL_INT(35, vavg);     // 34.5, rounded
+
+    TEST_ASSERT_EQUAL_INT(259, sh->getSample(SH_TEMP, 0));
+    TEST_ASSERT_EQUAL_INT(258, sh->getSample(SH_TEMP, 1));
+    TEST_ASSERT_EQUAL_INT(200, sh->getSample(SH_TEMP, 59));
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_TEMP, 60));
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_TEMP, SH_MINS));
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_NUMCH, 0));
+}
+
+void test_negative_avg(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    addTemp(T0, -10);
+    addTemp(T0 + 1, -15);
+
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(-15, vmin);
+    TEST_ASSERT_EQUAL_INT(-10, vmax);
+    TEST_ASSERT_EQUAL_INT(-13, vavg);    // -12.5, rounded away from 0
+}
+
+void test_invalid_not_counted(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    sh->add(T0, 200, SH_INVALID, 5);
+    sh->add(T0 + 1, 210, SH_INVALID, 7);
+
+    TEST_ASSERT_FALSE(sh->getStats(SH_HUM, false, vmin, vmax, vavg));
+    TEST_ASSERT_TRUE(sh->getStats(SH_LUX, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(6, vavg);
+}
+
+void test_one_sample_per_minute(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    addTemp(T0, 100);
+    addTemp(T0, 500);
+
+    TEST_ASSERT_EQUAL_INT(100, sh->getSample(SH_TEMP, 0));
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(100, vmax);
+}
+
+void test_gap_cleared(void)
+{
+    addTemp(T0, 100);
+    addTemp(T0 + 1, 101);
+    addTemp(T0 + 10, 110);
+
+    TEST_ASSERT_EQUAL_INT(110, sh->getSample(SH_TEMP, 0));
+    for(int i = 1; i < 9; i++) {
+        TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_TEMP, i));
+    }
+    TEST_ASSERT_EQUAL_INT(101, sh->getSample(SH_TEMP, 9));
+    TEST_ASSERT_EQUAL_INT(100, sh->getSample(SH_TEMP, 10));
+}
+
+void test_gap_wraps_ring(void)
+{
+    // A gap longer than the minute ring leaves nothing but the new sample,
+    // and old samples must not show through where the ring wraps
+    for(int i = 0; i < 10; i++) addTemp(T0 + i, 100 + i);
+    addTemp(T0 + 9 + SH_MINS + 5, 999);
+
+    TEST_ASSERT_EQUAL_INT(999, sh->getSample(SH_TEMP, 0));
+    for(int i = 1; i < SH_MINS; i++) {
+        TEST_ASSERT_EQUAL_INT(SH_INVALID, sh->getSample(SH_TEMP, i));
+    }
+}
+
+void test_backward_step_dropped(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    for(int i = 0; i < 6; i++) addTemp(T0 + i, 100);
+
+    // Clock corrected back by 3 minutes: Drop until it has caught up
+    addTemp(T0 + 2, 500);
+    addTemp(T0 + 5, 500);
+    TEST_ASSERT_EQUAL_INT(100, sh->getSample(SH_TEMP, 0));
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(100, vmax);
+
+    addTemp(T0 + 6, 200);
+    TEST_ASSERT_EQUAL_INT(200, sh->getSample(SH_TEMP, 0));
+    TEST_ASSERT_EQUAL_INT(100, sh->getSample(SH_TEMP, 6));
+}
+
+void test_far_jump_resets(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    addTemp(T0, 100);
+    addTemp(T0 + SH_DAYS * SH_MINS, 300);
+
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(300, vmin);
+    TEST_ASSERT_EQUAL_INT(300, vmax);
+
+    // Far back resets as well
+    addTemp(T0, 50);
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(50, vmin);
+    TEST_ASSERT_EQUAL_INT(50, vmax);
+}
+
+void test_day_and_month(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    addTemp(T0 + 30, 100);
+    addTemp(T0 + 30 + 25 * 60, 300);
+
+    // Older than 24 hours: Gone from the daily, still in the monthly stats
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(300, vmin);
+    TEST_ASSERT_EQUAL_INT(300, vmax);
+
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(100, vmin);
+    TEST_ASSERT_EQUAL_INT(300, vmax);
+    TEST_ASSERT_EQUAL_INT(200, vavg);
+
+    // The month includes today; 30 days later, the first day is gone
+    addTemp(T0 + 30 + (SH_DAYS - 1) * SH_MINS, 200);
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(100, vmin);
+    addTemp(T0 + 30 + SH_DAYS * SH_MINS, 200);
+    TEST_ASSERT_TRUE(sh->getStats(SH_TEMP, true, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(200, vmin);
+    TEST_ASSERT_EQUAL_INT(300, vmax);
+}
+
+void test_hourly_save(void)
+{
+    for(int i = 0; i < 60; i++) addTemp(T0 + i, 100);
+    TEST_ASSERT_EQUAL_INT(0, fsWrites);
+
+    addTemp(T0 + 60, 100);
+    TEST_ASSERT_EQUAL_INT(1, fsWrites);
+    TEST_ASSERT_EQUAL_INT(0, sdWrites);
+
+    // Nothing new, nothing written
+    sh->save();
+    TEST_ASSERT_EQUAL_INT(1, fsWrites);
+}
+
+void test_save_load(void)
+{
+    int16_t vmin, vmax, vavg;
+
+    for(int i = 0; i < 30; i++) addTemp(T0 + i, 100 + i);
+    sh->save();
+    TEST_ASSERT_EQUAL_INT(1, fsWrites);
+
+    sensHistory sh2;
+    sh2.begin(false);
+    TEST_ASSERT_EQUAL_INT(129, sh2.getSample(SH_TEMP, 0));
+    TEST_ASSERT_TRUE(sh2.getStats(SH_TEMP, false, vmin, vmax, vavg));
+    TEST_ASSERT_EQUAL_INT(100, vmin);
+    TEST_ASSERT_EQUAL_INT(129, vmax);
+
+    // Continues where it left off
+    sh2.add(T0 + 30, 130, 0, 0);
+    TEST_ASSERT_EQUAL_INT(129, sh2.getSample(SH_TEMP, 1));
+}
+
+void test_load_rejects(void)
+{
+    for(int i = 0; i < 30; i++) addTemp(T0 + i, 100 + i);
+    sh->save();
+
+    // Other temperature unit
+    sensHistory sh2;
+    sh2.begin(true);
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh2.getSample(SH_TEMP, 0));
+
+    // Damaged data
+    fsFiles.begin()->second[100] ^= 0x01;
+    sensHistory sh3;
+    sh3.begin(false);
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh3.getSample(SH_TEMP, 0));
+
+    // Truncated file
+    fsFiles.begin()->second.resize(100);
+    sensHistory sh4;
+    sh4.begin(false);
+    TEST_ASSERT_EQUAL_INT(SH_INVALID, sh4.getSample(SH_TEMP, 0));
+}
+
+void test_flashro_uses_sd(void)
+{
+    FlashROMode = true;
+
+    addTemp(T0, 100);
+    sh->save();
+    TEST_ASSERT_EQUAL_INT(0, fsWrites);
+    TEST_ASSERT_EQUAL_INT(1, sdWrites);
+
+    sensHistory sh2;
+    sh2.begin(false);
+    TEST_ASSERT_EQUAL_INT(100, sh2.getSample(SH_TEMP, 0));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_stats);
+    RUN_TEST(test_negative_avg);
+    RUN_TEST(test_invalid_not_counted);
+    RUN_TEST(test_one_sample_per_minute);
+    RUN_TEST(test_gap_cleared);
+    RUN_TEST(test_gap_wraps_ring);
+    RUN_TEST(test_backward_step_dropped);
+    RUN_TEST(test_far_jump_resets);
+    RUN_TEST(test_day_and_month);
+    RUN_TEST(test_hourly_save);
+    RUN_TEST(test_save_load);
+    RUN_TEST(test_load_rejects);
+    RUN_TEST(test_flashro_uses_sd);
+    return UNITY_END();
+}
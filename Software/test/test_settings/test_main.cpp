@@ -0,0 +1,205 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Settings schema
+ *
+ * Everything write_settings() puts in the config file must come 
+ * back unchanged through read_settings(); bad or missing values
+ * are corrected.
+ * Built with all optional hardware so that the whole schema is
+ * covered.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#define TC_HAVETEMP
+#define TC_HAVELIGHT
+#define TC_HAVESPEEDO
+#define TC_HAVEGPS
+#include "tc_settings.cpp"
+
+// Stand-ins for what other modules provide
+
+Settings   settings;
+IPSettings ipsettings;
+
+bool    alarmOnOff = false;
+uint8_t alarmHour = 255;
+uint8_t alarmMinute = 255;
+uint8_t alarmWeekday = 0;
+uint8_t remMonth = 0, remDay = 0, remHour = 0, remMin = 0;
+uint8_t curVolume = 0;
+
+bool checkTZ(const char *tz) { return true; }
+
+clockDisplay::clockDisplay(uint8_t did, uint8_t address) { }
+void clockDisplay::showTextDirect(const char *text, uint16_t flags) { }
+clockDisplay destinationTime(DISP_DEST, 0x71);   // Only used for "WAIT" at boot
+
+void start_file_copy() { }
+void file_copy_progress() { }
+void file_copy_done() { }
+void file_copy_error() { }
+
+static char *setting(int i)
+{
+    return (char *)&settings + settingsSchema[i].offs;
+}
+
+// A valid value different from the default
+static void makeValue(int i, char *buf)
+{
+    switch(settingsSchema[i].type) {
+    case SCT_NUM:
+        if((int)settingsSchema[i].upperLim != (int)settingsSchema[i].defVal) {
+            sprintf(buf, "%d", (int)settingsSchema[i].upperLim);
+        } else {
+            sprintf(buf, "%d", (int)settingsSchema[i].lowerLim);
+        }
+        break;
+    case SCT_FLOAT:
+        sprintf(buf, "%1.1f", settingsSchema[i].lowerLim);
+        break;
+    case SCT_STR:
+        snprintf(buf, settingsSchema[i].size, "v%d", i);
+        break;
+    }
+}
+
+static bool readBack()
+{
+    File configFile = SPIFFS.open(cfgName, "r");
+    bool ret;
+
+    TEST_ASSERT_TRUE(configFile);
+    ret = read_settings(configFile);
+    configFile.close();
+
+    return ret;
+}
+
+void setUp(void)
+{
+    SPIFFS.reset();
+    nvsPrefs.clear();
+    haveFS = haveNVS = true;
+    FlashROMode = false;
+    settings = Settings();
+}
+
+void tearDown(void)
+{
+}
+
+void test_schema(void)
+{
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        TEST_ASSERT_TRUE_MESSAGE(settingsSchema[i].offs + settingsSchema[i].size <= sizeof(settings), settingsSchema[i].key);
+        for(int j = 0; j < i; j++) {
+            TEST_ASSERT_TRUE_MESSAGE(strcmp(settingsSchema[i].key, settingsSchema[j].key), settingsSchema[i].key);
+            TEST_ASSERT_TRUE_MESSAGE(settingsSchema[i].offs != settingsSchema[j].offs, settingsSchema[i].key);
+        }
+        if(settingsSchema[i].type != SCT_STR) {
+            TEST_ASSERT_TRUE_MESSAGE(settingsSchema[i].defVal >= settingsSchema[i].lowerLim &&
+                                     settingsSchema[i].defVal <= settingsSchema[i].upperLim, settingsSchema[i].key);
+        }
+    }
+}
+
+void test_defaults_valid(void)
+{
+    Settings defaults;
+
+    // Struct defaults must pass the checks on reading
+    write_settings();
+    TEST_ASSERT_FALSE(readBack());
+    TEST_ASSERT_EQUAL_MEMORY(&defaults, &settings, sizeof(settings));
+}
+
+void test_round_trip(void)
+{
+    char buf[NUM_SETTINGS][16];
+
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        makeValue(i, buf[i]);
+        strcpy(setting(i), buf[i]);
+    }
+
+    write_settings();
+
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        char key[48];
+        snprintf(key, sizeof(key), "\"%s\":", settingsSchema[i].key);
+        TEST_ASSERT_TRUE_MESSAGE(SPIFFS.content(cfgName).find(key) != std::string::npos, key);
+    }
+
+    settings = Settings();
+    TEST_ASSERT_FALSE(readBack());
+
+    for(int i = 0; i < NUM_SETTINGS; i++) {
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(buf[i], setting(i), settingsSchema[i].key);
+    }
+}
+
+void test_corrected(void)
+{
+    SPIFFS.setContent(cfgName, "{\"beep\":\"9\",\"autoNMOn\":\"abc\",\"destTimeBright\":\"007\","
+                               "\"tempOffs\":\"-9\",\"speedoFact\":\"3.\"}");
+
+    // Missing and bad values mean the file needs to be rewritten
+    TEST_ASSERT_TRUE(readBack());
+    TEST_ASSERT_EQUAL_STRING("3", settings.beep);
+    TEST_ASSERT_EQUAL_STRING("0", settings.autoNMOn);
+    TEST_ASSERT_EQUAL_STRING("7", settings.destTimeBright);
+    TEST_ASSERT_EQUAL_STRING("-3.0", settings.tempOffs);
+    TEST_ASSERT_EQUAL_STRING("3.0", settings.speedoFact);
+    TEST_ASSERT_EQUAL_STRING(DEF_HOSTNAME, settings.hostName);
+}
+
+void test_long_string(void)
+{
+    char json[128];
+
+    snprintf(json, sizeof(json), "{\"timeZoneNDest\":\"%s\"}", "A name much too long");
+    SPIFFS.setContent(cfgName, json);
+
+    readBack();
+    TEST_ASSERT_EQUAL_INT(sizeof(settings.timeZoneNDest) - 1, strlen(settings.timeZoneNDest));
+}
+
+void test_legacy_keys(void)
+{
+    SPIFFS.setContent(cfgName, "{\"autoNMPreset\":\"2\",\"autoNM\":\"0\",\"speedoType\":\"1\",\"useSpeedo\":\"0\"}");
+    readBack();
+    TEST_ASSERT_EQUAL_STRING("10", settings.autoNMPreset);
+    TEST_ASSERT_EQUAL_STRING("99", settings.speedoType);
+
+    SPIFFS.setContent(cfgName, "{\"autoNMPreset\":\"2\",\"autoNM\":\"1\",\"speedoType\":\"1\",\"useSpeedo\":\"1\"}");
+    readBack();
+    TEST_ASSERT_EQUAL_STRING("2", settings.autoNMPreset);
+    TEST_ASSERT_EQUAL_STRING("1", settings.speedoType);
+}
+
+void test_bad_file(void)
+{
+    SPIFFS.setContent(cfgName, "{\"beep\":\"1\",");
+    TEST_ASSERT_TRUE(readBack());
+    TEST_ASSERT_EQUAL_STRING("0", settings.beep);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_schema);
+    RUN_TEST(test_defaults_valid);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_corrected);
+    RUN_TEST(test_long_string);
+    RUN_TEST(test_legacy_keys);
+    RUN_TEST(test_bad_file);
+    return UNITY_END();
+}
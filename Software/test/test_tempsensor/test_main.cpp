@@ -0,0 +1,225 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Temperature sensor on a mock i2c bus
+ *
+ * Checks detection, conversion and the non-blocking read: A read
+ * issued while the sensor is still converting must not touch the
+ * bus; loop() collects the result once the conversion is done.
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#define TC_HAVETEMP
+#include "sensors.cpp"
+
+bool FlashROMode = false;
+uint32_t i2cErrCount = 0;
+
+bool readFileFromSD(const char *fn, uint8_t *buf, int len)  { return false; }
+bool readFileFromFS(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToSD(const char *fn, uint8_t *buf, int len)   { return false; }
+bool writeFileToFS(const char *fn, uint8_t *buf, int len)   { return false; }
+
+static uint8_t sensCRC8(const uint8_t *buf)
+{
+    uint8_t crc = 0xff;
+
+    for(int j = 0; j < 2; j++) {
+        crc ^= buf[j];
+        for(int i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/*
+ * SHT4x: Command based, every read returns the result
+ * of the last measurement triggered
+ */
+class SHT40Dev : public I2CDevice {
+    public:
+        void write(const uint8_t *buf, size_t len)
+        {
+            if(buf[0] == 0xe0 || buf[0] == 0xf6 || buf[0] == 0xfd) {
+                triggers++;
+                result[0] = rawTemp >> 8;
+                result[1] = rawTemp & 0xff;
+                result[2] = sensCRC8(result) ^ (badCRC ? 1 : 0);
+                result[3] = rawHum >> 8;
+                result[4] = rawHum & 0xff;
+                result[5] = sensCRC8(result + 3);
+            }
+        }
+
+        size_t read(uint8_t *buf, size_t len)
+        {
+            memcpy(buf, result, std::min(len, sizeof(result)));
+            return std::min(len, sizeof(result));
+        }
+
+        uint16_t rawTemp = 0x6666;      // 25.00C
+        uint16_t rawHum  = 0x8000;      // 56%
+        bool     badCRC = false;
+        int      triggers = 0;
+        uint8_t  result[6];
+};
+
+static I2CRegDevice *mcp;
+static SHT40Dev     *sht;
+
+static uint8_t mcpAddr[] = { 0x18, MCP9808 };
+static uint8_t shtAddr[] = { 0x44, SHT40 };
+static uint8_t bothAddr[] = { 0x18, MCP9808, 0x44, SHT40 };
+
+void setUp(void)
+{
+    stubMillis() = 1000;
+    Wire.detachAll();
+    mcp = new I2CRegDevice(2);
+    mcp->set16(0x06, 0x0054);   // Manufacturer ID
+    mcp->set16(0x07, 0x0400);   // Device ID
+    mcp->set16(0x05, 0x0190);   // 25.00C
+    sht = new SHT40Dev();
+}
+
+void tearDown(void)
+{
+    delete mcp;
+    delete sht;
+}
+
+void test_no_sensor(void)
+{
+    tempSensor ts(2, bothAddr);
+
+    TEST_ASSERT_FALSE(ts.begin(0));
+}
+
+void test_mcp9808(void)
+{
+    tempSensor ts(1, mcpAddr);
+
+    Wire.attach(0x18, mcp);
+    TEST_ASSERT_TRUE(ts.begin(0));
+    TEST_ASSERT_FALSE(ts.haveHum());
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.0, ts.readTemp(true));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 77.0, ts.readTemp(false));
+
+    // Below zero (larger jump: no smoothing)
+    mcp->set16(0x05, 0x1f90);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, -7.0, ts.readTemp(true));
+}
+
+void test_smoothing_and_offset(void)
+{
+    tempSensor ts(1, mcpAddr);
+
+    Wire.attach(0x18, mcp);
+    ts.begin(0);
+    ts.setOffset(-1.5);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 23.5, ts.readTemp(true));
+    mcp->set16(0x05, 0x0198);   // 25.50C
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 23.75, ts.readTemp(true));
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 23.75, ts.readLastTemp());
+}
+
+void test_probe_order(void)
+{
+    tempSensor ts(2, bothAddr);
+
+    // MCP9808 missing, SHT4x found next
+    Wire.attach(0x44, sht);
+    TEST_ASSERT_TRUE(ts.begin(0));
+    TEST_ASSERT_TRUE(ts.haveHum());
+}
+
+void test_sht40_nonblocking(void)
+{
+    tempSensor ts(1, shtAddr);
+    int trans, trig;
+
+    Wire.attach(0x44, sht);
+    TEST_ASSERT_TRUE(ts.begin(0));
+    TEST_ASSERT_TRUE(ts.haveHum());
+
+    // Conversion triggered by begin() still running: No bus access
+    trans = Wire.transactions;
+    trig = sht->triggers;
+    TEST_ASSERT_TRUE(isnan(ts.readTemp(true)));
+    TEST_ASSERT_FALSE(ts.loop());
+    stubMillis() += 5;
+    TEST_ASSERT_FALSE(ts.loop());
+    TEST_ASSERT_EQUAL_INT(trans, Wire.transactions);
+
+    // Done: loop() collects and triggers the next conversion
+    stubMillis() += 5;
+    TEST_ASSERT_TRUE(ts.loop());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.0, ts.readLastTemp());
+    TEST_ASSERT_EQUAL_INT(56, ts.readHum());
+    TEST_ASSERT_EQUAL_INT(trig + 1, sht->triggers);
+
+    // Nothing pending anymore
+    TEST_ASSERT_FALSE(ts.loop());
+
+    // Read after the conversion time: Immediate, returns the
+    // result of the conversion triggered by the previous read
+    stubMillis() += 1000;
+    sht->rawTemp = 0x6a00;      // 27.46C
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.0, ts.readTemp(true));
+    stubMillis() += 10;
+    TEST_ASSERT_FLOAT_WITHIN(0.011, 27.46, ts.readTemp(true));
+}
+
+void test_sht40_fahrenheit_pending(void)
+{
+    tempSensor ts(1, shtAddr);
+
+    Wire.attach(0x44, sht);
+    ts.begin(0);
+
+    // Unit requested with the read applies when the result is collected
+    ts.readTemp(false);
+    stubMillis() += 10;
+    TEST_ASSERT_TRUE(ts.loop());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 77.0, ts.readLastTemp());
+}
+
+void test_sht40_bad_crc(void)
+{
+    tempSensor ts(1, shtAddr);
+
+    Wire.attach(0x44, sht);
+    ts.begin(0);
+    stubMillis() += 10;
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.0, ts.readTemp(true));
+
+    // Result of the conversion triggered next is damaged
+    sht->badCRC = true;
+    stubMillis() += 10;
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 25.0, ts.readTemp(true));
+    stubMillis() += 10;
+    TEST_ASSERT_TRUE(isnan(ts.readTemp(true)));
+    TEST_ASSERT_EQUAL_INT(56, ts.readHum());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_sensor);
+    RUN_TEST(test_mcp9808);
+    RUN_TEST(test_smoothing_and_offset);
+    RUN_TEST(test_probe_order);
+    RUN_TEST(test_sht40_nonblocking);
+    RUN_TEST(test_sht40_fahrenheit_pending);
+    RUN_TEST(test_sht40_bad_crc);
+    return UNITY_END();
+}
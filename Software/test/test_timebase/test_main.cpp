@@ -0,0 +1,458 @@
+/*
+ * -------------------------------------------------------------------
+ * CircuitSetup.us Time Circuits Display
+ * (C) 2023 Thomas Winischhofer (A10001986)
+ * https://github.com/realA10001986/Time-Circuits-Display
+ *
+ * Native unit tests: Software time base
+ *
+ * The time base (timeBaseNow/timeBaseSet plus DateTime::addSecond)
+ * and the incremental display update (advanceMinute) are stepped
+ * second by second against a simulated RTC, next to the former
+ * per-second path (read RTC, full display update). Both must agree
+ * every second, across month ends, leap years, DST changes, millis()
+ * wrapping, missed ticks, time travels and clock changes via menu.
+ * (Over 10 years, only the interesting days are stepped through;
+ * doing all of them would take minutes.)
+ * -------------------------------------------------------------------
+ */
+
+#include <unity.h>
+
+#include "rtc.cpp"
+#include "clockdisplay.cpp"
+#include "tc_timebase.cpp"
+
+// Stand-ins for what other modules provide
+
+bool     alarmOnOff = false;
+uint64_t timeDifference = 0;
+bool     timeDiffUp = false;
+bool     FlashROMode = false;
+uint32_t i2cErrCount = 0;
+
+bool readFileFromSD(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToSD(const char *fn, uint8_t *buf, int len)   { return false; }
+bool readFileFromFS(const char *fn, uint8_t *buf, int len)  { return false; }
+bool writeFileToFS(const char *fn, uint8_t *buf, int len)   { return false; }
+void removeFileFromFS(const char *fn) { }
+bool readBlobFromNVS(const char *key, uint8_t *buf, int len) { return false; }
+bool writeBlobToNVS(const char *key, uint8_t *buf, int len)  { return false; }
+
+#define DISP_ADDR 0x71
+
+// Date math, independent of tc_time.cpp's tables
+// (days since 1970-01-01, proleptic Gregorian)
+
+static int64_t daysFromCivil(int y, int m, int d)
+{
+    y -= (m <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civilFromDays(int64_t z, int& y, int& m, int& d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp + (mp < 10 ? 3 : -9);
+    y = yoe + era * 400 + (m <= 2);
+}
+
+// Offset keeps year 1 positive
+#define MINS_OFFS (800000LL * 24 * 60)
+
+uint64_t dateToMins(int year, int month, int day, int hour, int minute)
+{
+    return daysFromCivil(year, month, day) * 24 * 60 + hour * 60 + minute + MINS_OFFS;
+}
+
+void minsToDate(uint64_t total, int& year, int& month, int& day, int& hour, int& minute)
+{
+    int64_t t = (int64_t)total - MINS_OFFS;
+    int64_t days = t / (24 * 60);
+    int mins = t % (24 * 60);
+
+    civilFromDays(days, year, month, day);
+    hour = mins / 60;
+    minute = mins % 60;
+}
+
+int daysInMonth(int month, int year)
+{
+    int ny = (month == 12) ? year + 1 : year;
+    int nm = (month == 12) ? 1 : month + 1;
+
+    return daysFromCivil(ny, nm, 1) - daysFromCivil(year, month, 1);
+}
+
+// Simulated RTC (seconds since 1970; DateTime covers 2000-2099)
+
+static int64_t rtcSecs;
+static int     rtcReads;
+
+// (Day conversions cached; the simulation runs for 10 years)
+static void secsToDT(int64_t secs, DateTime& dt)
+{
+    static int64_t lastDays = -1;
+    static int y, m, d;
+    int64_t days = secs / (24*60*60);
+    int s = secs % (24*60*60);
+
+    if(days != lastDays) {
+        civilFromDays(days, y, m, d);
+        lastDays = days;
+    }
+    dt.set(y - 2000, m, d, s / 3600, (s / 60) % 60, s % 60);
+}
+
+static int64_t dtToSecs(DateTime& dt)
+{
+    static uint16_t lastY;
+    static uint8_t  lastM = 0, lastD;
+    static int64_t  days;
+
+    if(dt.year() != lastY || dt.month() != lastM || dt.day() != lastD) {
+        lastY = dt.year();
+        lastM = dt.month();
+        lastD = dt.day();
+        days = daysFromCivil(lastY, lastM, lastD);
+    }
+
+    return days * 24*60*60 + dt.hour() * 3600 + dt.minute() * 60 + dt.second();
+}
+
+void myrtcnow(DateTime& dt)
+{
+    rtcReads++;
+    secsToDT(rtcSecs, dt);
+}
+
+// Deterministic pseudo random numbers
+static uint32_t rndState;
+
+static uint32_t rnd(uint32_t range)
+{
+    rndState = rndState * 1664525 + 1013904223;
+    return (rndState >> 8) % range;
+}
+
+// EU DST: Last Sunday of March 02:00 to last Sunday of October
+// 02:00, in standard time
+static int64_t dstDays = -1, dstStart, dstEnd;
+
+static int64_t lastSunday(int year, int month)
+{
+    int64_t d = daysFromCivil(year, month, 31);
+
+    // 1970-01-01 was a Thursday
+    return d - ((d + 4) % 7);
+}
+
+static bool inDSTPeriod(int64_t stdSecs)
+{
+    int y, m, d;
+
+    if(stdSecs / (24*60*60) != dstDays) {
+        dstDays = stdSecs / (24*60*60);
+        civilFromDays(dstDays, y, m, d);
+        dstStart = lastSunday(y, 3) * 24*60*60 + 2*3600;
+        dstEnd = lastSunday(y, 10) * 24*60*60 + 2*3600;
+    }
+
+    return (stdSecs >= dstStart) && (stdSecs < dstEnd);
+}
+
+typedef struct {
+    int seconds;
+    int dstChanges;
+    int wraps;
+    int leapDays;
+    int monthEnds;
+    int missedTicks;
+    int menuSets;
+    int timeTravels;
+} simStats;
+
+#define SIM_JITTER      1   // SQW seen up to 300ms early/late
+#define SIM_MISSTICKS   2   // Occasionally blocked for over a second
+#define SIM_TIMETRAVEL  4   // Change timeDifference every few days
+#define SIM_MENUSET     8   // Set RTC via "menu" every few weeks
+
+static int64_t toSecs(int year, int month, int day, int hour, int minute)
+{
+    return daysFromCivil(year, month, day) * 24*60*60 + hour * 3600 + minute * 60;
+}
+
+/*
+ * Step both paths for "seconds" seconds, starting at the given time
+ * (local, standard time; see toSecs()) and millis() value. Fails on 
+ * the first mismatch.
+ */
+static void simulate(int64_t start, uint32_t startMillis, int seconds, int flags, simStats& st)
+{
+    clockDisplay presentA(DISP_PRES, DISP_ADDR);    // Time base + advanceMinute
+    clockDisplay presentB(DISP_PRES, DISP_ADDR);    // RTC + full update
+    DateTime dtA, dtB, lastB;
+    uint64_t lastTD = 0;
+    bool lastTDUp = false, haveB = false;
+    bool dstOn = false;
+    char msg[160];
+
+    memset(&st, 0, sizeof(st));
+
+    rtcSecs = start;
+    stubMillis() = startMillis;
+    timeDifference = 0;
+    timeDiffUp = false;
+    timeBaseInvalidate();
+
+    // Start as time_setup() would: Clock correct for DST
+    if(inDSTPeriod(rtcSecs)) {
+        dstOn = true;
+        rtcSecs += 3600;
+    }
+
+    while(st.seconds < seconds) {
+
+        int secs = 1;
+        uint32_t ms = 1000;
+
+        if((flags & SIM_JITTER) && !rnd(4)) {
+            ms += rnd(601) - 300;
+        }
+        if((flags & SIM_MISSTICKS) && !rnd(100000)) {
+            secs = 2 + rnd(3);
+            ms = secs * 1000 + rnd(300);
+            st.missedTicks++;
+        }
+        if((flags & SIM_TIMETRAVEL) && !rnd(3*24*60*60)) {
+            timeDifference = rnd(50*365) * 24 * 60 + rnd(24*60);
+            timeDiffUp = rnd(2);
+            st.timeTravels++;
+        }
+        if((flags & SIM_MENUSET) && !rnd(30*24*60*60)) {
+            // User corrects the clock in the menu; this
+            // does not happen at a tick
+            rtcSecs += (int)rnd(2*24*60*60) - 24*60*60;
+            timeBaseInvalidate();
+            st.menuSets++;
+        }
+
+        if((uint32_t)stubMillis() > (uint32_t)(stubMillis() + ms)) {
+            st.wraps++;
+        }
+        stubMillis() += ms;
+        rtcSecs += secs;
+        st.seconds += secs;
+
+        // Path A: As time_loop() does it
+
+        timeBaseNow(dtA);
+
+        if(inDSTPeriod(dtToSecs(dtA) - (dstOn ? 3600 : 0)) != dstOn) {
+            dstOn = !dstOn;
+            rtcSecs += dstOn ? 3600 : -3600;
+            secsToDT(dtToSecs(dtA) + (dstOn ? 3600 : -3600), dtA);
+            st.dstChanges++;
+        }
+
+        presentA.setDateTimeDiff(dtA);
+        timeBaseSet(dtA);
+
+        // Path B: RTC read every second, display fully updated
+        // (the display only depends on the minute and the time
+        // difference, so skip re-doing the same update)
+
+        secsToDT(rtcSecs, dtB);
+        if(!haveB || dtB.minute() != lastB.minute() || dtB.hour() != lastB.hour() ||
+           dtB.day() != lastB.day() || dtB.month() != lastB.month() || timeDifference != lastTD || timeDiffUp != lastTDUp) {
+            presentB.setFromParms(2000, 1, 1, 0, 0);
+            presentB.setDateTimeDiff(dtB);
+            lastB = dtB;
+            haveB = true;
+            lastTD = timeDifference;
+            lastTDUp = timeDiffUp;
+        }
+
+        if(dtB.day() == 29 && dtB.month() == 2 && !dtB.hour() && !dtB.minute() && !dtB.second()) {
+            st.leapDays++;
+        }
+        if(dtB.day() == 1 && !dtB.hour() && !dtB.minute() && !dtB.second()) {
+            st.monthEnds++;
+        }
+
+        if(dtA.second() != dtB.second() || dtA.minute() != dtB.minute() ||
+           dtA.hour()   != dtB.hour()   || dtA.day()    != dtB.day()    ||
+           dtA.month()  != dtB.month()  || dtA.year()   != dtB.year()   ||
+           presentA.getYear()   != presentB.getYear()   ||
+           presentA.getMonth()  != presentB.getMonth()  ||
+           presentA.getDay()    != presentB.getDay()    ||
+           presentA.getHour()   != presentB.getHour()   ||
+           presentA.getMinute() != presentB.getMinute()) {
+            snprintf(msg, sizeof(msg), "%04d-%02d-%02d %02d:%02d:%02d (shown %04d-%02d-%02d %02d:%02d) vs "
+                                       "%04d-%02d-%02d %02d:%02d:%02d (shown %04d-%02d-%02d %02d:%02d)",
+                dtA.year(), dtA.month(), dtA.day(), dtA.hour(), dtA.minute(), dtA.second(),
+                presentA.getYear(), presentA.getMonth(), presentA.getDay(), presentA.getHour(), presentA.getMinute(),
+                dtB.year(), dtB.month(), dtB.day(), dtB.hour(), dtB.minute(), dtB.second(),
+                presentB.getYear(), presentB.getMonth(), presentB.getDay(), presentB.getHour(), presentB.getMinute());
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+}
+
+void setUp(void)
+{
+    Wire.detachAll();
+    rndState = 1985;
+    rtcReads = 0;
+}
+
+void tearDown(void)
+{
+}
+
+// Four months through a leap February and a DST change, with 
+// everything that can happen on the way
+void test_months(void)
+{
+    simStats st;
+    int64_t start = toSecs(2028, 1, 1, 0, 0);
+
+    simulate(start, 0xffffffff - 5000, toSecs(2028, 5, 1, 0, 0) - start,
+             SIM_JITTER | SIM_MISSTICKS | SIM_TIMETRAVEL | SIM_MENUSET, st);
+
+    TEST_ASSERT_EQUAL(1, st.dstChanges);
+    TEST_ASSERT_EQUAL(1, st.leapDays);
+    TEST_ASSERT_GREATER_OR_EQUAL(4, st.monthEnds);
+    TEST_ASSERT_GREATER_OR_EQUAL(3, st.wraps);
+    TEST_ASSERT_GREATER_THAN(0, st.missedTicks);
+    TEST_ASSERT_GREATER_THAN(0, st.timeTravels);
+    TEST_ASSERT_GREATER_THAN(0, st.menuSets);
+
+    // RTC read every RTC_RESYNC_MINS minutes, plus once after
+    // each missed tick, DST change and menu set
+    int expReads = st.seconds / (RTC_RESYNC_MINS*60);
+    TEST_ASSERT_GREATER_OR_EQUAL(expReads, rtcReads);
+    TEST_ASSERT_LESS_OR_EQUAL(expReads + st.missedTicks + st.menuSets + st.dstChanges + 2, rtcReads);
+}
+
+// Three days around a given time; millis() wraps close to it
+static void window(int year, int month, int day, int hour, simStats& st)
+{
+    simulate(toSecs(year, month, day, hour, 0) - 36*60*60,
+             0 - (36*60*60*1000 + rnd(10000) - 5000), 72*60*60,
+             SIM_JITTER | SIM_MISSTICKS | SIM_TIMETRAVEL, st);
+
+    TEST_ASSERT_EQUAL(1, st.wraps);
+}
+
+// 2023-2032: End of February, DST changes, New Year
+void test_ten_years(void)
+{
+    simStats st;
+    int leapDays = 0, dstChanges = 0;
+
+    for(int y = 2023; y <= 2032; y++) {
+        window(y, 3, 1, 0, st);
+        leapDays += st.leapDays;
+        window(y, 3, lastSunday(y, 3) - daysFromCivil(y, 3, 0), 2, st);
+        TEST_ASSERT_EQUAL(1, st.dstChanges);
+        dstChanges += st.dstChanges;
+        window(y, 10, lastSunday(y, 10) - daysFromCivil(y, 10, 0), 2, st);
+        TEST_ASSERT_EQUAL(1, st.dstChanges);
+        dstChanges += st.dstChanges;
+        window(y + 1, 1, 1, 0, st);
+        TEST_ASSERT_EQUAL(1, st.monthEnds);
+    }
+
+    TEST_ASSERT_EQUAL(3, leapDays);
+    TEST_ASSERT_EQUAL(20, dstChanges);
+}
+
+// millis() wraps between two ticks
+void test_millis_wrap(void)
+{
+    simStats st;
+
+    for(int i = 0; i < 3000; i += 250) {
+        rtcReads = 0;
+        simulate(toSecs(2024, 12, 31, 23, 50), 0xffffffff - i, 20*60, 0, st);
+        TEST_ASSERT_EQUAL(1, st.wraps);
+        TEST_ASSERT_EQUAL(3, rtcReads);
+    }
+}
+
+// Day carry in addSecond(), for every day DateTime covers. (In
+// timeBaseNow(), this is hidden by the RTC read at 00:00:00.)
+void test_addsecond_days(void)
+{
+    DateTime dt, exp;
+    char msg[16];
+
+    for(int64_t d = daysFromCivil(2000, 1, 1); d < daysFromCivil(2099, 12, 31); d++) {
+        secsToDT(d * 24*60*60 + 24*60*60 - 1, dt);
+        dt.addSecond();
+        secsToDT((d + 1) * 24*60*60, exp);
+        snprintf(msg, sizeof(msg), "%04d-%02d-%02d", exp.year(), exp.month(), exp.day());
+        TEST_ASSERT_TRUE_MESSAGE(dt.year() == exp.year() && dt.month() == exp.month() &&
+                                 dt.day() == exp.day() && !dt.hour() && !dt.minute() &&
+                                 !dt.second(), msg);
+    }
+}
+
+// A missed tick must cause a re-read, not a second off
+void test_missed_tick(void)
+{
+    DateTime dt;
+
+    rtcSecs = toSecs(2024, 2, 28, 23, 59) + 58;
+    stubMillis() = 5000;
+    timeBaseInvalidate();
+    timeBaseNow(dt);
+    timeBaseSet(dt);
+    TEST_ASSERT_EQUAL(1, rtcReads);
+
+    // Regular tick: From memory
+    rtcSecs++;
+    stubMillis() += 1000;
+    timeBaseNow(dt);
+    timeBaseSet(dt);
+    TEST_ASSERT_EQUAL(1, rtcReads);
+    TEST_ASSERT_EQUAL(59, dt.second());
+
+    // Tick missed: RTC is read
+    rtcSecs += 2;
+    stubMillis() += 2000;
+    timeBaseNow(dt);
+    timeBaseSet(dt);
+    TEST_ASSERT_EQUAL(2, rtcReads);
+    TEST_ASSERT_EQUAL(29, dt.day());
+    TEST_ASSERT_EQUAL(0, dt.minute());
+    TEST_ASSERT_EQUAL(1, dt.second());
+
+    // Spurious early tick: RTC is read
+    stubMillis() += SQW_TICK_MIN;
+    timeBaseNow(dt);
+    TEST_ASSERT_EQUAL(3, rtcReads);
+    TEST_ASSERT_EQUAL(1, dt.second());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_addsecond_days);
+    RUN_TEST(test_missed_tick);
+    RUN_TEST(test_millis_wrap);
+    RUN_TEST(test_months);
+    RUN_TEST(test_ten_years);
+    return UNITY_END();
+}